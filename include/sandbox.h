@@ -17,25 +17,191 @@
 #include <limits.h>
 #include <linux/limits.h>
 #include <libgen.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/random.h>
+#include <pthread.h>
+#include "syscall_nr.h"  // 构建时由内核头文件生成
 
 #define STACK_SIZE (1024 * 1024)  // 子进程栈大小
+#define MAX_TRACED_SYSCALLS 128   // seccomp过滤模式下最多跟踪的系统调用数
+#define DEFAULT_TEMPLATE_DIR "/var/cache/malbox/templates"  // 根文件系统模板缓存目录
+#define DEFAULT_CGROUP_NAME "malbox"   // cgroup v2挂载点下存放各沙箱cgroup的目录
+#define CGROUP_CPU_PERIOD_US 100000    // cpu.max的周期
+
+// 系统调用计数器大小，取各ABI中最大的系统调用号
+#if SYSCALL_NR_MAX_64 > SYSCALL_NR_MAX_32
+#define SYSCALL_MAX (SYSCALL_NR_MAX_64 + 1)
+#else
+#define SYSCALL_MAX (SYSCALL_NR_MAX_32 + 1)
+#endif
+
 
 // 沙箱配置结构体
 typedef struct {
     char *binary_path;         // 可执行文件路径
     char *binary_name;         // 可执行文件名
     int using_default;         // 是否使用默认程序
-    // 可以添加更多配置选项，如网络模式、资源限制等
+    int seccomp_filter;        // 是否启用seccomp-bpf过滤跟踪
+    int traced_syscalls[MAX_TRACED_SYSCALLS]; // 过滤模式下需要跟踪的系统调用号
+    int traced_count;          // 需要跟踪的系统调用数量
+    int binary_log;            // 是否使用异步二进制跟踪日志
+    const char *json_output;   // NDJSON事件流的目标（文件路径或unix:套接字路径，NULL表示不输出）
+    int decode_selected;       // 是否用--decode指定了解码列表（否则解码所有有描述符的系统调用）
+    int decode_syscalls[MAX_TRACED_SYSCALLS]; // 需要解码参数的系统调用号
+    int decode_count;          // 需要解码参数的系统调用数量
+    int preview_bytes;         // write/sendto缓冲区预览的字节数（0表示默认值，-1表示不预览）
+    int fd_track_disabled;     // 不跟踪各进程的fd表（fd参数不再标注路径）
+    int ngram_n;               // 系统调用序列n-gram的长度（0表示默认值，-1表示不统计）
+    int ngram_top;             // 输出的top-K n-gram条目数（0表示默认值）
+    const char *batch_source;  // 批量模式的任务来源（目录或列表文件）
+    int batch_jobs;            // 批量模式的并行数量
+    int sync_pipe[2];          // 父进程完成用户命名空间映射后通知子进程
+    int template_cache;        // 是否使用根文件系统模板缓存
+    const char *template_dir;  // 模板缓存目录（NULL表示默认目录）
+    int stage_mode;            // 依赖库的暂存方式（STAGE_COPY等）
+    int stats;                 // 是否输出暂存统计
+    int pool_size;             // 批量模式下保持的预创建沙箱数量（0表示不使用）
+    int pooled;                // 沙箱是否预先创建、等待交接样本
+    int handoff_pipe[2];       // 池化模式下向沙箱发送样本路径
+    int latency_calibrate;     // 是否从系统调用延迟中扣除自校准的ptrace往返开销
+    int cgroup_disabled;       // 不为沙箱创建cgroup
+    const char *cgroup_root;   // 存放沙箱cgroup的目录（NULL表示挂载点下的DEFAULT_CGROUP_NAME）
+    long cpu_quota_us;         // 每个CGROUP_CPU_PERIOD_US周期内的CPU时间配额（0表示不限制）
+    uint64_t memory_max;       // 内存上限（字节，0表示不限制）
+    long pids_max;             // 进程/线程数上限（0表示不限制）
+    const char *io_max;        // 原样写入io.max的限制（如"8:0 rbps=1048576 wbps=1048576"）
+    long timeout_ms;           // 墙上时间限制（毫秒，0表示不限制）
+    long cpu_timeout_ms;       // 整个沙箱的CPU时间限制（毫秒，0表示不限制）
+    char sandbox_dir[PATH_MAX]; // 沙箱根目录（由父进程创建和删除）
+    int sandbox_pidfd;         // 沙箱根进程（PID命名空间init）的pidfd，-1表示不可用
+    int time_warp;             // 是否启用睡眠加速和虚拟时间
+    int time_warp_factor;      // 睡眠缩短的倍数，0表示直接跳过
+    struct policy *policy;     // 系统调用策略（NULL表示没有指定--policy）
+    int sinkhole;              // 是否启用伪造网络和sinkhole
+    const char *sinkhole_log;  // sinkhole日志文件（NULL表示默认路径）
+    int sinkhole_fd;           // 与sinkhole进程的控制连接
+    pid_t sinkhole_pid;        // sinkhole进程
+    int backend;               // 监控后端（MONITOR_BACKEND_*）
+    int start_sock[2];         // eBPF后端：沙箱就绪后等待内核程序挂载完成再exec样本
+    int notif_threads;         // 通知后端的监督线程数（0表示按CPU数）
+    int tracer_threads;        // ptrace后端的跟踪线程数（0或1表示只用主线程）
+    int mem_dump;              // 是否转储变为可执行的内存
+    const char *mem_dump_dir;  // 转储的上级目录（NULL表示默认的/tmp/malbox_dump_<pid>）
+    // 可以添加更多配置选项，如网络模式等
 } sandbox_config;
 
+// 池化沙箱的样本交接消息
+typedef struct {
+    char binary_path[PATH_MAX];  // 样本的绝对路径
+    char output_path[PATH_MAX];  // 沙箱输出追加到的文件（空表示不重定向）
+} sandbox_handoff_t;
+
+// 沙箱cgroup结束时的资源用量
+typedef struct {
+    int valid;                 // 是否已读取
+    uint64_t cpu_usage_us;     // cpu.stat
+    uint64_t cpu_user_us;
+    uint64_t cpu_system_us;
+    uint64_t nr_throttled;
+    uint64_t throttled_us;
+    uint64_t memory_peak;      // memory.peak（字节）
+    uint64_t oom_kills;        // memory.events中的oom_kill
+    uint64_t pids_peak;        // pids.peak
+    uint64_t io_read_bytes;    // io.stat各设备之和
+    uint64_t io_write_bytes;
+} cgroup_stats_t;
+
+// 沙箱被强制终止的原因
+enum {
+    TIMEOUT_NONE = 0,
+    TIMEOUT_WALL,              // 超过墙上时间限制
+    TIMEOUT_CPU,               // 超过CPU时间限制
+};
+
+// 单次沙箱运行结果
+typedef struct {
+    pid_t sandbox_pid;         // 沙箱根进程PID（日志文件以此命名）
+    int exit_status;           // 根进程的waitpid状态
+    int exited;                // 是否已获得根进程的退出状态
+    int unique_syscalls;       // 不同系统调用的数量
+    uint64_t ready_ns;         // 根进程到达初始停止（即将exec样本）的单调时钟时间
+    char cgroup_path[PATH_MAX]; // 沙箱所在的cgroup（空表示未创建）
+    cgroup_stats_t cgroup;     // 沙箱结束时的cgroup资源用量
+    int timeout_reason;        // 沙箱被强制终止的原因（TIMEOUT_*）
+} sandbox_result;
+
 // ---- 文件工具函数 ----
 int is_executable(const char *path);
 int is_static_elf(const char *path);
 int mkdir_p(const char *path, mode_t mode);
 int copy_file(const char *src, const char *dest);
 
+// ---- 文件暂存 ----
+// 依赖库的暂存方式：复制，或在文件系统允许时共享同一份数据
+enum {
+    STAGE_COPY = 0,
+    STAGE_HARDLINK,
+    STAGE_BIND,
+};
+
+// 暂存统计（每个沙箱子进程各自累计）
+typedef struct {
+    int files;                 // 暂存的文件数
+    uint64_t bytes;            // 暂存的字节数
+    uint64_t elapsed_ns;       // 暂存耗时
+    int reflinked;             // 各方式完成的文件数
+    int range_copied;
+    int sendfile_copied;
+    int buffered;
+    int linked;
+    int bound;
+} stage_stats_t;
+
+int stage_file(const char *src, const char *dest, mode_t mode, int link_mode);
+void print_stage_stats(const char *binary_name);
+
 // ---- 动态库处理 ----
-int prepare_dynamic_libs(const char *binary_path, const char *sandbox_root);
+// 依赖库路径列表
+typedef struct {
+    char **paths;
+    int count;
+    int capacity;
+} lib_list_t;
+
+int lib_list_add(lib_list_t *libs, const char *path);
+void free_lib_list(lib_list_t *libs);
+int resolve_dynamic_libs(const char *binary_path, lib_list_t *libs);
+int stage_dynamic_libs(const lib_list_t *libs, const char *sandbox_root, int link_mode);
+int prepare_dynamic_libs(const char *binary_path, const char *sandbox_root, int link_mode);
+
+// ---- ELF解析 ----
+// 从ELF文件中解析出的信息
+typedef struct {
+    int elf_class;             // 32或64
+    int big_endian;            // 是否为大端（只解析文件头）
+    uint16_t type;             // ET_EXEC/ET_DYN等
+    uint16_t machine;          // EM_X86_64等
+    int has_dynamic;           // 是否有PT_DYNAMIC段
+    int has_symtab;            // 是否保留了符号表（未剥离）
+    int section_count;         // 可读取的节头数量
+    char *interp;              // PT_INTERP指定的解释器（NULL表示无）
+    char *rpath;               // DT_RPATH（NULL表示无）
+    char *runpath;             // DT_RUNPATH（NULL表示无）
+    lib_list_t needed;         // DT_NEEDED中的库名（未解析）
+} elf_info_t;
+
+int elf_read_info(const char *path, elf_info_t *info);
+void free_elf_info(elf_info_t *info);
+int elf_is_static(const elf_info_t *info);
+int elf_matches_arch(const char *path, const elf_info_t *ref);
+void elf_describe(const elf_info_t *info, char *buf, size_t len);
+int ld_cache_lookup(const char *name, const elf_info_t *requester, char *path, size_t len);
+
+// ---- 根文件系统模板缓存 ----
+int setup_template_root(const sandbox_config *config, const char *sandbox_dir,
+                        char *root_out, size_t root_len);
 
 // ---- Hello World程序相关 ----
 extern const char* hello_world_c;
@@ -48,17 +214,647 @@ int copy_executable_to_sandbox(const char *binary_path, const char *binary_name,
                               const char *sandbox_root);
 int enter_sandbox(const char *sandbox_root);
 
+// ---- 沙箱运行 ----
+int spawn_sandbox(sandbox_config *config, sandbox_result *result);
+int handoff_sample(sandbox_config *config, const char *output_path);
+int monitor_sandbox(sandbox_config *config, sandbox_result *result);
+void kill_sandbox(const sandbox_config *config, pid_t pid);
+void release_sandbox(sandbox_config *config, sandbox_result *result);
+int run_sandbox(sandbox_config *config, sandbox_result *result);
+int run_batch(const sandbox_config *config);
+
 // ---- 命令行界面函数 ----
 void print_usage(const char *program_name);
 int parse_arguments(int argc, char *argv[], sandbox_config *config);
+int set_target_binary(sandbox_config *config, const char *target);
 void cleanup_config(sandbox_config *config);
 void print_file_info(const char *filepath);
 
 // ---- 命名空间函数 ----
 int setup_user_namespace(pid_t pid);
 
+// ---- cgroup资源限制 ----
+int cgroup_setup_sandbox(const sandbox_config *config, pid_t pid, sandbox_result *result);
+void cgroup_collect_stats(const char *path, cgroup_stats_t *stats);
+int cgroup_read_cpu_usage(const char *path, uint64_t *usage_us);
+void cgroup_destroy(const char *path);
+void print_cgroup_stats(const cgroup_stats_t *stats);
+
 // ---- 系统调用监控函数 ----
-int setup_monitoring(pid_t child_pid);
-int prepare_traced_child(void);
+// 监控后端：两者的系统调用事件交给同一套统计和日志
+enum {
+    MONITOR_BACKEND_PTRACE = 0, // 在每次被跟踪的系统调用处停下样本
+    MONITOR_BACKEND_EBPF,       // raw_syscalls跟踪点上的eBPF程序，样本不停止也不处于ptrace之下
+    MONITOR_BACKEND_NOTIF,      // seccomp用户通知，多个监督线程并发处理被选中的系统调用
+};
+
+// ptrace后端的跟踪线程上限。ptrace把被跟踪任务绑定到attach它的线程，新进程在初始停止后
+// 停在pause中脱离原线程，由负载最小的跟踪线程重新接管，样本和父进程都看不到这次交接；
+// 线程和共享地址空间的子进程留在父任务的跟踪线程上
+#define TRACER_THREADS_MAX 16
+
+int setup_monitoring(pid_t child_pid, const sandbox_config *config, sandbox_result *result);
+int prepare_traced_child(const sandbox_config *config);
+
+// ---- 被跟踪任务状态表 ----
+#define TASK_TABLE_SIZE 4096      // 任务状态表容量（必须是2的幂）
+
+// 新任务的状态（task_state_t.new_task）
+enum {
+    NEW_TASK_ATTACHED = 1,     // 尚未收到初始停止（SIGSTOP或PTRACE_EVENT_STOP）
+    NEW_TASK_HELD,             // 初始停止先于父任务的fork事件到达，停在那里等待该事件
+    NEW_TASK_MIGRATED,         // 从其他跟踪线程迁移过来，等待接管后的第一次停止
+};
+
+// 每个被跟踪线程（tid）的系统调用状态
+typedef struct {
+    pid_t tid;                 // 线程ID，0表示空槽位
+    int new_task;              // 新任务的状态（NEW_TASK_*），0表示已开始正常跟踪
+    int spawn;                 // 新任务的创建方式，决定能否迁移到其他跟踪线程
+    int in_syscall;            // 是否在系统调用中
+    int current_syscall;       // 当前系统调用号
+    int current_abi;           // 当前系统调用的ABI（SYSCALL_ABI_*）
+    unsigned long args[6];     // 当前系统调用参数
+    uint64_t entry_ns;         // 系统调用入口停止后恢复执行的时间（CLOCK_MONOTONIC_RAW）
+    int warp_action;           // 入口处对睡眠做的改写（WARP_*），退出时据此恢复
+    int warp_arg_index;        // 被替换的参数寄存器
+    unsigned long warp_saved_arg; // 被替换前的参数值
+    struct fd_table *fds;      // 所属进程的fd表（NULL表示不跟踪）
+    uint16_t ngram_history[4]; // 最近的系统调用（NGRAM_MAX - 1个），组成n-gram
+    uint8_t ngram_len;         // ngram_history中的有效个数
+    int policy_skip;           // 入口处按策略跳过了系统调用，退出时把返回值改为policy_ret
+    long policy_ret;           // 跳过的系统调用伪造的返回值
+    struct task_migration *migration; // 迁移前保存的寄存器和信号掩码，接管后的第一次停止时恢复
+} task_state_t;
+
+typedef struct {
+    task_state_t slots[TASK_TABLE_SIZE];
+    int count;                 // 已使用的槽位数
+} task_table_t;
+
+task_state_t *task_table_lookup(task_table_t *table, pid_t tid);
+task_state_t *task_table_insert(task_table_t *table, pid_t tid);
+void task_table_remove(task_table_t *table, pid_t tid);
+
+// ---- 睡眠加速与虚拟时间 ----
+enum {
+    WARP_NONE = 0,
+    WARP_SKIPPED,              // 睡眠被跳过，退出时伪造成功返回
+    WARP_SCALED,               // 超时参数被替换为缩短后的值
+};
+
+typedef struct {
+    int factor;                // 睡眠缩短的倍数，0表示直接跳过
+    int64_t offset_ns;         // 虚拟时间领先真实时间的量
+    uint64_t sleeps;           // 改写的睡眠次数
+} time_warp_t;
+
+struct user_regs_struct;
+int time_warp_entry(time_warp_t *warp, task_state_t *task, struct user_regs_struct *regs);
+int time_warp_exit(time_warp_t *warp, task_state_t *task, struct user_regs_struct *regs);
+int time_warp_hide_vdso(pid_t pid, const struct user_regs_struct *regs);
+
+// ---- 系统调用表 ----
+// 系统调用ABI：x86_64上的32位程序或int 0x80走i386兼容表
+enum {
+    SYSCALL_ABI_NATIVE = 0,
+    SYSCALL_ABI_COMPAT,
+    SYSCALL_ABI_COUNT,
+};
+
+const char *get_syscall_name(int syscall_nr);
+const char *get_syscall_name_abi(int abi, int syscall_nr);
+const char *get_syscall_abi_name(int abi);
+int get_syscall_number(const char *name);
+
+// ---- 系统调用参数解码 ----
+// 每个系统调用一个描述符，给出各参数的类型；只有描述符中需要读内存的参数
+// 才会读取被跟踪进程，其余系统调用没有额外开销。读到的内容序列化为参数块，
+// 由文本日志、二进制日志和NDJSON共用
+#define DEFAULT_PREVIEW_BYTES 64  // 缓冲区预览的默认字节数
+#define ARG_BLOB_MAX 24576        // 参数块上限（作为跟踪记录负载，须小于UINT16_MAX）
+#define ARG_ARRAY_MAX 8192        // argv/envp各自的字节上限
+#define ARG_ARRAY_ENTRIES 64      // argv/envp最多记录的条目数
+
+enum {
+    ARG_NONE = 0,
+    ARG_INT,                   // 有符号整数
+    ARG_HEX,                   // 地址或不透明值
+    ARG_FD,                    // 文件描述符
+    ARG_DIRFD,                 // *at系统调用的目录fd（AT_FDCWD）
+    ARG_MODE,                  // 八进制权限位
+    ARG_PATH,                  // 路径，aux为相对的dirfd参数下标（-1表示当前目录）
+    ARG_STRING,                // 不做解析的字符串（如symlink的目标）
+    ARG_STRING_ARRAY,          // 以NULL结尾的字符串指针数组（argv/envp）
+    ARG_SOCKADDR,              // 套接字地址，aux为长度参数下标
+    ARG_BUFFER,                // 输出缓冲区，aux为长度参数下标，只预览前若干字节
+    ARG_OPEN_FLAGS,            // O_*
+    ARG_PROT,                  // PROT_*
+    ARG_MMAP_FLAGS,            // MAP_*
+    ARG_CLONE_FLAGS,           // CLONE_*，低8位为退出信号
+    ARG_AT_FLAGS,              // AT_*
+};
+
+typedef struct {
+    const char *name;          // 参数名
+    uint8_t type;              // ARG_*
+    int8_t aux;                // 关联参数的下标，-1表示无
+} syscall_arg_desc_t;
+
+typedef struct {
+    int argc;                  // 参数个数，0表示没有描述符
+    syscall_arg_desc_t args[6];
+} syscall_desc_t;
+
+// 参数块中的一项：头部之后紧跟len字节数据。
+// 路径为"原始路径\0解析后的绝对路径"，字符串数组以NUL分隔，
+// fd参数为跟踪到的文件路径或套接字描述
+typedef struct {
+    uint8_t index;             // 参数下标
+    uint8_t type;              // ARG_*
+    uint16_t len;              // 数据长度
+} arg_blob_entry_t;
+
+#define ARG_SCRATCH_MAX 65536     // 一次停止中读取原始参数内存的暂存区
+
+typedef struct {
+    size_t len;                // 参数块长度
+    char blob[ARG_BLOB_MAX];
+    char scratch[ARG_SCRATCH_MAX];
+} arg_capture_t;
+
+const syscall_desc_t *get_syscall_desc(int abi, int syscall_nr);
+int arg_blob_find(const char *blob, size_t len, int index, const char **data, size_t *data_len);
+char *arg_blob_append(arg_capture_t *capture, int index, int type, size_t len);
+const char *arg_blob_path(const char *blob, size_t len, int index, size_t *path_len);
+size_t format_flag_names(int type, uint64_t value, char *out, size_t outlen);
+void format_syscall_args(FILE *fp, int syscall_nr, const uint64_t *args, const char *blob, size_t len);
+int capture_syscall_args(pid_t tid, int syscall_nr, const unsigned long *args, int preview_bytes,
+                         arg_capture_t *capture);
+ssize_t resolve_tracee_path(pid_t tid, long dirfd, const char *path, char *out, size_t outlen);
+
+// ---- 文件描述符跟踪 ----
+// 每个进程一张fd表（按fd下标的数组），元素是驻留字符串的id。
+// 共享文件表的线程（CLONE_FILES）共用同一张表，fork时复制，exec时去掉close-on-exec的fd
+#define FD_TABLE_MAX 65536            // 跟踪的最大fd号，更大的fd只在需要时从/proc读取
+#define FD_ENTRY_CLOEXEC 0x80000000u  // 表项中的close-on-exec标志
+#define FD_ENTRY_ID_MASK 0x7fffffffu
+
+typedef struct {
+    char *data;                // 所有字符串依次存放，id为偏移
+    size_t used;               // data已用字节数
+    size_t capacity;           // data容量
+    uint32_t *slots;           // 开放寻址哈希表，存放id（0表示空槽）
+    size_t slot_count;         // 槽位数（2的幂）
+    size_t count;              // 已驻留的字符串数
+} string_pool_t;
+
+uint32_t string_pool_intern(string_pool_t *pool, const char *str, size_t len);
+const char *string_pool_get(const string_pool_t *pool, uint32_t id);
+void string_pool_free(string_pool_t *pool);
+
+typedef struct fd_table {
+    int refs;                  // 共用该表的任务数
+    int size;                  // entries的容量
+    uint32_t *entries;         // 按fd索引：字符串id | FD_ENTRY_CLOEXEC，0表示未知或已关闭
+} fd_table_t;
+
+fd_table_t *fd_table_new(void);
+fd_table_t *fd_table_share(fd_table_t *table);
+fd_table_t *fd_table_copy(const fd_table_t *table);
+void fd_table_release(fd_table_t *table);
+fd_table_t *fd_table_exec(fd_table_t *table);
+char *fd_table_export(const fd_table_t *table, const string_pool_t *pool, size_t *len);
+fd_table_t *fd_table_import(const char *data, size_t len, string_pool_t *pool);
+uint32_t fd_table_describe(fd_table_t *table, string_pool_t *pool, pid_t tid, int fd);
+void fd_track_syscall_exit(fd_table_t **table, string_pool_t *pool, pid_t tid, int syscall_nr,
+                           const unsigned long *args, long ret, const arg_capture_t *capture);
+void fd_track_annotate(fd_table_t *table, string_pool_t *pool, pid_t tid, int syscall_nr,
+                       const unsigned long *args, arg_capture_t *capture);
+
+// ---- 系统调用延迟直方图 ----
+// 对数-线性分桶（HDR风格）：小于2*LAT_HIST_SUB_COUNT纳秒的值精确记录，
+// 之后每个2的幂区间再等分为LAT_HIST_SUB_COUNT格，相对误差约3%，内存固定
+#define LAT_HIST_SUB_BITS 5
+#define LAT_HIST_SUB_COUNT (1 << LAT_HIST_SUB_BITS)
+#define LAT_HIST_MAX_BITS 40      // 可记录的最大延迟约2^40纳秒（约18分钟），更大的值计入最后一格
+#define LAT_HIST_BUCKETS ((LAT_HIST_MAX_BITS - LAT_HIST_SUB_BITS + 1) * LAT_HIST_SUB_COUNT)
+
+typedef struct {
+    uint64_t count;            // 样本数
+    uint64_t total_ns;         // 延迟总和
+    uint64_t max_ns;           // 精确的最大值
+    uint32_t buckets[LAT_HIST_BUCKETS];
+} latency_hist_t;
+
+void latency_hist_record(latency_hist_t *hist, uint64_t ns);
+void latency_hist_merge(latency_hist_t *hist, const latency_hist_t *other);
+uint64_t latency_hist_percentile(const latency_hist_t *hist, double percentile);
+void print_latency_stats(FILE *fp, const char *label, int syscall_nr, const latency_hist_t *hist);
+
+// ---- 系统调用序列n-gram ----
+#define NGRAM_MIN 2
+#define NGRAM_MAX 5
+#define NGRAM_DEFAULT_N 3
+#define NGRAM_DEFAULT_TOP 20
+#define NGRAM_TOP_MAX 64
+#define NGRAM_CMS_DEPTH 4         // count-min sketch的行数
+#define NGRAM_CMS_WIDTH 4096      // 每行的计数器数（必须是2的幂）
+#define MINHASH_SIZE 64           // MinHash签名的长度
+
+typedef struct {
+    uint64_t key;              // 打包的n-gram，每个系统调用11位
+    uint32_t count;            // 估计计数
+} ngram_entry_t;
+
+typedef struct {
+    int n;                     // n-gram长度，0表示不统计
+    int top_k;                 // 输出的条目数
+    uint64_t total;            // n-gram总数
+    uint32_t sketch[NGRAM_CMS_DEPTH][NGRAM_CMS_WIDTH];
+    ngram_entry_t top[NGRAM_TOP_MAX]; // 估计计数最高的候选（无序）
+    int top_count;
+    uint64_t minhash[MINHASH_SIZE];   // 每个桶的最小哈希值
+} ngram_profile_t;
+
+void ngram_init(ngram_profile_t *profile, int n, int top_k);
+void ngram_push(ngram_profile_t *profile, uint16_t *history, uint8_t *len, int abi, int nr);
+void ngram_merge(ngram_profile_t *profile, const ngram_profile_t *other);
+int ngram_sorted_top(const ngram_profile_t *profile, ngram_entry_t *out);
+int ngram_minhash_signature(const ngram_profile_t *profile, uint32_t *signature);
+const char *ngram_token_name(uint64_t key, int n, int i, int *compat);
+void ngram_format_key(uint64_t key, int n, char *out, size_t outlen);
+void print_ngram_entry(FILE *fp, int rank, uint64_t key, int n, uint64_t count, uint64_t total);
+void print_minhash_signature(FILE *fp, const uint32_t *signature, int count);
+void print_ngram_profile(FILE *fp, const ngram_profile_t *profile);
+
+// ---- SHA-256 ----
+#define SHA256_DIGEST_LEN 32
+#define SHA256_HEX_LEN (SHA256_DIGEST_LEN * 2 + 1)
+
+void sha256(const void *data, size_t len, unsigned char digest[SHA256_DIGEST_LEN]);
+void sha256_hex(const unsigned char digest[SHA256_DIGEST_LEN], char *out);
+
+// ---- 可执行内存转储 ----
+// 加壳样本在内存中解密后用mmap/mprotect/mremap把代码改为可执行。这些调用成功返回和execve完成时，
+// 跟踪器把新的可执行区域批量读出并逐页计算哈希，与该区域上次的快照相同则不再写入；
+// 内容以SHA-256摘要命名存入本次运行的目录，相同的内容只保存一份
+#define MEM_DUMP_BUFFER (64ul << 20) // 一批读取的总字节数，也是单个区域的转储上限
+#define MEM_DUMP_BATCH 64            // 一次快照最多处理的区域数
+#define MEM_DUMP_TRACKED 256         // 保留页哈希的区域数，超出后覆盖最早的
+
+// 触发快照的事件
+enum {
+    MEM_DUMP_MMAP = 0,         // 匿名映射带PROT_EXEC
+    MEM_DUMP_MPROTECT,         // mprotect/pkey_mprotect加上PROT_EXEC
+    MEM_DUMP_MREMAP,           // 可执行的匿名映射被移动或扩大
+    MEM_DUMP_EXEC,             // execve完成，新映像的所有可执行区域
+    MEM_DUMP_RESCAN,           // exit_group或execve入口，重新检查该进程转储过的区域
+};
+
+// 一个区域的快照结果
+enum {
+    MEM_DUMP_STORED = 0,       // 新内容，已写入
+    MEM_DUMP_DUPLICATE,        // 同样的内容已经保存过
+    MEM_DUMP_UNCHANGED,        // 与该区域上次的快照相同
+    MEM_DUMP_EMPTY,            // 全是零页（刚映射还未写入），只记录页哈希
+    MEM_DUMP_UNREADABLE,       // 读取失败（区域已被解除映射）
+};
+
+typedef struct {
+    unsigned long start;
+    unsigned long end;
+    unsigned char digest[SHA256_DIGEST_LEN]; // 内容的SHA-256，十六进制形式是转储文件名
+    int pages;
+    int changed_pages;         // 与该区域上次快照相比变化的页数（第一次快照时等于pages）
+    int status;                // MEM_DUMP_STORED等
+} mem_dump_region_t;
+
+// 转储过的区域及其页哈希，按进程和地址范围查找
+typedef struct {
+    pid_t pid;                 // 所属进程（线程组），0表示空槽位
+    unsigned long start;
+    unsigned long end;
+    uint64_t *page_hashes;     // 只用于找出变化的页，不用于去重
+    int pages;
+} mem_dump_tracked_t;
+
+// 所有跟踪线程共用：目录、索引和计数器。索引按行写入，计数器用原子操作更新
+typedef struct {
+    char dir[PATH_MAX];        // 本次运行的转储目录
+    FILE *index;               // index.txt: 每个区域快照一行
+    uint64_t page_seed;        // 页哈希的随机初值，样本无法预先构造出哈希不变的修改
+    uint64_t snapshots;        // 区域快照次数
+    uint64_t stored;           // 写入的文件数
+    uint64_t stored_bytes;
+    uint64_t duplicates;
+    uint64_t unchanged;
+} mem_dump_t;
+
+// 每个跟踪线程自己的页哈希和读取缓冲区：一个进程的所有线程由同一个跟踪线程跟踪
+typedef struct {
+    mem_dump_tracked_t tracked[MEM_DUMP_TRACKED];
+    int next_slot;             // 没有空槽位时覆盖的位置
+    char *buf;                 // 读取缓冲区（MEM_DUMP_BUFFER字节，第一次快照时分配）
+} mem_dump_cache_t;
+
+int mem_dump_open(mem_dump_t *dump, const char *dir);
+int mem_dump_snapshot(mem_dump_t *dump, mem_dump_cache_t *cache, pid_t tgid, pid_t tid, int trigger,
+                      unsigned long start, unsigned long end, mem_dump_region_t *regions, int max_regions);
+void mem_dump_cache_free(mem_dump_cache_t *cache);
+void mem_dump_close(mem_dump_t *dump);
+
+// ---- 跟踪输出格式化 ----
+void format_sockaddr(const struct sockaddr_storage *addr, size_t len, char *out, size_t outlen);
+void format_policy_action(int action, long value, char *out, size_t outlen);
+const char *mem_dump_trigger_name(int trigger);
+const char *mem_dump_status_name(int status);
+void format_mem_dump(int trigger, const mem_dump_region_t *region, char *out, size_t outlen);
+
+// ---- 二进制跟踪日志 ----
+#define TRACE_LOG_MAGIC "MALBOXTR"
+#define TRACE_LOG_VERSION 1
+
+// 记录类型
+enum {
+    TRACE_REC_SYSCALL_ENTRY = 1,  // 系统调用入口
+    TRACE_REC_SYSCALL_EXIT,       // 系统调用退出，ret为返回值
+    TRACE_REC_FILE_OPEN,          // 负载: 打开的路径
+    TRACE_REC_EXEC,               // 负载: 执行的路径
+    TRACE_REC_EXEC_ARGV,          // 负载: 以NUL分隔的argv，args[0]为条目数
+    TRACE_REC_EXEC_ENVP,          // 负载: 以NUL分隔的envp，args[0]为条目数
+    TRACE_REC_NET_CONNECT,        // 负载: 原始sockaddr，args[0]为套接字fd
+    TRACE_REC_PROC_EXIT,          // 进程结束，ret为退出码或信号，flags标记是否被信号终止
+    TRACE_REC_PROC_NEW,           // 新进程/线程，args[0]为新tid，args[1]为PTRACE_EVENT_*
+    TRACE_REC_PROC_EXEC,          // execve完成，args[0]为执行前的tid
+    TRACE_REC_TIMEOUT,            // 超时终止沙箱，args[0]为TIMEOUT_*，args[1]为限制（毫秒）
+    TRACE_REC_SYSCALL_STATS,      // 结束时的每个系统调用统计: args[0..5]为次数、总延迟、p50、p90、p99、最大值
+    TRACE_REC_SUMMARY,            // 结束汇总: args[0]为系统调用种数，args[1]为TIMEOUT_*，
+                                  // args[2]为改写的睡眠次数，ret为虚拟时间偏移（纳秒）
+    TRACE_REC_NGRAM,              // 结束时的top-K n-gram: args[0]为打包的n-gram，args[1]为估计计数，
+                                  // args[2]为n，args[3]为名次，args[4]为n-gram总数
+    TRACE_REC_MINHASH,            // 负载: MinHash签名（uint32数组），args[0]为n，args[1]为签名长度
+    TRACE_REC_POLICY,             // 命中策略规则: args[0]为POLICY_*动作，args[1]为errno或伪造的返回值，
+                                  // args[2]为规则所在行，args[3]为1表示由跟踪器执行（否则在内核中执行）
+    TRACE_REC_SIGNAL,             // 转发给任务的信号: args[0]为信号，args[1]为si_code
+    TRACE_REC_MEM_DUMP,           // 可执行内存快照，负载: 内容的SHA-256摘要。args[0..1]为起止地址，
+                                  // args[3]为MEM_DUMP_MMAP等触发事件，args[4]为页数，args[5]为变化的页数，
+                                  // ret为MEM_DUMP_STORED等结果
+};
+
+#define TRACE_REC_FLAG_SIGNALED 0x1
+#define TRACE_REC_FLAG_COMPAT 0x2    // 系统调用走i386兼容ABI
+#define TRACE_REC_FLAG_LATENCY 0x4   // 退出记录的args[0]为跟踪器测得的延迟（纳秒）
+#define TRACE_REC_FLAG_DECODED 0x8   // 入口记录按描述符解码，负载为参数块
+
+// 定长二进制事件记录；字符串负载紧跟在记录之后，占用若干个记录大小的槽位
+typedef struct {
+    uint64_t timestamp_ns;     // CLOCK_MONOTONIC时间戳
+    uint32_t tid;              // 线程ID
+    uint16_t type;             // 记录类型
+    uint16_t payload_len;      // 负载长度（字节），0表示无负载
+    int32_t syscall_nr;        // 系统调用号
+    uint32_t flags;            // 记录标志
+    uint64_t args[6];          // 系统调用参数
+    int64_t ret;               // 返回值
+} trace_record_t;
+
+// 文件头
+typedef struct {
+    char magic[8];             // TRACE_LOG_MAGIC
+    uint32_t version;          // TRACE_LOG_VERSION
+    uint32_t record_size;      // sizeof(trace_record_t)
+    uint32_t pid;              // 目标进程ID
+    uint32_t reserved;
+    uint64_t start_realtime_ns; // 开始记录时的墙上时间
+} trace_log_header_t;
+
+// 负载占用的槽位数
+#define TRACE_PAYLOAD_SLOTS(len) (((len) + sizeof(trace_record_t) - 1) / sizeof(trace_record_t))
+
+// 跟踪日志的输出格式
+enum {
+    TRACE_FORMAT_BINARY,       // 原始定长记录，malbox-decode离线解码
+    TRACE_FORMAT_NDJSON,       // 每个事件一行JSON对象，写线程负责格式化
+};
+
+#define TRACE_PRODUCERS_MAX (TRACER_THREADS_MAX + 1) // 每个跟踪线程一个，另加处理超时的分派线程
+
+typedef struct trace_log trace_log_t;
+trace_log_t *trace_log_open(const char *target, pid_t pid, int format, int producers);
+void trace_log_push(trace_log_t *log, int producer, const trace_record_t *rec, const void *payload,
+                    size_t payload_len);
+void trace_log_idle(trace_log_t *log, int producer);
+void trace_log_busy(trace_log_t *log, int producer);
+void trace_log_close(trace_log_t *log);
+uint64_t trace_timestamp_ns(void);
+
+// ---- NDJSON事件输出 ----
+#define JSON_OUT_BUFFER_SIZE (1024 * 1024) // 攒够一批再写，减少系统调用次数；须容得下最大的单个事件
+
+typedef struct {
+    int fd;
+    int is_socket;             // 套接字用send(MSG_NOSIGNAL)，对端关闭时不触发SIGPIPE
+    int failed;                // 写入失败后丢弃后续输出
+    size_t len;
+    char buf[JSON_OUT_BUFFER_SIZE];
+} json_out_t;
+
+void json_out_init(json_out_t *out, int fd, int is_socket);
+int json_out_flush(json_out_t *out);
+void json_write_start(json_out_t *out, uint32_t pid, uint64_t start_realtime_ns);
+void json_write_record(json_out_t *out, uint32_t pid, const trace_record_t *rec, const char *payload);
+
+// ---- 被跟踪进程内存读取 ----
+ssize_t read_tracee_memory(pid_t pid, unsigned long addr, void *buf, size_t len);
+ssize_t read_tracee_string(pid_t pid, unsigned long addr, char *str, size_t maxlen);
+int read_tracee_pointer_array(pid_t pid, unsigned long addr, unsigned long *ptrs, int max_count);
+int write_tracee_memory(pid_t pid, unsigned long addr, const void *buf, size_t len);
+
+// 一次批量读取中的一段
+typedef struct {
+    unsigned long addr;        // 被跟踪进程中的地址
+    void *buf;                 // 本地缓冲区
+    size_t len;                // 请求的字节数
+    ssize_t result;            // 实际读到的字节数，-1表示不可读
+} tracee_read_t;
+
+int read_tracee_batch(pid_t pid, tracee_read_t *reads, int count);
+
+// ---- 系统调用策略 ----
+// 策略文件每行一条规则"动作 系统调用 [条件...]"，条件之间为"与"；同一系统调用的
+// 规则按出现顺序取第一条命中的，都不命中时放行。只比较寄存器参数的规则编译进
+// seccomp-bpf由内核执行，需要读取被跟踪进程内存的条件（路径、套接字地址）
+// 由跟踪器在系统调用入口判定
+#define POLICY_MAX_CONDS 6        // 每条规则最多的条件数
+
+// 规则动作
+enum {
+    POLICY_ALLOW = 0,          // 放行
+    POLICY_LOG,                // 放行并记录
+    POLICY_ERRNO,              // 不执行，返回-value
+    POLICY_FAKE,               // 不执行，返回value（伪装成功）
+    POLICY_KILL,               // 终止进程
+};
+
+// 条件类型
+enum {
+    POLICY_COND_ARG,           // 寄存器参数（argN==V、argN!=V、argN&V），只比较低32位
+    POLICY_COND_FAMILY,        // 套接字地址的地址族（family=inet）
+    POLICY_COND_PATH,          // 路径（path=/etc/passwd，以*结尾时为前缀）
+};
+
+enum {
+    POLICY_OP_EQ,              // 等于
+    POLICY_OP_NE,              // 不等于
+    POLICY_OP_SET,             // 与value有公共位
+};
+
+typedef struct {
+    uint8_t type;              // POLICY_COND_*
+    uint8_t op;                // POLICY_OP_*（参数条件）
+    uint8_t arg;               // 参数下标
+    uint8_t prefix;            // 路径条件为前缀匹配
+    uint32_t value;            // 比较值或地址族
+    char *path;                // 路径条件（前缀匹配时已去掉末尾的*）
+} policy_cond_t;
+
+typedef struct {
+    int syscall_nr;            // 本机系统调用号
+    int action;                // POLICY_*
+    long value;                // errno或伪造的返回值
+    int line;                  // 所在行，用于日志
+    int cond_count;
+    policy_cond_t conds[POLICY_MAX_CONDS];
+    int needs_tracer;          // 条件需要读内存，或动作无法用seccomp返回值表达
+    int tracer_enforced;       // 由跟踪器执行：自身或同一系统调用前面的规则需要跟踪器
+    int next;                  // 同一系统调用的下一条规则，-1表示没有
+} policy_rule_t;
+
+typedef struct policy {
+    const char *path;          // 策略文件
+    policy_rule_t *rules;
+    int count;
+    int first[SYSCALL_MAX];    // 每个本机系统调用的第一条规则，-1表示没有（匹配时O(1)跳过）
+    int compat_set;            // 是否指定了i386兼容ABI调用的动作
+    int compat_action;         // 兼容ABI调用的统一动作（规则只按本机编号匹配）
+    long compat_value;
+} policy_t;
+
+policy_t *policy_load(const char *path);
+void policy_free(policy_t *policy);
+const policy_rule_t *policy_match(const policy_t *policy, int syscall_nr, const unsigned long *args,
+                                  const arg_capture_t *capture);
+int policy_needs_capture(const policy_t *policy, int syscall_nr);
+
+// ---- 伪造网络与sinkhole ----
+// 沙箱网络命名空间中启用回环接口，并把所有IPv4/IPv6地址路由为本地地址；
+// 样本connect/sendto时跟踪器进入该命名空间创建对应端口的监听套接字，
+// 通过Unix域套接字交给主机侧的sinkhole进程，由它应答DNS、接受连接并记录负载。
+// 一个sinkhole进程用epoll服务批量模式下的所有沙箱
+#define SINKHOLE_DNS_PORT 53
+#define SINKHOLE_FAKE_NET 0xc6120000u   // DNS应答分配的地址段198.18.0.0/15
+#define SINKHOLE_FAKE_MASK 0xfffe0000u
+
+// 跟踪器发给sinkhole的消息，TCP/UDP消息附带监听套接字（SCM_RIGHTS）
+enum {
+    SINKHOLE_MSG_TCP = 1,      // TCP监听套接字
+    SINKHOLE_MSG_UDP,          // UDP套接字（53端口按DNS应答）
+    SINKHOLE_MSG_CLOSE,        // 沙箱结束，关闭它的所有套接字
+};
+
+typedef struct {
+    uint32_t sandbox;          // 沙箱根进程的pid，与跟踪日志文件名一致
+    uint16_t kind;             // SINKHOLE_MSG_*
+    uint16_t port;             // 监听的端口
+} sinkhole_msg_t;
+
+// 跟踪器侧每个沙箱的伪造网络状态
+typedef struct {
+    int ctl_fd;                // 与sinkhole进程的连接
+    int netns_fd;              // 沙箱的网络命名空间
+    int self_netns_fd;         // 跟踪器原来的网络命名空间
+    uint32_t sandbox;          // 沙箱根进程的pid
+    uint8_t ports[2][65536 / 8]; // 已尝试创建监听的TCP/UDP端口（原子地置位，置位的线程负责创建）
+    uint8_t ready[2][65536 / 8]; // 创建已完成（无论成功与否）的端口
+    pthread_mutex_t ready_lock; // 只用于等待其他跟踪线程正在创建的端口
+    pthread_cond_t ready_cond;
+} fake_net_t;
+
+pid_t sinkhole_start(const char *log_path, int *ctl_fd);
+void sinkhole_stop(pid_t pid, int ctl_fd);
+int fake_net_attach(fake_net_t *net, int ctl_fd, pid_t pid);
+int fake_net_listen(fake_net_t *net, int type, uint16_t port);
+void fake_net_detach(fake_net_t *net);
+
+// ---- seccomp过滤函数 ----
+int parse_syscall_list(const char *list, int *syscalls, int max_count);
+int install_seccomp_filter(const sandbox_config *config);
+
+// ---- eBPF监控后端 ----
+// 手工汇编的eBPF程序挂在raw_syscalls:sys_enter/sys_exit和sched_process_exit上，
+// 只处理沙箱cgroup中的任务；入口记录带寄存器副本和一段用户内存（路径或套接字地址），
+// 经BPF环形缓冲区以定长记录交给监控进程。寄存器副本按x86_64的pt_regs布局，
+// 与struct user_regs_struct的前EBPF_REGS_COUNT个字段一致
+#define EBPF_RINGBUF_SIZE (8 * 1024 * 1024) // 环形缓冲区大小（2的幂，页的整数倍）
+#define EBPF_DATA_MAX 256          // 入口记录捕获的用户内存上限
+#define EBPF_REGS_COUNT 21         // 记录的寄存器数（r15 ... ss）
+
+// 记录类型
+enum {
+    EBPF_EVENT_ENTRY = 1,      // 系统调用入口
+    EBPF_EVENT_EXIT,           // 系统调用退出
+    EBPF_EVENT_TASK_EXIT,      // 任务结束（sched_process_exit）
+};
+
+// 内核程序写入环形缓冲区的记录。退出和任务结束记录只有regs之前的部分
+typedef struct {
+    uint64_t timestamp_ns;     // bpf_ktime_get_ns（CLOCK_MONOTONIC）
+    uint32_t tid;              // 主机上的线程ID
+    uint32_t tgid;             // 主机上的进程ID
+    uint32_t type;             // EBPF_EVENT_*
+    int32_t syscall_nr;        // 系统调用号，任务结束记录为-1
+    int64_t ret;               // 退出记录的返回值
+    uint64_t regs[EBPF_REGS_COUNT]; // 入口时的寄存器
+    int32_t data_len;          // data中读到的字节数（字符串含结尾NUL），负数为读取失败
+    uint32_t reserved;
+    char data[EBPF_DATA_MAX];  // 按捕获计划读取的用户内存
+} ebpf_event_t;
+
+typedef struct {
+    int ring_fd;               // BPF_MAP_TYPE_RINGBUF
+    int capture_fd;            // 每个本机系统调用要捕获的参数（BPF_MAP_TYPE_ARRAY）
+    int drops_fd;              // 环形缓冲区已满时丢弃的记录数
+    int prog_fds[3];           // sys_enter、sys_exit、sched_process_exit上的程序
+    int link_fds[3];           // raw tracepoint连接，关闭即卸载
+    void *consumer;            // 映射的消费者位置页
+    void *producer;            // 映射的生产者位置页和数据区（数据区映射两次，记录不会在末尾被截断）
+    size_t page_size;
+    uint64_t mask;             // 数据区大小减1
+    int8_t capture_index[SYSCALL_MAX]; // 捕获的参数下标，-1表示不捕获
+    uint8_t capture_type[SYSCALL_MAX]; // 捕获参数的ARG_*类型
+} ebpf_backend_t;
+
+typedef void (*ebpf_event_handler_t)(void *ctx, const ebpf_event_t *event);
+
+int ebpf_backend_open(ebpf_backend_t *backend, const char *cgroup_path, const uint8_t *capture);
+int ebpf_backend_consume(ebpf_backend_t *backend, ebpf_event_handler_t handler, void *ctx);
+void ebpf_event_capture(const ebpf_backend_t *backend, const ebpf_event_t *event, arg_capture_t *capture);
+uint64_t ebpf_backend_drops(const ebpf_backend_t *backend);
+void ebpf_backend_close(ebpf_backend_t *backend);
+
+// ---- seccomp用户通知后端 ----
+// 沙箱在exec前安装过滤器，被选中的系统调用返回SECCOMP_RET_USER_NOTIF，监控进程在安装时
+// 短暂跟踪沙箱并用pidfd_getfd取走监听fd；监督线程并发接收通知，读取参数内存，按策略回复放行、errno或伪造的返回值。
+// 只能看到系统调用入口，没有退出和返回值
+#define NOTIF_THREADS_MAX 16
+
+struct seccomp_notif;
+
+int notif_fetch_listener(pid_t pid, int pidfd);
+int notif_receive(int listener, struct seccomp_notif *req);
+int notif_id_valid(int listener, uint64_t id);
+int notif_continue(int listener, uint64_t id);
+int notif_return(int listener, uint64_t id, long value);
 
-#endif // SANDBOX_H
\ No newline at end of file
+#endif // SANDBOX_H
@@ -0,0 +1,506 @@
+// src/batch.c
+#include "sandbox.h"
+#include <dirent.h>
+#include <sys/mman.h>
+#include <time.h>
+
+// 批量任务状态
+typedef struct {
+    char *path;                // 样本路径
+    pid_t runner;              // 负责该任务的工作进程
+    struct timespec start;     // 开始时间
+    double wall_ms;            // 墙上时间（毫秒）
+    int runner_status;         // 工作进程的waitpid状态
+} batch_job_t;
+
+// 批量任务列表
+typedef struct {
+    batch_job_t *jobs;
+    int count;
+    int capacity;
+} batch_list_t;
+
+#define POOL_MAX_FAILURES 8  // 预创建连续失败这么多次后退回逐个创建沙箱
+
+// 持有一个预创建沙箱、等待分配任务的工作进程
+typedef struct {
+    pid_t pid;
+    int cmd_fd;                // 写端：发送任务编号
+} pool_worker_t;
+
+// 预创建沙箱池
+typedef struct {
+    pool_worker_t *idle;       // 空闲工作进程（按创建顺序）
+    int idle_count;
+    int size;                  // 目标空闲数量
+    int failures;              // 连续预创建失败次数
+} sandbox_pool_t;
+
+static int add_job(batch_list_t *list, const char *path) {
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 64;
+        batch_job_t *jobs = realloc(list->jobs, (size_t)capacity * sizeof(*jobs));
+        if (!jobs) {
+            perror("内存分配失败");
+            return -1;
+        }
+        list->jobs = jobs;
+        list->capacity = capacity;
+    }
+
+    batch_job_t *job = &list->jobs[list->count];
+    memset(job, 0, sizeof(*job));
+    job->path = strdup(path);
+    if (!job->path) {
+        perror("内存分配失败");
+        return -1;
+    }
+    list->count++;
+    return 0;
+}
+
+static int compare_jobs(const void *a, const void *b) {
+    return strcmp(((const batch_job_t *)a)->path, ((const batch_job_t *)b)->path);
+}
+
+// 收集目录中的可执行文件
+static int collect_from_directory(batch_list_t *list, const char *dir_path) {
+    DIR *dir = opendir(dir_path);
+    if (!dir) {
+        perror("打开批量任务目录失败");
+        return -1;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/%s", dir_path, entry->d_name);
+
+        struct stat st;
+        if (stat(path, &st) != 0 || !S_ISREG(st.st_mode) || !is_executable(path)) {
+            continue;
+        }
+        if (add_job(list, path) != 0) {
+            closedir(dir);
+            return -1;
+        }
+    }
+    closedir(dir);
+
+    // 目录顺序不稳定，排序后输出便于比较
+    qsort(list->jobs, (size_t)list->count, sizeof(batch_job_t), compare_jobs);
+    return 0;
+}
+
+// 从列表文件读取样本路径，每行一个，忽略空行和#注释
+static int collect_from_list(batch_list_t *list, const char *list_path) {
+    FILE *fp = fopen(list_path, "r");
+    if (!fp) {
+        perror("打开批量任务列表失败");
+        return -1;
+    }
+
+    char line[PATH_MAX];
+    while (fgets(line, sizeof(line), fp)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#') continue;
+        if (add_job(list, line) != 0) {
+            fclose(fp);
+            return -1;
+        }
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+static double elapsed_ms(const struct timespec *start, const struct timespec *end) {
+    return (double)(end->tv_sec - start->tv_sec) * 1000.0 +
+           (double)(end->tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+// 工作进程：复用命令行配置，为单个样本运行一次完整的沙箱+监控
+static void run_job(const sandbox_config *base, const char *path, const char *output_path,
+                    sandbox_result *result) {
+    // 每个任务的输出单独保存，避免并行任务的输出交错
+    int fd = open(output_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd != -1) {
+        dup2(fd, STDOUT_FILENO);
+        dup2(fd, STDERR_FILENO);
+        close(fd);
+    }
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    sandbox_config config = *base;
+    config.batch_source = NULL;
+    config.binary_path = NULL;
+    config.binary_name = NULL;
+    config.using_default = 0;
+
+    if (set_target_binary(&config, path) != 0) {
+        _exit(2);
+    }
+
+    int ret = run_sandbox(&config, result);
+    cleanup_config(&config);
+    fflush(stdout);
+    _exit(ret == 0 ? 0 : 1);
+}
+
+static void format_output_path(char *path, size_t len, pid_t batch_pid, int index) {
+    snprintf(path, len, "/tmp/malbox_batch_%d_%d.out", batch_pid, index);
+}
+
+// 池化工作进程：先创建好沙箱（命名空间、映射、tmpfs根目录），
+// 再阻塞等待调度进程分配任务，拿到任务后只剩交接样本和exec
+static void run_pool_worker(const sandbox_config *base, const batch_list_t *list, int cmd_fd,
+                            pid_t batch_pid, sandbox_result *results) {
+    // 预创建阶段的输出没有归属的任务，丢弃
+    int null_fd = open("/dev/null", O_WRONLY);
+    if (null_fd != -1) {
+        dup2(null_fd, STDOUT_FILENO);
+        dup2(null_fd, STDERR_FILENO);
+        close(null_fd);
+    }
+
+    sandbox_config config = *base;
+    config.batch_source = NULL;
+    config.binary_path = NULL;
+    config.binary_name = NULL;
+    config.using_default = 0;
+    config.pooled = 1;
+
+    // 预创建在后台进行：以SCHED_IDLE运行（沙箱进程继承该策略），
+    // 不与正在分析的样本争抢CPU
+    struct sched_param param = { 0 };
+    sched_setscheduler(0, SCHED_IDLE, &param);
+
+    sandbox_result warm;
+    if (spawn_sandbox(&config, &warm) != 0) {
+        _exit(3);
+    }
+
+    int index;
+    if (read(cmd_fd, &index, sizeof(index)) != (ssize_t)sizeof(index) ||
+        index < 0 || index >= list->count) {
+        // 没有任务了：关闭交接管道，沙箱读到EOF后自行退出
+        close(config.handoff_pipe[1]);
+        waitpid(warm.sandbox_pid, NULL, 0);
+        release_sandbox(&config, &warm);
+        _exit(0);
+    }
+    close(cmd_fd);
+
+    // 分配到任务后恢复普通调度策略（沙箱进程在子用户命名空间中，需要由这里代为设置）
+    sched_setscheduler(0, SCHED_OTHER, &param);
+    sched_setscheduler(warm.sandbox_pid, SCHED_OTHER, &param);
+
+    char output_path[PATH_MAX];
+    format_output_path(output_path, sizeof(output_path), batch_pid, index);
+    int fd = open(output_path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (fd != -1) {
+        dup2(fd, STDOUT_FILENO);
+        dup2(fd, STDERR_FILENO);
+        close(fd);
+    }
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    sandbox_result *result = &results[index];
+    *result = warm;
+    if (set_target_binary(&config, list->jobs[index].path) != 0) {
+        close(config.handoff_pipe[1]);
+        waitpid(warm.sandbox_pid, NULL, 0);
+        release_sandbox(&config, &warm);
+        _exit(2);
+    }
+    print_file_info(config.binary_path);
+    int ret = handoff_sample(&config, output_path);
+    if (ret == 0) {
+        ret = monitor_sandbox(&config, result);
+    } else {
+        waitpid(warm.sandbox_pid, NULL, 0);
+        release_sandbox(&config, &warm);
+    }
+    cleanup_config(&config);
+    fflush(stdout);
+    _exit(ret == 0 ? 0 : 1);
+}
+
+// 新建一个池化工作进程放入空闲队列
+static int pool_spawn(sandbox_pool_t *pool, const sandbox_config *config, const batch_list_t *list,
+                      sandbox_result *results) {
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) == -1) {
+        perror("创建任务管道失败");
+        return -1;
+    }
+
+    pid_t batch_pid = getpid();
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("创建工作进程失败");
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        // 其他工作进程的任务管道不能留在这里，否则它们收不到EOF
+        for (int i = 0; i < pool->idle_count; i++) {
+            close(pool->idle[i].cmd_fd);
+        }
+        close(fds[1]);
+        run_pool_worker(config, list, fds[0], batch_pid, results);
+    }
+
+    close(fds[0]);
+    pool->idle[pool->idle_count].pid = pid;
+    pool->idle[pool->idle_count].cmd_fd = fds[1];
+    pool->idle_count++;
+    return 0;
+}
+
+// 从空闲队列取出最早创建（最可能已就绪）的工作进程并分配任务
+static pid_t pool_assign(sandbox_pool_t *pool, int index) {
+    pool_worker_t worker = pool->idle[0];
+    memmove(&pool->idle[0], &pool->idle[1], (size_t)(pool->idle_count - 1) * sizeof(pool_worker_t));
+    pool->idle_count--;
+
+    // 工作进程可能还在后台预创建，提升回普通调度策略以免拖慢任务
+    struct sched_param param = { 0 };
+    sched_setscheduler(worker.pid, SCHED_OTHER, &param);
+
+    ssize_t n = write(worker.cmd_fd, &index, sizeof(index));
+    close(worker.cmd_fd);
+    if (n != (ssize_t)sizeof(index)) {
+        perror("分配任务失败");
+        return -1;
+    }
+    return worker.pid;
+}
+
+// 空闲工作进程意外退出（预创建失败）时从队列中移除
+static int pool_remove(sandbox_pool_t *pool, pid_t pid) {
+    for (int i = 0; i < pool->idle_count; i++) {
+        if (pool->idle[i].pid == pid) {
+            close(pool->idle[i].cmd_fd);
+            pool->idle[i] = pool->idle[pool->idle_count - 1];
+            pool->idle_count--;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void format_exit_status(const batch_job_t *job, const sandbox_result *result,
+                               char *out, size_t outlen) {
+    if (!WIFEXITED(job->runner_status) || WEXITSTATUS(job->runner_status) != 0) {
+        snprintf(out, outlen, "运行失败");
+    } else if (result->timeout_reason == TIMEOUT_WALL) {
+        snprintf(out, outlen, "超时(墙钟)");
+    } else if (result->timeout_reason == TIMEOUT_CPU) {
+        snprintf(out, outlen, "超时(CPU)");
+    } else if (!result->exited) {
+        snprintf(out, outlen, "未知");
+    } else if (WIFEXITED(result->exit_status)) {
+        snprintf(out, outlen, "exit %d", WEXITSTATUS(result->exit_status));
+    } else if (WIFSIGNALED(result->exit_status)) {
+        snprintf(out, outlen, "signal %d", WTERMSIG(result->exit_status));
+    } else {
+        snprintf(out, outlen, "未知");
+    }
+}
+
+// 输出批量分析汇总
+static void print_batch_summary(const batch_list_t *list, const sandbox_result *results,
+                                double total_ms, int jobs) {
+    printf("\n===== 批量分析汇总 =====\n");
+    printf("%-5s %12s %10s %-12s %8s %10s %10s %8s  %s\n", "#", "墙上时间(ms)", "准备(ms)", "退出状态",
+           "系统调用", "CPU(ms)", "内存(MiB)", "沙箱PID", "样本");
+
+    int failed = 0;
+    double sum_ms = 0;
+    for (int i = 0; i < list->count; i++) {
+        const batch_job_t *job = &list->jobs[i];
+        char status[32];
+        format_exit_status(job, &results[i], status, sizeof(status));
+        if (!WIFEXITED(job->runner_status) || WEXITSTATUS(job->runner_status) != 0) {
+            failed++;
+        }
+        sum_ms += job->wall_ms;
+
+        // 准备时间：从任务开始到沙箱即将exec样本
+        double setup_ms = 0;
+        if (results[i].ready_ns != 0) {
+            uint64_t start_ns = (uint64_t)job->start.tv_sec * 1000000000ull + (uint64_t)job->start.tv_nsec;
+            setup_ms = (double)(int64_t)(results[i].ready_ns - start_ns) / 1e6;
+        }
+        // 资源用量来自沙箱的cgroup，未创建cgroup时显示为"-"
+        const cgroup_stats_t *cg = &results[i].cgroup;
+        char cpu_ms[16] = "-", mem_mib[16] = "-";
+        if (cg->valid) {
+            snprintf(cpu_ms, sizeof(cpu_ms), "%.1f", (double)cg->cpu_usage_us / 1e3);
+            if (cg->memory_peak > 0) {
+                snprintf(mem_mib, sizeof(mem_mib), "%.1f", (double)cg->memory_peak / (1024.0 * 1024.0));
+            }
+        }
+        printf("%-5d %12.1f %10.2f %-12s %8d %10s %10s %8d  %s\n", i, job->wall_ms, setup_ms, status,
+               results[i].unique_syscalls, cpu_ms, mem_mib, results[i].sandbox_pid, job->path);
+    }
+
+    printf("\n样本数: %d, 失败: %d, 并行数: %d\n", list->count, failed, jobs);
+    printf("总耗时: %.1f ms, 单样本平均: %.1f ms, 吞吐量: %.2f 样本/秒\n",
+           total_ms, list->count ? sum_ms / list->count : 0.0,
+           total_ms > 0 ? list->count * 1000.0 / total_ms : 0.0);
+}
+
+// 批量模式：维持最多N个沙箱/跟踪器对同时运行，每个任务在独立的工作进程中完成
+int run_batch(const sandbox_config *config) {
+    batch_list_t list;
+    memset(&list, 0, sizeof(list));
+
+    struct stat st;
+    if (stat(config->batch_source, &st) != 0) {
+        perror("无法访问批量任务来源");
+        return -1;
+    }
+    int ret = S_ISDIR(st.st_mode) ? collect_from_directory(&list, config->batch_source)
+                                  : collect_from_list(&list, config->batch_source);
+    if (ret != 0 || list.count == 0) {
+        fprintf(stderr, "错误: 没有可分析的样本\n");
+        free(list.jobs);
+        return -1;
+    }
+
+    int jobs = config->batch_jobs > 0 ? config->batch_jobs : 1;
+    printf("批量分析: %d 个样本, 并行数 %d\n", list.count, jobs);
+
+    // 运行结果由工作进程直接写入共享内存
+    size_t results_size = (size_t)list.count * sizeof(sandbox_result);
+    sandbox_result *results = mmap(NULL, results_size, PROT_READ | PROT_WRITE,
+                                   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (results == MAP_FAILED) {
+        perror("分配共享结果区失败");
+        free(list.jobs);
+        return -1;
+    }
+
+    struct timespec batch_start, now;
+    clock_gettime(CLOCK_MONOTONIC, &batch_start);
+
+    sandbox_pool_t pool;
+    memset(&pool, 0, sizeof(pool));
+    pool.size = config->pool_size;
+    if (pool.size > 0) {
+        pool.idle = calloc((size_t)pool.size, sizeof(pool_worker_t));
+        if (!pool.idle) {
+            perror("内存分配失败");
+            pool.size = 0;
+        } else {
+            printf("预创建沙箱池: %d 个\n", pool.size);
+        }
+    }
+
+    int next = 0, running = 0, finished = 0;
+    fflush(stdout);
+    while (finished < list.count) {
+        // 补充预创建的沙箱，数量不超过剩余任务数
+        while (pool.size > 0 && pool.idle_count < pool.size &&
+               next + pool.idle_count < list.count) {
+            fflush(stdout);
+            if (pool_spawn(&pool, config, &list, results) != 0) {
+                break;
+            }
+        }
+
+        // 填满工作池
+        while (running < jobs && next < list.count) {
+            batch_job_t *job = &list.jobs[next];
+            char output_path[PATH_MAX];
+            format_output_path(output_path, sizeof(output_path), getpid(), next);
+
+            clock_gettime(CLOCK_MONOTONIC, &job->start);
+            pid_t pid;
+            if (pool.idle_count > 0) {
+                pid = pool_assign(&pool, next);
+            } else {
+                pid = fork();
+                if (pid == 0) {
+                    for (int i = 0; i < pool.idle_count; i++) {
+                        close(pool.idle[i].cmd_fd);
+                    }
+                    run_job(config, job->path, output_path, &results[next]);
+                }
+            }
+            if (pid == -1) {
+                perror("创建工作进程失败");
+                break;
+            }
+
+            job->runner = pid;
+            printf("[%d/%d] 开始: %s (输出: %s)\n", next + 1, list.count, job->path, output_path);
+            next++;
+            running++;
+        }
+
+        if (running == 0) {
+            // fork失败且没有任务在运行，无法继续
+            break;
+        }
+
+        // 等待任意一个工作进程结束
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid == -1) {
+            if (errno == EINTR) continue;
+            perror("等待工作进程失败");
+            break;
+        }
+
+        if (pool_remove(&pool, pid)) {
+            // 预创建失败的工作进程没有任务，连续失败过多时停用沙箱池
+            if (++pool.failures >= POOL_MAX_FAILURES) {
+                printf("预创建沙箱连续失败，改为逐个创建\n");
+                while (pool.idle_count > 0) {
+                    pool_remove(&pool, pool.idle[0].pid);
+                }
+                pool.size = 0;
+            }
+            continue;
+        }
+        pool.failures = 0;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        for (int i = 0; i < next; i++) {
+            batch_job_t *job = &list.jobs[i];
+            if (job->runner == pid) {
+                job->runner_status = status;
+                job->wall_ms = elapsed_ms(&job->start, &now);
+                job->runner = 0;
+                running--;
+                finished++;
+                printf("[%d/%d] 完成: %s (%.1f ms)\n", finished, list.count, job->path, job->wall_ms);
+                break;
+            }
+        }
+    }
+
+    // 关闭剩余空闲工作进程的任务管道，它们会释放沙箱后退出
+    while (pool.idle_count > 0) {
+        pid_t pid = pool.idle[0].pid;
+        pool_remove(&pool, pid);
+        waitpid(pid, NULL, 0);
+    }
+    free(pool.idle);
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    print_batch_summary(&list, results, elapsed_ms(&batch_start, &now), jobs);
+
+    for (int i = 0; i < list.count; i++) {
+        free(list.jobs[i].path);
+    }
+    free(list.jobs);
+    munmap(results, results_size);
+    return finished == list.count ? 0 : -1;
+}
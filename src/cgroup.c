@@ -0,0 +1,260 @@
+// src/cgroup.c
+#include "sandbox.h"
+
+// 每个沙箱一个cgroup v2叶子节点：限制CPU/内存/进程数/I/O，
+// 结束时读取资源用量。主机不支持某个控制器时只跳过对应的限制
+
+// 从/proc/self/mounts找到cgroup2挂载点（可能是/sys/fs/cgroup或混合模式的.../unified）
+static int find_cgroup2_mount(char *out, size_t outlen) {
+    FILE *fp = fopen("/proc/self/mounts", "r");
+    if (!fp) {
+        return -1;
+    }
+
+    char line[PATH_MAX * 2];
+    int found = -1;
+    while (fgets(line, sizeof(line), fp)) {
+        char dev[64], dir[PATH_MAX], type[64];
+        if (sscanf(line, "%63s %4095s %63s", dev, dir, type) == 3 && strcmp(type, "cgroup2") == 0) {
+            snprintf(out, outlen, "%s", dir);
+            found = 0;
+            break;
+        }
+    }
+    fclose(fp);
+    return found;
+}
+
+static int write_cgroup_file(const char *dir, const char *name, const char *value) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    int fd = open(path, O_WRONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return -1;
+    }
+    ssize_t n = write(fd, value, strlen(value));
+    int saved = errno;
+    close(fd);
+    errno = saved;
+    return n == (ssize_t)strlen(value) ? 0 : -1;
+}
+
+static int read_cgroup_file(const char *dir, const char *name, char *buf, size_t buflen) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return -1;
+    }
+    ssize_t n = read(fd, buf, buflen - 1);
+    close(fd);
+    if (n < 0) {
+        return -1;
+    }
+    buf[n] = '\0';
+    return 0;
+}
+
+// 在"key value"格式的文件内容中查找key
+static uint64_t stat_value(const char *content, const char *key) {
+    size_t keylen = strlen(key);
+    const char *p = content;
+    while (p && *p) {
+        if (strncmp(p, key, keylen) == 0 && p[keylen] == ' ') {
+            return strtoull(p + keylen + 1, NULL, 10);
+        }
+        p = strchr(p, '\n');
+        if (p) p++;
+    }
+    return 0;
+}
+
+// 空格分隔的列表中是否包含word
+static int list_contains(const char *list, const char *word) {
+    size_t len = strlen(word);
+    for (const char *p = list; (p = strstr(p, word)) != NULL; p += len) {
+        int starts = p == list || p[-1] == ' ';
+        int ends = p[len] == '\0' || p[len] == ' ' || p[len] == '\n';
+        if (starts && ends) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// 沿挂载点到dir的路径逐级打开控制器委派（写subtree_control），
+// 每级只启用上一级实际提供的控制器
+static void enable_controllers(const char *mount_point, const char *dir) {
+    static const char *const wanted[] = { "cpu", "memory", "pids", "io" };
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s", mount_point);
+    const char *rest = dir + strlen(mount_point);
+
+    while (1) {
+        char available[256];
+        if (read_cgroup_file(path, "cgroup.controllers", available, sizeof(available)) == 0) {
+            for (size_t i = 0; i < sizeof(wanted) / sizeof(wanted[0]); i++) {
+                if (list_contains(available, wanted[i])) {
+                    char token[16];
+                    snprintf(token, sizeof(token), "+%s", wanted[i]);
+                    write_cgroup_file(path, "cgroup.subtree_control", token);
+                }
+            }
+        }
+
+        while (*rest == '/') rest++;
+        if (*rest == '\0') break;
+        size_t seg = strcspn(rest, "/");
+        size_t len = strlen(path);
+        snprintf(path + len, sizeof(path) - len, "/%.*s", (int)seg, rest);
+        rest += seg;
+    }
+}
+
+// 写入一项限制；控制器不可用时给出提示但不视为失败
+static void apply_limit(const char *dir, const char *name, const char *value) {
+    if (write_cgroup_file(dir, name, value) != 0) {
+        printf("警告: 无法设置cgroup限制 %s=%s: %s\n", name, value, strerror(errno));
+    }
+}
+
+// 为沙箱进程pid创建cgroup叶子节点并设置限制，成功时路径写入result->cgroup_path。
+// 在沙箱进程收到同步信号之前调用，此后创建的所有进程都继承该cgroup
+int cgroup_setup_sandbox(const sandbox_config *config, pid_t pid, sandbox_result *result) {
+    result->cgroup_path[0] = '\0';
+
+    char mount_point[PATH_MAX];
+    if (find_cgroup2_mount(mount_point, sizeof(mount_point)) != 0) {
+        printf("警告: 未找到cgroup v2挂载点，不限制沙箱资源\n");
+        return -1;
+    }
+
+    char parent[PATH_MAX + 32];
+    if (config->cgroup_root) {
+        snprintf(parent, sizeof(parent), "%s", config->cgroup_root);
+    } else {
+        snprintf(parent, sizeof(parent), "%s/%s", mount_point, DEFAULT_CGROUP_NAME);
+    }
+    if (mkdir_p(parent, 0755) != 0) {
+        printf("警告: 创建cgroup %s 失败: %s\n", parent, strerror(errno));
+        return -1;
+    }
+    if (strncmp(parent, mount_point, strlen(mount_point)) == 0) {
+        enable_controllers(mount_point, parent);
+    }
+
+    char *leaf = result->cgroup_path;
+    int n = snprintf(leaf, sizeof(result->cgroup_path), "%s/sandbox-%d", parent, pid);
+    if (n < 0 || (size_t)n >= sizeof(result->cgroup_path)) {
+        printf("警告: cgroup路径过长: %s\n", parent);
+        leaf[0] = '\0';
+        return -1;
+    }
+    if (mkdir(leaf, 0755) == -1 && errno != EEXIST) {
+        printf("警告: 创建cgroup %s 失败: %s\n", leaf, strerror(errno));
+        leaf[0] = '\0';
+        return -1;
+    }
+
+    char value[256];
+    if (config->cpu_quota_us > 0) {
+        snprintf(value, sizeof(value), "%ld %d", config->cpu_quota_us, CGROUP_CPU_PERIOD_US);
+        apply_limit(leaf, "cpu.max", value);
+    }
+    if (config->memory_max > 0) {
+        snprintf(value, sizeof(value), "%llu", (unsigned long long)config->memory_max);
+        apply_limit(leaf, "memory.max", value);
+        // 不让样本借助swap绕过内存限制；OOM时整个沙箱一起结束
+        write_cgroup_file(leaf, "memory.swap.max", "0");
+        write_cgroup_file(leaf, "memory.oom.group", "1");
+    }
+    if (config->pids_max > 0) {
+        snprintf(value, sizeof(value), "%ld", config->pids_max);
+        apply_limit(leaf, "pids.max", value);
+    }
+    if (config->io_max) {
+        apply_limit(leaf, "io.max", config->io_max);
+    }
+
+    snprintf(value, sizeof(value), "%d", pid);
+    if (write_cgroup_file(leaf, "cgroup.procs", value) != 0) {
+        printf("警告: 无法将沙箱加入cgroup %s: %s\n", leaf, strerror(errno));
+        rmdir(leaf);
+        leaf[0] = '\0';
+        return -1;
+    }
+    return 0;
+}
+
+// 读取cgroup中所有进程累计的CPU时间（用于CPU超时检查）
+int cgroup_read_cpu_usage(const char *path, uint64_t *usage_us) {
+    char buf[1024];
+    if (path[0] == '\0' || read_cgroup_file(path, "cpu.stat", buf, sizeof(buf)) != 0) {
+        return -1;
+    }
+    *usage_us = stat_value(buf, "usage_usec");
+    return 0;
+}
+
+// 读取沙箱结束时的资源用量。不存在的统计文件（控制器未启用）对应字段保持为0
+void cgroup_collect_stats(const char *path, cgroup_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+    char buf[4096];
+
+    if (read_cgroup_file(path, "cpu.stat", buf, sizeof(buf)) == 0) {
+        stats->cpu_usage_us = stat_value(buf, "usage_usec");
+        stats->cpu_user_us = stat_value(buf, "user_usec");
+        stats->cpu_system_us = stat_value(buf, "system_usec");
+        stats->nr_throttled = stat_value(buf, "nr_throttled");
+        stats->throttled_us = stat_value(buf, "throttled_usec");
+    }
+    if (read_cgroup_file(path, "memory.peak", buf, sizeof(buf)) == 0) {
+        stats->memory_peak = strtoull(buf, NULL, 10);
+    }
+    if (read_cgroup_file(path, "memory.events", buf, sizeof(buf)) == 0) {
+        stats->oom_kills = stat_value(buf, "oom_kill");
+    }
+    if (read_cgroup_file(path, "pids.peak", buf, sizeof(buf)) == 0) {
+        stats->pids_peak = strtoull(buf, NULL, 10);
+    }
+    // io.stat每行一个设备: "MAJ:MIN rbytes=N wbytes=N rios=N ..."
+    if (read_cgroup_file(path, "io.stat", buf, sizeof(buf)) == 0) {
+        for (char *p = buf; (p = strstr(p, "bytes=")) != NULL; p += 6) {
+            if (p > buf && p[-1] == 'r') {
+                stats->io_read_bytes += strtoull(p + 6, NULL, 10);
+            } else if (p > buf && p[-1] == 'w') {
+                stats->io_write_bytes += strtoull(p + 6, NULL, 10);
+            }
+        }
+    }
+    stats->valid = 1;
+}
+
+// 删除沙箱的cgroup；残留的进程先用cgroup.kill结束
+void cgroup_destroy(const char *path) {
+    if (path[0] == '\0') {
+        return;
+    }
+
+    for (int attempt = 0; attempt < 50; attempt++) {
+        if (rmdir(path) == 0 || errno == ENOENT) {
+            return;
+        }
+        if (errno != EBUSY) {
+            break;
+        }
+        write_cgroup_file(path, "cgroup.kill", "1");
+        usleep(10000);
+    }
+    printf("警告: 删除cgroup %s 失败: %s\n", path, strerror(errno));
+}
+
+void print_cgroup_stats(const cgroup_stats_t *stats) {
+    printf("[CGROUP] CPU: %.1f ms (用户 %.1f ms, 内核 %.1f ms, 被节流 %llu 次/%.1f ms), "
+           "内存峰值: %.1f MiB, OOM: %llu, 进程数峰值: %llu, I/O: 读 %.1f KiB, 写 %.1f KiB\n",
+           (double)stats->cpu_usage_us / 1e3, (double)stats->cpu_user_us / 1e3,
+           (double)stats->cpu_system_us / 1e3, (unsigned long long)stats->nr_throttled,
+           (double)stats->throttled_us / 1e3, (double)stats->memory_peak / (1024.0 * 1024.0),
+           (unsigned long long)stats->oom_kills, (unsigned long long)stats->pids_peak,
+           (double)stats->io_read_bytes / 1024.0, (double)stats->io_write_bytes / 1024.0);
+}
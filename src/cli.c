@@ -1,52 +1,588 @@
 // src/cli.c
 #include "sandbox.h"
+#include <getopt.h>
+
+// seccomp过滤模式下默认跟踪的系统调用
+#define DEFAULT_TRACED_SYSCALLS "open,openat,execve,connect,clone,fork,vfork,unlink"
+// 睡眠加速需要在过滤模式下额外跟踪的系统调用
+#define TIME_WARP_SYSCALLS "nanosleep,clock_nanosleep,select,pselect6,poll,ppoll,clock_gettime,gettimeofday,time"
+// fd跟踪需要在过滤模式下额外跟踪的系统调用（创建、复制、关闭fd以及继承文件表）
+#define FD_TRACK_SYSCALLS "open,openat,openat2,creat,socket,socketpair,accept,accept4,connect,bind," \
+                          "dup,dup2,dup3,fcntl,close,close_range,pipe,pipe2,clone,clone3,fork,vfork"
+// 伪造网络需要在过滤模式下额外跟踪的系统调用（在样本连接前创建监听）
+#define SINKHOLE_SYSCALLS "connect,sendto"
+// 通知后端额外选中的系统调用（看不到任务结束，只能从exit得知）
+#define NOTIF_SYSCALLS "exit,exit_group"
+// 可执行内存转储需要在过滤模式下额外跟踪的系统调用（内存变为可执行，以及进程结束前的重新检查）
+#define MEM_DUMP_SYSCALLS "mmap,mprotect,pkey_mprotect,mremap,execve,execveat,exit_group"
+
+enum {
+    OPT_SECCOMP = 0x100,
+    OPT_TRACE,
+    OPT_BINARY_LOG,
+    OPT_JSON,
+    OPT_DECODE,
+    OPT_BUFFER_PREVIEW,
+    OPT_NO_FD_TRACK,
+    OPT_NGRAM,
+    OPT_NGRAM_TOP,
+    OPT_POLICY,
+    OPT_SINKHOLE,
+    OPT_BATCH,
+    OPT_TEMPLATE_CACHE,
+    OPT_STAGE_LIBS,
+    OPT_STATS,
+    OPT_POOL,
+    OPT_CALIBRATE_LATENCY,
+    OPT_NO_CGROUP,
+    OPT_CGROUP_ROOT,
+    OPT_CPUS,
+    OPT_MEMORY_MAX,
+    OPT_PIDS_MAX,
+    OPT_IO_MAX,
+    OPT_TIMEOUT,
+    OPT_CPU_TIMEOUT,
+    OPT_ACCELERATE_TIME,
+    OPT_BACKEND,
+    OPT_NOTIF_THREADS,
+    OPT_TRACER_THREADS,
+    OPT_DUMP_EXEC,
+};
+
+static const struct option long_options[] = {
+    {"help",           no_argument,       NULL, 'h'},
+    {"seccomp",        no_argument,       NULL, OPT_SECCOMP},
+    {"trace",          required_argument, NULL, OPT_TRACE},
+    {"backend",        required_argument, NULL, OPT_BACKEND},
+    {"notif-threads",  required_argument, NULL, OPT_NOTIF_THREADS},
+    {"tracer-threads", required_argument, NULL, OPT_TRACER_THREADS},
+    {"binary-log",     no_argument,       NULL, OPT_BINARY_LOG},
+    {"json",           required_argument, NULL, OPT_JSON},
+    {"decode",         required_argument, NULL, OPT_DECODE},
+    {"buffer-preview", required_argument, NULL, OPT_BUFFER_PREVIEW},
+    {"no-fd-track",    no_argument,       NULL, OPT_NO_FD_TRACK},
+    {"ngram",          required_argument, NULL, OPT_NGRAM},
+    {"ngram-top",      required_argument, NULL, OPT_NGRAM_TOP},
+    {"policy",         required_argument, NULL, OPT_POLICY},
+    {"sinkhole",       optional_argument, NULL, OPT_SINKHOLE},
+    {"dump-exec",      optional_argument, NULL, OPT_DUMP_EXEC},
+    {"batch",          required_argument, NULL, OPT_BATCH},
+    {"jobs",           required_argument, NULL, 'j'},
+    {"template-cache", optional_argument, NULL, OPT_TEMPLATE_CACHE},
+    {"stage-libs",     required_argument, NULL, OPT_STAGE_LIBS},
+    {"stats",          no_argument,       NULL, OPT_STATS},
+    {"pool",           required_argument, NULL, OPT_POOL},
+    {"calibrate-latency", no_argument,    NULL, OPT_CALIBRATE_LATENCY},
+    {"no-cgroup",      no_argument,       NULL, OPT_NO_CGROUP},
+    {"cgroup-root",    required_argument, NULL, OPT_CGROUP_ROOT},
+    {"cpus",           required_argument, NULL, OPT_CPUS},
+    {"memory-max",     required_argument, NULL, OPT_MEMORY_MAX},
+    {"pids-max",       required_argument, NULL, OPT_PIDS_MAX},
+    {"io-max",         required_argument, NULL, OPT_IO_MAX},
+    {"timeout",        required_argument, NULL, OPT_TIMEOUT},
+    {"cpu-timeout",    required_argument, NULL, OPT_CPU_TIMEOUT},
+    {"accelerate-time", optional_argument, NULL, OPT_ACCELERATE_TIME},
+    {NULL, 0, NULL, 0}
+};
 
 void print_usage(const char *program_name) {
-    printf("用法: %s [ELF文件路径]\n", program_name);
+    printf("用法: %s [选项] [ELF文件路径]\n", program_name);
     printf("如果不指定ELF文件，将运行默认的Hello World程序\n");
+    printf("\n选项:\n");
+    printf("  -h, --help          显示帮助信息\n");
+    printf("  --seccomp           使用seccomp-bpf过滤，仅在关心的系统调用处停止\n");
+    printf("                      (默认: %s)\n", DEFAULT_TRACED_SYSCALLS);
+    printf("  --trace=LIST        指定过滤模式下跟踪的系统调用（逗号分隔的名称或编号），隐含--seccomp\n");
+    printf("  --backend=NAME      监控后端: ptrace(默认)，或ebpf —— 由挂载在raw_syscalls跟踪点上的\n");
+    printf("                      eBPF程序经环形缓冲区上报，样本不处于ptrace之下、不停止，\n");
+    printf("                      每次调用只在内核中捕获一个路径或地址参数；需要CAP_BPF和CAP_PERFMON\n");
+    printf("                      (或root)和沙箱cgroup，不支持--seccomp、--sinkhole、--accelerate-time、--dump-exec和改写调用的策略\n");
+    printf("                      或notif —— seccomp用户通知: --trace选中的系统调用交给多个监督线程\n");
+    printf("                      并发处理，读取参数并按策略回复；只有入口没有返回值，不跟踪fd表；\n");
+    printf("                      放行后内核会重新读取参数内存，按路径或地址拦截的策略不可用\n");
+    printf("  --notif-threads=N   notif后端的监督线程数 (默认: CPU数，2-%d)\n", NOTIF_THREADS_MAX);
+    printf("  --tracer-threads=N  ptrace后端的跟踪线程数 (默认: 1，最多%d)；新进程分给负载最小的线程，\n",
+           TRACER_THREADS_MAX);
+    printf("                      适合大量派生进程的样本；迁移对样本不可见，各线程独立处理，日志按时间归并\n");
+    printf("  --binary-log        将事件写入异步二进制日志/tmp/malbox_syscall_<pid>.bin，\n");
+    printf("                      用malbox-decode离线转换为文本\n");
+    printf("  --json=FILE|unix:SOCK\n");
+    printf("                      以NDJSON输出事件流（每行一个JSON对象，含结束时的统计），\n");
+    printf("                      追加写入文件，或连接到消费者监听的Unix域套接字\n");
+    printf("  --decode=LIST|none  只解码列表中系统调用的参数（路径、argv、地址、标志位、缓冲区），\n");
+    printf("                      默认解码所有内置描述符的系统调用；其余调用不读取被跟踪进程内存\n");
+    printf("  --buffer-preview=N  write/sendto缓冲区预览的字节数 (默认: %d，0表示不预览)\n",
+           DEFAULT_PREVIEW_BYTES);
+    printf("  --no-fd-track       不跟踪各进程的fd表；默认在解码的参数中把fd标注为\n");
+    printf("                      对应的路径或套接字 (如write(fd=3</tmp/a.txt>, ...))\n");
+    printf("  --ngram=N           按线程统计长度为N的系统调用序列 (%d-%d，默认: %d，0表示关闭)，\n",
+           NGRAM_MIN, NGRAM_MAX, NGRAM_DEFAULT_N);
+    printf("                      结束时输出top-K n-gram和MinHash签名，内存占用固定\n");
+    printf("  --ngram-top=K       输出的n-gram条目数 (默认: %d，最多%d)\n", NGRAM_DEFAULT_TOP, NGRAM_TOP_MAX);
+    printf("  --policy=FILE       按策略文件放行、记录、伪造返回值或终止，每行一条规则:\n");
+    printf("                      ACTION SYSCALL [argN==V|argN!=V|argN&V|family=NAME|path=P[*]]...\n");
+    printf("                      ACTION为allow、log、errno(EPERM)、fake[(N)]、kill；SYSCALL为compat时\n");
+    printf("                      指定所有i386兼容ABI调用的动作。只看寄存器的规则在内核中执行\n");
+    printf("  --sinkhole[=FILE]   伪造网络: 沙箱内所有地址路由到回环接口，由主机侧sinkhole应答DNS、\n");
+    printf("                      接受任意端口的连接，记录HTTP请求、TLS SNI和负载\n");
+    printf("                      (默认日志: /tmp/malbox_sinkhole_<pid>.log)\n");
+    printf("  --dump-exec[=DIR]   mmap/mprotect/mremap使内存变为可执行以及execve完成时转储可执行区域，\n");
+    printf("                      按内容哈希命名，相同或未变化的内容不重复写入；用于获取脱壳后的代码\n");
+    printf("                      (默认目录: /tmp/malbox_dump_<pid>，指定DIR时为DIR/<pid>)\n");
+    printf("  --batch=DIR|LIST    批量分析目录中的所有可执行文件，或列表文件中每行一个路径\n");
+    printf("  -j, --jobs=N        批量模式下并行运行的沙箱数量 (默认: 1)\n");
+    printf("  --pool=K            批量模式下保持K个预先创建好命名空间和根目录的沙箱，\n");
+    printf("                      样本到达时只需复制样本并exec\n");
+    printf("  --template-cache[=DIR]\n");
+    printf("                      按依赖集合缓存只读根文件系统模板，沙箱以overlayfs叠加可写层\n");
+    printf("                      (默认目录: %s)\n", DEFAULT_TEMPLATE_DIR);
+    printf("  --stage-libs=MODE   依赖库暂存方式: copy(默认)、hardlink、bind(只读)，\n");
+    printf("                      文件系统不允许时自动退回复制\n");
+    printf("  --stats             输出每个样本的暂存字节数和耗时\n");
+    printf("  --calibrate-latency 启动时测量ptrace往返开销，并从每次系统调用延迟中扣除，\n");
+    printf("                      使统计的分位数接近内核内的执行时间\n");
+    printf("  --timeout=SEC       墙上时间限制，到期后终止整个沙箱（可为小数）\n");
+    printf("  --cpu-timeout=SEC   沙箱内所有进程的CPU时间限制，到期后终止整个沙箱\n");
+    printf("  --accelerate-time[=N]\n");
+    printf("                      睡眠加速: 跳过样本的睡眠（指定N时缩短为1/N），省下的时间\n");
+    printf("                      累计为虚拟时间加到时间查询结果上；会隐藏vDSO，时间查询变慢\n");
+    printf("\n资源限制（每个沙箱一个cgroup v2，结束时输出CPU/内存/进程数/I/O用量）:\n");
+    printf("  --cpus=N            CPU配额，可为小数 (如0.5表示半个CPU)\n");
+    printf("  --memory-max=SIZE   内存上限，支持K/M/G后缀\n");
+    printf("  --pids-max=N        进程和线程总数上限\n");
+    printf("  --io-max=SPEC       原样写入io.max (如\"8:0 rbps=1048576 wbps=1048576\")\n");
+    printf("  --cgroup-root=DIR   存放沙箱cgroup的目录 (默认: cgroup2挂载点下的%s)\n", DEFAULT_CGROUP_NAME);
+    printf("  --no-cgroup         不创建cgroup\n");
+}
+
+// 拒绝所选后端不支持的选项。eBPF后端只观察不停止样本；通知后端能在入口处停下样本，
+// 但看不到系统调用退出，无法改写返回值或测量ptrace开销
+static int check_backend_options(const sandbox_config *config) {
+    int ebpf = config->backend == MONITOR_BACKEND_EBPF;
+    const char *option = NULL;
+    if (ebpf && config->seccomp_filter) {
+        option = "--seccomp/--trace";
+    } else if (ebpf && config->sinkhole) {
+        option = "--sinkhole";
+
+    } else if (config->time_warp) {
+        option = "--accelerate-time";
+    } else if (config->latency_calibrate) {
+        option = "--calibrate-latency";
+    } else if (config->tracer_threads > 1) {
+        option = "--tracer-threads";
+    } else if (config->mem_dump) {
+        option = "--dump-exec";
+    }
+    if (ebpf && config->cgroup_disabled) {
+        // 内核程序按沙箱cgroup识别样本的任务
+        fprintf(stderr, "错误: --backend=ebpf 需要沙箱cgroup，不能与 --no-cgroup 同时使用\n");
+        return -1;
+    }
+    if (option) {
+        fprintf(stderr, "错误: %s 需要ptrace后端，不能与 --backend=%s 同时使用\n", option,
+                ebpf ? "ebpf" : "notif");
+        return -1;
+    }
+    const policy_t *policy = config->policy;
+    if (!ebpf) {
+        // 通知后端按监督线程读到的参数内存判定，放行时回复CONTINUE，内核之后重新读取参数；
+        // 样本的另一个线程可以在两次读取之间换掉路径或地址。同一系统调用有拦截规则时，
+        // 按内存参数匹配的规则（无论本身是拦截还是放行）都可能被这样绕过
+        for (int i = 0; policy && i < policy->count; i++) {
+            const policy_rule_t *rule = &policy->rules[i];
+            if (rule->action != POLICY_ALLOW && rule->action != POLICY_LOG &&
+                policy_needs_capture(policy, rule->syscall_nr)) {
+                fprintf(stderr, "错误: %s:%d 的规则所在系统调用有按路径或地址匹配的规则，--backend=notif 下"
+                        "样本可在判定后换掉参数内存，不能据此拦截\n", policy->path, rule->line);
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    // 只看寄存器的规则在内核中执行，需要跟踪器改写或终止的规则无法执行
+    for (int i = 0; policy && i < policy->count; i++) {
+        const policy_rule_t *rule = &policy->rules[i];
+        if (rule->tracer_enforced && rule->action != POLICY_ALLOW && rule->action != POLICY_LOG) {
+            fprintf(stderr, "错误: %s:%d 的规则需要跟踪器执行，不能用于 --backend=ebpf\n",
+                    policy->path, rule->line);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// 解析秒数（可为小数），返回毫秒，无效时返回-1
+static long parse_seconds(const char *text) {
+    char *end;
+    double seconds = strtod(text, &end);
+    if (end == text || *end != '\0' || seconds <= 0 || seconds > LONG_MAX / 1000.0) {
+        return -1;
+    }
+    long ms = (long)(seconds * 1000.0 + 0.5);
+    return ms > 0 ? ms : -1;
+}
+
+// 解析带K/M/G后缀的字节数
+static int parse_size(const char *text, uint64_t *out) {
+    char *end;
+    errno = 0;
+    unsigned long long value = strtoull(text, &end, 10);
+    if (errno != 0 || end == text) {
+        return -1;
+    }
+
+    switch (*end) {
+    case 'k': case 'K': value <<= 10; end++; break;
+    case 'm': case 'M': value <<= 20; end++; break;
+    case 'g': case 'G': value <<= 30; end++; break;
+    default: break;
+    }
+    if (*end != '\0' || value == 0) {
+        return -1;
+    }
+    *out = value;
+    return 0;
+}
+
+// 把list中尚未跟踪的系统调用追加到过滤列表
+static void add_traced_syscalls(sandbox_config *config, const char *list) {
+    int extra[MAX_TRACED_SYSCALLS];
+    int count = parse_syscall_list(list, extra, MAX_TRACED_SYSCALLS);
+    for (int i = 0; i < count && config->traced_count < MAX_TRACED_SYSCALLS; i++) {
+        int present = 0;
+        for (int j = 0; j < config->traced_count; j++) {
+            if (config->traced_syscalls[j] == extra[i]) {
+                present = 1;
+                break;
+            }
+        }
+        if (!present) {
+            config->traced_syscalls[config->traced_count++] = extra[i];
+        }
+    }
 }
 
 void print_file_info(const char *filepath) {
-    char file_cmd[PATH_MAX + 16];
-    snprintf(file_cmd, sizeof(file_cmd), "file %s", filepath);
-    printf("文件信息: ");
-    fflush(stdout);
-    system(file_cmd);
+    elf_info_t info;
+    if (elf_read_info(filepath, &info) != 0) {
+        printf("文件信息: 非ELF文件或ELF结构损坏\n");
+        return;
+    }
+
+    char desc[PATH_MAX + 256];
+    elf_describe(&info, desc, sizeof(desc));
+    printf("文件信息: %s\n", desc);
+    if (info.needed.count > 0) {
+        printf("直接依赖:");
+        for (int i = 0; i < info.needed.count; i++) {
+            printf(" %s", info.needed.paths[i]);
+        }
+        printf("\n");
+    }
+    free_elf_info(&info);
+}
+
+// 设置要在沙箱中运行的目标程序（命令行位置参数和批量任务共用）
+int set_target_binary(sandbox_config *config, const char *target) {
+    // 检查指定的文件是否存在且可执行
+    if (!is_executable(target)) {
+        fprintf(stderr, "错误: '%s' 不存在或不可执行\n", target);
+        return EXIT_FAILURE;
+    }
+
+    config->binary_path = realpath(target, NULL);
+    if (!config->binary_path) {
+        perror("获取文件完整路径失败");
+        return EXIT_FAILURE;
+    }
+
+    char *target_copy = strdup(target);
+    if (!target_copy) {
+        perror("内存分配失败");
+        free(config->binary_path);
+        config->binary_path = NULL;
+        return EXIT_FAILURE;
+    }
+    config->binary_name = strdup(basename(target_copy));
+    free(target_copy);
+    if (!config->binary_name) {
+        perror("内存分配失败");
+        free(config->binary_path);
+        config->binary_path = NULL;
+        return EXIT_FAILURE;
+    }
+
+    printf("将在沙箱中运行: %s (文件名: %s)\n", config->binary_path, config->binary_name);
+
+    // 检查是否是静态链接的ELF文件
+    if (!is_static_elf(config->binary_path)) {
+        printf("检测到动态链接程序，将自动处理库依赖\n");
+    }
+
+    return 0;
 }
 
 int parse_arguments(int argc, char *argv[], sandbox_config *config) {
-    // 处理命令行参数
-    if (argc > 1) {
-        if (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) {
+    const char *trace_list = NULL;
+    int opt;
+
+    // 处理命令行选项
+    optind = 1;
+    while ((opt = getopt_long(argc, argv, "hj:", long_options, NULL)) != -1) {
+        switch (opt) {
+        case 'h':
             print_usage(argv[0]);
             return EXIT_SUCCESS;
+        case OPT_SECCOMP:
+            config->seccomp_filter = 1;
+            break;
+        case OPT_TRACE:
+            config->seccomp_filter = 1;
+            trace_list = optarg;
+            break;
+        case OPT_BACKEND:
+            if (strcmp(optarg, "ptrace") == 0) {
+                config->backend = MONITOR_BACKEND_PTRACE;
+            } else if (strcmp(optarg, "ebpf") == 0) {
+                config->backend = MONITOR_BACKEND_EBPF;
+            } else if (strcmp(optarg, "notif") == 0) {
+                config->backend = MONITOR_BACKEND_NOTIF;
+            } else {
+                fprintf(stderr, "错误: 未知的监控后端 '%s'\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case OPT_NOTIF_THREADS:
+            config->notif_threads = atoi(optarg);
+            if (config->notif_threads <= 0 || config->notif_threads > NOTIF_THREADS_MAX) {
+                fprintf(stderr, "错误: 无效的监督线程数 '%s'\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case OPT_TRACER_THREADS:
+            config->tracer_threads = atoi(optarg);
+            if (config->tracer_threads <= 0 || config->tracer_threads > TRACER_THREADS_MAX) {
+                fprintf(stderr, "错误: 无效的跟踪线程数 '%s'\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case OPT_BINARY_LOG:
+            config->binary_log = 1;
+            break;
+        case OPT_JSON:
+            config->json_output = optarg;
+            break;
+        case OPT_DECODE:
+            config->decode_selected = 1;
+            config->decode_count = 0;
+            if (strcmp(optarg, "none") != 0) {
+                config->decode_count = parse_syscall_list(optarg, config->decode_syscalls,
+                                                          MAX_TRACED_SYSCALLS);
+                if (config->decode_count < 0) {
+                    return EXIT_FAILURE;
+                }
+            }
+            break;
+        case OPT_BUFFER_PREVIEW: {
+            char *end;
+            long bytes = strtol(optarg, &end, 10);
+            if (end == optarg || *end != '\0' || bytes < 0 || bytes > INT_MAX) {
+                fprintf(stderr, "错误: 无效的预览字节数 '%s'\n", optarg);
+                return EXIT_FAILURE;
+            }
+            config->preview_bytes = bytes > 0 ? (int)bytes : -1;
+            break;
         }
-
-        // 检查指定的文件是否存在且可执行
-        if (!is_executable(argv[1])) {
-            fprintf(stderr, "错误: '%s' 不存在或不可执行\n", argv[1]);
+        case OPT_NO_FD_TRACK:
+            config->fd_track_disabled = 1;
+            break;
+        case OPT_NGRAM: {
+            char *end;
+            long n = strtol(optarg, &end, 10);
+            if (end == optarg || *end != '\0' || (n != 0 && (n < NGRAM_MIN || n > NGRAM_MAX))) {
+                fprintf(stderr, "错误: 无效的n-gram长度 '%s' (%d-%d，0表示关闭)\n", optarg, NGRAM_MIN, NGRAM_MAX);
+                return EXIT_FAILURE;
+            }
+            config->ngram_n = n > 0 ? (int)n : -1;
+            break;
+        }
+        case OPT_NGRAM_TOP: {
+            char *end;
+            long k = strtol(optarg, &end, 10);
+            if (end == optarg || *end != '\0' || k < 1 || k > NGRAM_TOP_MAX) {
+                fprintf(stderr, "错误: 无效的n-gram条目数 '%s' (1-%d)\n", optarg, NGRAM_TOP_MAX);
+                return EXIT_FAILURE;
+            }
+            config->ngram_top = (int)k;
+            break;
+        }
+        case OPT_POLICY:
+            policy_free(config->policy);
+            config->policy = policy_load(optarg);
+            if (!config->policy) {
+                return EXIT_FAILURE;
+            }
+            break;
+        case OPT_SINKHOLE:
+            config->sinkhole = 1;
+            config->sinkhole_log = optarg;
+            break;
+        case OPT_DUMP_EXEC:
+            config->mem_dump = 1;
+            config->mem_dump_dir = optarg;
+            break;
+        case OPT_BATCH:
+            config->batch_source = optarg;
+            break;
+        case OPT_TEMPLATE_CACHE:
+            config->template_cache = 1;
+            config->template_dir = optarg;
+            break;
+        case OPT_STAGE_LIBS:
+            if (strcmp(optarg, "copy") == 0) {
+                config->stage_mode = STAGE_COPY;
+            } else if (strcmp(optarg, "hardlink") == 0) {
+                config->stage_mode = STAGE_HARDLINK;
+            } else if (strcmp(optarg, "bind") == 0) {
+                config->stage_mode = STAGE_BIND;
+            } else {
+                fprintf(stderr, "错误: 未知的暂存方式 '%s'\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case OPT_STATS:
+            config->stats = 1;
+            break;
+        case OPT_NO_CGROUP:
+            config->cgroup_disabled = 1;
+            break;
+        case OPT_CGROUP_ROOT:
+            config->cgroup_root = optarg;
+            break;
+        case OPT_CPUS: {
+            double cpus = atof(optarg);
+            config->cpu_quota_us = (long)(cpus * CGROUP_CPU_PERIOD_US);
+            if (config->cpu_quota_us < 1000) {
+                fprintf(stderr, "错误: 无效的CPU配额 '%s'\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        }
+        case OPT_MEMORY_MAX:
+            if (parse_size(optarg, &config->memory_max) != 0) {
+                fprintf(stderr, "错误: 无效的内存上限 '%s'\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case OPT_PIDS_MAX:
+            config->pids_max = atol(optarg);
+            if (config->pids_max <= 0) {
+                fprintf(stderr, "错误: 无效的进程数上限 '%s'\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case OPT_IO_MAX:
+            config->io_max = optarg;
+            break;
+        case OPT_TIMEOUT:
+            config->timeout_ms = parse_seconds(optarg);
+            if (config->timeout_ms < 0) {
+                fprintf(stderr, "错误: 无效的超时时间 '%s'\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case OPT_CPU_TIMEOUT:
+            config->cpu_timeout_ms = parse_seconds(optarg);
+            if (config->cpu_timeout_ms < 0) {
+                fprintf(stderr, "错误: 无效的CPU超时时间 '%s'\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case OPT_ACCELERATE_TIME:
+            config->time_warp = 1;
+            config->time_warp_factor = optarg ? atoi(optarg) : 0;
+            if (optarg && config->time_warp_factor <= 1) {
+                fprintf(stderr, "错误: 无效的睡眠缩短倍数 '%s'\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case OPT_CALIBRATE_LATENCY:
+            config->latency_calibrate = 1;
+            break;
+        case OPT_POOL:
+            config->pool_size = atoi(optarg);
+            if (config->pool_size <= 0) {
+                fprintf(stderr, "错误: 无效的沙箱池大小 '%s'\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'j':
+            config->batch_jobs = atoi(optarg);
+            if (config->batch_jobs <= 0) {
+                fprintf(stderr, "错误: 无效的并行数量 '%s'\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        default:
+            print_usage(argv[0]);
             return EXIT_FAILURE;
         }
+    }
 
-        config->binary_path = realpath(argv[1], NULL);
-        if (!config->binary_path) {
-            perror("获取文件完整路径失败");
+    if (config->binary_log && config->json_output) {
+        fprintf(stderr, "错误: --binary-log 和 --json 不能同时使用\n");
+        return EXIT_FAILURE;
+    }
+
+    if (config->backend != MONITOR_BACKEND_PTRACE && check_backend_options(config) != 0) {
+        return EXIT_FAILURE;
+    }
+    if (config->backend == MONITOR_BACKEND_NOTIF) {
+        // --trace选择被通知的系统调用；看不到返回值，无法维护fd表
+        config->seccomp_filter = 1;
+        config->fd_track_disabled = 1;
+    }
+
+    if (config->seccomp_filter) {
+        config->traced_count = parse_syscall_list(trace_list ? trace_list : DEFAULT_TRACED_SYSCALLS,
+                                                  config->traced_syscalls, MAX_TRACED_SYSCALLS);
+        if (config->traced_count <= 0) {
+            fprintf(stderr, "错误: 未指定有效的跟踪系统调用列表\n");
             return EXIT_FAILURE;
         }
+        if (config->time_warp) {
+            add_traced_syscalls(config, TIME_WARP_SYSCALLS);
+        }
+        if (!config->fd_track_disabled) {
+            add_traced_syscalls(config, FD_TRACK_SYSCALLS);
+        }
+        if (config->sinkhole) {
+            add_traced_syscalls(config, SINKHOLE_SYSCALLS);
+        }
+        if (config->backend == MONITOR_BACKEND_NOTIF) {
+            add_traced_syscalls(config, NOTIF_SYSCALLS);
+        }
+        if (config->mem_dump) {
+            add_traced_syscalls(config, MEM_DUMP_SYSCALLS);
+        }
+    }
 
-        config->binary_name = strdup(basename(argv[1]));
-        if (!config->binary_name) {
-            perror("内存分配失败");
-            free(config->binary_path);
-            config->binary_path = NULL;
+    // 批量模式下目标来自任务列表
+    if (config->batch_source) {
+        if (optind < argc) {
+            fprintf(stderr, "错误: --batch 模式下不能同时指定ELF文件\n");
             return EXIT_FAILURE;
         }
+        return 0;
+    }
 
-        printf("将在沙箱中运行: %s (文件名: %s)\n", config->binary_path, config->binary_name);
-
-        // 检查是否是静态链接的ELF文件
-        if (!is_static_elf(config->binary_path)) {
-            printf("检测到动态链接程序，将自动处理库依赖\n");
+    // 处理位置参数
+    if (optind < argc) {
+        int ret = set_target_binary(config, argv[optind]);
+        if (ret != 0) {
+            return ret;
         }
     } else {
         // 使用默认的Hello World程序
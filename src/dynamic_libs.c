@@ -36,102 +36,225 @@ int mkdir_p(const char *path, mode_t mode) {
 
 // 复制文件
 int copy_file(const char *src, const char *dest) {
-    int fd_src = open(src, O_RDONLY);
-    if (fd_src == -1) {
-        printf("无法打开源文件 %s: %s\n", src, strerror(errno));
-        return -1;
+    return stage_file(src, dest, 0755, STAGE_COPY);
+}
+
+// 检查文件是否是静态链接的ELF
+int is_static_elf(const char *path) {
+    elf_info_t info;
+    if (elf_read_info(path, &info) != 0) {
+        return 0;
     }
 
-    // 创建目标文件的目录结构
-    char *dest_dir = strdup(dest);
-    char *dir = dirname(dest_dir);
-    mkdir_p(dir, 0755);
-    free(dest_dir);
+    int ret = elf_is_static(&info);
+    free_elf_info(&info);
+    return ret;
+}
 
-    int fd_dest = open(dest, O_WRONLY | O_CREAT | O_TRUNC, 0755);
-    if (fd_dest == -1) {
-        printf("无法创建目标文件 %s: %s\n", dest, strerror(errno));
-        close(fd_src);
-        return -1;
+// 向依赖列表追加一个库路径（忽略重复项）
+int lib_list_add(lib_list_t *libs, const char *path) {
+    for (int i = 0; i < libs->count; i++) {
+        if (strcmp(libs->paths[i], path) == 0) {
+            return 0;
+        }
     }
 
-    char buffer[4096];
-    ssize_t bytes_read;
-    while ((bytes_read = read(fd_src, buffer, sizeof(buffer))) > 0) {
-        if (write(fd_dest, buffer, bytes_read) != bytes_read) {
-            printf("写入文件失败: %s\n", strerror(errno));
-            close(fd_src);
-            close(fd_dest);
+    if (libs->count == libs->capacity) {
+        int capacity = libs->capacity ? libs->capacity * 2 : 16;
+        char **paths = realloc(libs->paths, (size_t)capacity * sizeof(char *));
+        if (!paths) {
+            perror("内存分配失败");
             return -1;
         }
+        libs->paths = paths;
+        libs->capacity = capacity;
     }
 
-    close(fd_src);
-    close(fd_dest);
+    libs->paths[libs->count] = strdup(path);
+    if (!libs->paths[libs->count]) {
+        perror("内存分配失败");
+        return -1;
+    }
+    libs->count++;
     return 0;
 }
 
-// 检查文件是否是静态链接的ELF
-int is_static_elf(const char *path) {
-    FILE *fp;
-    char cmd[PATH_MAX + 32];
-    snprintf(cmd, sizeof(cmd), "file %s | grep -q 'statically linked'", path);
+void free_lib_list(lib_list_t *libs) {
+    for (int i = 0; i < libs->count; i++) {
+        free(libs->paths[i]);
+    }
+    free(libs->paths);
+    memset(libs, 0, sizeof(*libs));
+}
 
-    fp = popen(cmd, "r");
-    if (fp == NULL) return 0;
+// ld.so.cache未命中时的默认搜索路径（含Debian系的multiarch目录）
+static const char *default_lib_dirs_64[] = {
+    "/lib/x86_64-linux-gnu", "/usr/lib/x86_64-linux-gnu",
+    "/lib64", "/usr/lib64", "/lib", "/usr/lib", NULL
+};
 
-    int status = pclose(fp);
-    return WEXITSTATUS(status) == 0;
+static const char *default_lib_dirs_32[] = {
+    "/lib/i386-linux-gnu", "/usr/lib/i386-linux-gnu",
+    "/lib32", "/usr/lib32", "/lib", "/usr/lib", NULL
+};
+
+// 取文件所在目录，用于展开$ORIGIN
+static void path_origin(const char *path, char *origin, size_t len) {
+    char *copy = strdup(path);
+    snprintf(origin, len, "%s", copy ? dirname(copy) : ".");
+    free(copy);
 }
 
-// 解析动态库依赖并复制到沙箱
-int prepare_dynamic_libs(const char *binary_path, const char *sandbox_root) {
-    // 如果是静态链接的程序，无需处理
-    if (is_static_elf(binary_path)) {
-        printf("检测到静态链接程序，跳过库依赖处理\n");
+// 在目录中查找库，找到且架构匹配时写入完整路径
+static int try_lib_dir(const char *dir, const char *name, const elf_info_t *requester,
+                       char *path, size_t len) {
+    snprintf(path, len, "%s/%s", dir, name);
+    return elf_matches_arch(path, requester) ? 0 : -1;
+}
+
+// 按冒号分隔的搜索路径（DT_RPATH/DT_RUNPATH）查找库，支持$ORIGIN
+static int search_lib_path(const char *dirs, const char *origin, const char *name,
+                           const elf_info_t *requester, char *path, size_t len) {
+    char *copy = strdup(dirs);
+    if (!copy) {
+        return -1;
+    }
+
+    int ret = -1;
+    char *saveptr = NULL;
+    for (char *dir = strtok_r(copy, ":", &saveptr); dir; dir = strtok_r(NULL, ":", &saveptr)) {
+        char expanded[PATH_MAX];
+        if (strncmp(dir, "$ORIGIN", 7) == 0) {
+            snprintf(expanded, sizeof(expanded), "%s%s", origin, dir + 7);
+        } else if (strncmp(dir, "${ORIGIN}", 9) == 0) {
+            snprintf(expanded, sizeof(expanded), "%s%s", origin, dir + 9);
+        } else {
+            snprintf(expanded, sizeof(expanded), "%s", dir);
+        }
+
+        if (try_lib_dir(expanded, name, requester, path, len) == 0) {
+            ret = 0;
+            break;
+        }
+    }
+
+    free(copy);
+    return ret;
+}
+
+// 按动态链接器的顺序解析一个DT_NEEDED：
+// DT_RUNPATH，或没有DT_RUNPATH时依次为本对象和主程序的DT_RPATH，然后是ld.so.cache和默认路径
+static int resolve_needed(const char *name, const elf_info_t *object, const char *origin,
+                          const elf_info_t *exe, const char *exe_origin, char *path, size_t len) {
+    // 对解释器的依赖（如libc依赖ld-linux）指向已加载的解释器本身
+    if (exe->interp) {
+        const char *slash = strrchr(exe->interp, '/');
+        if (strcmp(name, slash ? slash + 1 : exe->interp) == 0) {
+            snprintf(path, len, "%s", exe->interp);
+            return 0;
+        }
+    }
+
+    if (strchr(name, '/')) {
+        snprintf(path, len, "%s", name);
+        return elf_matches_arch(path, exe) ? 0 : -1;
+    }
+
+    if (object->runpath) {
+        if (search_lib_path(object->runpath, origin, name, exe, path, len) == 0) return 0;
+    } else {
+        if (object->rpath && search_lib_path(object->rpath, origin, name, exe, path, len) == 0) return 0;
+        if (object != exe && exe->rpath && !exe->runpath &&
+            search_lib_path(exe->rpath, exe_origin, name, exe, path, len) == 0) return 0;
+    }
+
+    if (ld_cache_lookup(name, exe, path, len) == 0 && elf_matches_arch(path, exe)) {
         return 0;
     }
 
-    printf("检测动态库依赖...\n");
-    char temp_file[] = "/tmp/sandbox_libs_XXXXXX";
-    int fd = mkstemp(temp_file);
-    if (fd == -1) {
-        perror("创建临时文件失败");
-        return -1;
+    const char **dirs = exe->elf_class == 64 ? default_lib_dirs_64 : default_lib_dirs_32;
+    for (int i = 0; dirs[i]; i++) {
+        if (try_lib_dir(dirs[i], name, exe, path, len) == 0) return 0;
     }
-    close(fd);
+    return -1;
+}
 
-    // 使用ldd查找依赖库
-    char cmd[PATH_MAX * 2];
-    snprintf(cmd, sizeof(cmd), "ldd %s | grep -o '/[^ ]*' > %s", binary_path, temp_file);
-    int ret = system(cmd);
-    if (ret != 0) {
-        printf("无法获取程序依赖: %s\n", strerror(errno));
-        unlink(temp_file);
-        return -1;
+// 解析一个对象的全部DT_NEEDED并追加到依赖列表
+static int add_needed_libs(lib_list_t *libs, const elf_info_t *object, const char *origin,
+                           const elf_info_t *exe, const char *exe_origin) {
+    for (int i = 0; i < object->needed.count; i++) {
+        char path[PATH_MAX];
+        if (resolve_needed(object->needed.paths[i], object, origin, exe, exe_origin,
+                           path, sizeof(path)) != 0) {
+            printf("警告: 未找到依赖库 %s\n", object->needed.paths[i]);
+            continue;
+        }
+        if (lib_list_add(libs, path) != 0) {
+            return -1;
+        }
     }
+    return 0;
+}
+
+// 解析程序的动态库依赖（包括间接依赖和解释器）；静态链接程序返回空列表
+int resolve_dynamic_libs(const char *binary_path, lib_list_t *libs) {
+    memset(libs, 0, sizeof(*libs));
 
-    // 读取依赖库列表并复制到沙箱
-    FILE *fp = fopen(temp_file, "r");
-    if (!fp) {
-        perror("打开依赖列表失败");
-        unlink(temp_file);
+    elf_info_t exe;
+    if (elf_read_info(binary_path, &exe) != 0) {
+        printf("无法解析ELF文件: %s\n", binary_path);
         return -1;
     }
 
+    // 如果是静态链接的程序，无需处理
+    if (elf_is_static(&exe)) {
+        free_elf_info(&exe);
+        return 0;
+    }
+
+    char exe_origin[PATH_MAX];
+    path_origin(binary_path, exe_origin, sizeof(exe_origin));
+
+    int ret = 0;
+    if (exe.interp) {
+        ret = lib_list_add(libs, exe.interp);
+    }
+    if (ret == 0) {
+        ret = add_needed_libs(libs, &exe, exe_origin, &exe, exe_origin);
+    }
+
+    // 广度优先：依赖列表本身就是队列，逐个解析已找到的库的依赖
+    for (int i = 0; ret == 0 && i < libs->count; i++) {
+        elf_info_t lib;
+        if (elf_read_info(libs->paths[i], &lib) != 0) {
+            continue;
+        }
+        char origin[PATH_MAX];
+        path_origin(libs->paths[i], origin, sizeof(origin));
+        ret = add_needed_libs(libs, &lib, origin, &exe, exe_origin);
+        free_elf_info(&lib);
+    }
+
+    free_elf_info(&exe);
+    if (ret != 0) {
+        free_lib_list(libs);
+    }
+    return ret;
+}
+
+// 将依赖库复制到沙箱（保持路径结构），并为动态链接器补齐标准路径
+int stage_dynamic_libs(const lib_list_t *libs, const char *sandbox_root, int link_mode) {
     int lib_count = 0;
-    char lib_path[PATH_MAX];
-    while (fgets(lib_path, sizeof(lib_path), fp)) {
-        // 去除换行符
-        lib_path[strcspn(lib_path, "\n")] = 0;
-        if (strlen(lib_path) == 0) continue;
+
+    for (int n = 0; n < libs->count; n++) {
+        const char *lib_path = libs->paths[n];
 
         // 复制库文件到沙箱，保持路径结构
         char dest[PATH_MAX];
         snprintf(dest, sizeof(dest), "%s%s", sandbox_root, lib_path);
 
         printf("复制依赖库: %s -> %s\n", lib_path, dest);
-        if (copy_file(lib_path, dest) == 0) {
+        if (stage_file(lib_path, dest, 0755, link_mode) == 0) {
             lib_count++;
         }
 
@@ -168,9 +291,26 @@ int prepare_dynamic_libs(const char *binary_path, const char *sandbox_root) {
         }
     }
 
-    fclose(fp);
-    unlink(temp_file);
+    return lib_count;
+}
+
+// 解析动态库依赖并复制到沙箱
+int prepare_dynamic_libs(const char *binary_path, const char *sandbox_root, int link_mode) {
+    printf("检测动态库依赖...\n");
+    lib_list_t libs;
+    if (resolve_dynamic_libs(binary_path, &libs) != 0) {
+        return -1;
+    }
+
+    // 如果是静态链接的程序，无需处理
+    if (libs.count == 0) {
+        printf("检测到静态链接程序，跳过库依赖处理\n");
+        return 0;
+    }
+
+    int lib_count = stage_dynamic_libs(&libs, sandbox_root, link_mode);
+    free_lib_list(&libs);
 
     printf("成功复制 %d 个依赖库到沙箱环境\n", lib_count);
     return lib_count;
-}
\ No newline at end of file
+}
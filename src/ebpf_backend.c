@@ -0,0 +1,554 @@
+// src/ebpf_backend.c
+#include "sandbox.h"
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/user.h>
+#include <linux/bpf.h>
+
+// eBPF监控后端：不依赖libbpf和编译器，程序在加载时按沙箱的cgroup现场汇编。
+// 内核程序只做过滤、复制寄存器和读取一段用户内存，解码、fd跟踪和统计仍由监控进程完成
+
+#define EBPF_INSNS_MAX 128
+#define EBPF_LABELS_MAX 16
+#define EBPF_LOG_SIZE 65536
+
+// 记录中各字段的偏移，写进程序里
+#define EV_TIMESTAMP offsetof(ebpf_event_t, timestamp_ns)
+#define EV_TID offsetof(ebpf_event_t, tid)
+#define EV_TYPE offsetof(ebpf_event_t, type)
+#define EV_NR offsetof(ebpf_event_t, syscall_nr)
+#define EV_RET offsetof(ebpf_event_t, ret)
+#define EV_REGS offsetof(ebpf_event_t, regs)
+#define EV_DATA_LEN offsetof(ebpf_event_t, data_len)
+#define EV_DATA offsetof(ebpf_event_t, data)
+#define EV_REGS_SIZE (EBPF_REGS_COUNT * 8)
+
+#define X86_COMPAT_CS 0x23  // 32位用户代码段选择子
+
+// 捕获计划：每个本机系统调用读取哪个参数指向的用户内存
+enum {
+    CAPTURE_NONE = 0,
+    CAPTURE_STRING,            // 以NUL结尾的字符串
+    CAPTURE_BYTES,             // 长度由另一个参数给出
+};
+
+typedef struct {
+    uint16_t ptr_off;          // 指针参数在寄存器副本中的偏移
+    uint16_t len_off;          // 长度参数在寄存器副本中的偏移（CAPTURE_BYTES）
+    uint32_t kind;             // CAPTURE_*
+} ebpf_capture_t;
+
+static long sys_bpf(int cmd, union bpf_attr *attr) {
+    return syscall(SYS_bpf, cmd, attr, sizeof(*attr));
+}
+
+// 程序构建：跳转目标以标签表示，最后统一回填16位偏移
+typedef struct {
+    struct bpf_insn insns[EBPF_INSNS_MAX];
+    int label_of[EBPF_INSNS_MAX];  // 跳转指令的目标标签，-1表示不需要回填
+    int len;
+    int labels[EBPF_LABELS_MAX];   // 标签所在的指令位置
+    int label_count;
+    int overflow;
+} ebpf_builder_t;
+
+static int ebpf_new_label(ebpf_builder_t *b) {
+    if (b->label_count == EBPF_LABELS_MAX) {
+        b->overflow = 1;
+        return 0;
+    }
+    b->labels[b->label_count] = -1;
+    return b->label_count++;
+}
+
+static void ebpf_bind(ebpf_builder_t *b, int label) {
+    b->labels[label] = b->len;
+}
+
+static void ebpf_emit(ebpf_builder_t *b, uint8_t code, uint8_t dst, uint8_t src, int16_t off, int32_t imm,
+                      int label) {
+    if (b->len == EBPF_INSNS_MAX) {
+        b->overflow = 1;
+        return;
+    }
+    struct bpf_insn *insn = &b->insns[b->len];
+    memset(insn, 0, sizeof(*insn));
+    insn->code = code;
+    insn->dst_reg = dst & 0xf;
+    insn->src_reg = src & 0xf;
+    insn->off = off;
+    insn->imm = imm;
+    b->label_of[b->len++] = label;
+}
+
+static void ebpf_mov_imm(ebpf_builder_t *b, int dst, int32_t imm) {
+    ebpf_emit(b, BPF_ALU64 | BPF_MOV | BPF_K, dst, 0, 0, imm, -1);
+}
+
+static void ebpf_mov_reg(ebpf_builder_t *b, int dst, int src) {
+    ebpf_emit(b, BPF_ALU64 | BPF_MOV | BPF_X, dst, src, 0, 0, -1);
+}
+
+static void ebpf_add_imm(ebpf_builder_t *b, int dst, int32_t imm) {
+    ebpf_emit(b, BPF_ALU64 | BPF_ADD | BPF_K, dst, 0, 0, imm, -1);
+}
+
+static void ebpf_add_reg(ebpf_builder_t *b, int dst, int src) {
+    ebpf_emit(b, BPF_ALU64 | BPF_ADD | BPF_X, dst, src, 0, 0, -1);
+}
+
+// dst = *(size *)(src + off)
+static void ebpf_load(ebpf_builder_t *b, int size, int dst, int src, size_t off) {
+    ebpf_emit(b, BPF_LDX | size | BPF_MEM, dst, src, (int16_t)off, 0, -1);
+}
+
+// *(size *)(dst + off) = src
+static void ebpf_store(ebpf_builder_t *b, int size, int dst, size_t off, int src) {
+    ebpf_emit(b, BPF_STX | size | BPF_MEM, dst, src, (int16_t)off, 0, -1);
+}
+
+static void ebpf_store_imm(ebpf_builder_t *b, int size, int dst, long off, int32_t imm) {
+    ebpf_emit(b, BPF_ST | size | BPF_MEM, dst, 0, (int16_t)off, imm, -1);
+}
+
+// 64位立即数占两条指令；src为BPF_PSEUDO_MAP_FD时imm是映射的fd
+static void ebpf_load_imm64(ebpf_builder_t *b, int dst, int src, uint64_t imm) {
+    ebpf_emit(b, BPF_LD | BPF_DW | BPF_IMM, dst, src, 0, (int32_t)(uint32_t)imm, -1);
+    ebpf_emit(b, 0, 0, 0, 0, (int32_t)(uint32_t)(imm >> 32), -1);
+}
+
+static void ebpf_call(ebpf_builder_t *b, int helper) {
+    ebpf_emit(b, BPF_JMP | BPF_CALL, 0, 0, 0, helper, -1);
+}
+
+static void ebpf_exit(ebpf_builder_t *b) {
+    ebpf_emit(b, BPF_JMP | BPF_EXIT, 0, 0, 0, 0, -1);
+}
+
+static void ebpf_goto(ebpf_builder_t *b, int label) {
+    ebpf_emit(b, BPF_JMP | BPF_JA, 0, 0, 0, 0, label);
+}
+
+// 条件成立时跳到label
+static void ebpf_jump_if(ebpf_builder_t *b, int op, int dst, int32_t imm, int label) {
+    ebpf_emit(b, BPF_JMP | op | BPF_K, dst, 0, 0, imm, label);
+}
+
+static void ebpf_jump_if_reg(ebpf_builder_t *b, int op, int dst, int src, int label) {
+    ebpf_emit(b, BPF_JMP | op | BPF_X, dst, src, 0, 0, label);
+}
+
+static int ebpf_resolve(ebpf_builder_t *b) {
+    if (b->overflow) {
+        fprintf(stderr, "eBPF程序过大 (最多 %d 条指令)\n", EBPF_INSNS_MAX);
+        return -1;
+    }
+    for (int i = 0; i < b->len; i++) {
+        if (b->label_of[i] >= 0) {
+            b->insns[i].off = (int16_t)(b->labels[b->label_of[i]] - i - 1);
+        }
+    }
+    return 0;
+}
+
+// 各程序共用的开头：不在沙箱cgroup中的任务直接返回；在环形缓冲区中预留size字节，
+// 记录指针放在r7（r6为上下文），填好时间戳、tid/tgid和类型。
+// 不按PID命名空间判断：样本可以unshare(CLONE_NEWPID)后fork，子进程进入嵌套的命名空间，
+// 而cgroup由fork继承，沙箱中没有cgroupfs，样本无法离开
+static void emit_prologue(ebpf_builder_t *b, const ebpf_backend_t *backend, uint64_t cgroup_id,
+                          size_t size, uint32_t type, int out, int drop) {
+    ebpf_mov_reg(b, BPF_REG_6, BPF_REG_1);
+    ebpf_call(b, BPF_FUNC_get_current_cgroup_id);
+    ebpf_load_imm64(b, BPF_REG_1, 0, cgroup_id);
+    ebpf_jump_if_reg(b, BPF_JNE, BPF_REG_0, BPF_REG_1, out);
+
+    ebpf_load_imm64(b, BPF_REG_1, BPF_PSEUDO_MAP_FD, (uint64_t)backend->ring_fd);
+    ebpf_mov_imm(b, BPF_REG_2, (int32_t)size);
+    ebpf_mov_imm(b, BPF_REG_3, 0);
+    ebpf_call(b, BPF_FUNC_ringbuf_reserve);
+    ebpf_jump_if(b, BPF_JEQ, BPF_REG_0, 0, drop);
+    ebpf_mov_reg(b, BPF_REG_7, BPF_REG_0);
+
+    ebpf_call(b, BPF_FUNC_ktime_get_ns);
+    ebpf_store(b, BPF_DW, BPF_REG_7, EV_TIMESTAMP, BPF_REG_0);
+    ebpf_call(b, BPF_FUNC_get_current_pid_tgid);  // 低32位为tid，高32位为tgid
+    ebpf_store(b, BPF_DW, BPF_REG_7, EV_TID, BPF_REG_0);
+    ebpf_store_imm(b, BPF_W, BPF_REG_7, EV_TYPE, (int32_t)type);
+    ebpf_store_imm(b, BPF_W, BPF_REG_7, EV_NR, -1);
+    ebpf_store_imm(b, BPF_DW, BPF_REG_7, EV_RET, 0);
+}
+
+// 提交记录并返回；预留失败时给丢弃计数加一
+static void emit_epilogue(ebpf_builder_t *b, const ebpf_backend_t *backend, int submit, int out, int drop) {
+    ebpf_bind(b, submit);
+    ebpf_mov_reg(b, BPF_REG_1, BPF_REG_7);
+    ebpf_mov_imm(b, BPF_REG_2, 0);
+    ebpf_call(b, BPF_FUNC_ringbuf_submit);
+    ebpf_bind(b, out);
+    ebpf_mov_imm(b, BPF_REG_0, 0);
+    ebpf_exit(b);
+
+    ebpf_bind(b, drop);
+    ebpf_store_imm(b, BPF_W, BPF_REG_10, -4, 0);
+    ebpf_load_imm64(b, BPF_REG_1, BPF_PSEUDO_MAP_FD, (uint64_t)backend->drops_fd);
+    ebpf_mov_reg(b, BPF_REG_2, BPF_REG_10);
+    ebpf_add_imm(b, BPF_REG_2, -4);
+    ebpf_call(b, BPF_FUNC_map_lookup_elem);
+    ebpf_jump_if(b, BPF_JEQ, BPF_REG_0, 0, out);
+    ebpf_mov_imm(b, BPF_REG_1, 1);
+    ebpf_emit(b, BPF_STX | BPF_DW | BPF_ATOMIC, BPF_REG_0, BPF_REG_1, 0, BPF_ADD, -1);
+    ebpf_goto(b, out);
+}
+
+// sys_enter(struct pt_regs *regs, long id)：复制寄存器，按捕获计划读取一段用户内存
+static void build_sys_enter(ebpf_builder_t *b, const ebpf_backend_t *backend, uint64_t cgroup_id) {
+    int submit = ebpf_new_label(b), out = ebpf_new_label(b), drop = ebpf_new_label(b);
+    int string = ebpf_new_label(b), sized = ebpf_new_label(b), stored = ebpf_new_label(b);
+    emit_prologue(b, backend, cgroup_id, sizeof(ebpf_event_t), EBPF_EVENT_ENTRY, out, drop);
+
+    ebpf_store_imm(b, BPF_W, BPF_REG_7, EV_DATA_LEN, 0);
+    ebpf_load(b, BPF_DW, BPF_REG_1, BPF_REG_6, 8);
+    ebpf_store(b, BPF_W, BPF_REG_7, EV_NR, BPF_REG_1);
+    ebpf_mov_reg(b, BPF_REG_1, BPF_REG_7);
+    ebpf_add_imm(b, BPF_REG_1, EV_REGS);
+    ebpf_mov_imm(b, BPF_REG_2, EV_REGS_SIZE);
+    ebpf_load(b, BPF_DW, BPF_REG_3, BPF_REG_6, 0);
+    ebpf_call(b, BPF_FUNC_probe_read_kernel);
+
+    // 32位代码段的调用号属于i386表，捕获计划按本机编号，不适用
+    ebpf_load(b, BPF_DW, BPF_REG_1, BPF_REG_7, EV_REGS + offsetof(struct user_regs_struct, cs));
+    ebpf_jump_if(b, BPF_JEQ, BPF_REG_1, X86_COMPAT_CS, submit);
+    ebpf_load(b, BPF_W, BPF_REG_1, BPF_REG_7, EV_NR);
+    ebpf_store(b, BPF_W, BPF_REG_10, -4, BPF_REG_1);
+    ebpf_load_imm64(b, BPF_REG_1, BPF_PSEUDO_MAP_FD, (uint64_t)backend->capture_fd);
+    ebpf_mov_reg(b, BPF_REG_2, BPF_REG_10);
+    ebpf_add_imm(b, BPF_REG_2, -4);
+    ebpf_call(b, BPF_FUNC_map_lookup_elem);
+    ebpf_jump_if(b, BPF_JEQ, BPF_REG_0, 0, submit);
+    ebpf_mov_reg(b, BPF_REG_8, BPF_REG_0);
+    ebpf_load(b, BPF_W, BPF_REG_1, BPF_REG_8, offsetof(ebpf_capture_t, kind));
+    ebpf_jump_if(b, BPF_JEQ, BPF_REG_1, CAPTURE_NONE, submit);
+
+    // r3 = 指针参数；偏移先限定在寄存器副本内，验证器据此确认访问不越界
+    ebpf_load(b, BPF_H, BPF_REG_2, BPF_REG_8, offsetof(ebpf_capture_t, ptr_off));
+    ebpf_jump_if(b, BPF_JGT, BPF_REG_2, EV_REGS_SIZE - 8, submit);
+    ebpf_mov_reg(b, BPF_REG_3, BPF_REG_7);
+    ebpf_add_reg(b, BPF_REG_3, BPF_REG_2);
+    ebpf_load(b, BPF_DW, BPF_REG_3, BPF_REG_3, EV_REGS);
+    ebpf_jump_if(b, BPF_JEQ, BPF_REG_1, CAPTURE_STRING, string);
+
+    // 按长度参数读取，最多EBPF_DATA_MAX字节；r9保存长度，调用后作为data_len
+    ebpf_load(b, BPF_H, BPF_REG_2, BPF_REG_8, offsetof(ebpf_capture_t, len_off));
+    ebpf_jump_if(b, BPF_JGT, BPF_REG_2, EV_REGS_SIZE - 8, submit);
+    ebpf_mov_reg(b, BPF_REG_4, BPF_REG_7);
+    ebpf_add_reg(b, BPF_REG_4, BPF_REG_2);
+    ebpf_load(b, BPF_DW, BPF_REG_2, BPF_REG_4, EV_REGS);
+    ebpf_jump_if(b, BPF_JLE, BPF_REG_2, EBPF_DATA_MAX, sized);
+    ebpf_mov_imm(b, BPF_REG_2, EBPF_DATA_MAX);
+    ebpf_bind(b, sized);
+    ebpf_mov_reg(b, BPF_REG_9, BPF_REG_2);
+    ebpf_mov_reg(b, BPF_REG_1, BPF_REG_7);
+    ebpf_add_imm(b, BPF_REG_1, EV_DATA);
+    ebpf_call(b, BPF_FUNC_probe_read_user);
+    ebpf_jump_if(b, BPF_JSLT, BPF_REG_0, 0, stored);
+    ebpf_mov_reg(b, BPF_REG_0, BPF_REG_9);
+    ebpf_goto(b, stored);
+
+    ebpf_bind(b, string);
+    ebpf_mov_reg(b, BPF_REG_1, BPF_REG_7);
+    ebpf_add_imm(b, BPF_REG_1, EV_DATA);
+    ebpf_mov_imm(b, BPF_REG_2, EBPF_DATA_MAX);
+    ebpf_call(b, BPF_FUNC_probe_read_user_str);
+    ebpf_bind(b, stored);
+    ebpf_store(b, BPF_W, BPF_REG_7, EV_DATA_LEN, BPF_REG_0);
+
+    emit_epilogue(b, backend, submit, out, drop);
+}
+
+// sys_exit(struct pt_regs *regs, long ret)：调用号取自regs->orig_ax
+static void build_sys_exit(ebpf_builder_t *b, const ebpf_backend_t *backend, uint64_t cgroup_id) {
+    int submit = ebpf_new_label(b), out = ebpf_new_label(b), drop = ebpf_new_label(b);
+    emit_prologue(b, backend, cgroup_id, EV_REGS, EBPF_EVENT_EXIT, out, drop);
+
+    ebpf_load(b, BPF_DW, BPF_REG_1, BPF_REG_6, 8);
+    ebpf_store(b, BPF_DW, BPF_REG_7, EV_RET, BPF_REG_1);
+    ebpf_mov_reg(b, BPF_REG_1, BPF_REG_7);
+    ebpf_add_imm(b, BPF_REG_1, EV_NR);
+    ebpf_mov_imm(b, BPF_REG_2, 4);
+    ebpf_load(b, BPF_DW, BPF_REG_3, BPF_REG_6, 0);
+    ebpf_add_imm(b, BPF_REG_3, offsetof(struct user_regs_struct, orig_rax));
+    ebpf_call(b, BPF_FUNC_probe_read_kernel);
+
+    emit_epilogue(b, backend, submit, out, drop);
+}
+
+// sched_process_exit：每个线程结束时一条记录
+static void build_task_exit(ebpf_builder_t *b, const ebpf_backend_t *backend, uint64_t cgroup_id) {
+    int submit = ebpf_new_label(b), out = ebpf_new_label(b), drop = ebpf_new_label(b);
+    emit_prologue(b, backend, cgroup_id, EV_REGS, EBPF_EVENT_TASK_EXIT, out, drop);
+    emit_epilogue(b, backend, submit, out, drop);
+}
+
+static int create_map(int type, uint32_t key_size, uint32_t value_size, uint32_t max_entries) {
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.map_type = (uint32_t)type;
+    attr.key_size = key_size;
+    attr.value_size = value_size;
+    attr.max_entries = max_entries;
+    return (int)sys_bpf(BPF_MAP_CREATE, &attr);
+}
+
+// 加载失败时带上验证器日志重试一次，便于定位
+static int load_program(ebpf_builder_t *b, const char *name) {
+    if (ebpf_resolve(b) != 0) {
+        return -1;
+    }
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.prog_type = BPF_PROG_TYPE_RAW_TRACEPOINT;
+    attr.insns = (uint64_t)(uintptr_t)b->insns;
+    attr.insn_cnt = (uint32_t)b->len;
+    attr.license = (uint64_t)(uintptr_t)"GPL";  // probe_read_*和环形缓冲区辅助函数要求GPL兼容
+    int fd = (int)sys_bpf(BPF_PROG_LOAD, &attr);
+    if (fd != -1) {
+        return fd;
+    }
+
+    int saved = errno;
+    char *log = calloc(1, EBPF_LOG_SIZE);
+    if (log) {
+        attr.log_buf = (uint64_t)(uintptr_t)log;
+        attr.log_size = EBPF_LOG_SIZE;
+        attr.log_level = 1;
+        sys_bpf(BPF_PROG_LOAD, &attr);
+    }
+    fprintf(stderr, "加载eBPF程序 %s 失败: %s\n%s", name, strerror(saved), log ? log : "");
+    free(log);
+    return -1;
+}
+
+static int attach_program(int prog_fd, const char *tracepoint) {
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.raw_tracepoint.name = (uint64_t)(uintptr_t)tracepoint;
+    attr.raw_tracepoint.prog_fd = (uint32_t)prog_fd;
+    int fd = (int)sys_bpf(BPF_RAW_TRACEPOINT_OPEN, &attr);
+    if (fd == -1) {
+        fprintf(stderr, "挂载到跟踪点 %s 失败: %s\n", tracepoint, strerror(errno));
+    }
+    return fd;
+}
+
+// 按参数描述符确定每个系统调用捕获的参数：优先路径/字符串，其次套接字地址
+static int fill_capture_plan(ebpf_backend_t *backend, const uint8_t *capture) {
+    static const size_t arg_offsets[6] = {
+        offsetof(struct user_regs_struct, rdi), offsetof(struct user_regs_struct, rsi),
+        offsetof(struct user_regs_struct, rdx), offsetof(struct user_regs_struct, r10),
+        offsetof(struct user_regs_struct, r8), offsetof(struct user_regs_struct, r9),
+    };
+    memset(backend->capture_index, -1, sizeof(backend->capture_index));
+
+    for (int nr = 0; nr < SYSCALL_MAX; nr++) {
+        const syscall_desc_t *desc = get_syscall_desc(SYSCALL_ABI_NATIVE, nr);
+        if (!capture[nr] || !desc) continue;
+
+        int chosen = -1;
+        for (int i = 0; i < desc->argc && chosen < 0; i++) {
+            if (desc->args[i].type == ARG_PATH || desc->args[i].type == ARG_STRING) chosen = i;
+        }
+        for (int i = 0; i < desc->argc && chosen < 0; i++) {
+            if (desc->args[i].type == ARG_SOCKADDR && desc->args[i].aux >= 0) chosen = i;
+        }
+        if (chosen < 0) continue;
+
+        const syscall_arg_desc_t *arg = &desc->args[chosen];
+        ebpf_capture_t value = {
+            .ptr_off = (uint16_t)arg_offsets[chosen],
+            .len_off = arg->type == ARG_SOCKADDR ? (uint16_t)arg_offsets[arg->aux] : 0,
+            .kind = arg->type == ARG_SOCKADDR ? CAPTURE_BYTES : CAPTURE_STRING,
+        };
+        uint32_t key = (uint32_t)nr;
+        union bpf_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.map_fd = (uint32_t)backend->capture_fd;
+        attr.key = (uint64_t)(uintptr_t)&key;
+        attr.value = (uint64_t)(uintptr_t)&value;
+        attr.flags = BPF_ANY;
+        if (sys_bpf(BPF_MAP_UPDATE_ELEM, &attr) == -1) {
+            perror("写入eBPF捕获计划失败");
+            return -1;
+        }
+        backend->capture_index[nr] = (int8_t)chosen;
+        backend->capture_type[nr] = arg->type;
+    }
+    return 0;
+}
+
+// 映射环形缓冲区：消费者位置页可写，生产者位置页和数据区只读
+static int map_ring(ebpf_backend_t *backend) {
+    backend->page_size = (size_t)sysconf(_SC_PAGESIZE);
+    backend->mask = EBPF_RINGBUF_SIZE - 1;
+    void *consumer = mmap(NULL, backend->page_size, PROT_READ | PROT_WRITE, MAP_SHARED, backend->ring_fd, 0);
+    if (consumer == MAP_FAILED) {
+        perror("映射eBPF环形缓冲区失败");
+        return -1;
+    }
+    backend->consumer = consumer;
+    void *producer = mmap(NULL, backend->page_size + 2 * (size_t)EBPF_RINGBUF_SIZE, PROT_READ, MAP_SHARED,
+                          backend->ring_fd, (off_t)backend->page_size);
+    if (producer == MAP_FAILED) {
+        perror("映射eBPF环形缓冲区失败");
+        return -1;
+    }
+    backend->producer = producer;
+    return 0;
+}
+
+// 创建映射、加载并挂载程序。capture[nr]非0的本机系统调用在入口处捕获参数内存。
+// 必须在沙箱exec样本之前调用，之后沙箱cgroup中的系统调用都会进入环形缓冲区
+int ebpf_backend_open(ebpf_backend_t *backend, const char *cgroup_path, const uint8_t *capture) {
+    memset(backend, 0, sizeof(*backend));
+    backend->ring_fd = backend->capture_fd = backend->drops_fd = -1;
+    for (int i = 0; i < 3; i++) {
+        backend->prog_fds[i] = backend->link_fds[i] = -1;
+    }
+
+#ifndef __x86_64__
+    (void)cgroup_path;
+    (void)capture;
+    fprintf(stderr, "eBPF后端只支持x86_64\n");
+    return -1;
+#else
+    // 内核程序按cgroup id识别沙箱的任务，cgroup v2目录的inode号即为cgroup id
+    struct stat cgroup;
+    if (cgroup_path[0] == '\0') {
+        fprintf(stderr, "eBPF后端需要沙箱cgroup\n");
+        return -1;
+    }
+    if (stat(cgroup_path, &cgroup) == -1) {
+        perror("读取沙箱cgroup失败");
+        return -1;
+    }
+
+    backend->ring_fd = create_map(BPF_MAP_TYPE_RINGBUF, 0, 0, EBPF_RINGBUF_SIZE);
+    backend->capture_fd = create_map(BPF_MAP_TYPE_ARRAY, sizeof(uint32_t), sizeof(ebpf_capture_t), SYSCALL_MAX);
+    backend->drops_fd = create_map(BPF_MAP_TYPE_ARRAY, sizeof(uint32_t), sizeof(uint64_t), 1);
+    if (backend->ring_fd == -1 || backend->capture_fd == -1 || backend->drops_fd == -1) {
+        perror("创建eBPF映射失败");
+        ebpf_backend_close(backend);
+        return -1;
+    }
+    if (fill_capture_plan(backend, capture) != 0 || map_ring(backend) != 0) {
+        ebpf_backend_close(backend);
+        return -1;
+    }
+
+    static const char *const tracepoints[3] = { "sys_enter", "sys_exit", "sched_process_exit" };
+    void (*const builders[3])(ebpf_builder_t *, const ebpf_backend_t *, uint64_t) = {
+        build_sys_enter, build_sys_exit, build_task_exit,
+    };
+    ebpf_builder_t *b = malloc(sizeof(*b));
+    if (!b) {
+        perror("内存分配失败");
+        ebpf_backend_close(backend);
+        return -1;
+    }
+    for (int i = 0; i < 3; i++) {
+        memset(b, 0, sizeof(*b));
+        builders[i](b, backend, (uint64_t)cgroup.st_ino);
+        backend->prog_fds[i] = load_program(b, tracepoints[i]);
+        if (backend->prog_fds[i] == -1 ||
+            (backend->link_fds[i] = attach_program(backend->prog_fds[i], tracepoints[i])) == -1) {
+            free(b);
+            ebpf_backend_close(backend);
+            return -1;
+        }
+    }
+    free(b);
+    return 0;
+#endif
+}
+
+// 取出环形缓冲区中已提交的全部记录，返回处理的条数。
+// 退出和任务结束记录只有regs之前的部分，handler只能读取对应类型的字段
+int ebpf_backend_consume(ebpf_backend_t *backend, ebpf_event_handler_t handler, void *ctx) {
+    uint64_t *consumer_pos = backend->consumer;
+    const uint64_t *producer_pos = backend->producer;
+    const char *data = (const char *)backend->producer + backend->page_size;
+    uint64_t cons = __atomic_load_n(consumer_pos, __ATOMIC_ACQUIRE);
+    int count = 0;
+
+    // 只处理调用时已有的记录：样本不停止，持续产生记录时也要及时返回去检查计时器和退出状态
+    uint64_t prod = __atomic_load_n(producer_pos, __ATOMIC_ACQUIRE);
+    while (cons < prod) {
+        const uint32_t *header = (const uint32_t *)(data + (cons & backend->mask));
+        uint32_t len = __atomic_load_n(header, __ATOMIC_ACQUIRE);
+        if (len & BPF_RINGBUF_BUSY_BIT) {
+            // 已预留但尚未提交，后面的记录要等它
+            break;
+        }
+        if (!(len & BPF_RINGBUF_DISCARD_BIT)) {
+            handler(ctx, (const ebpf_event_t *)(header + 2));
+            count++;
+        }
+        len &= ~BPF_RINGBUF_DISCARD_BIT;
+        cons += (len + BPF_RINGBUF_HDR_SZ + 7) & ~7ull;
+        __atomic_store_n(consumer_pos, cons, __ATOMIC_RELEASE);
+    }
+    return count;
+}
+
+// 把入口记录中捕获的用户内存转成参数块，供解码、fd跟踪和策略共用。
+// 路径只有原始字符串（样本不停止，无法可靠地按它的当前目录解析）
+void ebpf_event_capture(const ebpf_backend_t *backend, const ebpf_event_t *event, arg_capture_t *capture) {
+    capture->len = 0;
+    int nr = event->syscall_nr;
+    if (event->data_len <= 0 || nr < 0 || nr >= SYSCALL_MAX || backend->capture_index[nr] < 0) {
+        return;
+    }
+    size_t len = event->data_len < EBPF_DATA_MAX ? (size_t)event->data_len : EBPF_DATA_MAX;
+    if (backend->capture_type[nr] != ARG_SOCKADDR) {
+        len = strnlen(event->data, len);
+    }
+    char *data = arg_blob_append(capture, backend->capture_index[nr], backend->capture_type[nr], len);
+    if (data) {
+        memcpy(data, event->data, len);
+    }
+}
+
+// 环形缓冲区已满时内核程序丢弃的记录数
+uint64_t ebpf_backend_drops(const ebpf_backend_t *backend) {
+    uint32_t key = 0;
+    uint64_t value = 0;
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.map_fd = (uint32_t)backend->drops_fd;
+    attr.key = (uint64_t)(uintptr_t)&key;
+    attr.value = (uint64_t)(uintptr_t)&value;
+    if (backend->drops_fd == -1 || sys_bpf(BPF_MAP_LOOKUP_ELEM, &attr) == -1) {
+        return 0;
+    }
+    return value;
+}
+
+// 卸载程序并释放映射
+void ebpf_backend_close(ebpf_backend_t *backend) {
+    for (int i = 0; i < 3; i++) {
+        if (backend->link_fds[i] != -1) close(backend->link_fds[i]);
+        if (backend->prog_fds[i] != -1) close(backend->prog_fds[i]);
+        backend->link_fds[i] = backend->prog_fds[i] = -1;
+    }
+    if (backend->producer) {
+        munmap(backend->producer, backend->page_size + 2 * (size_t)EBPF_RINGBUF_SIZE);
+        backend->producer = NULL;
+    }
+    if (backend->consumer) {
+        munmap(backend->consumer, backend->page_size);
+        backend->consumer = NULL;
+    }
+    if (backend->ring_fd != -1) close(backend->ring_fd);
+    if (backend->capture_fd != -1) close(backend->capture_fd);
+    if (backend->drops_fd != -1) close(backend->drops_fd);
+    backend->ring_fd = backend->capture_fd = backend->drops_fd = -1;
+}
@@ -0,0 +1,511 @@
+// src/elf_reader.c
+#include "sandbox.h"
+#include <elf.h>
+#include <sys/mman.h>
+
+// 进程内ELF32/ELF64解析器：mmap一次，读取程序头、动态段和节头，
+// 不再调用file/ldd（ldd会执行目标的加载器，对恶意样本不安全）。
+// 所有偏移都来自不可信输入，访问前一律做边界检查
+
+#define LD_SO_CACHE "/etc/ld.so.cache"
+#define LD_CACHE_MAGIC_OLD "ld.so-1.7.0"
+#define LD_CACHE_MAGIC_NEW "glibc-ld.so.cache1.1"
+#define LD_CACHE_FLAG_ELF_LIBC6 0x0003
+#define LD_CACHE_FLAG_TYPE_MASK 0x00ff
+#define LD_CACHE_FLAG_ARCH_MASK 0xff00
+#define LD_CACHE_FLAG_X8664_LIB64 0x0300
+#define LD_CACHE_FLAG_AARCH64_LIB64 0x0a00
+
+// 已映射的ELF文件
+typedef struct {
+    const unsigned char *data;
+    size_t size;
+} elf_image_t;
+
+// 统一成64位的程序头/节头字段，屏蔽ELF32和ELF64的差异
+typedef struct {
+    uint32_t type;
+    uint64_t offset;
+    uint64_t vaddr;
+    uint64_t filesz;
+} elf_segment_t;
+
+typedef struct {
+    uint32_t type;
+    uint32_t link;
+    uint64_t offset;
+    uint64_t size;
+    uint64_t entsize;
+} elf_section_t;
+
+// 判断[offset, offset+len)是否在文件范围内
+static int image_range_ok(const elf_image_t *img, uint64_t offset, uint64_t len) {
+    return offset <= img->size && len <= img->size - offset;
+}
+
+static int read_segment(const elf_image_t *img, const elf_info_t *info,
+                        uint64_t phoff, int index, elf_segment_t *seg) {
+    if (info->elf_class == 64) {
+        uint64_t off = phoff + (uint64_t)index * sizeof(Elf64_Phdr);
+        if (!image_range_ok(img, off, sizeof(Elf64_Phdr))) return -1;
+        Elf64_Phdr ph;
+        memcpy(&ph, img->data + off, sizeof(ph));
+        seg->type = ph.p_type;
+        seg->offset = ph.p_offset;
+        seg->vaddr = ph.p_vaddr;
+        seg->filesz = ph.p_filesz;
+    } else {
+        uint64_t off = phoff + (uint64_t)index * sizeof(Elf32_Phdr);
+        if (!image_range_ok(img, off, sizeof(Elf32_Phdr))) return -1;
+        Elf32_Phdr ph;
+        memcpy(&ph, img->data + off, sizeof(ph));
+        seg->type = ph.p_type;
+        seg->offset = ph.p_offset;
+        seg->vaddr = ph.p_vaddr;
+        seg->filesz = ph.p_filesz;
+    }
+    return 0;
+}
+
+static int read_section(const elf_image_t *img, const elf_info_t *info,
+                        uint64_t shoff, int index, elf_section_t *sec) {
+    if (info->elf_class == 64) {
+        uint64_t off = shoff + (uint64_t)index * sizeof(Elf64_Shdr);
+        if (!image_range_ok(img, off, sizeof(Elf64_Shdr))) return -1;
+        Elf64_Shdr sh;
+        memcpy(&sh, img->data + off, sizeof(sh));
+        sec->type = sh.sh_type;
+        sec->link = sh.sh_link;
+        sec->offset = sh.sh_offset;
+        sec->size = sh.sh_size;
+        sec->entsize = sh.sh_entsize;
+    } else {
+        uint64_t off = shoff + (uint64_t)index * sizeof(Elf32_Shdr);
+        if (!image_range_ok(img, off, sizeof(Elf32_Shdr))) return -1;
+        Elf32_Shdr sh;
+        memcpy(&sh, img->data + off, sizeof(sh));
+        sec->type = sh.sh_type;
+        sec->link = sh.sh_link;
+        sec->offset = sh.sh_offset;
+        sec->size = sh.sh_size;
+        sec->entsize = sh.sh_entsize;
+    }
+    return 0;
+}
+
+// 读取第index个动态段条目，越界返回-1
+static int read_dynamic(const elf_image_t *img, const elf_info_t *info, uint64_t offset,
+                        uint64_t size, uint64_t index, int64_t *tag, uint64_t *val) {
+    size_t entsize = info->elf_class == 64 ? sizeof(Elf64_Dyn) : sizeof(Elf32_Dyn);
+    if ((index + 1) * entsize > size || !image_range_ok(img, offset + index * entsize, entsize)) {
+        return -1;
+    }
+
+    const unsigned char *p = img->data + offset + index * entsize;
+    if (info->elf_class == 64) {
+        Elf64_Dyn dyn;
+        memcpy(&dyn, p, sizeof(dyn));
+        *tag = dyn.d_tag;
+        *val = dyn.d_un.d_val;
+    } else {
+        Elf32_Dyn dyn;
+        memcpy(&dyn, p, sizeof(dyn));
+        *tag = dyn.d_tag;
+        *val = dyn.d_un.d_val;
+    }
+    return 0;
+}
+
+// 通过PT_LOAD段把虚拟地址换算为文件偏移
+static int vaddr_to_offset(const elf_image_t *img, const elf_info_t *info, uint64_t phoff,
+                           int phnum, uint64_t vaddr, uint64_t *offset) {
+    for (int i = 0; i < phnum; i++) {
+        elf_segment_t seg;
+        if (read_segment(img, info, phoff, i, &seg) != 0) return -1;
+        if (seg.type == PT_LOAD && vaddr >= seg.vaddr && vaddr - seg.vaddr < seg.filesz) {
+            *offset = seg.offset + (vaddr - seg.vaddr);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// 从字符串表中取出以NUL结尾的字符串，越界或未结束返回NULL
+static const char *image_string(const elf_image_t *img, uint64_t table, uint64_t table_size,
+                                uint64_t index) {
+    if (index >= table_size || !image_range_ok(img, table, table_size)) {
+        return NULL;
+    }
+    const char *str = (const char *)img->data + table + index;
+    if (!memchr(str, '\0', table_size - index)) {
+        return NULL;
+    }
+    return str;
+}
+
+// 解析动态段：DT_NEEDED/DT_RPATH/DT_RUNPATH
+static int parse_dynamic(const elf_image_t *img, elf_info_t *info, uint64_t phoff, int phnum,
+                         uint64_t dyn_offset, uint64_t dyn_size,
+                         uint64_t fallback_strtab, uint64_t fallback_strsz) {
+    uint64_t strtab_vaddr = 0, strsz = 0;
+    int has_strtab = 0;
+    int64_t tag;
+    uint64_t val;
+
+    for (uint64_t i = 0; read_dynamic(img, info, dyn_offset, dyn_size, i, &tag, &val) == 0; i++) {
+        if (tag == DT_NULL) break;
+        if (tag == DT_STRTAB) {
+            strtab_vaddr = val;
+            has_strtab = 1;
+        } else if (tag == DT_STRSZ) {
+            strsz = val;
+        }
+    }
+
+    // 优先按程序头定位字符串表，节头被剥离或伪造时它仍然有效
+    uint64_t strtab = 0;
+    if (has_strtab && vaddr_to_offset(img, info, phoff, phnum, strtab_vaddr, &strtab) == 0) {
+        if (strsz == 0 || !image_range_ok(img, strtab, strsz)) {
+            strsz = img->size - strtab;
+        }
+    } else if (fallback_strsz > 0) {
+        strtab = fallback_strtab;
+        strsz = fallback_strsz;
+    } else {
+        printf("ELF动态段缺少可用的字符串表\n");
+        return -1;
+    }
+
+    for (uint64_t i = 0; read_dynamic(img, info, dyn_offset, dyn_size, i, &tag, &val) == 0; i++) {
+        if (tag == DT_NULL) break;
+        if (tag != DT_NEEDED && tag != DT_RPATH && tag != DT_RUNPATH) continue;
+
+        const char *str = image_string(img, strtab, strsz, val);
+        if (!str) continue;
+
+        if (tag == DT_NEEDED) {
+            if (lib_list_add(&info->needed, str) != 0) return -1;
+        } else {
+            char **dest = tag == DT_RPATH ? &info->rpath : &info->runpath;
+            free(*dest);
+            *dest = strdup(str);
+            if (!*dest) {
+                perror("内存分配失败");
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+static int parse_image(const elf_image_t *img, elf_info_t *info) {
+    const unsigned char *ident = img->data;
+    if (img->size < EI_NIDENT || memcmp(ident, ELFMAG, SELFMAG) != 0) {
+        return -1;
+    }
+
+    uint64_t phoff, shoff;
+    int phnum, shnum;
+    if (ident[EI_CLASS] == ELFCLASS64 && img->size >= sizeof(Elf64_Ehdr)) {
+        Elf64_Ehdr eh;
+        memcpy(&eh, img->data, sizeof(eh));
+        info->elf_class = 64;
+        info->type = eh.e_type;
+        info->machine = eh.e_machine;
+        phoff = eh.e_phoff;
+        phnum = eh.e_phnum;
+        shoff = eh.e_shoff;
+        shnum = eh.e_shnum;
+    } else if (ident[EI_CLASS] == ELFCLASS32 && img->size >= sizeof(Elf32_Ehdr)) {
+        Elf32_Ehdr eh;
+        memcpy(&eh, img->data, sizeof(eh));
+        info->elf_class = 32;
+        info->type = eh.e_type;
+        info->machine = eh.e_machine;
+        phoff = eh.e_phoff;
+        phnum = eh.e_phnum;
+        shoff = eh.e_shoff;
+        shnum = eh.e_shnum;
+    } else {
+        return -1;
+    }
+
+    info->big_endian = ident[EI_DATA] == ELFDATA2MSB;
+    if (info->big_endian) {
+        // 大端ELF无法在本机运行，只报告基本信息
+        return 0;
+    }
+
+    // 节头：统计数量、判断是否剥离符号表，并记下.dynamic对应的字符串表作为后备
+    uint64_t sec_dynstr = 0, sec_dynstr_size = 0;
+    info->section_count = 0;
+    for (int i = 0; shoff != 0 && i < shnum; i++) {
+        elf_section_t sec;
+        if (read_section(img, info, shoff, i, &sec) != 0) break;
+        info->section_count++;
+        if (sec.type == SHT_SYMTAB) {
+            info->has_symtab = 1;
+        } else if (sec.type == SHT_DYNAMIC && sec.link < (uint32_t)shnum) {
+            elf_section_t strsec;
+            if (read_section(img, info, shoff, (int)sec.link, &strsec) == 0 &&
+                strsec.type == SHT_STRTAB && image_range_ok(img, strsec.offset, strsec.size)) {
+                sec_dynstr = strsec.offset;
+                sec_dynstr_size = strsec.size;
+            }
+        }
+    }
+
+    uint64_t dyn_offset = 0, dyn_size = 0;
+    for (int i = 0; i < phnum; i++) {
+        elf_segment_t seg;
+        if (read_segment(img, info, phoff, i, &seg) != 0) {
+            printf("ELF程序头越界\n");
+            return -1;
+        }
+
+        if (seg.type == PT_INTERP && image_range_ok(img, seg.offset, seg.filesz) && seg.filesz > 1) {
+            size_t len = strnlen((const char *)img->data + seg.offset, seg.filesz);
+            free(info->interp);
+            info->interp = strndup((const char *)img->data + seg.offset, len);
+            if (!info->interp) {
+                perror("内存分配失败");
+                return -1;
+            }
+        } else if (seg.type == PT_DYNAMIC && image_range_ok(img, seg.offset, seg.filesz)) {
+            info->has_dynamic = 1;
+            dyn_offset = seg.offset;
+            dyn_size = seg.filesz;
+        }
+    }
+
+    if (info->has_dynamic) {
+        return parse_dynamic(img, info, phoff, phnum, dyn_offset, dyn_size,
+                             sec_dynstr, sec_dynstr_size);
+    }
+    return 0;
+}
+
+// 解析ELF文件头部信息和动态依赖。非ELF文件或结构损坏时返回-1
+int elf_read_info(const char *path, elf_info_t *info) {
+    memset(info, 0, sizeof(*info));
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size < EI_NIDENT) {
+        close(fd);
+        return -1;
+    }
+
+    void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return -1;
+    }
+
+    elf_image_t img = { data, (size_t)st.st_size };
+    int ret = parse_image(&img, info);
+    munmap(data, (size_t)st.st_size);
+
+    if (ret != 0) {
+        free_elf_info(info);
+    }
+    return ret;
+}
+
+void free_elf_info(elf_info_t *info) {
+    free(info->interp);
+    free(info->rpath);
+    free(info->runpath);
+    free_lib_list(&info->needed);
+    memset(info, 0, sizeof(*info));
+}
+
+// 判断另一个ELF文件的字长和架构是否与ref一致（只读文件头），
+// 动态链接器会跳过不匹配的库，解析依赖时也要同样处理
+int elf_matches_arch(const char *path, const elf_info_t *ref) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return 0;
+    }
+
+    // e_machine在ELF32和ELF64中偏移相同
+    unsigned char ident[EI_NIDENT + 4];
+    ssize_t n = pread(fd, ident, sizeof(ident), 0);
+    close(fd);
+    if (n != (ssize_t)sizeof(ident) || memcmp(ident, ELFMAG, SELFMAG) != 0) {
+        return 0;
+    }
+
+    int elf_class = ident[EI_CLASS] == ELFCLASS64 ? 64 : ident[EI_CLASS] == ELFCLASS32 ? 32 : 0;
+    uint16_t machine;
+    memcpy(&machine, ident + EI_NIDENT + 2, sizeof(machine));
+    return elf_class == ref->elf_class && machine == ref->machine;
+}
+
+// 没有解释器也没有依赖库即为静态链接（包括static-pie）
+int elf_is_static(const elf_info_t *info) {
+    return info->interp == NULL && info->needed.count == 0;
+}
+
+static const char *elf_machine_name(uint16_t machine) {
+    switch (machine) {
+    case EM_X86_64: return "x86-64";
+    case EM_386: return "Intel 80386";
+    case EM_AARCH64: return "ARM aarch64";
+    case EM_ARM: return "ARM";
+    case EM_MIPS: return "MIPS";
+    case EM_PPC: return "PowerPC";
+    case EM_PPC64: return "64-bit PowerPC";
+    case EM_RISCV: return "RISC-V";
+    default: return "未知架构";
+    }
+}
+
+// 生成类似file(1)的一行描述
+void elf_describe(const elf_info_t *info, char *buf, size_t len) {
+    const char *kind;
+    switch (info->type) {
+    case ET_EXEC: kind = "executable"; break;
+    case ET_DYN: kind = info->interp ? "pie executable" : "shared object"; break;
+    case ET_REL: kind = "relocatable"; break;
+    case ET_CORE: kind = "core file"; break;
+    default: kind = "unknown type"; break;
+    }
+
+    const char *linkage = info->interp ? "dynamically linked" :
+                          info->has_dynamic && info->needed.count == 0 ? "static-pie linked" :
+                          info->needed.count > 0 ? "dynamically linked" : "statically linked";
+
+    int n = snprintf(buf, len, "ELF %d-bit %s %s, %s, %s",
+                     info->elf_class, info->big_endian ? "MSB" : "LSB", kind,
+                     elf_machine_name(info->machine), linkage);
+    if (n >= 0 && (size_t)n < len && info->interp) {
+        n += snprintf(buf + n, len - (size_t)n, ", interpreter %s", info->interp);
+    }
+    if (n >= 0 && (size_t)n < len && !info->big_endian) {
+        snprintf(buf + n, len - (size_t)n, ", %s", info->has_symtab ? "not stripped" : "stripped");
+    }
+}
+
+// ---- ld.so.cache ----
+
+// 新格式缓存的文件头与条目（与glibc的cache_file_new/file_entry_new一致）
+typedef struct {
+    char magic[sizeof(LD_CACHE_MAGIC_NEW) - 1];
+    uint32_t nlibs;
+    uint32_t len_strings;
+    uint8_t flags;
+    uint8_t padding[3];
+    uint32_t extension_offset;
+    uint32_t unused[3];
+} ld_cache_header_t;
+
+typedef struct {
+    int32_t flags;
+    uint32_t key;
+    uint32_t value;
+    uint32_t osversion;
+    uint64_t hwcap;
+} ld_cache_entry_t;
+
+typedef struct {
+    const unsigned char *data;     // 新格式头起始位置，字符串偏移以此为基准
+    size_t size;
+    const unsigned char *entries;  // 新格式条目起始位置
+    uint32_t nlibs;
+    int loaded;
+} ld_cache_t;
+
+static ld_cache_t ld_cache;
+
+// 映射ld.so.cache，进程内只做一次；缓存不存在时只使用默认搜索路径
+static const ld_cache_t *load_ld_cache(void) {
+    if (ld_cache.loaded) {
+        return ld_cache.entries ? &ld_cache : NULL;
+    }
+    ld_cache.loaded = 1;
+
+    int fd = open(LD_SO_CACHE, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(ld_cache_header_t)) {
+        close(fd);
+        return NULL;
+    }
+    void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+    const unsigned char *file = data;
+    size_t file_size = (size_t)st.st_size;
+
+    // 旧格式文件可能在新格式之前附带一段兼容数据，需要跳过。
+    // 新格式的头按8字节对齐（glibc的ALIGN_CACHE，条目中含64位的hwcap）
+    size_t offset = 0;
+    if (memcmp(file, LD_CACHE_MAGIC_OLD, sizeof(LD_CACHE_MAGIC_OLD) - 1) == 0) {
+        uint32_t old_nlibs;
+        memcpy(&old_nlibs, file + 12, sizeof(old_nlibs));
+        offset = (16 + (size_t)old_nlibs * 12 + 7) & ~(size_t)7;
+    }
+
+    ld_cache_header_t header;
+    if (offset > file_size || file_size - offset < sizeof(header)) {
+        munmap(data, file_size);
+        return NULL;
+    }
+    memcpy(&header, file + offset, sizeof(header));
+    if (memcmp(header.magic, LD_CACHE_MAGIC_NEW, sizeof(header.magic)) != 0 ||
+        (file_size - offset - sizeof(header)) / sizeof(ld_cache_entry_t) < header.nlibs) {
+        munmap(data, file_size);
+        return NULL;
+    }
+
+    ld_cache.data = file + offset;
+    ld_cache.size = file_size - offset;
+    ld_cache.entries = ld_cache.data + sizeof(header);
+    ld_cache.nlibs = header.nlibs;
+    return &ld_cache;
+}
+
+// 与目标架构对应的缓存条目标志（ldconfig按架构区分同名库）
+static int ld_cache_arch_flags(const elf_info_t *info) {
+    if (info->machine == EM_X86_64 && info->elf_class == 64) return LD_CACHE_FLAG_X8664_LIB64;
+    if (info->machine == EM_AARCH64) return LD_CACHE_FLAG_AARCH64_LIB64;
+    if (info->machine == EM_386) return 0;
+    return -1;  // 其他架构不限制
+}
+
+// 在ld.so.cache中查找库名，找到时写入完整路径
+int ld_cache_lookup(const char *name, const elf_info_t *requester, char *path, size_t len) {
+    const ld_cache_t *cache = load_ld_cache();
+    if (!cache) {
+        return -1;
+    }
+
+    int arch = ld_cache_arch_flags(requester);
+    for (uint32_t i = 0; i < cache->nlibs; i++) {
+        ld_cache_entry_t entry;
+        memcpy(&entry, cache->entries + (size_t)i * sizeof(entry), sizeof(entry));
+
+        if ((entry.flags & LD_CACHE_FLAG_TYPE_MASK) != LD_CACHE_FLAG_ELF_LIBC6) continue;
+        if (arch != -1 && (entry.flags & LD_CACHE_FLAG_ARCH_MASK) != arch) continue;
+        if (entry.key >= cache->size || entry.value >= cache->size) continue;
+
+        const char *key = (const char *)cache->data + entry.key;
+        if (!memchr(key, '\0', cache->size - entry.key) || strcmp(key, name) != 0) continue;
+
+        const char *value = (const char *)cache->data + entry.value;
+        if (!memchr(value, '\0', cache->size - entry.value)) continue;
+
+        snprintf(path, len, "%s", value);
+        return 0;
+    }
+    return -1;
+}
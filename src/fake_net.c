@@ -0,0 +1,265 @@
+// src/fake_net.c
+#include "sandbox.h"
+#include <sched.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <netinet/in.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+// 跟踪器侧的伪造网络：配置沙箱网络命名空间，按需创建监听套接字交给sinkhole。
+// 需要在沙箱命名空间中执行的操作通过setns临时切换，setns只影响调用线程
+
+// 启用回环接口
+static int bring_up_loopback(void) {
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        perror("创建套接字失败");
+        return -1;
+    }
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "lo");
+    int ret = ioctl(fd, SIOCGIFFLAGS, &ifr);
+    if (ret == 0) {
+        ifr.ifr_flags |= IFF_UP | IFF_RUNNING;
+        ret = ioctl(fd, SIOCSIFFLAGS, &ifr);
+    }
+    if (ret == -1) {
+        perror("启用回环接口失败");
+    }
+    close(fd);
+    return ret;
+}
+
+// 相当于"ip route add local 0.0.0.0/0 dev lo table local"：
+// 该地址族的所有地址都是本地地址，监听通配地址的套接字可以接受发往任意地址的连接
+static int add_local_route(int family) {
+    int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (fd == -1) {
+        perror("创建netlink套接字失败");
+        return -1;
+    }
+
+    struct {
+        struct nlmsghdr nh;
+        struct rtmsg rt;
+        char attrs[RTA_SPACE(sizeof(int))];
+    } req;
+    memset(&req, 0, sizeof(req));
+    req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(req.rt));
+    req.nh.nlmsg_type = RTM_NEWROUTE;
+    req.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_CREATE | NLM_F_REPLACE | NLM_F_ACK;
+    req.rt.rtm_family = (unsigned char)family;
+    req.rt.rtm_table = RT_TABLE_LOCAL;
+    req.rt.rtm_protocol = RTPROT_BOOT;
+    req.rt.rtm_scope = RT_SCOPE_HOST;
+    req.rt.rtm_type = RTN_LOCAL;
+
+    int ifindex = (int)if_nametoindex("lo");
+    struct rtattr *rta = (struct rtattr *)((char *)&req + NLMSG_ALIGN(req.nh.nlmsg_len));
+    rta->rta_type = RTA_OIF;
+    rta->rta_len = RTA_LENGTH(sizeof(ifindex));
+    memcpy(RTA_DATA(rta), &ifindex, sizeof(ifindex));
+    req.nh.nlmsg_len = NLMSG_ALIGN(req.nh.nlmsg_len) + RTA_SPACE(sizeof(ifindex));
+
+    struct sockaddr_nl kernel = { .nl_family = AF_NETLINK };
+    char reply[512];
+    ssize_t n = -1;
+    if (sendto(fd, &req, req.nh.nlmsg_len, 0, (struct sockaddr *)&kernel, sizeof(kernel)) != -1) {
+        n = recv(fd, reply, sizeof(reply), 0);
+    }
+    close(fd);
+
+    struct nlmsghdr *nh = (struct nlmsghdr *)reply;
+    if (n < (ssize_t)NLMSG_LENGTH(sizeof(struct nlmsgerr)) || nh->nlmsg_type != NLMSG_ERROR) {
+        fprintf(stderr, "添加本地路由失败: netlink无应答\n");
+        return -1;
+    }
+    int error = ((struct nlmsgerr *)NLMSG_DATA(nh))->error;
+    if (error != 0) {
+        fprintf(stderr, "添加%s本地路由失败: %s\n", family == AF_INET6 ? "IPv6" : "IPv4", strerror(-error));
+        return -1;
+    }
+    return 0;
+}
+
+// 创建监听通配地址的套接字：优先IPv6双栈，内核未启用IPv6时退回IPv4
+static int open_listener(int type, uint16_t port) {
+    static const int families[] = { AF_INET6, AF_INET };
+    for (size_t i = 0; i < sizeof(families) / sizeof(families[0]); i++) {
+        int fd = socket(families[i], type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd == -1) continue;
+
+        int one = 1, zero = 0;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        struct sockaddr_storage addr;
+        socklen_t addr_len;
+        memset(&addr, 0, sizeof(addr));
+        if (families[i] == AF_INET6) {
+            setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero));
+            struct sockaddr_in6 *in6 = (struct sockaddr_in6 *)&addr;
+            in6->sin6_family = AF_INET6;
+            in6->sin6_port = htons(port);
+            in6->sin6_addr = in6addr_any;
+            addr_len = sizeof(*in6);
+        } else {
+            struct sockaddr_in *in = (struct sockaddr_in *)&addr;
+            in->sin_family = AF_INET;
+            in->sin_port = htons(port);
+            in->sin_addr.s_addr = htonl(INADDR_ANY);
+            addr_len = sizeof(*in);
+        }
+
+        if (bind(fd, (struct sockaddr *)&addr, addr_len) == 0 &&
+            (type != SOCK_STREAM || listen(fd, SOMAXCONN) == 0)) {
+            return fd;
+        }
+        // 端口已被样本自己占用时不抢占
+        int saved = errno;
+        close(fd);
+        if (saved == EADDRINUSE) {
+            return -1;
+        }
+    }
+    return -1;
+}
+
+// 把套接字连同消息交给sinkhole进程
+static int send_to_sinkhole(int ctl_fd, const sinkhole_msg_t *msg, int fd) {
+    struct iovec iov = { .iov_base = (void *)msg, .iov_len = sizeof(*msg) };
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    if (fd >= 0) {
+        memset(&control, 0, sizeof(control));
+        mh.msg_control = control.buf;
+        mh.msg_controllen = sizeof(control.buf);
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&mh);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    }
+    if (sendmsg(ctl_fd, &mh, MSG_NOSIGNAL) == -1) {
+        perror("发送到sinkhole失败");
+        return -1;
+    }
+    return 0;
+}
+
+// 进入沙箱的网络命名空间，启用回环接口和本地路由，并监听DNS端口。
+// 沙箱根进程此时停在ptrace的初始停止处，样本还没有开始执行
+int fake_net_attach(fake_net_t *net, int ctl_fd, pid_t pid) {
+    memset(net, 0, sizeof(*net));
+    net->ctl_fd = ctl_fd;
+    net->sandbox = (uint32_t)pid;
+    net->netns_fd = -1;
+    pthread_mutex_init(&net->ready_lock, NULL);
+    pthread_cond_init(&net->ready_cond, NULL);
+
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/ns/net", pid);
+    net->self_netns_fd = open("/proc/self/ns/net", O_RDONLY | O_CLOEXEC);
+    net->netns_fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (net->self_netns_fd == -1 || net->netns_fd == -1) {
+        perror("打开网络命名空间失败");
+        fake_net_detach(net);
+        return -1;
+    }
+
+    if (setns(net->netns_fd, CLONE_NEWNET) == -1) {
+        perror("进入沙箱网络命名空间失败");
+        fake_net_detach(net);
+        return -1;
+    }
+    int ret = bring_up_loopback();
+    if (ret == 0) {
+        ret = add_local_route(AF_INET);
+        // IPv6可能未启用，只影响IPv6连接
+        add_local_route(AF_INET6);
+    }
+    if (setns(net->self_netns_fd, CLONE_NEWNET) == -1) {
+        perror("返回原网络命名空间失败");
+        ret = -1;
+    }
+    if (ret != 0) {
+        fake_net_detach(net);
+        return -1;
+    }
+
+    fake_net_listen(net, SOCK_DGRAM, SINKHOLE_DNS_PORT);
+    return 0;
+}
+
+// 标记端口的创建已经完成，唤醒等待它的跟踪线程
+static void mark_ready(fake_net_t *net, int udp, uint16_t port) {
+    pthread_mutex_lock(&net->ready_lock);
+    __atomic_fetch_or(&net->ready[udp][port >> 3], (uint8_t)(1u << (port & 7)), __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&net->ready_cond);
+    pthread_mutex_unlock(&net->ready_lock);
+}
+
+// 确保沙箱中有监听该端口的套接字。返回1表示新建，0表示已尝试过，-1表示失败。
+// 失败的端口同样标记，避免每次连接都重试。多个跟踪线程可以同时调用：抢到端口的线程创建，
+// 其他线程等它完成后再返回，样本的connect不会先于监听发生；setns只影响调用线程
+int fake_net_listen(fake_net_t *net, int type, uint16_t port) {
+    int udp = type == SOCK_DGRAM;
+    uint8_t bit = (uint8_t)(1u << (port & 7));
+    if (net->netns_fd == -1 || port == 0) {
+        return 0;
+    }
+    if (__atomic_fetch_or(&net->ports[udp][port >> 3], bit, __ATOMIC_ACQ_REL) & bit) {
+        if (!(__atomic_load_n(&net->ready[udp][port >> 3], __ATOMIC_ACQUIRE) & bit)) {
+            pthread_mutex_lock(&net->ready_lock);
+            while (!(__atomic_load_n(&net->ready[udp][port >> 3], __ATOMIC_ACQUIRE) & bit)) {
+                pthread_cond_wait(&net->ready_cond, &net->ready_lock);
+            }
+            pthread_mutex_unlock(&net->ready_lock);
+        }
+        return 0;
+    }
+
+    int fd = -1;
+    if (setns(net->netns_fd, CLONE_NEWNET) == -1) {
+        perror("进入沙箱网络命名空间失败");
+    } else {
+        fd = open_listener(udp ? SOCK_DGRAM : SOCK_STREAM, port);
+        if (setns(net->self_netns_fd, CLONE_NEWNET) == -1) {
+            perror("返回原网络命名空间失败");
+        }
+    }
+    // 套接字创建后连接就会排队，不必等sinkhole收到
+    mark_ready(net, udp, port);
+    if (fd == -1) {
+        return -1;
+    }
+
+    sinkhole_msg_t msg = {
+        .sandbox = net->sandbox,
+        .kind = udp ? SINKHOLE_MSG_UDP : SINKHOLE_MSG_TCP,
+        .port = port,
+    };
+    int ret = send_to_sinkhole(net->ctl_fd, &msg, fd);
+    close(fd);
+    return ret == 0 ? 1 : -1;
+}
+
+// 沙箱结束：通知sinkhole关闭该沙箱的套接字
+void fake_net_detach(fake_net_t *net) {
+    if (net->netns_fd != -1) {
+        sinkhole_msg_t msg = { .sandbox = net->sandbox, .kind = SINKHOLE_MSG_CLOSE };
+        send_to_sinkhole(net->ctl_fd, &msg, -1);
+        close(net->netns_fd);
+        net->netns_fd = -1;
+    }
+    if (net->self_netns_fd != -1) {
+        close(net->self_netns_fd);
+        net->self_netns_fd = -1;
+    }
+}
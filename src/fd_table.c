@@ -0,0 +1,470 @@
+// src/fd_table.c
+#include "sandbox.h"
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <linux/close_range.h>
+
+// 文件描述符跟踪：在系统调用退出时按返回值更新所属进程的fd表，
+// 在入口把fd参数对应的路径或套接字描述附加到参数块。
+// 表中没有的fd（继承来的、经SCM_RIGHTS收到的、未跟踪的系统调用创建的）
+// 在第一次用到时从/proc/<tid>/fd读取并补进表里
+
+#define FD_TABLE_INITIAL 64
+#define FD_DESC_MAX (PATH_MAX + 128)
+
+fd_table_t *fd_table_new(void) {
+    fd_table_t *table = calloc(1, sizeof(*table));
+    if (!table) {
+        return NULL;
+    }
+    table->refs = 1;
+    return table;
+}
+
+// 线程共用文件表（CLONE_FILES）
+fd_table_t *fd_table_share(fd_table_t *table) {
+    table->refs++;
+    return table;
+}
+
+// fork时复制文件表
+fd_table_t *fd_table_copy(const fd_table_t *table) {
+    fd_table_t *copy = fd_table_new();
+    if (!copy || table->size == 0) {
+        return copy;
+    }
+    copy->entries = malloc((size_t)table->size * sizeof(uint32_t));
+    if (!copy->entries) {
+        free(copy);
+        return NULL;
+    }
+    memcpy(copy->entries, table->entries, (size_t)table->size * sizeof(uint32_t));
+    copy->size = table->size;
+    return copy;
+}
+
+void fd_table_release(fd_table_t *table) {
+    if (table && --table->refs == 0) {
+        free(table->entries);
+        free(table);
+    }
+}
+
+// 与其他进程共用的表先复制一份再修改（exec、close_range(CLOSE_RANGE_UNSHARE)）
+static fd_table_t *fd_table_unshare(fd_table_t *table) {
+    if (table->refs == 1) {
+        return table;
+    }
+    fd_table_t *copy = fd_table_copy(table);
+    if (!copy) {
+        return table;
+    }
+    fd_table_release(table);
+    return copy;
+}
+
+// exec之后的文件表：去掉所有close-on-exec的fd
+fd_table_t *fd_table_exec(fd_table_t *table) {
+    if (!table) {
+        return NULL;
+    }
+    table = fd_table_unshare(table);
+    for (int fd = 0; fd < table->size; fd++) {
+        if (table->entries[fd] & FD_ENTRY_CLOEXEC) {
+            table->entries[fd] = 0;
+        }
+    }
+    return table;
+}
+
+static uint32_t fd_table_get(const fd_table_t *table, int fd) {
+    return fd >= 0 && fd < table->size ? table->entries[fd] : 0;
+}
+
+static void fd_table_set(fd_table_t *table, int fd, uint32_t id, int cloexec) {
+    if (fd < 0 || fd >= FD_TABLE_MAX) {
+        return;
+    }
+    if (fd >= table->size) {
+        if (id == 0) {
+            return;
+        }
+        int size = table->size ? table->size : FD_TABLE_INITIAL;
+        while (size <= fd) size *= 2;
+        uint32_t *entries = realloc(table->entries, (size_t)size * sizeof(uint32_t));
+        if (!entries) {
+            return;
+        }
+        memset(entries + table->size, 0, (size_t)(size - table->size) * sizeof(uint32_t));
+        table->entries = entries;
+        table->size = size;
+    }
+    table->entries[fd] = id ? (id | (cloexec ? FD_ENTRY_CLOEXEC : 0)) : 0;
+}
+
+static void fd_table_clear(fd_table_t *table, int fd) {
+    if (fd >= 0 && fd < table->size) {
+        table->entries[fd] = 0;
+    }
+}
+
+// 从/proc/<tid>/fdinfo读取close-on-exec标志
+static int proc_fd_cloexec(pid_t tid, int fd) {
+    char path[64], buf[256];
+    snprintf(path, sizeof(path), "/proc/%d/fdinfo/%d", tid, fd);
+    int info = open(path, O_RDONLY | O_CLOEXEC);
+    if (info == -1) {
+        return 0;
+    }
+    ssize_t n = read(info, buf, sizeof(buf) - 1);
+    close(info);
+    if (n <= 0) {
+        return 0;
+    }
+    buf[n] = '\0';
+    const char *flags = strstr(buf, "flags:");
+    return flags && (strtoul(flags + 6, NULL, 8) & O_CLOEXEC) != 0;
+}
+
+// 返回fd的描述（字符串id），表中没有时从/proc读取并记入表中；fd无效时返回0
+uint32_t fd_table_describe(fd_table_t *table, string_pool_t *pool, pid_t tid, int fd) {
+    uint32_t entry = fd_table_get(table, fd);
+    if (entry) {
+        return entry & FD_ENTRY_ID_MASK;
+    }
+    if (fd < 0) {
+        return 0;
+    }
+
+    char desc[PATH_MAX];
+    ssize_t len = resolve_tracee_path(tid, fd, "", desc, sizeof(desc));
+    if (len <= 0) {
+        return 0;
+    }
+    uint32_t id = string_pool_intern(pool, desc, (size_t)len);
+    fd_table_set(table, fd, id, proc_fd_cloexec(tid, fd));
+    return id;
+}
+
+// 导出时每个fd的记录头，描述字符串紧随其后（不含结尾的NUL）
+typedef struct {
+    int32_t fd;
+    uint32_t flags;            // FD_ENTRY_CLOEXEC
+    uint32_t len;
+} fd_export_t;
+
+// 把fd表连同描述字符串导出为自包含的字节串，交给使用另一个字符串池的跟踪线程。
+// 返回malloc的缓冲区，*len为其长度；失败时返回NULL
+char *fd_table_export(const fd_table_t *table, const string_pool_t *pool, size_t *len) {
+    size_t total = 0;
+    for (int fd = 0; fd < table->size; fd++) {
+        if (table->entries[fd]) {
+            total += sizeof(fd_export_t) + strlen(string_pool_get(pool, table->entries[fd] & FD_ENTRY_ID_MASK));
+        }
+    }
+    char *data = malloc(total ? total : 1);
+    if (!data) {
+        return NULL;
+    }
+    size_t pos = 0;
+    for (int fd = 0; fd < table->size; fd++) {
+        uint32_t entry = table->entries[fd];
+        if (!entry) continue;
+        const char *desc = string_pool_get(pool, entry & FD_ENTRY_ID_MASK);
+        fd_export_t header = { .fd = fd, .flags = entry & FD_ENTRY_CLOEXEC, .len = (uint32_t)strlen(desc) };
+        memcpy(data + pos, &header, sizeof(header));
+        memcpy(data + pos + sizeof(header), desc, header.len);
+        pos += sizeof(header) + header.len;
+    }
+    *len = total;
+    return data;
+}
+
+// 由fd_table_export的结果重建fd表，描述字符串驻留到pool中
+fd_table_t *fd_table_import(const char *data, size_t len, string_pool_t *pool) {
+    fd_table_t *table = fd_table_new();
+    size_t pos = 0;
+    while (table && pos + sizeof(fd_export_t) <= len) {
+        fd_export_t header;
+        memcpy(&header, data + pos, sizeof(header));
+        pos += sizeof(header);
+        if (header.len > len - pos) {
+            break;
+        }
+        fd_table_set(table, header.fd, string_pool_intern(pool, data + pos, header.len),
+                     (header.flags & FD_ENTRY_CLOEXEC) != 0);
+        pos += header.len;
+    }
+    return table;
+}
+
+static const char *family_name(int family) {
+    switch (family) {
+    case AF_UNIX: return "unix";
+    case AF_INET: return "inet";
+    case AF_INET6: return "inet6";
+    case AF_NETLINK: return "netlink";
+    case AF_PACKET: return "packet";
+    default: return NULL;
+    }
+}
+
+static const char *socktype_name(int type) {
+    switch (type) {
+    case SOCK_STREAM: return "stream";
+    case SOCK_DGRAM: return "dgram";
+    case SOCK_RAW: return "raw";
+    case SOCK_SEQPACKET: return "seqpacket";
+    default: return NULL;
+    }
+}
+
+// 新套接字的描述，如"socket:[inet/stream]"
+static uint32_t intern_socket(string_pool_t *pool, unsigned long domain, unsigned long type) {
+    char family_buf[16], type_buf[16], desc[64];
+    const char *family = family_name((int)domain);
+    const char *kind = socktype_name((int)(type & 0xf));
+    if (!family) {
+        snprintf(family_buf, sizeof(family_buf), "af%lu", domain);
+        family = family_buf;
+    }
+    if (!kind) {
+        snprintf(type_buf, sizeof(type_buf), "type%lu", type & 0xf);
+        kind = type_buf;
+    }
+    int len = snprintf(desc, sizeof(desc), "socket:[%s/%s]", family, kind);
+    return string_pool_intern(pool, desc, (size_t)len);
+}
+
+// 在套接字原有描述（第一个空格之前）后附加地址，如"socket:[inet/stream] -> 8.8.8.8:53"
+static void describe_socket_addr(fd_table_t *table, string_pool_t *pool, pid_t tid, int fd, int target,
+                                 const char *relation, const void *addr, size_t addr_len, int cloexec) {
+    uint32_t base_id = fd_table_describe(table, pool, tid, fd);
+    if (base_id == 0) {
+        fd_table_clear(table, target);
+        return;
+    }
+    const char *base = string_pool_get(pool, base_id);
+
+    char addr_str[PATH_MAX];
+    struct sockaddr_storage storage;
+    memset(&storage, 0, sizeof(storage));
+    addr_len = addr_len < sizeof(storage) ? addr_len : sizeof(storage);
+    memcpy(&storage, addr, addr_len);
+    format_sockaddr(&storage, addr_len, addr_str, sizeof(addr_str));
+
+    char desc[FD_DESC_MAX];
+    int len = snprintf(desc, sizeof(desc), "%.*s %s %s", (int)strcspn(base, " "), base, relation, addr_str);
+    if (len > 0 && (size_t)len < sizeof(desc)) {
+        fd_table_set(table, target, string_pool_intern(pool, desc, (size_t)len), cloexec);
+    }
+}
+
+// 新fd复制已有fd的描述（dup系列）
+static void copy_fd(fd_table_t *table, string_pool_t *pool, pid_t tid, int oldfd, int newfd, int cloexec) {
+    uint32_t id = fd_table_describe(table, pool, tid, oldfd);
+    if (id) {
+        fd_table_set(table, newfd, id, cloexec);
+    } else {
+        fd_table_clear(table, newfd);
+    }
+}
+
+// 内核写回的int[2]（pipe/socketpair），先清掉旧表项，再从/proc取得"pipe:[inode]"等描述
+static void track_fd_pair(fd_table_t *table, string_pool_t *pool, pid_t tid, unsigned long addr,
+                          uint32_t id, int cloexec) {
+    int fds[2];
+    if (read_tracee_memory(tid, addr, fds, sizeof(fds)) != (ssize_t)sizeof(fds)) {
+        return;
+    }
+    for (int i = 0; i < 2; i++) {
+        fd_table_clear(table, fds[i]);
+        if (id) {
+            fd_table_set(table, fds[i], id, cloexec);
+        } else {
+            fd_table_describe(table, pool, tid, fds[i]);
+        }
+    }
+}
+
+// 参数块中的路径，只接受绝对路径（相对路径未能解析时交给/proc）
+static uint32_t intern_captured_path(string_pool_t *pool, const arg_capture_t *capture, int index) {
+    if (!capture) {
+        return 0;
+    }
+    size_t len;
+    const char *path = arg_blob_path(capture->blob, capture->len, index, &len);
+    return len > 0 && path[0] == '/' ? string_pool_intern(pool, path, len) : 0;
+}
+
+static void track_open(fd_table_t *table, string_pool_t *pool, pid_t tid, long fd, uint32_t id,
+                       unsigned long flags) {
+    fd_table_clear(table, (int)fd);
+    if (id) {
+        fd_table_set(table, (int)fd, id, (flags & O_CLOEXEC) != 0);
+    } else {
+        fd_table_describe(table, pool, tid, (int)fd);
+    }
+}
+
+// 系统调用退出时更新fd表。capture为该任务本次入口的参数块，
+// 已被其他任务的入口覆盖时为NULL（改从/proc读取）
+void fd_track_syscall_exit(fd_table_t **tablep, string_pool_t *pool, pid_t tid, int syscall_nr,
+                           const unsigned long *args, long ret, const arg_capture_t *capture) {
+    fd_table_t *table = *tablep;
+    if (!table) {
+        return;
+    }
+
+    switch (syscall_nr) {
+    case __NR_open:
+        if (ret >= 0) track_open(table, pool, tid, ret, intern_captured_path(pool, capture, 0), args[1]);
+        break;
+    case __NR_creat:
+        if (ret >= 0) track_open(table, pool, tid, ret, intern_captured_path(pool, capture, 0), 0);
+        break;
+    case __NR_openat:
+        if (ret >= 0) track_open(table, pool, tid, ret, intern_captured_path(pool, capture, 1), args[2]);
+        break;
+    case __NR_openat2: {
+        // struct open_how的第一个字段是flags
+        uint64_t flags = 0;
+        if (ret >= 0) {
+            read_tracee_memory(tid, args[2], &flags, sizeof(flags));
+            track_open(table, pool, tid, ret, intern_captured_path(pool, capture, 1), flags);
+        }
+        break;
+    }
+    case __NR_socket:
+        if (ret >= 0) {
+            fd_table_set(table, (int)ret, intern_socket(pool, args[0], args[1]), (args[1] & SOCK_CLOEXEC) != 0);
+        }
+        break;
+    case __NR_socketpair:
+        if (ret == 0) {
+            track_fd_pair(table, pool, tid, args[3], intern_socket(pool, args[0], args[1]),
+                          (args[1] & SOCK_CLOEXEC) != 0);
+        }
+        break;
+    case __NR_pipe:
+    case __NR_pipe2:
+        if (ret == 0) track_fd_pair(table, pool, tid, args[0], 0, 0);
+        break;
+    case __NR_accept:
+    case __NR_accept4: {
+        if (ret < 0) break;
+        int cloexec = syscall_nr == __NR_accept4 && (args[3] & SOCK_CLOEXEC);
+        struct sockaddr_storage peer;
+        socklen_t peer_len = 0;
+        if (args[1] && args[2] &&
+            read_tracee_memory(tid, args[2], &peer_len, sizeof(peer_len)) == (ssize_t)sizeof(peer_len) &&
+            peer_len > 0) {
+            if (peer_len > sizeof(peer)) peer_len = sizeof(peer);
+            if (read_tracee_memory(tid, args[1], &peer, peer_len) != (ssize_t)peer_len) peer_len = 0;
+        }
+        if (peer_len > 0) {
+            describe_socket_addr(table, pool, tid, (int)args[0], (int)ret, "<-", &peer, peer_len, cloexec);
+        } else {
+            copy_fd(table, pool, tid, (int)args[0], (int)ret, cloexec);
+        }
+        break;
+    }
+    case __NR_connect:
+    case __NR_bind: {
+        const char *data;
+        size_t len;
+        int ok = syscall_nr == __NR_connect ? (ret == 0 || ret == -EINPROGRESS) : ret == 0;
+        if (ok && capture && arg_blob_find(capture->blob, capture->len, 1, &data, &len) == 0) {
+            int fd = (int)args[0];
+            describe_socket_addr(table, pool, tid, fd, fd, syscall_nr == __NR_connect ? "->" : "@",
+                                 data, len, (fd_table_get(table, fd) & FD_ENTRY_CLOEXEC) != 0);
+        }
+        break;
+    }
+    case __NR_dup:
+        if (ret >= 0) copy_fd(table, pool, tid, (int)args[0], (int)ret, 0);
+        break;
+    case __NR_dup2:
+        if (ret >= 0 && (int)args[0] != (int)args[1]) copy_fd(table, pool, tid, (int)args[0], (int)ret, 0);
+        break;
+    case __NR_dup3:
+        if (ret >= 0) copy_fd(table, pool, tid, (int)args[0], (int)ret, (args[2] & O_CLOEXEC) != 0);
+        break;
+    case __NR_fcntl:
+        if (ret < 0) break;
+        if ((int)args[1] == F_DUPFD || (int)args[1] == F_DUPFD_CLOEXEC) {
+            copy_fd(table, pool, tid, (int)args[0], (int)ret, (int)args[1] == F_DUPFD_CLOEXEC);
+        } else if ((int)args[1] == F_SETFD) {
+            uint32_t entry = fd_table_get(table, (int)args[0]);
+            if (entry) {
+                fd_table_set(table, (int)args[0], entry & FD_ENTRY_ID_MASK, (args[2] & FD_CLOEXEC) != 0);
+            }
+        }
+        break;
+    case __NR_close:
+        // 除EBADF外，即使返回错误（如EINTR）fd也已经关闭
+        if (ret != -EBADF) fd_table_clear(table, (int)args[0]);
+        break;
+    case __NR_close_range: {
+        if (ret != 0) break;
+        if (args[2] & CLOSE_RANGE_UNSHARE) {
+            table = *tablep = fd_table_unshare(table);
+        }
+        unsigned long last = args[1] < (unsigned long)table->size ? args[1] : (unsigned long)table->size - 1;
+        for (unsigned long fd = args[0]; table->size > 0 && fd <= last; fd++) {
+            if (args[2] & CLOSE_RANGE_CLOEXEC) {
+                if (table->entries[fd]) table->entries[fd] |= FD_ENTRY_CLOEXEC;
+            } else {
+                table->entries[fd] = 0;
+            }
+        }
+        break;
+    }
+    // 其他创建fd的系统调用：清掉可能残留的旧表项，第一次用到时再从/proc读取
+    case __NR_epoll_create:
+    case __NR_epoll_create1:
+    case __NR_eventfd:
+    case __NR_eventfd2:
+    case __NR_signalfd:
+    case __NR_signalfd4:
+    case __NR_timerfd_create:
+    case __NR_inotify_init:
+    case __NR_inotify_init1:
+    case __NR_memfd_create:
+    case __NR_userfaultfd:
+    case __NR_perf_event_open:
+    case __NR_pidfd_open:
+    case __NR_pidfd_getfd:
+    case __NR_fanotify_init:
+    case __NR_open_by_handle_at:
+        if (ret >= 0) fd_table_clear(table, (int)ret);
+        break;
+    default:
+        break;
+    }
+}
+
+// 把入口参数中各fd的描述附加到参数块（格式化时显示为fd<描述>）
+void fd_track_annotate(fd_table_t *table, string_pool_t *pool, pid_t tid, int syscall_nr,
+                       const unsigned long *args, arg_capture_t *capture) {
+    const syscall_desc_t *desc = get_syscall_desc(SYSCALL_ABI_NATIVE, syscall_nr);
+    if (!table || !desc) {
+        return;
+    }
+    for (int i = 0; i < desc->argc; i++) {
+        int type = desc->args[i].type;
+        if (type != ARG_FD && type != ARG_DIRFD) {
+            continue;
+        }
+        uint32_t id = fd_table_describe(table, pool, tid, (int)args[i]);
+        if (id == 0) {
+            continue;
+        }
+        const char *str = string_pool_get(pool, id);
+        size_t len = strlen(str);
+        char *data = arg_blob_append(capture, i, type, len);
+        if (data) {
+            memcpy(data, str, len);
+        }
+    }
+}
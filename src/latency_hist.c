@@ -0,0 +1,85 @@
+// src/latency_hist.c
+#include "sandbox.h"
+
+// 系统调用延迟直方图。平均值会掩盖长尾（sleep规避、大量I/O），
+// 因此按固定大小的对数-线性分桶记录，统计时给出分位数
+
+static inline int lat_hist_index(uint64_t ns) {
+    if (ns < 2 * LAT_HIST_SUB_COUNT) {
+        return (int)ns;
+    }
+
+    int msb = 63 - __builtin_clzll(ns);
+    if (msb >= LAT_HIST_MAX_BITS) {
+        return LAT_HIST_BUCKETS - 1;
+    }
+    int shift = msb - LAT_HIST_SUB_BITS;
+    return (shift + 1) * LAT_HIST_SUB_COUNT + (int)((ns >> shift) - LAT_HIST_SUB_COUNT);
+}
+
+// 分桶覆盖范围的上界（该格中最大的值）
+static inline uint64_t lat_hist_bucket_value(int index) {
+    if (index < 2 * LAT_HIST_SUB_COUNT) {
+        return (uint64_t)index;
+    }
+    int shift = index / LAT_HIST_SUB_COUNT - 1;
+    uint64_t sub = (uint64_t)(index % LAT_HIST_SUB_COUNT + LAT_HIST_SUB_COUNT);
+    return ((sub + 1) << shift) - 1;
+}
+
+void latency_hist_record(latency_hist_t *hist, uint64_t ns) {
+    hist->buckets[lat_hist_index(ns)]++;
+    hist->count++;
+    hist->total_ns += ns;
+    if (ns > hist->max_ns) {
+        hist->max_ns = ns;
+    }
+}
+
+// 把另一个直方图（另一个跟踪线程的同类调用）并入hist，分桶相同，合并后的分位数是精确的
+void latency_hist_merge(latency_hist_t *hist, const latency_hist_t *other) {
+    if (other->count == 0) {
+        return;
+    }
+    for (int i = 0; i < LAT_HIST_BUCKETS; i++) {
+        hist->buckets[i] += other->buckets[i];
+    }
+    hist->count += other->count;
+    hist->total_ns += other->total_ns;
+    if (other->max_ns > hist->max_ns) {
+        hist->max_ns = other->max_ns;
+    }
+}
+
+// 返回percentile（0-100）分位数所在分桶的上界，不超过实际最大值
+uint64_t latency_hist_percentile(const latency_hist_t *hist, double percentile) {
+    if (hist->count == 0) {
+        return 0;
+    }
+
+    uint64_t rank = (uint64_t)(percentile / 100.0 * (double)hist->count + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > hist->count) rank = hist->count;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < LAT_HIST_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen >= rank) {
+            uint64_t value = lat_hist_bucket_value(i);
+            return value < hist->max_ns ? value : hist->max_ns;
+        }
+    }
+    return hist->max_ns;
+}
+
+// 输出一行系统调用统计（监控日志和malbox-decode共用同一格式）
+void print_latency_stats(FILE *fp, const char *label, int syscall_nr, const latency_hist_t *hist) {
+    fprintf(fp, "%-20s (#%d): %llu 次调用, 总执行时间: %.1f us, 平均: %.2f us, "
+            "p50/p90/p99/max: %.2f/%.2f/%.2f/%.2f us\n",
+            label, syscall_nr, (unsigned long long)hist->count, (double)hist->total_ns / 1e3,
+            (double)hist->total_ns / 1e3 / (double)hist->count,
+            (double)latency_hist_percentile(hist, 50) / 1e3,
+            (double)latency_hist_percentile(hist, 90) / 1e3,
+            (double)latency_hist_percentile(hist, 99) / 1e3,
+            (double)hist->max_ns / 1e3);
+}
@@ -14,58 +14,42 @@ int main(int argc, char *argv[]) {
 
     // 处理命令行参数
     int ret = parse_arguments(argc, argv, &config);
-    if (ret != 0) {
+    if (ret != 0 || (!config.binary_path && !config.batch_source)) {
+        policy_free(config.policy);
         return ret; // 参数处理中已经输出了错误或帮助信息
     }
 
-    // 打印文件类型信息
-    print_file_info(config.binary_path);
-
-    // 分配子进程栈
-    char *stack = malloc(STACK_SIZE);
-    if (!stack) {
-        perror("栈内存分配失败");
-        cleanup_config(&config);
-        return EXIT_FAILURE;
-    }
-
-    // 创建带有命名空间的子进程
-    int flags = CLONE_NEWUSER | CLONE_NEWPID | CLONE_NEWIPC | CLONE_NEWUTS | CLONE_NEWNET | SIGCHLD;
-    printf("创建带有命名空间的沙箱...\n");
-    pid_t pid = clone(child_func, stack + STACK_SIZE, flags, &config);
-
-    if (pid == -1) {
-        perror("创建子进程失败");
-        free(stack);
-        cleanup_config(&config);
-        return EXIT_FAILURE;
+    // 一个sinkhole进程服务本次运行的所有沙箱
+    if (config.sinkhole) {
+        char log_path[PATH_MAX];
+        if (config.sinkhole_log) {
+            snprintf(log_path, sizeof(log_path), "%s", config.sinkhole_log);
+        } else {
+            snprintf(log_path, sizeof(log_path), "/tmp/malbox_sinkhole_%d.log", getpid());
+        }
+        config.sinkhole_pid = sinkhole_start(log_path, &config.sinkhole_fd);
+        if (config.sinkhole_pid == -1) {
+            cleanup_config(&config);
+            policy_free(config.policy);
+            return EXIT_FAILURE;
+        }
+        printf("sinkhole已启动，日志文件: %s\n", log_path);
     }
 
-    printf("沙箱进程已启动，PID: %d\n", pid);
-
-    // 设置用户命名空间映射
-    if (setup_user_namespace(pid) != 0) {
-        printf("警告: 用户命名空间设置不完整\n");
-    }
-
-    // 启动系统调用监控
-    printf("启动系统调用监控...\n");
-    setup_monitoring(pid);
-
-    // 等待子进程
-    int status;
-    printf("等待沙箱进程完成...\n");
-    waitpid(pid, &status, 0);
-
-    if (WIFEXITED(status)) {
-        printf("沙箱进程退出，状态码: %d\n", WEXITSTATUS(status));
-    } else if (WIFSIGNALED(status)) {
-        printf("沙箱进程被信号终止: %d\n", WTERMSIG(status));
+    // 批量模式：由工作池调度多个样本
+    if (config.batch_source) {
+        ret = run_batch(&config);
+    } else {
+        sandbox_result result;
+        ret = run_sandbox(&config, &result);
     }
 
     // 清理资源
-    free(stack);
+    if (config.sinkhole) {
+        sinkhole_stop(config.sinkhole_pid, config.sinkhole_fd);
+    }
     cleanup_config(&config);
+    policy_free(config.policy);
 
-    return 0;
-}
\ No newline at end of file
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
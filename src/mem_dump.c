@@ -0,0 +1,365 @@
+// src/mem_dump.c
+#include "sandbox.h"
+
+// 可执行内存转储。可执行区域从/proc/<tid>/maps中找出，一批区域用一次process_vm_readv读入
+// 缓冲区（read_tracee_batch，只有执行权限的区域经/proc/<tid>/mem每个一次补读）。
+// 每页算一个64位FNV哈希，与上次快照逐页比较，看出解密循环改写了哪些页；FNV可以被样本构造碰撞，
+// 只用来判断变化。转储文件以内容的SHA-256命名，同一内容（如多个进程中的同一段解密代码）只写一次
+
+#define FNV_OFFSET 14695981039346656037ull
+#define FNV_PRIME 1099511628211ull
+
+// 一个待读取的区域
+typedef struct {
+    unsigned long start;
+    unsigned long end;
+} dump_range_t;
+
+static size_t dump_page_size(void) {
+    static size_t page_size = 0;
+    if (page_size == 0) {
+        long ret = sysconf(_SC_PAGESIZE);
+        page_size = ret > 0 ? (size_t)ret : 4096;
+    }
+    return page_size;
+}
+
+// 页哈希：从每次运行随机的初值开始按8字节字做FNV-1a式的混合，*zero返回该页是否全为零
+static uint64_t hash_page(uint64_t seed, const unsigned char *data, size_t len, int *zero) {
+    uint64_t hash = FNV_OFFSET ^ seed;
+    uint64_t any = 0;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        any |= word;
+        hash = (hash ^ word) * FNV_PRIME;
+    }
+    for (; i < len; i++) {
+        any |= data[i];
+        hash = (hash ^ data[i]) * FNV_PRIME;
+    }
+    *zero = any == 0;
+    return hash;
+}
+
+// 创建本次运行的转储目录和索引文件
+int mem_dump_open(mem_dump_t *dump, const char *dir) {
+    memset(dump, 0, sizeof(*dump));
+    snprintf(dump->dir, sizeof(dump->dir), "%s", dir);
+    if (mkdir(dump->dir, 0700) == -1 && errno != EEXIST) {
+        perror("创建内存转储目录失败");
+        return -1;
+    }
+    if (getrandom(&dump->page_seed, sizeof(dump->page_seed), 0) != sizeof(dump->page_seed)) {
+        dump->page_seed = (uint64_t)trace_timestamp_ns() * FNV_PRIME;
+    }
+    char path[PATH_MAX + 32];
+    snprintf(path, sizeof(path), "%s/index.txt", dump->dir);
+    dump->index = fopen(path, "we");
+    if (!dump->index) {
+        perror("创建内存转储索引失败");
+        return -1;
+    }
+    fprintf(dump->index, "# tid 触发事件 起始-结束 页数 变化页数 内容哈希 结果\n");
+    return 0;
+}
+
+// 收集与[start, end)重叠的可执行映射，截取到该范围。anon_only时跳过文件映射：
+// 动态链接器映射的库代码和磁盘上的文件相同，没有转储的必要
+static int collect_exec_ranges(pid_t tid, unsigned long start, unsigned long end, int anon_only,
+                               dump_range_t *ranges, int max_ranges) {
+    char path[64], line[PATH_MAX + 128];
+    snprintf(path, sizeof(path), "/proc/%d/maps", tid);
+    FILE *fp = fopen(path, "re");
+    if (!fp) {
+        return 0;
+    }
+
+    int count = 0;
+    while (count < max_ranges && fgets(line, sizeof(line), fp)) {
+        unsigned long map_start, map_end, inode;
+        char perms[8];
+        int name_offset = 0;
+        if (sscanf(line, "%lx-%lx %7s %*s %*s %lu %n", &map_start, &map_end, perms, &inode, &name_offset) < 4 ||
+            perms[2] != 'x' || map_end <= start || map_start >= end) {
+            continue;
+        }
+        // vsyscall页不能被读取，vDSO和vvar由内核提供
+        const char *name = line + name_offset;
+        if (strncmp(name, "[vsyscall]", 10) == 0 || strncmp(name, "[vdso]", 6) == 0 ||
+            strncmp(name, "[vvar", 5) == 0 || (anon_only && inode != 0)) {
+            continue;
+        }
+        ranges[count].start = map_start > start ? map_start : start;
+        ranges[count].end = map_end < end ? map_end : end;
+        if (ranges[count].end - ranges[count].start > MEM_DUMP_BUFFER) {
+            ranges[count].end = ranges[count].start + MEM_DUMP_BUFFER;
+        }
+        count++;
+    }
+    fclose(fp);
+    return count;
+}
+
+static mem_dump_tracked_t *find_tracked(mem_dump_cache_t *cache, pid_t tgid, unsigned long start,
+                                        unsigned long end) {
+    for (int i = 0; i < MEM_DUMP_TRACKED; i++) {
+        mem_dump_tracked_t *tracked = &cache->tracked[i];
+        if (tracked->pid == tgid && tracked->start == start && tracked->end == end) {
+            return tracked;
+        }
+    }
+    return NULL;
+}
+
+static void forget_tracked(mem_dump_tracked_t *tracked) {
+    free(tracked->page_hashes);
+    memset(tracked, 0, sizeof(*tracked));
+}
+
+// 取一个空槽位，没有时按轮转覆盖
+static mem_dump_tracked_t *new_tracked(mem_dump_cache_t *cache) {
+    for (int i = 0; i < MEM_DUMP_TRACKED; i++) {
+        if (cache->tracked[i].pid == 0) {
+            return &cache->tracked[i];
+        }
+    }
+    mem_dump_tracked_t *tracked = &cache->tracked[cache->next_slot];
+    cache->next_slot = (cache->next_slot + 1) % MEM_DUMP_TRACKED;
+    forget_tracked(tracked);
+    return tracked;
+}
+
+// 以内容的SHA-256为文件名写入。多个跟踪线程可能同时保存同一内容，先写入临时文件，
+// 写完后再link到最终文件名：文件已存在说明同样的内容已经保存过，也不会有人读到写了一半的文件
+static int store_region(mem_dump_t *dump, const unsigned char *digest, const char *data, size_t len) {
+    char path[PATH_MAX + 80], tmp[PATH_MAX + 16], hex[SHA256_HEX_LEN];
+    sha256_hex(digest, hex);
+    snprintf(path, sizeof(path), "%s/%s.bin", dump->dir, hex);
+    if (access(path, F_OK) == 0) {
+        return MEM_DUMP_DUPLICATE;
+    }
+    snprintf(tmp, sizeof(tmp), "%s/.tmp.XXXXXX", dump->dir);
+    int fd = mkostemp(tmp, O_CLOEXEC);
+    if (fd == -1) {
+        perror("写入内存转储失败");
+        return MEM_DUMP_UNREADABLE;
+    }
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = write(fd, data + done, len - done);
+        if (n <= 0) {
+            if (n == -1 && errno == EINTR) continue;
+            perror("写入内存转储失败");
+            break;
+        }
+        done += (size_t)n;
+    }
+    close(fd);
+
+    int status = MEM_DUMP_UNREADABLE;
+    if (done == len) {
+        if (link(tmp, path) == 0) {
+            status = MEM_DUMP_STORED;
+        } else if (errno == EEXIST) {
+            status = MEM_DUMP_DUPLICATE;
+        } else {
+            perror("写入内存转储失败");
+        }
+    }
+    unlink(tmp);
+    if (status == MEM_DUMP_STORED) {
+        __atomic_fetch_add(&dump->stored, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&dump->stored_bytes, len, __ATOMIC_RELAXED);
+    }
+    return status;
+}
+
+// 对读出的一个区域计算页哈希，与上次快照比较后决定是否写入。
+// 只有写入成功、内容已存在或全为零页时才记住页哈希，写入失败的区域下次还会被当作有变化
+static void process_region(mem_dump_t *dump, mem_dump_cache_t *cache, pid_t tgid, const char *data,
+                           size_t len, mem_dump_region_t *region) {
+    size_t page_size = dump_page_size();
+    int pages = (int)((len + page_size - 1) / page_size);
+    uint64_t *hashes = malloc((size_t)pages * sizeof(*hashes));
+    if (!hashes) {
+        region->status = MEM_DUMP_UNREADABLE;
+        return;
+    }
+
+    int all_zero = 1;
+    for (int i = 0; i < pages; i++) {
+        size_t offset = (size_t)i * page_size;
+        size_t chunk = len - offset < page_size ? len - offset : page_size;
+        int zero;
+        hashes[i] = hash_page(dump->page_seed, (const unsigned char *)data + offset, chunk, &zero);
+        all_zero &= zero;
+    }
+    region->pages = pages;
+
+    mem_dump_tracked_t *tracked = find_tracked(cache, tgid, region->start, region->end);
+    region->changed_pages = pages;
+    if (tracked && tracked->pages == pages) {
+        region->changed_pages = 0;
+        for (int i = 0; i < pages; i++) {
+            region->changed_pages += tracked->page_hashes[i] != hashes[i];
+        }
+    }
+
+    if (region->changed_pages == 0) {
+        region->status = MEM_DUMP_UNCHANGED;
+        __atomic_fetch_add(&dump->unchanged, 1, __ATOMIC_RELAXED);
+        free(hashes);
+        return;
+    }
+    if (all_zero) {
+        region->status = MEM_DUMP_EMPTY;
+    } else {
+        sha256(data, len, region->digest);
+        region->status = store_region(dump, region->digest, data, len);
+        if (region->status == MEM_DUMP_DUPLICATE) {
+            __atomic_fetch_add(&dump->duplicates, 1, __ATOMIC_RELAXED);
+        } else if (region->status != MEM_DUMP_STORED) {
+            // 不记页哈希，但保留范围，进程退出前的重新检查会再试一次
+            free(hashes);
+            hashes = NULL;
+            pages = 0;
+        }
+    }
+
+    if (!tracked) {
+        tracked = new_tracked(cache);
+    }
+    free(tracked->page_hashes);
+    tracked->pid = tgid;
+    tracked->start = region->start;
+    tracked->end = region->end;
+    tracked->page_hashes = hashes;
+    tracked->pages = pages;
+}
+
+// 读取一批区域并逐个处理，总大小不超过缓冲区
+static void snapshot_batch(mem_dump_t *dump, mem_dump_cache_t *cache, pid_t tgid, pid_t tid,
+                           mem_dump_region_t *regions, int count) {
+    tracee_read_t reads[MEM_DUMP_BATCH];
+    size_t offset = 0;
+    for (int i = 0; i < count; i++) {
+        reads[i].addr = regions[i].start;
+        reads[i].buf = cache->buf + offset;
+        reads[i].len = regions[i].end - regions[i].start;
+        offset += reads[i].len;
+    }
+    read_tracee_batch(tid, reads, count);
+
+    for (int i = 0; i < count; i++) {
+        __atomic_fetch_add(&dump->snapshots, 1, __ATOMIC_RELAXED);
+        if (reads[i].result <= 0) {
+            regions[i].status = MEM_DUMP_UNREADABLE;
+            continue;
+        }
+        // 只读到一部分（后面的页已被解除映射）时按实际读到的范围处理，
+        // 不把截断内容的页哈希记在完整的范围上
+        regions[i].end = regions[i].start + (unsigned long)reads[i].result;
+        process_region(dump, cache, tgid, reads[i].buf, (size_t)reads[i].result, &regions[i]);
+    }
+}
+
+// 对一个进程做一次快照，结果写入regions并记入索引，返回区域数。
+// tgid用来关联同一进程的前后快照，tid用来读取（线程组leader可能已经退出）。
+// MEM_DUMP_EXEC忽略范围，取新映像的所有可执行区域；MEM_DUMP_RESCAN重新读取该进程
+// 转储过的区域，之后不再记住它们（进程即将退出或被新映像取代）。
+// cache属于调用的跟踪线程，一个进程的快照总是用同一个cache
+int mem_dump_snapshot(mem_dump_t *dump, mem_dump_cache_t *cache, pid_t tgid, pid_t tid, int trigger,
+                      unsigned long start, unsigned long end, mem_dump_region_t *regions, int max_regions) {
+    dump_range_t ranges[MEM_DUMP_BATCH];
+    int count = 0;
+    if (max_regions > MEM_DUMP_BATCH) {
+        max_regions = MEM_DUMP_BATCH;
+    }
+    if (!cache->buf) {
+        cache->buf = malloc(MEM_DUMP_BUFFER);
+        if (!cache->buf) {
+            perror("内存分配失败");
+            return 0;
+        }
+    }
+
+    if (trigger == MEM_DUMP_RESCAN) {
+        for (int i = 0; i < MEM_DUMP_TRACKED && count < max_regions; i++) {
+            if (cache->tracked[i].pid == tgid) {
+                ranges[count].start = cache->tracked[i].start;
+                ranges[count].end = cache->tracked[i].end;
+                count++;
+            }
+        }
+    } else {
+        if (trigger == MEM_DUMP_EXEC) {
+            // 旧映像的区域随execve一起消失
+            for (int i = 0; i < MEM_DUMP_TRACKED; i++) {
+                if (cache->tracked[i].pid == tgid) {
+                    forget_tracked(&cache->tracked[i]);
+                }
+            }
+            start = 0;
+            end = ~0ul;
+        }
+        int anon_only = trigger == MEM_DUMP_MMAP || trigger == MEM_DUMP_MREMAP;
+        count = collect_exec_ranges(tid, start, end, anon_only, ranges, max_regions);
+    }
+
+    // 按缓冲区大小分批，每批一次process_vm_readv
+    int batch_start = 0;
+    size_t batch_bytes = 0;
+    for (int i = 0; i <= count; i++) {
+        size_t len = i < count ? ranges[i].end - ranges[i].start : 0;
+        if (i == count || batch_bytes + len > MEM_DUMP_BUFFER) {
+            if (i > batch_start) {
+                snapshot_batch(dump, cache, tgid, tid, regions + batch_start, i - batch_start);
+            }
+            batch_start = i;
+            batch_bytes = 0;
+        }
+        if (i < count) {
+            memset(&regions[i], 0, sizeof(regions[i]));
+            regions[i].start = ranges[i].start;
+            regions[i].end = ranges[i].end;
+            batch_bytes += len;
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        const mem_dump_region_t *region = &regions[i];
+        char hex[SHA256_HEX_LEN] = "-";
+        if (region->status == MEM_DUMP_STORED || region->status == MEM_DUMP_DUPLICATE) {
+            sha256_hex(region->digest, hex);
+        }
+        fprintf(dump->index, "%d %s %lx-%lx %d %d %s %s\n", tid, mem_dump_trigger_name(trigger),
+                region->start, region->end, region->pages, region->changed_pages, hex,
+                mem_dump_status_name(region->status));
+    }
+
+    if (trigger == MEM_DUMP_RESCAN) {
+        for (int i = 0; i < MEM_DUMP_TRACKED; i++) {
+            if (cache->tracked[i].pid == tgid) {
+                forget_tracked(&cache->tracked[i]);
+            }
+        }
+    }
+    return count;
+}
+
+void mem_dump_cache_free(mem_dump_cache_t *cache) {
+    for (int i = 0; i < MEM_DUMP_TRACKED; i++) {
+        free(cache->tracked[i].page_hashes);
+    }
+    free(cache->buf);
+    memset(cache, 0, sizeof(*cache));
+}
+
+void mem_dump_close(mem_dump_t *dump) {
+    if (dump->index) {
+        fclose(dump->index);
+    }
+    dump->index = NULL;
+}
@@ -0,0 +1,232 @@
+// src/ngram.c
+#include "sandbox.h"
+
+// 系统调用序列的n-gram画像，用于样本聚类。
+// 每个线程保留最近n-1个系统调用，与当前调用组成一个n-gram；
+// 计数用count-min sketch（保守更新），内存固定，与跟踪长度无关；
+// 同时维护估计计数最高的K个候选，结束时输出top-K；
+// MinHash签名用单次哈希分桶（one permutation hashing），每次更新只算一次哈希
+
+#define NGRAM_TOKEN_BITS 11                     // 每个系统调用占的位数：1位ABI + 10位调用号
+#define NGRAM_TOKEN_OTHER 0x3ff                 // 超出范围的调用号
+#define NGRAM_TOKEN_MASK ((1u << NGRAM_TOKEN_BITS) - 1)
+#define NGRAM_CMS_MASK (NGRAM_CMS_WIDTH - 1)
+#define MINHASH_BUCKET_SHIFT 58                 // 哈希高6位选桶（MINHASH_SIZE为64）
+#define MINHASH_SEED 0x9e3779b97f4a7c15ull
+
+// splitmix64的终结函数
+static inline uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+void ngram_init(ngram_profile_t *profile, int n, int top_k) {
+    memset(profile, 0, sizeof(*profile));
+    profile->n = n;
+    profile->top_k = top_k;
+    for (int i = 0; i < MINHASH_SIZE; i++) {
+        profile->minhash[i] = UINT64_MAX;
+    }
+}
+
+static inline uint16_t ngram_token(int abi, int nr) {
+    uint16_t token = nr >= 0 && nr < NGRAM_TOKEN_OTHER ? (uint16_t)nr : NGRAM_TOKEN_OTHER;
+    return abi == SYSCALL_ABI_COMPAT ? (uint16_t)(token | (1u << (NGRAM_TOKEN_BITS - 1))) : token;
+}
+
+// count-min sketch的保守更新：只增加等于最小值的计数器，返回更新后的估计值。
+// 各行的下标由两个哈希线性组合得到
+static uint32_t sketch_update(ngram_profile_t *profile, uint64_t key) {
+    uint64_t h1 = mix64(key);
+    uint64_t h2 = mix64(key ^ MINHASH_SEED) | 1;
+    uint32_t *cells[NGRAM_CMS_DEPTH];
+    uint32_t estimate = UINT32_MAX;
+    for (int i = 0; i < NGRAM_CMS_DEPTH; i++) {
+        cells[i] = &profile->sketch[i][(h1 + (uint64_t)i * h2) & NGRAM_CMS_MASK];
+        if (*cells[i] < estimate) estimate = *cells[i];
+    }
+    if (estimate < UINT32_MAX) estimate++;
+    for (int i = 0; i < NGRAM_CMS_DEPTH; i++) {
+        if (*cells[i] < estimate) *cells[i] = estimate;
+    }
+    return estimate;
+}
+
+// 更新top-K候选：已在候选中的刷新计数，否则在超过最小候选时替换它
+static void top_update(ngram_profile_t *profile, uint64_t key, uint32_t count) {
+    int min_index = 0;
+    for (int i = 0; i < profile->top_count; i++) {
+        if (profile->top[i].key == key) {
+            profile->top[i].count = count;
+            return;
+        }
+        if (profile->top[i].count < profile->top[min_index].count) {
+            min_index = i;
+        }
+    }
+    if (profile->top_count < profile->top_k) {
+        profile->top[profile->top_count].key = key;
+        profile->top[profile->top_count].count = count;
+        profile->top_count++;
+    } else if (count > profile->top[min_index].count) {
+        profile->top[min_index].key = key;
+        profile->top[min_index].count = count;
+    }
+}
+
+// 线程执行了一次系统调用：history/len为该线程最近的调用
+void ngram_push(ngram_profile_t *profile, uint16_t *history, uint8_t *len, int abi, int nr) {
+    int n = profile->n;
+    uint16_t token = ngram_token(abi, nr);
+
+    if (*len == n - 1) {
+        uint64_t key = 0;
+        for (int i = 0; i < n - 1; i++) {
+            key = (key << NGRAM_TOKEN_BITS) | history[i];
+        }
+        key = (key << NGRAM_TOKEN_BITS) | token;
+
+        profile->total++;
+        top_update(profile, key, sketch_update(profile, key));
+
+        uint64_t h = mix64(key ^ MINHASH_SEED);
+        uint64_t *slot = &profile->minhash[h >> MINHASH_BUCKET_SHIFT];
+        uint64_t value = h << (64 - MINHASH_BUCKET_SHIFT);
+        if (value < *slot) *slot = value;
+
+        memmove(history, history + 1, (size_t)(n - 2) * sizeof(history[0]));
+        history[n - 2] = token;
+    } else {
+        history[(*len)++] = token;
+    }
+}
+
+// 当前sketch对key的估计值（各行计数的最小值）
+static uint32_t sketch_estimate(const ngram_profile_t *profile, uint64_t key) {
+    uint64_t h1 = mix64(key);
+    uint64_t h2 = mix64(key ^ MINHASH_SEED) | 1;
+    uint32_t estimate = UINT32_MAX;
+    for (int i = 0; i < NGRAM_CMS_DEPTH; i++) {
+        uint32_t cell = profile->sketch[i][(h1 + (uint64_t)i * h2) & NGRAM_CMS_MASK];
+        if (cell < estimate) estimate = cell;
+    }
+    return estimate;
+}
+
+// 并入另一个跟踪线程的画像（n相同）。sketch逐格相加，估计值仍是真实计数的上界；
+// 两边的top候选按合并后的sketch重新估计；MinHash逐桶取最小值，与在一个画像中统计的结果相同
+void ngram_merge(ngram_profile_t *profile, const ngram_profile_t *other) {
+    if (other->total == 0) {
+        return;
+    }
+    profile->total += other->total;
+    for (int i = 0; i < NGRAM_CMS_DEPTH; i++) {
+        for (int j = 0; j < NGRAM_CMS_WIDTH; j++) {
+            uint64_t sum = (uint64_t)profile->sketch[i][j] + other->sketch[i][j];
+            profile->sketch[i][j] = sum > UINT32_MAX ? UINT32_MAX : (uint32_t)sum;
+        }
+    }
+    for (int i = 0; i < MINHASH_SIZE; i++) {
+        if (other->minhash[i] < profile->minhash[i]) {
+            profile->minhash[i] = other->minhash[i];
+        }
+    }
+
+    ngram_entry_t candidates[2 * NGRAM_TOP_MAX];
+    int count = profile->top_count;
+    memcpy(candidates, profile->top, (size_t)count * sizeof(candidates[0]));
+    memcpy(candidates + count, other->top, (size_t)other->top_count * sizeof(candidates[0]));
+    count += other->top_count;
+    profile->top_count = 0;
+    for (int i = 0; i < count; i++) {
+        top_update(profile, candidates[i].key, sketch_estimate(profile, candidates[i].key));
+    }
+}
+
+static int compare_entries(const void *a, const void *b) {
+    const ngram_entry_t *x = a, *y = b;
+    if (x->count != y->count) return x->count < y->count ? 1 : -1;
+    return x->key < y->key ? -1 : x->key > y->key;
+}
+
+// 按估计计数从高到低输出top-K，返回条目数
+int ngram_sorted_top(const ngram_profile_t *profile, ngram_entry_t *out) {
+    memcpy(out, profile->top, (size_t)profile->top_count * sizeof(out[0]));
+    qsort(out, (size_t)profile->top_count, sizeof(out[0]), compare_entries);
+    return profile->top_count;
+}
+
+// MinHash签名：每个桶的最小值取高32位；空桶按轮转致密化（densification）
+// 借用后面第一个非空桶的值，保证两个样本的签名可逐位比较。没有任何n-gram时返回-1
+int ngram_minhash_signature(const ngram_profile_t *profile, uint32_t *signature) {
+    if (profile->total == 0) {
+        return -1;
+    }
+    for (int i = 0; i < MINHASH_SIZE; i++) {
+        int j = i;
+        while (profile->minhash[j] == UINT64_MAX) {
+            j = (j + 1) % MINHASH_SIZE;
+        }
+        // 借来的值与距离混合，避免相邻空桶取到相同的值
+        uint64_t value = profile->minhash[j];
+        signature[i] = (uint32_t)((j == i ? value : mix64(value + (uint64_t)(j - i + MINHASH_SIZE))) >> 32);
+    }
+    return 0;
+}
+
+// n-gram中第i个系统调用的名称
+const char *ngram_token_name(uint64_t key, int n, int i, int *compat) {
+    uint16_t token = (uint16_t)((key >> (NGRAM_TOKEN_BITS * (n - 1 - i))) & NGRAM_TOKEN_MASK);
+    int nr = token & NGRAM_TOKEN_OTHER;
+    *compat = (token >> (NGRAM_TOKEN_BITS - 1)) & 1;
+    return nr == NGRAM_TOKEN_OTHER ? "?" :
+           get_syscall_name_abi(*compat ? SYSCALL_ABI_COMPAT : SYSCALL_ABI_NATIVE, nr);
+}
+
+// 把n-gram格式化为"openat -> read -> close"
+void ngram_format_key(uint64_t key, int n, char *out, size_t outlen) {
+    size_t pos = 0;
+    out[0] = '\0';
+    for (int i = 0; i < n && pos < outlen; i++) {
+        int compat;
+        const char *name = ngram_token_name(key, n, i, &compat);
+        int written = snprintf(out + pos, outlen - pos, "%s%s%s", i > 0 ? " -> " : "",
+                               compat ? "i386:" : "", name);
+        if (written < 0) break;
+        pos += (size_t)written;
+    }
+}
+
+void print_ngram_entry(FILE *fp, int rank, uint64_t key, int n, uint64_t count, uint64_t total) {
+    char label[256];
+    ngram_format_key(key, n, label, sizeof(label));
+    fprintf(fp, "%3d. %-60s ~%llu (%.1f%%)\n", rank, label, (unsigned long long)count,
+            total ? 100.0 * (double)count / (double)total : 0.0);
+}
+
+void print_minhash_signature(FILE *fp, const uint32_t *signature, int count) {
+    fprintf(fp, "MinHash签名 (%d x 32位): ", count);
+    for (int i = 0; i < count; i++) {
+        fprintf(fp, "%08x", signature[i]);
+    }
+    fputc('\n', fp);
+}
+
+void print_ngram_profile(FILE *fp, const ngram_profile_t *profile) {
+    ngram_entry_t top[NGRAM_TOP_MAX];
+    int count = ngram_sorted_top(profile, top);
+    fprintf(fp, "\n===== 系统调用序列 (%d-gram, 共 %llu 个，计数为估计值) =====\n", profile->n,
+            (unsigned long long)profile->total);
+    for (int i = 0; i < count; i++) {
+        print_ngram_entry(fp, i + 1, top[i].key, profile->n, top[i].count, profile->total);
+    }
+
+    uint32_t signature[MINHASH_SIZE];
+    if (ngram_minhash_signature(profile, signature) == 0) {
+        print_minhash_signature(fp, signature, MINHASH_SIZE);
+    }
+}
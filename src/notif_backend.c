@@ -0,0 +1,113 @@
+// src/notif_backend.c
+#include "sandbox.h"
+#include <sys/ioctl.h>
+#include <sys/ptrace.h>
+#include <linux/seccomp.h>
+
+// seccomp用户通知后端的底层操作：监听fd的交接和通知的接收、校验、回复。
+// ioctl编号中编码了结构大小，直接使用头文件中的结构即可，
+// 接收缓冲区在每次接收前必须清零
+
+// 取得沙箱的监听fd。沙箱用PTRACE_TRACEME停在初始停止，监控进程用系统调用停止跟到
+// 安装过滤器的seccomp调用退出处，此时监听fd已存在、沙箱还没有执行下一个系统调用，
+// 用pidfd_getfd（5.6及以上内核）复制过来后脱离。过滤器中没有为交接留下任何例外
+int notif_fetch_listener(pid_t pid, int pidfd) {
+    int status;
+    if (waitpid(pid, &status, 0) != pid || !WIFSTOPPED(status)) {
+        fprintf(stderr, "沙箱进程没有到达初始停止\n");
+        return -1;
+    }
+    if (ptrace(PTRACE_SETOPTIONS, pid, 0, PTRACE_O_TRACESYSGOOD | PTRACE_O_EXITKILL) == -1) {
+        perror("设置ptrace选项失败");
+        return -1;
+    }
+
+    struct __ptrace_syscall_info info;
+    int in_filter = 0, sig = 0;
+    for (;;) {
+        if (ptrace(PTRACE_SYSCALL, pid, 0, sig) == -1) {
+            perror("恢复沙箱进程失败");
+            return -1;
+        }
+        if (waitpid(pid, &status, 0) != pid || !WIFSTOPPED(status)) {
+            fprintf(stderr, "沙箱进程在安装seccomp过滤器之前退出\n");
+            return -1;
+        }
+        // 信号停止把信号原样交还
+        sig = WSTOPSIG(status) == (SIGTRAP | 0x80) ? 0 : WSTOPSIG(status);
+        if (sig != 0) continue;
+        if (ptrace(PTRACE_GET_SYSCALL_INFO, pid, sizeof(info), &info) <= 0) {
+            perror("PTRACE_GET_SYSCALL_INFO失败");
+            return -1;
+        }
+        if (info.op == PTRACE_SYSCALL_INFO_ENTRY) {
+            in_filter = info.entry.nr == __NR_seccomp &&
+                        info.entry.args[0] == SECCOMP_SET_MODE_FILTER &&
+                        (info.entry.args[1] & SECCOMP_FILTER_FLAG_NEW_LISTENER);
+        } else if (info.op == PTRACE_SYSCALL_INFO_EXIT && in_filter) {
+            break;
+        }
+    }
+
+    int listener = -1;
+    if (info.exit.is_error) {
+        fprintf(stderr, "沙箱进程安装seccomp过滤器失败\n");
+    } else {
+        listener = (int)syscall(SYS_pidfd_getfd, pidfd, (int)info.exit.rval, 0);
+        if (listener == -1) {
+            perror("pidfd_getfd取得seccomp监听fd失败");
+        }
+    }
+    if (ptrace(PTRACE_DETACH, pid, 0, 0) == -1) {
+        perror("脱离沙箱进程失败");
+        if (listener != -1) {
+            close(listener);
+        }
+        return -1;
+    }
+    return listener;
+}
+
+// 接收一条通知，没有通知时阻塞，所以只在poll报告监听fd可读后调用。
+// 样本线程在通知被接收前已被终止时返回-1且errno为ENOENT
+int notif_receive(int listener, struct seccomp_notif *req) {
+    memset(req, 0, sizeof(*req));
+    return ioctl(listener, SECCOMP_IOCTL_NOTIF_RECV, req);
+}
+
+// 通知是否仍然有效：样本线程还停在该次系统调用中。读取参数内存后检查，
+// 确认读到的是该线程的内存，而不是线程退出后复用了tid的其他任务
+int notif_id_valid(int listener, uint64_t id) {
+    return ioctl(listener, SECCOMP_IOCTL_NOTIF_ID_VALID, &id) == 0;
+}
+
+static int notif_send(int listener, struct seccomp_notif_resp *resp) {
+    if (ioctl(listener, SECCOMP_IOCTL_NOTIF_SEND, resp) == -1 && errno != ENOENT) {
+        // ENOENT：样本线程在等待期间被信号终止，通知已经失效
+        perror("回复seccomp通知失败");
+        return -1;
+    }
+    return 0;
+}
+
+// 放行：内核继续执行原系统调用（需要5.5及以上内核）
+int notif_continue(int listener, uint64_t id) {
+    struct seccomp_notif_resp resp;
+    memset(&resp, 0, sizeof(resp));
+    resp.id = id;
+    resp.flags = SECCOMP_USER_NOTIF_FLAG_CONTINUE;
+    return notif_send(listener, &resp);
+}
+
+// 不执行系统调用，直接返回value：-4095到-1之间为errno，其余为伪造的返回值
+int notif_return(int listener, uint64_t id, long value) {
+    struct seccomp_notif_resp resp;
+    memset(&resp, 0, sizeof(resp));
+    resp.id = id;
+    if (value < 0 && value >= -4095) {
+        resp.error = (int32_t)value;
+    } else {
+        resp.val = value;
+    }
+    return notif_send(listener, &resp);
+}
@@ -0,0 +1,456 @@
+// src/policy.c
+#include "sandbox.h"
+
+// 系统调用策略文件的解析和跟踪器侧的匹配。
+// 规则按系统调用号串成链表，first[nr]为-1的系统调用（绝大多数）匹配时直接返回；
+// seccomp-bpf程序的生成见seccomp_filter.c。
+// 跟踪器侧的路径条件在入口处检查，与内核真正使用的路径之间存在时间窗口
+// （其他线程可改写路径内存）并且不解析符号链接，只用于行为分析，不作为安全边界
+
+#define POLICY_LINE_MAX 1024
+#define POLICY_COMPAT_NAME "compat"   // 指定i386兼容ABI调用统一动作的伪系统调用名
+
+// 地址族名称
+static const struct {
+    const char *name;
+    int family;
+} family_names[] = {
+    {"unix", AF_UNIX},
+    {"local", AF_UNIX},
+    {"inet", AF_INET},
+    {"inet6", AF_INET6},
+    {"netlink", AF_NETLINK},
+    {"packet", AF_PACKET},
+};
+
+// 按名称（EACCES）或数字解析errno
+static long parse_errno(const char *text) {
+    char *end;
+    long value = strtol(text, &end, 0);
+    if (end != text && *end == '\0') {
+        return value > 0 && value < 4096 ? value : -1;
+    }
+    for (int i = 1; i < 4096; i++) {
+        const char *name = strerrorname_np(i);
+        if (name && strcmp(name, text) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// 解析动作：allow、log、kill、errno(N)、fake、fake(N)
+static int parse_action(const char *text, int *action, long *value) {
+    *value = 0;
+    if (strcmp(text, "allow") == 0) {
+        *action = POLICY_ALLOW;
+        return 0;
+    }
+    if (strcmp(text, "log") == 0) {
+        *action = POLICY_LOG;
+        return 0;
+    }
+    if (strcmp(text, "kill") == 0) {
+        *action = POLICY_KILL;
+        return 0;
+    }
+    if (strcmp(text, "fake") == 0) {
+        *action = POLICY_FAKE;
+        return 0;
+    }
+
+    char name[16], arg[64];
+    size_t len = strlen(text);
+    const char *open = strchr(text, '(');
+    if (!open || text[len - 1] != ')' || (size_t)(open - text) >= sizeof(name) ||
+        len - (size_t)(open - text) - 2 >= sizeof(arg)) {
+        return -1;
+    }
+    snprintf(name, sizeof(name), "%.*s", (int)(open - text), text);
+    snprintf(arg, sizeof(arg), "%.*s", (int)(len - (size_t)(open - text) - 2), open + 1);
+
+    if (strcmp(name, "errno") == 0) {
+        *action = POLICY_ERRNO;
+        *value = parse_errno(arg);
+        return *value > 0 ? 0 : -1;
+    }
+    if (strcmp(name, "fake") == 0) {
+        char *end;
+        *action = POLICY_FAKE;
+        *value = strtol(arg, &end, 0);
+        return end != arg && *end == '\0' ? 0 : -1;
+    }
+    return -1;
+}
+
+// 描述符中第一个指定类型的参数下标，没有时返回-1
+static int find_arg_type(int syscall_nr, int type) {
+    const syscall_desc_t *desc = get_syscall_desc(SYSCALL_ABI_NATIVE, syscall_nr);
+    for (int i = 0; desc && i < desc->argc; i++) {
+        if (desc->args[i].type == type) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// 32位比较值：接受有符号（如AT_FDCWD的-100）或无符号写法
+static int parse_value(const char *text, uint32_t *value) {
+    char *end;
+    errno = 0;
+    long long v = strtoll(text, &end, 0);
+    if (errno != 0 || end == text || *end != '\0' || v < INT32_MIN || v > UINT32_MAX) {
+        return -1;
+    }
+    *value = (uint32_t)v;
+    return 0;
+}
+
+// 解析一个条件，错误时返回错误信息
+static const char *parse_cond(const char *text, int syscall_nr, policy_cond_t *cond) {
+    memset(cond, 0, sizeof(*cond));
+
+    if (strncmp(text, "arg", 3) == 0 && text[3] >= '0' && text[3] <= '5') {
+        const char *op = text + 4;
+        const char *value;
+        cond->type = POLICY_COND_ARG;
+        cond->arg = (uint8_t)(text[3] - '0');
+        if (strncmp(op, "==", 2) == 0) {
+            cond->op = POLICY_OP_EQ;
+            value = op + 2;
+        } else if (strncmp(op, "!=", 2) == 0) {
+            cond->op = POLICY_OP_NE;
+            value = op + 2;
+        } else if (*op == '&') {
+            cond->op = POLICY_OP_SET;
+            value = op + 1;
+        } else {
+            return "无效的参数条件（应为argN==V、argN!=V或argN&V）";
+        }
+        return parse_value(value, &cond->value) == 0 ? NULL : "无效的比较值（须在32位范围内）";
+    }
+
+    if (strncmp(text, "family=", 7) == 0) {
+        const char *name = text + 7;
+        int family = -1;
+        for (size_t i = 0; i < sizeof(family_names) / sizeof(family_names[0]); i++) {
+            if (strcmp(family_names[i].name, name) == 0) {
+                family = family_names[i].family;
+            }
+        }
+        if (family < 0) {
+            char *end;
+            long v = strtol(name, &end, 0);
+            if (end == name || *end != '\0' || v < 0 || v > UINT16_MAX) {
+                return "未知的地址族";
+            }
+            family = (int)v;
+        }
+
+        // socket/socketpair的地址族就在第一个参数中，可以在内核中比较
+        if (syscall_nr == __NR_socket || syscall_nr == __NR_socketpair) {
+            cond->type = POLICY_COND_ARG;
+            cond->op = POLICY_OP_EQ;
+            cond->arg = 0;
+        } else {
+            int index = find_arg_type(syscall_nr, ARG_SOCKADDR);
+            if (index < 0) {
+                return "该系统调用没有套接字地址参数";
+            }
+            cond->type = POLICY_COND_FAMILY;
+            cond->arg = (uint8_t)index;
+        }
+        cond->value = (uint32_t)family;
+        return NULL;
+    }
+
+    if (strncmp(text, "path=", 5) == 0) {
+        int index = find_arg_type(syscall_nr, ARG_PATH);
+        if (index < 0) {
+            return "该系统调用没有路径参数";
+        }
+        size_t len = strlen(text + 5);
+        if (len == 0 || text[5] != '/') {
+            return "路径条件须为绝对路径";
+        }
+        cond->type = POLICY_COND_PATH;
+        cond->arg = (uint8_t)index;
+        cond->prefix = text[5 + len - 1] == '*';
+        cond->path = strndup(text + 5, cond->prefix ? len - 1 : len);
+        return cond->path ? NULL : "内存分配失败";
+    }
+
+    return "未知的条件";
+}
+
+// 动作能否用seccomp返回值表达：伪造成功只能返回0（SECCOMP_RET_ERRNO|0）
+static int action_in_kernel(int action, long value) {
+    return action != POLICY_FAKE || value == 0;
+}
+
+// 解析一行规则，注释和空行返回0，错误时返回-1
+static int parse_rule_line(policy_t *policy, char *line, int lineno, int *capacity) {
+    char *comment = strchr(line, '#');
+    if (comment) *comment = '\0';
+
+    char *saveptr = NULL;
+    char *action_text = strtok_r(line, " \t\r\n", &saveptr);
+    if (!action_text) {
+        return 0;
+    }
+    char *syscall_text = strtok_r(NULL, " \t\r\n", &saveptr);
+    if (!syscall_text) {
+        fprintf(stderr, "错误: %s:%d: 缺少系统调用名\n", policy->path, lineno);
+        return -1;
+    }
+
+    int action;
+    long value;
+    if (parse_action(action_text, &action, &value) != 0) {
+        fprintf(stderr, "错误: %s:%d: 未知的动作 '%s'\n", policy->path, lineno, action_text);
+        return -1;
+    }
+
+    if (strcmp(syscall_text, POLICY_COMPAT_NAME) == 0) {
+        if (strtok_r(NULL, " \t\r\n", &saveptr)) {
+            fprintf(stderr, "错误: %s:%d: compat规则不能带条件\n", policy->path, lineno);
+            return -1;
+        }
+        if (!action_in_kernel(action, value)) {
+            fprintf(stderr, "错误: %s:%d: compat规则只能伪造返回0\n", policy->path, lineno);
+            return -1;
+        }
+        policy->compat_set = 1;
+        policy->compat_action = action;
+        policy->compat_value = value;
+        return 0;
+    }
+
+    char *end;
+    long nr = strtol(syscall_text, &end, 10);
+    if (*end != '\0') {
+        nr = get_syscall_number(syscall_text);
+    }
+    if (nr < 0 || nr >= SYSCALL_MAX) {
+        fprintf(stderr, "错误: %s:%d: 未知的系统调用 '%s'\n", policy->path, lineno, syscall_text);
+        return -1;
+    }
+
+    if (policy->count == *capacity) {
+        int new_capacity = *capacity ? *capacity * 2 : 16;
+        policy_rule_t *rules = realloc(policy->rules, (size_t)new_capacity * sizeof(*rules));
+        if (!rules) {
+            perror("内存分配失败");
+            return -1;
+        }
+        policy->rules = rules;
+        *capacity = new_capacity;
+    }
+
+    policy_rule_t *rule = &policy->rules[policy->count];
+    memset(rule, 0, sizeof(*rule));
+    rule->syscall_nr = (int)nr;
+    rule->action = action;
+    rule->value = value;
+    rule->line = lineno;
+    rule->next = -1;
+    rule->needs_tracer = !action_in_kernel(action, value);
+    policy->count++;
+
+    for (char *token = strtok_r(NULL, " \t\r\n", &saveptr); token;
+         token = strtok_r(NULL, " \t\r\n", &saveptr)) {
+        if (rule->cond_count == POLICY_MAX_CONDS) {
+            fprintf(stderr, "错误: %s:%d: 条件过多 (最多 %d 个)\n", policy->path, lineno, POLICY_MAX_CONDS);
+            return -1;
+        }
+        policy_cond_t *cond = &rule->conds[rule->cond_count];
+        const char *error = parse_cond(token, (int)nr, cond);
+        if (error) {
+            fprintf(stderr, "错误: %s:%d: %s: '%s'\n", policy->path, lineno, error, token);
+            free(cond->path);
+            return -1;
+        }
+        rule->cond_count++;
+        if (cond->type != POLICY_COND_ARG) {
+            rule->needs_tracer = 1;
+        }
+    }
+    return 0;
+}
+
+// 读取并解析策略文件，错误时输出文件名和行号并返回NULL
+policy_t *policy_load(const char *path) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        fprintf(stderr, "错误: 无法打开策略文件 '%s': %s\n", path, strerror(errno));
+        return NULL;
+    }
+
+    policy_t *policy = calloc(1, sizeof(*policy));
+    if (!policy) {
+        perror("内存分配失败");
+        fclose(fp);
+        return NULL;
+    }
+    policy->path = path;
+
+    char line[POLICY_LINE_MAX];
+    int lineno = 0;
+    int capacity = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        lineno++;
+        if (!strchr(line, '\n') && !feof(fp)) {
+            fprintf(stderr, "错误: %s:%d: 行过长\n", path, lineno);
+            goto fail;
+        }
+        if (parse_rule_line(policy, line, lineno, &capacity) != 0) {
+            goto fail;
+        }
+    }
+    fclose(fp);
+
+    // 每个系统调用的规则按出现顺序串起来；第一条需要跟踪器的规则之后，
+    // 内核把该系统调用交给跟踪器，后面的规则也只能由跟踪器执行
+    int last[SYSCALL_MAX];
+    int traced[SYSCALL_MAX];
+    for (int nr = 0; nr < SYSCALL_MAX; nr++) {
+        policy->first[nr] = -1;
+        last[nr] = -1;
+        traced[nr] = 0;
+    }
+    for (int i = 0; i < policy->count; i++) {
+        policy_rule_t *rule = &policy->rules[i];
+        int nr = rule->syscall_nr;
+        if (last[nr] < 0) {
+            policy->first[nr] = i;
+        } else {
+            policy->rules[last[nr]].next = i;
+        }
+        last[nr] = i;
+        traced[nr] |= rule->needs_tracer;
+        rule->tracer_enforced = traced[nr];
+    }
+    return policy;
+
+fail:
+    fclose(fp);
+    policy_free(policy);
+    return NULL;
+}
+
+void policy_free(policy_t *policy) {
+    if (!policy) {
+        return;
+    }
+    for (int i = 0; i < policy->count; i++) {
+        for (int j = 0; j < policy->rules[i].cond_count; j++) {
+            free(policy->rules[i].conds[j].path);
+        }
+    }
+    free(policy->rules);
+    free(policy);
+}
+
+// 是否有规则需要读取该系统调用的参数内存
+int policy_needs_capture(const policy_t *policy, int syscall_nr) {
+    for (int i = policy->first[syscall_nr]; i >= 0; i = policy->rules[i].next) {
+        for (int j = 0; j < policy->rules[i].cond_count; j++) {
+            if (policy->rules[i].conds[j].type != POLICY_COND_ARG) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+// 按字面规整路径中的"."、".."和重复的"/"，避免用/tmp/../etc绕过前缀
+static void normalize_path(const char *path, size_t len, char *out, size_t outlen) {
+    size_t pos = 0;
+    size_t i = 0;
+    while (i < len) {
+        while (i < len && path[i] == '/') i++;
+        size_t start = i;
+        while (i < len && path[i] != '/') i++;
+        size_t seg = i - start;
+        if (seg == 0 || (seg == 1 && path[start] == '.')) {
+            continue;
+        }
+        if (seg == 2 && path[start] == '.' && path[start + 1] == '.') {
+            while (pos > 0 && out[pos - 1] != '/') pos--;
+            if (pos > 0) pos--;
+            continue;
+        }
+        if (pos + 1 + seg >= outlen) {
+            break;
+        }
+        out[pos++] = '/';
+        memcpy(out + pos, path + start, seg);
+        pos += seg;
+    }
+    if (pos == 0) {
+        out[pos++] = '/';
+    }
+    out[pos] = '\0';
+}
+
+static int cond_matches(const policy_cond_t *cond, const unsigned long *args, const arg_capture_t *capture) {
+    const char *data;
+    size_t len;
+
+    switch (cond->type) {
+    case POLICY_COND_ARG: {
+        uint32_t value = (uint32_t)args[cond->arg];
+        switch (cond->op) {
+        case POLICY_OP_EQ: return value == cond->value;
+        case POLICY_OP_NE: return value != cond->value;
+        default: return (value & cond->value) != 0;
+        }
+    }
+    case POLICY_COND_FAMILY: {
+        uint16_t family;
+        if (!capture || arg_blob_find(capture->blob, capture->len, cond->arg, &data, &len) != 0 ||
+            len < sizeof(family)) {
+            return 0;
+        }
+        memcpy(&family, data, sizeof(family));
+        return family == cond->value;
+    }
+    case POLICY_COND_PATH: {
+        if (!capture) {
+            return 0;
+        }
+        data = arg_blob_path(capture->blob, capture->len, cond->arg, &len);
+        if (len == 0 || data[0] != '/') {
+            return 0;
+        }
+        char path[PATH_MAX];
+        normalize_path(data, len, path, sizeof(path));
+        if (!cond->prefix) {
+            return strcmp(path, cond->path) == 0;
+        }
+        return strncmp(path, cond->path, strlen(cond->path)) == 0;
+    }
+    default:
+        return 0;
+    }
+}
+
+// 返回该本机系统调用第一条命中的规则，没有命中时返回NULL。
+// capture为入口处的参数块（路径和地址条件需要），可以为NULL
+const policy_rule_t *policy_match(const policy_t *policy, int syscall_nr, const unsigned long *args,
+                                  const arg_capture_t *capture) {
+    if (syscall_nr < 0 || syscall_nr >= SYSCALL_MAX) {
+        return NULL;
+    }
+    for (int i = policy->first[syscall_nr]; i >= 0; i = policy->rules[i].next) {
+        const policy_rule_t *rule = &policy->rules[i];
+        int matched = 1;
+        for (int j = 0; j < rule->cond_count && matched; j++) {
+            matched = cond_matches(&rule->conds[j], args, capture);
+        }
+        if (matched) {
+            return rule;
+        }
+    }
+    return NULL;
+}
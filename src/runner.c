@@ -0,0 +1,253 @@
+// src/runner.c
+#include "sandbox.h"
+#include <poll.h>
+
+#define SANDBOX_DIR_TEMPLATE "/tmp/sandbox-XXXXXX"
+
+// 创建带命名空间的沙箱进程并完成用户命名空间映射。
+// 池化模式(config->pooled)下沙箱挂起在交接管道上，等待handoff_sample发送样本
+int spawn_sandbox(sandbox_config *config, sandbox_result *result) {
+    memset(result, 0, sizeof(*result));
+    config->sandbox_pidfd = -1;
+    config->start_sock[0] = config->start_sock[1] = -1;
+
+    // 沙箱根目录在父进程中创建，沙箱结束后由父进程删除
+    // （tmpfs只挂载在沙箱自己的挂载命名空间中，随命名空间一起消失）
+    snprintf(config->sandbox_dir, sizeof(config->sandbox_dir), "%s", SANDBOX_DIR_TEMPLATE);
+    if (!mkdtemp(config->sandbox_dir)) {
+        perror("创建沙箱临时目录失败");
+        config->sandbox_dir[0] = '\0';
+        return -1;
+    }
+
+    // 子进程要等父进程写完用户命名空间映射后才能继续
+    if (pipe2(config->sync_pipe, O_CLOEXEC) == -1) {
+        perror("创建同步管道失败");
+        rmdir(config->sandbox_dir);
+        return -1;
+    }
+
+    config->handoff_pipe[0] = config->handoff_pipe[1] = -1;
+    if (config->pooled && pipe2(config->handoff_pipe, O_CLOEXEC) == -1) {
+        perror("创建交接管道失败");
+        close(config->sync_pipe[0]);
+        close(config->sync_pipe[1]);
+        rmdir(config->sandbox_dir);
+        return -1;
+    }
+
+    // eBPF后端：沙箱通过启动套接字报告就绪，并等待内核程序挂载完成
+    if (config->backend == MONITOR_BACKEND_EBPF &&
+        socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, config->start_sock) == -1) {
+        perror("创建启动套接字失败");
+        close(config->sync_pipe[0]);
+        close(config->sync_pipe[1]);
+        if (config->pooled) {
+            close(config->handoff_pipe[0]);
+            close(config->handoff_pipe[1]);
+        }
+        rmdir(config->sandbox_dir);
+        return -1;
+    }
+
+    // 分配子进程栈
+    char *stack = malloc(STACK_SIZE);
+    if (!stack) {
+        perror("栈内存分配失败");
+        close(config->sync_pipe[0]);
+        close(config->sync_pipe[1]);
+        if (config->pooled) {
+            close(config->handoff_pipe[0]);
+            close(config->handoff_pipe[1]);
+        }
+        if (config->start_sock[0] != -1) {
+            close(config->start_sock[0]);
+            close(config->start_sock[1]);
+            config->start_sock[0] = config->start_sock[1] = -1;
+        }
+        rmdir(config->sandbox_dir);
+        return -1;
+    }
+
+    // 创建带有命名空间的子进程。沙箱根进程是新PID命名空间的init，
+    // 同时取得它的pidfd，超时后通过它终止整个命名空间而不受PID复用影响
+    int flags = CLONE_NEWUSER | CLONE_NEWPID | CLONE_NEWIPC | CLONE_NEWUTS | CLONE_NEWNET | SIGCHLD;
+    printf("创建带有命名空间的沙箱...\n");
+    pid_t pid = clone(child_func, stack + STACK_SIZE, flags | CLONE_PIDFD, config, &config->sandbox_pidfd);
+    if (pid == -1 && errno == EINVAL) {
+        // 内核不支持CLONE_PIDFD（5.2之前），退回按PID发信号
+        config->sandbox_pidfd = -1;
+        pid = clone(child_func, stack + STACK_SIZE, flags, config);
+    }
+
+    // 没有CLONE_VM，子进程使用自己的地址空间副本，父进程中的栈可以立即释放
+    free(stack);
+    close(config->sync_pipe[0]);
+    if (config->pooled) {
+        close(config->handoff_pipe[0]);
+    }
+    if (config->start_sock[0] != -1) {
+        close(config->start_sock[0]);
+        config->start_sock[0] = -1;
+    }
+    if (pid == -1) {
+        perror("创建子进程失败");
+        close(config->sync_pipe[1]);
+        if (config->pooled) {
+            close(config->handoff_pipe[1]);
+        }
+        if (config->start_sock[1] != -1) {
+            close(config->start_sock[1]);
+            config->start_sock[1] = -1;
+        }
+        rmdir(config->sandbox_dir);
+        return -1;
+    }
+
+    printf("沙箱进程已启动，PID: %d\n", pid);
+    result->sandbox_pid = pid;
+
+    // 设置用户命名空间映射
+    if (setup_user_namespace(pid) != 0) {
+        printf("警告: 用户命名空间设置不完整\n");
+    }
+
+    // 放入独立的cgroup，沙箱此时还停在同步管道上，之后创建的进程都会继承
+    if (!config->cgroup_disabled) {
+        cgroup_setup_sandbox(config, pid, result);
+    }
+
+    // 通知子进程继续
+    if (write(config->sync_pipe[1], "x", 1) != 1) {
+        perror("通知沙箱进程失败");
+    }
+    close(config->sync_pipe[1]);
+    return 0;
+}
+
+// 把样本交给预先创建的沙箱。output_path非NULL时沙箱把输出追加到该文件
+int handoff_sample(sandbox_config *config, const char *output_path) {
+    sandbox_handoff_t msg;
+    memset(&msg, 0, sizeof(msg));
+    snprintf(msg.binary_path, sizeof(msg.binary_path), "%s", config->binary_path);
+    if (output_path) {
+        snprintf(msg.output_path, sizeof(msg.output_path), "%s", output_path);
+    }
+
+    // 消息大于PIPE_BUF，可能分多次写入
+    const char *p = (const char *)&msg;
+    size_t left = sizeof(msg);
+    while (left > 0) {
+        ssize_t n = write(config->handoff_pipe[1], p, left);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            perror("向沙箱发送样本失败");
+            close(config->handoff_pipe[1]);
+            return -1;
+        }
+        p += n;
+        left -= (size_t)n;
+    }
+    close(config->handoff_pipe[1]);
+    return 0;
+}
+
+// 终止整个沙箱：向PID命名空间的init发送SIGKILL，内核随之杀死命名空间中的所有进程
+void kill_sandbox(const sandbox_config *config, pid_t pid) {
+    if (config->sandbox_pidfd != -1 &&
+        syscall(SYS_pidfd_send_signal, config->sandbox_pidfd, SIGKILL, NULL, 0) == 0) {
+        return;
+    }
+    kill(pid, SIGKILL);
+}
+
+// 监控失败时根进程尚未被回收，在这里等待；设置了墙上时间限制时最多等待该时长
+static void wait_sandbox(sandbox_config *config, sandbox_result *result) {
+    pid_t pid = result->sandbox_pid;
+    printf("等待沙箱进程完成...\n");
+
+    if (config->timeout_ms > 0 && config->sandbox_pidfd != -1) {
+        struct pollfd pfd = { .fd = config->sandbox_pidfd, .events = POLLIN };
+        int n;
+        do {
+            n = poll(&pfd, 1, (int)config->timeout_ms);
+        } while (n == -1 && errno == EINTR);
+        if (n == 0) {
+            printf("沙箱超过墙上时间限制，终止\n");
+            result->timeout_reason = TIMEOUT_WALL;
+            kill_sandbox(config, pid);
+        }
+    }
+
+    if (waitpid(pid, &result->exit_status, 0) == pid) {
+        result->exited = 1;
+    }
+}
+
+// 监控结束或失败后关闭启动套接字，仍在等待的沙箱读到EOF后退出
+static void close_start_sock(sandbox_config *config) {
+    if (config->start_sock[1] != -1) {
+        close(config->start_sock[1]);
+        config->start_sock[1] = -1;
+    }
+}
+
+// 释放沙箱占用的主机资源：cgroup、沙箱根目录、启动套接字和pidfd
+void release_sandbox(sandbox_config *config, sandbox_result *result) {
+    close_start_sock(config);
+    cgroup_destroy(result->cgroup_path);
+    if (config->sandbox_dir[0] != '\0') {
+        if (rmdir(config->sandbox_dir) == -1 && errno != ENOENT) {
+            printf("警告: 删除沙箱目录 %s 失败: %s\n", config->sandbox_dir, strerror(errno));
+        }
+        config->sandbox_dir[0] = '\0';
+    }
+    if (config->sandbox_pidfd != -1) {
+        close(config->sandbox_pidfd);
+        config->sandbox_pidfd = -1;
+    }
+}
+
+// 跟踪沙箱直到根进程退出并输出退出状态
+int monitor_sandbox(sandbox_config *config, sandbox_result *result) {
+    pid_t pid = result->sandbox_pid;
+
+    // 启动系统调用监控
+    printf("启动系统调用监控...\n");
+    setup_monitoring(pid, config, result);
+    close_start_sock(config);
+
+    if (!result->exited) {
+        wait_sandbox(config, result);
+    }
+
+    if (result->exited && WIFEXITED(result->exit_status)) {
+        printf("沙箱进程退出，状态码: %d\n", WEXITSTATUS(result->exit_status));
+    } else if (result->exited && WIFSIGNALED(result->exit_status)) {
+        printf("沙箱进程被信号终止: %d\n", WTERMSIG(result->exit_status));
+    }
+
+    if (result->timeout_reason == TIMEOUT_WALL) {
+        printf("沙箱因超过墙上时间限制被终止\n");
+    } else if (result->timeout_reason == TIMEOUT_CPU) {
+        printf("沙箱因超过CPU时间限制被终止\n");
+    }
+
+    if (result->cgroup_path[0] != '\0') {
+        cgroup_collect_stats(result->cgroup_path, &result->cgroup);
+        print_cgroup_stats(&result->cgroup);
+    }
+    release_sandbox(config, result);
+    return 0;
+}
+
+// 在新的命名空间沙箱中运行config指定的程序并监控，结果写入result
+int run_sandbox(sandbox_config *config, sandbox_result *result) {
+    // 打印文件类型信息
+    print_file_info(config->binary_path);
+
+    if (spawn_sandbox(config, result) != 0) {
+        return -1;
+    }
+    return monitor_sandbox(config, result);
+}
@@ -6,7 +6,7 @@ int create_sandbox_directories(const char *sandbox_root) {
 
     // 创建/bin目录
     snprintf(path, sizeof(path), "%s/bin", sandbox_root);
-    if (mkdir(path, 0755) == -1) {
+    if (mkdir(path, 0755) == -1 && errno != EEXIST) {
         printf("创建bin目录失败: %s (错误码: %d)\n", strerror(errno), errno);
         return -1;
     }
@@ -44,36 +44,11 @@ int copy_executable_to_sandbox(const char *binary_path, const char *binary_name,
     snprintf(dest_path, sizeof(dest_path), "%s/bin/%s", sandbox_root, binary_name);
     printf("复制文件到: %s\n", dest_path);
 
-    // 打开源文件
-    int src_fd = open(binary_path, O_RDONLY);
-    if (src_fd == -1) {
-        perror("打开源文件失败");
+    // 样本总是复制一份，不与主机共享数据
+    if (stage_file(binary_path, dest_path, 0755, STAGE_COPY) != 0) {
         return -1;
     }
 
-    // 创建目标文件
-    int dest_fd = open(dest_path, O_WRONLY | O_CREAT, 0755);
-    if (dest_fd == -1) {
-        perror("创建目标文件失败");
-        close(src_fd);
-        return -1;
-    }
-
-    // 复制文件内容
-    char buffer[4096];
-    ssize_t bytes_read;
-    while ((bytes_read = read(src_fd, buffer, sizeof(buffer))) > 0) {
-        if (write(dest_fd, buffer, bytes_read) != bytes_read) {
-            perror("写入文件失败");
-            close(src_fd);
-            close(dest_fd);
-            return -1;
-        }
-    }
-
-    close(src_fd);
-    close(dest_fd);
-
     // 检查文件是否成功复制和可执行
     struct stat st;
     if (stat(dest_path, &st) != 0) {
@@ -120,10 +95,60 @@ int enter_sandbox(const char *sandbox_root) {
 }
 
 // 在子进程(沙箱)中运行的函数
+// 池化沙箱在命名空间和根目录准备好之后挂起，从交接管道接收样本路径
+static int receive_handoff(sandbox_config *config) {
+    close(config->handoff_pipe[1]);
+
+    sandbox_handoff_t msg;
+    char *p = (char *)&msg;
+    size_t left = sizeof(msg);
+    while (left > 0) {
+        ssize_t n = read(config->handoff_pipe[0], p, left);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) {
+            // 父进程放弃了这个沙箱（任务取消或退出）
+            close(config->handoff_pipe[0]);
+            return -1;
+        }
+        p += n;
+        left -= (size_t)n;
+    }
+    close(config->handoff_pipe[0]);
+    msg.binary_path[sizeof(msg.binary_path) - 1] = '\0';
+    msg.output_path[sizeof(msg.output_path) - 1] = '\0';
+
+    if (msg.output_path[0] != '\0') {
+        int fd = open(msg.output_path, O_WRONLY | O_APPEND | O_CLOEXEC);
+        if (fd != -1) {
+            dup2(fd, STDOUT_FILENO);
+            dup2(fd, STDERR_FILENO);
+            close(fd);
+        }
+    }
+
+    config->binary_path = strdup(msg.binary_path);
+    config->binary_name = strdup(basename(msg.binary_path));
+    if (!config->binary_path || !config->binary_name) {
+        perror("内存分配失败");
+        return -1;
+    }
+    printf("预创建的沙箱收到样本: %s\n", config->binary_path);
+    return 0;
+}
+
 int child_func(void *arg) {
     // 现在参数是sandbox_config结构
     sandbox_config *config = (sandbox_config *)arg;
 
+    // 等待父进程写完uid_map/gid_map，否则创建文件会因未映射的uid失败
+    char sync_byte;
+    close(config->sync_pipe[1]);
+    if (read(config->sync_pipe[0], &sync_byte, 1) != 1) {
+        printf("等待用户命名空间映射失败\n");
+        return EXIT_FAILURE;
+    }
+    close(config->sync_pipe[0]);
+
     // 创建新的挂载命名空间
     if (unshare(CLONE_NEWNS) == -1) {
         perror("创建挂载命名空间失败");
@@ -136,15 +161,9 @@ int child_func(void *arg) {
         return EXIT_FAILURE;
     }
 
-    // 为沙箱创建临时目录
-    char sandbox_dir[] = "/tmp/sandbox-XXXXXX";
-    char *dir = mkdtemp(sandbox_dir);
-    if (!dir) {
-        perror("创建沙箱临时目录失败");
-        return EXIT_FAILURE;
-    }
-
-    printf("创建沙箱目录: %s\n", dir);
+    // 沙箱目录由父进程创建，父进程在沙箱结束后删除
+    const char *dir = config->sandbox_dir;
+    printf("沙箱目录: %s\n", dir);
 
     // 挂载tmpfs作为沙箱根目录
     if (mount("none", dir, "tmpfs", 0, "size=50M") == -1) {
@@ -152,22 +171,44 @@ int child_func(void *arg) {
         return EXIT_FAILURE;
     }
 
-    // 创建基本目录结构
-    if (create_sandbox_directories(dir) != 0) {
+    // 池化模式：到此为止的准备工作已提前完成，等待样本交接
+    if (config->pooled && receive_handoff(config) != 0) {
         return EXIT_FAILURE;
     }
 
+    // 优先使用缓存的根文件系统模板，只需复制样本本身
+    char root[PATH_MAX];
+    int from_template = config->template_cache &&
+                        setup_template_root(config, dir, root, sizeof(root)) == 0;
+    if (!from_template) {
+        if (config->template_cache) {
+            printf("模板缓存不可用，回退为逐个复制依赖\n");
+        }
+        snprintf(root, sizeof(root), "%s", dir);
+
+        // 创建基本目录结构
+        if (create_sandbox_directories(root) != 0) {
+            return EXIT_FAILURE;
+        }
+    }
+
     // 复制可执行文件到沙箱
-    if (copy_executable_to_sandbox(config->binary_path, config->binary_name, dir) != 0) {
+    if (copy_executable_to_sandbox(config->binary_path, config->binary_name, root) != 0) {
         return EXIT_FAILURE;
     }
 
-    // 处理动态库依赖
-    printf("检查程序类型并处理依赖...\n");
-    prepare_dynamic_libs(config->binary_path, dir);
+    if (!from_template) {
+        // 处理动态库依赖
+        printf("检查程序类型并处理依赖...\n");
+        prepare_dynamic_libs(config->binary_path, root, config->stage_mode);
+    }
+
+    if (config->stats) {
+        print_stage_stats(config->binary_name);
+    }
 
     // 切换根目录并进入沙箱环境
-    if (enter_sandbox(dir) != 0) {
+    if (enter_sandbox(root) != 0) {
         return EXIT_FAILURE;
     }
 
@@ -190,13 +231,16 @@ int child_func(void *arg) {
     printf("在沙箱中执行程序: %s\n", exec_path);
 
     // 开启ptrace跟踪
-    if (prepare_traced_child() == -1) {
+    if (prepare_traced_child(config) == -1) {
         printf("设置跟踪失败: %s\n", strerror(errno));
         return EXIT_FAILURE;
     }
 
     printf("程序已准备好被跟踪\n");
 
+    // exec会丢弃stdio缓冲区，输出重定向到文件或管道时需要先刷新
+    fflush(stdout);
+
     // 执行程序
     if (execl(exec_path, config->binary_name, NULL) == -1) {
         printf("执行程序失败: %s\n", strerror(errno));
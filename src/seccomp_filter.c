@@ -0,0 +1,304 @@
+// src/seccomp_filter.c
+#include "sandbox.h"
+#include <stddef.h>
+#include <sys/prctl.h>
+#include <linux/audit.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+
+#ifdef __x86_64__
+#define SECCOMP_NATIVE_ARCH AUDIT_ARCH_X86_64
+#else
+#define SECCOMP_NATIVE_ARCH AUDIT_ARCH_I386
+#endif
+
+#define X32_SYSCALL_BIT 0x40000000
+
+// 解析逗号分隔的系统调用列表（名称或编号），返回解析出的数量
+int parse_syscall_list(const char *list, int *syscalls, int max_count) {
+    char *copy = strdup(list);
+    if (!copy) {
+        perror("内存分配失败");
+        return -1;
+    }
+
+    int count = 0;
+    char *saveptr = NULL;
+    for (char *token = strtok_r(copy, ",", &saveptr); token;
+         token = strtok_r(NULL, ",", &saveptr)) {
+        if (*token == '\0') continue;
+
+        char *end;
+        long nr = strtol(token, &end, 10);
+        if (*end != '\0') {
+            nr = get_syscall_number(token);
+        }
+        if (nr < 0) {
+            fprintf(stderr, "错误: 未知的系统调用 '%s'\n", token);
+            free(copy);
+            return -1;
+        }
+        if (count >= max_count) {
+            fprintf(stderr, "错误: 跟踪的系统调用过多 (最多 %d 个)\n", max_count);
+            free(copy);
+            return -1;
+        }
+        syscalls[count++] = (int)nr;
+    }
+
+    free(copy);
+    return count;
+}
+
+// BPF程序构建：条件跳转只有8位偏移，这里只用它跳过紧随其后的一条指令，
+// 远跳转一律用32位偏移的BPF_JA，目标以标签表示，最后统一回填
+#define BPF_LABELS_MAX BPF_MAXINSNS
+
+typedef struct {
+    struct sock_filter insns[BPF_MAXINSNS];
+    int label_of[BPF_MAXINSNS];   // BPF_JA指令跳往的标签，-1表示不需要回填
+    int len;
+    int labels[BPF_LABELS_MAX];   // 标签所在的指令位置，-1表示尚未绑定
+    int label_count;
+    int overflow;                 // 指令或标签超出上限
+} bpf_builder_t;
+
+static int bpf_new_label(bpf_builder_t *b) {
+    if (b->label_count == BPF_LABELS_MAX) {
+        b->overflow = 1;
+        return 0;
+    }
+    b->labels[b->label_count] = -1;
+    return b->label_count++;
+}
+
+static void bpf_bind(bpf_builder_t *b, int label) {
+    b->labels[label] = b->len;
+}
+
+static void bpf_emit(bpf_builder_t *b, struct sock_filter insn, int label) {
+    if (b->len == BPF_MAXINSNS) {
+        b->overflow = 1;
+        return;
+    }
+    b->label_of[b->len] = label;
+    b->insns[b->len++] = insn;
+}
+
+static void bpf_load(bpf_builder_t *b, uint32_t offset) {
+    bpf_emit(b, (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offset), -1);
+}
+
+static void bpf_ret(bpf_builder_t *b, uint32_t value) {
+    bpf_emit(b, (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, value), -1);
+}
+
+static void bpf_goto(bpf_builder_t *b, int label) {
+    bpf_emit(b, (struct sock_filter)BPF_STMT(BPF_JMP | BPF_JA, 0), label);
+}
+
+// 条件成立时跳到label，否则继续执行下一条
+static void bpf_jump_if(bpf_builder_t *b, uint16_t op, uint32_t k, int label) {
+    bpf_emit(b, (struct sock_filter)BPF_JUMP(BPF_JMP | op | BPF_K, k, 0, 1), -1);
+    bpf_goto(b, label);
+}
+
+// 条件不成立时跳到label
+static void bpf_jump_unless(bpf_builder_t *b, uint16_t op, uint32_t k, int label) {
+    bpf_emit(b, (struct sock_filter)BPF_JUMP(BPF_JMP | op | BPF_K, k, 1, 0), -1);
+    bpf_goto(b, label);
+}
+
+static int bpf_resolve(bpf_builder_t *b) {
+    if (b->overflow) {
+        fprintf(stderr, "seccomp过滤器过大 (最多 %d 条指令)\n", BPF_MAXINSNS);
+        return -1;
+    }
+    for (int i = 0; i < b->len; i++) {
+        if (b->label_of[i] >= 0) {
+            b->insns[i].k = (uint32_t)(b->labels[b->label_of[i]] - i - 1);
+        }
+    }
+    return 0;
+}
+
+// 需要单独处理的系统调用：被跟踪的，或有策略规则的
+typedef struct {
+    int nr;
+    int label;                    // 该系统调用的处理块
+} bpf_dispatch_t;
+
+static int compare_dispatch(const void *a, const void *b) {
+    return ((const bpf_dispatch_t *)a)->nr - ((const bpf_dispatch_t *)b)->nr;
+}
+
+// 按系统调用号二分分派：每个系统调用最多比较O(log n)次，而不是逐个比较
+static void emit_dispatch(bpf_builder_t *b, const bpf_dispatch_t *entries, int count, int fallback) {
+    if (count <= 4) {
+        for (int i = 0; i < count; i++) {
+            bpf_jump_if(b, BPF_JEQ, (uint32_t)entries[i].nr, entries[i].label);
+        }
+        bpf_goto(b, fallback);
+        return;
+    }
+    int mid = count / 2;
+    int upper = bpf_new_label(b);
+    bpf_jump_if(b, BPF_JGE, (uint32_t)entries[mid].nr, upper);
+    emit_dispatch(b, entries, mid, fallback);
+    bpf_bind(b, upper);
+    emit_dispatch(b, entries + mid, count - mid, fallback);
+}
+
+// 规则动作对应的seccomp返回值；trace为交给跟踪器时的返回值，allow为该系统调用的默认处理
+static uint32_t action_return(int action, long value, uint32_t trace, uint32_t allow) {
+    switch (action) {
+    case POLICY_LOG:
+        return trace;
+    case POLICY_ERRNO:
+    case POLICY_FAKE:
+        // 伪造成功只能返回0，非0的伪造值由跟踪器处理
+        return SECCOMP_RET_ERRNO | ((uint32_t)value & SECCOMP_RET_DATA);
+    case POLICY_KILL:
+        return SECCOMP_RET_KILL_PROCESS;
+    default:
+        return allow;
+    }
+}
+
+// 一条规则：寄存器条件全部成立时返回动作，否则跳到下一条规则。
+// 需要读内存的条件不在这里判断，寄存器条件成立就交给跟踪器
+static void emit_rule(bpf_builder_t *b, const policy_rule_t *rule, uint32_t trace, uint32_t allow) {
+    int next = bpf_new_label(b);
+    for (int i = 0; i < rule->cond_count; i++) {
+        const policy_cond_t *cond = &rule->conds[i];
+        if (cond->type != POLICY_COND_ARG) continue;
+        // 小端序下args[i]的低32位在前
+        bpf_load(b, (uint32_t)offsetof(struct seccomp_data, args[cond->arg]));
+        if (cond->op == POLICY_OP_EQ) {
+            bpf_jump_unless(b, BPF_JEQ, cond->value, next);
+        } else if (cond->op == POLICY_OP_NE) {
+            bpf_jump_if(b, BPF_JEQ, cond->value, next);
+        } else {
+            bpf_jump_unless(b, BPF_JSET, cond->value, next);
+        }
+    }
+    bpf_ret(b, rule->needs_tracer ? trace : action_return(rule->action, rule->value, trace, allow));
+    bpf_bind(b, next);
+}
+
+// 安装seccomp-bpf过滤器：
+// 过滤模式下跟踪列表中的系统调用返回SECCOMP_RET_TRACE交给跟踪者，其余直接放行，
+// 避免每个系统调用都产生两次ptrace停止；指定了策略时同时在内核中执行只看寄存器的规则。
+// 完整跟踪模式下跟踪器在seccomp之前就已看到每个系统调用入口，"交给跟踪器"即为放行。
+// 通知后端中"交给跟踪器"为SECCOMP_RET_USER_NOTIF，成功时返回监听fd；其余情况成功返回0
+int install_seccomp_filter(const sandbox_config *config) {
+    const policy_t *policy = config->policy;
+    int traced = config->seccomp_filter;
+    int notif = config->backend == MONITOR_BACKEND_NOTIF;
+    uint32_t trace = notif ? SECCOMP_RET_USER_NOTIF : traced ? SECCOMP_RET_TRACE : SECCOMP_RET_ALLOW;
+    uint32_t compat = trace;
+    if (policy && policy->compat_set) {
+        compat = action_return(policy->compat_action, policy->compat_value, trace, trace);
+    }
+
+    // 构建器较大，放在堆上
+    bpf_builder_t *b = calloc(1, sizeof(*b));
+    bpf_dispatch_t *entries = malloc(SYSCALL_MAX * sizeof(*entries));
+    if (!b || !entries) {
+        perror("内存分配失败");
+        free(b);
+        free(entries);
+        return -1;
+    }
+
+    // 非本机架构（如x86_64上的int 0x80）和x32调用按compat处理
+    int compat_label = bpf_new_label(b);
+    bpf_load(b, offsetof(struct seccomp_data, arch));
+    bpf_jump_unless(b, BPF_JEQ, SECCOMP_NATIVE_ARCH, compat_label);
+    bpf_load(b, offsetof(struct seccomp_data, nr));
+    if (policy) {
+        // 跟踪器按策略跳过的系统调用号改成了-1，不能再按compat处理
+        int native_label = bpf_new_label(b);
+        bpf_jump_unless(b, BPF_JEQ, (uint32_t)-1, native_label);
+        bpf_ret(b, SECCOMP_RET_ALLOW);
+        bpf_bind(b, native_label);
+    }
+    bpf_jump_if(b, BPF_JGE, X32_SYSCALL_BIT, compat_label);
+
+    int count = 0;
+    int trace_label = bpf_new_label(b);
+    int allow_label = bpf_new_label(b);
+    uint8_t is_traced[SYSCALL_MAX] = {0};
+    for (int i = 0; traced && i < config->traced_count; i++) {
+        if (config->traced_syscalls[i] >= 0 && config->traced_syscalls[i] < SYSCALL_MAX) {
+            is_traced[config->traced_syscalls[i]] = 1;
+        }
+    }
+    for (int nr = 0; nr < SYSCALL_MAX; nr++) {
+        int has_rules = policy && policy->first[nr] >= 0;
+        if (has_rules) {
+            entries[count].nr = nr;
+            entries[count++].label = bpf_new_label(b);
+        } else if (is_traced[nr]) {
+            entries[count].nr = nr;
+            entries[count++].label = trace_label;
+        }
+    }
+    qsort(entries, (size_t)count, sizeof(entries[0]), compare_dispatch);
+    emit_dispatch(b, entries, count, allow_label);
+
+    // 各系统调用的规则块，规则都不命中时按是否跟踪处理
+    for (int i = 0; i < count; i++) {
+        if (entries[i].label == trace_label) continue;
+        int nr = entries[i].nr;
+        uint32_t allow = is_traced[nr] ? trace : SECCOMP_RET_ALLOW;
+        bpf_bind(b, entries[i].label);
+        for (int r = policy->first[nr]; r >= 0; r = policy->rules[r].next) {
+            emit_rule(b, &policy->rules[r], trace, allow);
+        }
+        bpf_ret(b, allow);
+    }
+
+    bpf_bind(b, trace_label);
+    bpf_ret(b, trace);
+    bpf_bind(b, allow_label);
+    bpf_ret(b, SECCOMP_RET_ALLOW);
+    bpf_bind(b, compat_label);
+    bpf_ret(b, compat);
+    free(entries);
+
+    if (bpf_resolve(b) != 0) {
+        free(b);
+        return -1;
+    }
+
+    struct sock_fprog prog = {
+        .len = (unsigned short)b->len,
+        .filter = b->insns,
+    };
+
+    // 非特权安装seccomp过滤器需要先设置no_new_privs
+    if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) == -1) {
+        perror("设置PR_SET_NO_NEW_PRIVS失败");
+        free(b);
+        return -1;
+    }
+
+    if (notif) {
+        int listener = (int)syscall(SYS_seccomp, SECCOMP_SET_MODE_FILTER, SECCOMP_FILTER_FLAG_NEW_LISTENER, &prog);
+        if (listener == -1) {
+            perror("安装seccomp用户通知过滤器失败");
+        }
+        free(b);
+        return listener;
+    }
+
+    if (prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &prog) == -1) {
+        perror("安装seccomp过滤器失败");
+        free(b);
+        return -1;
+    }
+
+    free(b);
+    return 0;
+}
@@ -0,0 +1,684 @@
+// src/sinkhole.c
+#include "sandbox.h"
+#include <stdarg.h>
+#include <ctype.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+// 主机侧的sinkhole进程：用一个epoll循环服务所有沙箱交来的监听套接字。
+// DNS对任意名称应答198.18.0.0/15中按名称分配的地址，之后的连接可据目的地址
+// 对应回名称；TCP连接接受后记录负载，HTTP请求返回空的200应答，
+// TLS记录ClientHello中的SNI后关闭（无法完成握手）
+
+#define SINKHOLE_EVENTS 64
+#define SINKHOLE_PREVIEW 256          // 每次读取记录的字节数
+#define SINKHOLE_CONN_LOG_MAX 4096    // 每个连接最多记录的负载字节数
+#define SINKHOLE_NAMES_MAX 65536      // 每个沙箱最多分配的DNS名称
+#define SINKHOLE_UDP_LOG_MAX 1024     // 每个UDP端点（沙箱和端口）最多记录的数据报数
+#define SINKHOLE_UDP_BATCH 64         // 每次唤醒在一个UDP端点上最多处理的数据报数
+#define DNS_TYPE_A 1
+#define DNS_TYPE_AAAA 28
+
+enum {
+    EP_CONTROL,                // 与跟踪器的控制连接
+    EP_TCP_LISTEN,             // 沙箱中的TCP监听套接字
+    EP_UDP,                    // 沙箱中的UDP套接字
+    EP_CONN,                   // 已接受的TCP连接
+};
+
+enum {
+    PROTO_UNKNOWN,
+    PROTO_HTTP,
+    PROTO_TLS,
+    PROTO_OTHER,
+};
+
+struct sandbox_state;
+
+typedef struct endpoint {
+    int kind;                  // EP_*
+    int fd;                    // -1表示已关闭，等本轮事件处理完再释放
+    uint16_t port;             // 监听的端口
+    struct sandbox_state *sandbox;
+    char label[384];           // 连接的"对端 -> 目的地址 (名称)"
+    int proto;                 // 连接上识别出的协议（PROTO_*）
+    size_t received;           // 连接收到的字节数
+    size_t datagrams;          // UDP端点收到的数据报数
+    struct endpoint *next;     // 同一沙箱的端点链表，或待释放链表
+} endpoint_t;
+
+typedef struct sandbox_state {
+    uint32_t id;               // 沙箱根进程的pid
+    char **names;              // 下标i的名称分配到SINKHOLE_FAKE_NET + i + 1
+    int name_count;
+    int name_capacity;
+    int *name_slots;           // 按名称（不分大小写）哈希的开放寻址表，存下标+1，0为空
+    size_t slot_mask;          // 表大小 - 1，表大小是2的幂且不少于名称数的两倍
+    endpoint_t *endpoints;
+    struct sandbox_state *next;
+} sandbox_state_t;
+
+typedef struct {
+    int epoll_fd;
+    FILE *log;
+    sandbox_state_t *sandboxes;
+    endpoint_t *garbage;       // 已关闭、待本轮事件处理完后释放的端点
+} sinkhole_t;
+
+static void sink_log(sinkhole_t *sink, uint32_t sandbox, const char *tag, const char *fmt, ...) {
+    uint64_t ns = trace_timestamp_ns();
+    fprintf(sink->log, "[%llu.%06llu] [%u] [%s] ", (unsigned long long)(ns / 1000000000ull),
+            (unsigned long long)(ns % 1000000000ull / 1000), sandbox, tag);
+    va_list ap;
+    va_start(ap, fmt);
+    vfprintf(sink->log, fmt, ap);
+    va_end(ap);
+    fputc('\n', sink->log);
+}
+
+// 把负载写成可读形式，不可打印的字节转义
+static void format_preview(const uint8_t *data, size_t len, char *out, size_t outlen) {
+    size_t pos = 0;
+    for (size_t i = 0; i < len && pos + 5 < outlen; i++) {
+        uint8_t c = data[i];
+        if (c == '\n') {
+            pos += (size_t)snprintf(out + pos, outlen - pos, "\\n");
+        } else if (c == '\r') {
+            pos += (size_t)snprintf(out + pos, outlen - pos, "\\r");
+        } else if (c == '\\' || c == '"') {
+            pos += (size_t)snprintf(out + pos, outlen - pos, "\\%c", c);
+        } else if (c >= 0x20 && c < 0x7f) {
+            out[pos++] = (char)c;
+        } else {
+            pos += (size_t)snprintf(out + pos, outlen - pos, "\\x%02x", c);
+        }
+    }
+    out[pos] = '\0';
+}
+
+static sandbox_state_t *find_sandbox(sinkhole_t *sink, uint32_t id, int create) {
+    for (sandbox_state_t *sb = sink->sandboxes; sb; sb = sb->next) {
+        if (sb->id == id) return sb;
+    }
+    if (!create) {
+        return NULL;
+    }
+    sandbox_state_t *sb = calloc(1, sizeof(*sb));
+    if (!sb) {
+        return NULL;
+    }
+    sb->id = id;
+    sb->next = sink->sandboxes;
+    sink->sandboxes = sb;
+    return sb;
+}
+
+static endpoint_t *add_endpoint(sinkhole_t *sink, sandbox_state_t *sb, int kind, int fd, uint16_t port) {
+    endpoint_t *ep = calloc(1, sizeof(*ep));
+    if (!ep) {
+        close(fd);
+        return NULL;
+    }
+    ep->kind = kind;
+    ep->fd = fd;
+    ep->port = port;
+    ep->sandbox = sb;
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = ep };
+    if (epoll_ctl(sink->epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        close(fd);
+        free(ep);
+        return NULL;
+    }
+    if (sb) {
+        ep->next = sb->endpoints;
+        sb->endpoints = ep;
+    }
+    return ep;
+}
+
+// 关闭端点：从沙箱链表中摘下，放入待释放链表
+static void close_endpoint(sinkhole_t *sink, endpoint_t *ep) {
+    if (ep->kind == EP_CONN) {
+        sink_log(sink, ep->sandbox->id, "TCP", "%s 关闭，共收到 %zu 字节", ep->label, ep->received);
+    } else if (ep->kind == EP_UDP && ep->datagrams > SINKHOLE_UDP_LOG_MAX) {
+        sink_log(sink, ep->sandbox->id, "UDP", "端口 %u 关闭，共收到 %zu 个数据报", ep->port, ep->datagrams);
+    }
+    for (endpoint_t **p = &ep->sandbox->endpoints; *p; p = &(*p)->next) {
+        if (*p == ep) {
+            *p = ep->next;
+            break;
+        }
+    }
+    close(ep->fd);
+    ep->fd = -1;
+    ep->next = sink->garbage;
+    sink->garbage = ep;
+}
+
+static void close_sandbox(sinkhole_t *sink, uint32_t id) {
+    sandbox_state_t *sb = find_sandbox(sink, id, 0);
+    if (!sb) {
+        return;
+    }
+    while (sb->endpoints) {
+        close_endpoint(sink, sb->endpoints);
+    }
+    for (sandbox_state_t **p = &sink->sandboxes; *p; p = &(*p)->next) {
+        if (*p == sb) {
+            *p = sb->next;
+            break;
+        }
+    }
+    for (int i = 0; i < sb->name_count; i++) {
+        free(sb->names[i]);
+    }
+    free(sb->names);
+    free(sb->name_slots);
+    free(sb);
+}
+
+// 不分大小写的FNV-1a
+static size_t name_hash(const char *name) {
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)name; *p; p++) {
+        hash = (hash ^ (uint32_t)tolower(*p)) * 16777619u;
+    }
+    return hash;
+}
+
+// 名称所在的槽位：找到时槽位中是它的下标+1，否则是可以插入的空槽位
+static size_t find_name_slot(const sandbox_state_t *sb, const char *name) {
+    size_t slot = name_hash(name) & sb->slot_mask;
+    while (sb->name_slots[slot] != 0 && strcasecmp(sb->names[sb->name_slots[slot] - 1], name) != 0) {
+        slot = (slot + 1) & sb->slot_mask;
+    }
+    return slot;
+}
+
+// 名称数组和哈希表扩容，哈希表按新的大小重新插入
+static int grow_names(sandbox_state_t *sb) {
+    int capacity = sb->name_capacity ? sb->name_capacity * 2 : 64;
+    char **names = realloc(sb->names, (size_t)capacity * sizeof(*names));
+    if (!names) {
+        return -1;
+    }
+    sb->names = names;
+    size_t slot_count = (size_t)capacity * 2;
+    int *slots = calloc(slot_count, sizeof(*slots));
+    if (!slots) {
+        return -1;
+    }
+    free(sb->name_slots);
+    sb->name_slots = slots;
+    sb->slot_mask = slot_count - 1;
+    sb->name_capacity = capacity;
+    for (int i = 0; i < sb->name_count; i++) {
+        sb->name_slots[find_name_slot(sb, sb->names[i])] = i + 1;
+    }
+    return 0;
+}
+
+// 名称对应的伪造地址（主机字节序），名称过多时返回0
+static uint32_t fake_address(sandbox_state_t *sb, const char *name) {
+    if (sb->name_count == sb->name_capacity) {
+        if (sb->name_count == SINKHOLE_NAMES_MAX) {
+            size_t slot = find_name_slot(sb, name);
+            return sb->name_slots[slot] ? SINKHOLE_FAKE_NET + (uint32_t)sb->name_slots[slot] : 0;
+        }
+        if (grow_names(sb) != 0) {
+            return 0;
+        }
+    }
+    size_t slot = find_name_slot(sb, name);
+    if (sb->name_slots[slot] != 0) {
+        return SINKHOLE_FAKE_NET + (uint32_t)sb->name_slots[slot];
+    }
+    sb->names[sb->name_count] = strdup(name);
+    if (!sb->names[sb->name_count]) {
+        return 0;
+    }
+    sb->name_slots[slot] = ++sb->name_count;
+    return SINKHOLE_FAKE_NET + (uint32_t)sb->name_count;
+}
+
+// 伪造地址对应的名称，不是分配出去的地址时返回NULL
+static const char *fake_address_name(const sandbox_state_t *sb, const struct sockaddr_storage *addr) {
+    uint32_t ip;
+    if (addr->ss_family == AF_INET) {
+        ip = ntohl(((const struct sockaddr_in *)addr)->sin_addr.s_addr);
+    } else if (addr->ss_family == AF_INET6 &&
+               IN6_IS_ADDR_V4MAPPED(&((const struct sockaddr_in6 *)addr)->sin6_addr)) {
+        memcpy(&ip, ((const struct sockaddr_in6 *)addr)->sin6_addr.s6_addr + 12, sizeof(ip));
+        ip = ntohl(ip);
+    } else {
+        return NULL;
+    }
+    if ((ip & SINKHOLE_FAKE_MASK) != SINKHOLE_FAKE_NET) {
+        return NULL;
+    }
+    uint32_t index = ip - SINKHOLE_FAKE_NET;
+    return index >= 1 && index <= (uint32_t)sb->name_count ? sb->names[index - 1] : NULL;
+}
+
+// 解析DNS查询并构造应答：A记录应答分配的地址，其他类型应答无记录。
+// verbose为0时只应答不记录。返回应答长度，查询无效时返回0
+static size_t dns_answer(sinkhole_t *sink, sandbox_state_t *sb, const uint8_t *query, size_t len,
+                         uint8_t *out, size_t outlen, int verbose) {
+    if (len < 12 || (query[2] & 0x80) || ((query[4] << 8) | query[5]) == 0) {
+        return 0;
+    }
+
+    char name[256];
+    size_t name_len = 0;
+    size_t pos = 12;
+    while (pos < len && query[pos] != 0) {
+        size_t label = query[pos];
+        if ((label & 0xc0) || pos + 1 + label > len || name_len + label + 1 >= sizeof(name)) {
+            return 0;
+        }
+        if (name_len > 0) name[name_len++] = '.';
+        memcpy(name + name_len, query + pos + 1, label);
+        name_len += label;
+        pos += 1 + label;
+    }
+    name[name_len] = '\0';
+    if (pos + 5 > len) {
+        return 0;
+    }
+    int qtype = (query[pos + 1] << 8) | query[pos + 2];
+    int qclass = (query[pos + 3] << 8) | query[pos + 4];
+    size_t question_end = pos + 5;
+    if (question_end + 16 > outlen) {
+        return 0;
+    }
+
+    // 头部：QR=1、AA=1，保留opcode和RD，RA=1，只回应第一个问题
+    memcpy(out, query, question_end);
+    out[2] = (uint8_t)(0x80 | (query[2] & 0x79) | 0x04);
+    out[3] = 0x80;
+    out[4] = 0;
+    out[5] = 1;
+    memset(out + 6, 0, 6);
+    size_t n = question_end;
+
+    char printable[512];
+    format_preview((const uint8_t *)name, name_len, printable, sizeof(printable));
+    uint32_t ip = qtype == DNS_TYPE_A && qclass == 1 ? fake_address(sb, name) : 0;
+    if (ip != 0) {
+        static const uint8_t answer[] = { 0xc0, 0x0c, 0, DNS_TYPE_A, 0, 1, 0, 0, 0, 60, 0, 4 };
+        uint32_t be = htonl(ip);
+        out[7] = 1;
+        memcpy(out + n, answer, sizeof(answer));
+        memcpy(out + n + sizeof(answer), &be, sizeof(be));
+        n += sizeof(answer) + sizeof(be);
+
+        char addr[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &be, addr, sizeof(addr));
+        if (verbose) {
+            sink_log(sink, sb->id, "DNS", "A %s -> %s", printable, addr);
+        }
+    } else if (verbose) {
+        sink_log(sink, sb->id, "DNS", "%s %s (无记录)", qtype == DNS_TYPE_AAAA ? "AAAA" :
+                 qtype == DNS_TYPE_A ? "A" : "type", printable);
+    }
+    return n;
+}
+
+// 从TLS ClientHello中取出SNI。成功返回0（没有SNI时sni为空串），不是完整的ClientHello时返回-1
+static int parse_client_hello_sni(const uint8_t *p, size_t len, char *sni, size_t sni_size) {
+    sni[0] = '\0';
+    if (len < 9 || p[0] != 0x16 || p[5] != 0x01) {
+        return -1;
+    }
+    size_t pos = 5 + 4 + 2 + 32;              // 记录头、握手头、client_version、random
+    if (pos + 1 > len) return -1;
+    pos += 1 + (size_t)p[pos];                // session_id
+    if (pos + 2 > len) return -1;
+    pos += 2 + (size_t)((p[pos] << 8) | p[pos + 1]);  // cipher_suites
+    if (pos + 1 > len) return -1;
+    pos += 1 + (size_t)p[pos];                // compression_methods
+    if (pos + 2 > len) return -1;
+    size_t end = pos + 2 + (size_t)((p[pos] << 8) | p[pos + 1]);
+    pos += 2;
+    if (end > len) return -1;
+
+    while (pos + 4 <= end) {
+        int type = (p[pos] << 8) | p[pos + 1];
+        size_t ext_len = (size_t)((p[pos + 2] << 8) | p[pos + 3]);
+        pos += 4;
+        if (pos + ext_len > end) return -1;
+        // server_name: 列表长度(2) + 类型(1，0为主机名) + 名称长度(2) + 名称
+        if (type == 0 && ext_len >= 5 && p[pos + 2] == 0) {
+            size_t name_len = (size_t)((p[pos + 3] << 8) | p[pos + 4]);
+            if (5 + name_len > ext_len) return -1;
+            format_preview(p + pos + 5, name_len, sni, sni_size);
+            return 0;
+        }
+        pos += ext_len;
+    }
+    return 0;
+}
+
+// 是否以HTTP请求方法开头
+static int is_http_request(const uint8_t *data, size_t len) {
+    static const char *const methods[] = {
+        "GET ", "POST ", "HEAD ", "PUT ", "DELETE ", "OPTIONS ", "PATCH ", "CONNECT ",
+    };
+    for (size_t i = 0; i < sizeof(methods) / sizeof(methods[0]); i++) {
+        size_t n = strlen(methods[i]);
+        if (len >= n && memcmp(data, methods[i], n) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// 记录HTTP请求行和Host头，返回空的200应答
+static void handle_http(sinkhole_t *sink, endpoint_t *ep, const uint8_t *data, size_t len) {
+    const uint8_t *eol = memchr(data, '\n', len);
+    size_t line_len = eol ? (size_t)(eol - data) : len;
+    if (line_len > 0 && data[line_len - 1] == '\r') line_len--;
+    char line[SINKHOLE_PREVIEW * 4 + 8], host[SINKHOLE_PREVIEW * 4 + 8] = "";
+    format_preview(data, line_len < SINKHOLE_PREVIEW ? line_len : SINKHOLE_PREVIEW, line, sizeof(line));
+
+    for (const uint8_t *p = eol; p && p + 1 < data + len; p = memchr(p + 1, '\n', (size_t)(data + len - p - 1))) {
+        size_t rest = (size_t)(data + len - p - 1);
+        if (rest > 5 && strncasecmp((const char *)p + 1, "host:", 5) == 0) {
+            const uint8_t *start = p + 6;
+            while (start < data + len && *start == ' ') start++;
+            const uint8_t *stop = memchr(start, '\r', (size_t)(data + len - start));
+            size_t host_len = stop ? (size_t)(stop - start) : (size_t)(data + len - start);
+            format_preview(start, host_len < SINKHOLE_PREVIEW ? host_len : SINKHOLE_PREVIEW, host, sizeof(host));
+            break;
+        }
+    }
+    sink_log(sink, ep->sandbox->id, "HTTP", "%s \"%s\" Host: %s", ep->label, line, host[0] ? host : "-");
+
+    static const char response[] = "HTTP/1.1 200 OK\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    if (send(ep->fd, response, sizeof(response) - 1, MSG_NOSIGNAL) == -1 && errno != EAGAIN) {
+        close_endpoint(sink, ep);
+    }
+}
+
+// 连接上可读：第一次数据决定协议，之后只记录负载
+static void handle_conn(sinkhole_t *sink, endpoint_t *ep) {
+    uint8_t buf[16384];
+    ssize_t n = recv(ep->fd, buf, sizeof(buf), 0);
+    if (n == -1 && (errno == EAGAIN || errno == EINTR)) {
+        return;
+    }
+    if (n <= 0) {
+        close_endpoint(sink, ep);
+        return;
+    }
+
+    size_t len = (size_t)n;
+    int first = ep->proto == PROTO_UNKNOWN;
+    size_t before = ep->received;
+    ep->received += len;
+    if (first) {
+        ep->proto = buf[0] == 0x16 && len > 1 && buf[1] == 0x03 ? PROTO_TLS :
+                    is_http_request(buf, len) ? PROTO_HTTP : PROTO_OTHER;
+    }
+
+    if (ep->proto == PROTO_TLS) {
+        char sni[1024];
+        if (parse_client_hello_sni(buf, len, sni, sizeof(sni)) == 0) {
+            sink_log(sink, ep->sandbox->id, "TLS", "%s ClientHello SNI=%s", ep->label, sni[0] ? sni : "-");
+        } else {
+            sink_log(sink, ep->sandbox->id, "TLS", "%s 不完整的ClientHello (%zu 字节)", ep->label, len);
+        }
+        close_endpoint(sink, ep);
+        return;
+    }
+    if (ep->proto == PROTO_HTTP && is_http_request(buf, len)) {
+        handle_http(sink, ep, buf, len);
+        if (ep->fd == -1) return;
+    }
+
+    if (before < SINKHOLE_CONN_LOG_MAX) {
+        size_t shown = len < SINKHOLE_PREVIEW ? len : SINKHOLE_PREVIEW;
+        char preview[SINKHOLE_PREVIEW * 4 + 8];
+        format_preview(buf, shown, preview, sizeof(preview));
+        sink_log(sink, ep->sandbox->id, "DATA", "%s %zd 字节: \"%s\"%s", ep->label, n, preview,
+                 shown < len ? "..." : "");
+    }
+}
+
+static void format_endpoint_addr(const struct sockaddr_storage *addr, char *out, size_t outlen) {
+    // 双栈套接字上的IPv4连接以映射地址出现，按IPv4显示
+    struct sockaddr_storage plain = *addr;
+    const struct sockaddr_in6 *in6 = (const struct sockaddr_in6 *)addr;
+    if (addr->ss_family == AF_INET6 && IN6_IS_ADDR_V4MAPPED(&in6->sin6_addr)) {
+        struct sockaddr_in *in = (struct sockaddr_in *)&plain;
+        uint16_t port = in6->sin6_port;
+        uint32_t ip;
+        memcpy(&ip, in6->sin6_addr.s6_addr + 12, sizeof(ip));
+        memset(&plain, 0, sizeof(plain));
+        in->sin_family = AF_INET;
+        in->sin_port = port;
+        in->sin_addr.s_addr = ip;
+    }
+    format_sockaddr(&plain, sizeof(plain), out, outlen);
+}
+
+static void handle_accept(sinkhole_t *sink, endpoint_t *listener) {
+    for (;;) {
+        struct sockaddr_storage peer, local;
+        socklen_t peer_len = sizeof(peer), local_len = sizeof(local);
+        int fd = accept4(listener->fd, (struct sockaddr *)&peer, &peer_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd == -1) {
+            return;
+        }
+        // 所有地址都路由为本地地址，getsockname得到的就是样本连接的目的地址
+        if (getsockname(fd, (struct sockaddr *)&local, &local_len) == -1) {
+            memset(&local, 0, sizeof(local));
+        }
+        endpoint_t *ep = add_endpoint(sink, listener->sandbox, EP_CONN, fd, listener->port);
+        if (!ep) {
+            continue;
+        }
+        char peer_str[64], local_str[64];
+        format_endpoint_addr(&peer, peer_str, sizeof(peer_str));
+        format_endpoint_addr(&local, local_str, sizeof(local_str));
+        const char *name = fake_address_name(listener->sandbox, &local);
+        snprintf(ep->label, sizeof(ep->label), "%s -> %s%s%s%s", peer_str, local_str,
+                 name ? " (" : "", name ? name : "", name ? ")" : "");
+        sink_log(sink, listener->sandbox->id, "TCP", "%s 已连接", ep->label);
+    }
+}
+
+// 每次唤醒最多处理SINKHOLE_UDP_BATCH个数据报，其余的等下一轮epoll_wait（水平触发），
+// 一个沙箱的数据报洪泛不会占住循环；每个端点只记录前SINKHOLE_UDP_LOG_MAX个，DNS照常应答
+static void handle_udp(sinkhole_t *sink, endpoint_t *ep) {
+    for (int i = 0; i < SINKHOLE_UDP_BATCH; i++) {
+        uint8_t buf[4096], reply[512];
+        struct sockaddr_storage peer;
+        socklen_t peer_len = sizeof(peer);
+        ssize_t n = recvfrom(ep->fd, buf, sizeof(buf), 0, (struct sockaddr *)&peer, &peer_len);
+        if (n <= 0) {
+            return;
+        }
+        int verbose = ep->datagrams++ < SINKHOLE_UDP_LOG_MAX;
+        if (ep->datagrams == SINKHOLE_UDP_LOG_MAX + 1) {
+            sink_log(sink, ep->sandbox->id, "UDP", "端口 %u 已记录 %d 个数据报，之后只应答和计数",
+                     ep->port, SINKHOLE_UDP_LOG_MAX);
+        }
+        if (ep->port == SINKHOLE_DNS_PORT) {
+            size_t len = dns_answer(sink, ep->sandbox, buf, (size_t)n, reply, sizeof(reply), verbose);
+            if (len > 0) {
+                sendto(ep->fd, reply, len, 0, (struct sockaddr *)&peer, peer_len);
+                continue;
+            }
+        }
+        if (!verbose) {
+            continue;
+        }
+        char peer_str[64], preview[SINKHOLE_PREVIEW * 4 + 8];
+        size_t shown = (size_t)n < SINKHOLE_PREVIEW ? (size_t)n : SINKHOLE_PREVIEW;
+        format_endpoint_addr(&peer, peer_str, sizeof(peer_str));
+        format_preview(buf, shown, preview, sizeof(preview));
+        sink_log(sink, ep->sandbox->id, "UDP", "%s -> 端口 %u %zd 字节: \"%s\"%s", peer_str, ep->port, n,
+                 preview, shown < (size_t)n ? "..." : "");
+    }
+}
+
+// 控制连接上的消息。返回-1表示所有跟踪器都已关闭连接
+static int handle_control(sinkhole_t *sink, endpoint_t *ep) {
+    sinkhole_msg_t msg;
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct iovec iov = { .iov_base = &msg, .iov_len = sizeof(msg) };
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    mh.msg_control = control.buf;
+    mh.msg_controllen = sizeof(control.buf);
+
+    ssize_t n = recvmsg(ep->fd, &mh, MSG_CMSG_CLOEXEC);
+    if (n == -1) {
+        return errno == EINTR || errno == EAGAIN ? 0 : -1;
+    }
+    if (n == 0) {
+        return -1;
+    }
+
+    int fd = -1;
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&mh);
+    if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+        memcpy(&fd, CMSG_DATA(cmsg), sizeof(fd));
+    }
+    if ((size_t)n != sizeof(msg)) {
+        if (fd != -1) close(fd);
+        return 0;
+    }
+
+    if (msg.kind == SINKHOLE_MSG_CLOSE) {
+        close_sandbox(sink, msg.sandbox);
+        return 0;
+    }
+    if (fd == -1) {
+        return 0;
+    }
+    sandbox_state_t *sb = find_sandbox(sink, msg.sandbox, 1);
+    if (!sb) {
+        close(fd);
+        return 0;
+    }
+    int udp = msg.kind == SINKHOLE_MSG_UDP;
+    if (add_endpoint(sink, sb, udp ? EP_UDP : EP_TCP_LISTEN, fd, msg.port)) {
+        sink_log(sink, sb->id, "LISTEN", "%s/%u", udp ? "udp" : "tcp", msg.port);
+    }
+    return 0;
+}
+
+static void sinkhole_run(int ctl_fd, FILE *log) {
+    sinkhole_t sink;
+    memset(&sink, 0, sizeof(sink));
+    sink.log = log;
+    sink.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (sink.epoll_fd == -1) {
+        perror("epoll_create1失败");
+        return;
+    }
+    if (!add_endpoint(&sink, NULL, EP_CONTROL, ctl_fd, 0)) {
+        perror("监听控制连接失败");
+        close(sink.epoll_fd);
+        return;
+    }
+
+    int running = 1;
+    while (running) {
+        struct epoll_event events[SINKHOLE_EVENTS];
+        int n = epoll_wait(sink.epoll_fd, events, SINKHOLE_EVENTS, -1);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait失败");
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            endpoint_t *ep = events[i].data.ptr;
+            if (ep->fd == -1) continue;
+            switch (ep->kind) {
+            case EP_CONTROL:
+                if (handle_control(&sink, ep) != 0) running = 0;
+                break;
+            case EP_TCP_LISTEN:
+                handle_accept(&sink, ep);
+                break;
+            case EP_UDP:
+                handle_udp(&sink, ep);
+                break;
+            default:
+                handle_conn(&sink, ep);
+                break;
+            }
+        }
+        while (sink.garbage) {
+            endpoint_t *next = sink.garbage->next;
+            free(sink.garbage);
+            sink.garbage = next;
+        }
+    }
+
+    while (sink.sandboxes) {
+        close_sandbox(&sink, sink.sandboxes->id);
+    }
+    while (sink.garbage) {
+        endpoint_t *next = sink.garbage->next;
+        free(sink.garbage);
+        sink.garbage = next;
+    }
+    close(sink.epoll_fd);
+}
+
+// 启动sinkhole进程，ctl_fd为交给跟踪器的控制连接（批量模式下由各工作进程继承）。
+// 所有持有控制连接的进程关闭它之后sinkhole退出
+pid_t sinkhole_start(const char *log_path, int *ctl_fd) {
+    FILE *log = fopen(log_path, "a");
+    if (!log) {
+        fprintf(stderr, "无法打开sinkhole日志 '%s': %s\n", log_path, strerror(errno));
+        return -1;
+    }
+
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) == -1) {
+        perror("创建sinkhole控制连接失败");
+        fclose(log);
+        return -1;
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("创建sinkhole进程失败");
+        close(sv[0]);
+        close(sv[1]);
+        fclose(log);
+        return -1;
+    }
+    if (pid == 0) {
+        close(sv[0]);
+        setvbuf(log, NULL, _IOLBF, 0);
+        sinkhole_run(sv[1], log);
+        fclose(log);
+        _exit(0);
+    }
+
+    close(sv[1]);
+    fclose(log);
+    *ctl_fd = sv[0];
+    return pid;
+}
+
+// 关闭控制连接并等待sinkhole处理完剩余事件后退出
+void sinkhole_stop(pid_t pid, int ctl_fd) {
+    close(ctl_fd);
+    while (waitpid(pid, NULL, 0) == -1 && errno == EINTR) {
+    }
+}
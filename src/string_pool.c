@@ -0,0 +1,121 @@
+// src/string_pool.c
+#include "sandbox.h"
+
+// 字符串驻留池：相同的字符串只存一份，用32位id引用。
+// 字符串依次存放在一块连续内存中，id就是偏移（0号是空串，表示无）；
+// 查重用开放寻址哈希表，只存id，扩容时从字符串本身重新计算哈希
+
+#define STRING_POOL_INITIAL_DATA 4096
+#define STRING_POOL_INITIAL_SLOTS 256   // 必须是2的幂
+
+static uint32_t string_hash(const char *str, size_t len) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (unsigned char)str[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static int string_pool_init(string_pool_t *pool) {
+    pool->data = malloc(STRING_POOL_INITIAL_DATA);
+    pool->slots = calloc(STRING_POOL_INITIAL_SLOTS, sizeof(uint32_t));
+    if (!pool->data || !pool->slots) {
+        free(pool->data);
+        free(pool->slots);
+        pool->data = NULL;
+        pool->slots = NULL;
+        return -1;
+    }
+    pool->data[0] = '\0';
+    pool->used = 1;
+    pool->capacity = STRING_POOL_INITIAL_DATA;
+    pool->slot_count = STRING_POOL_INITIAL_SLOTS;
+    pool->count = 0;
+    return 0;
+}
+
+// 哈希表扩容为两倍并重新插入所有id
+static int string_pool_grow_slots(string_pool_t *pool) {
+    size_t slot_count = pool->slot_count * 2;
+    uint32_t *slots = calloc(slot_count, sizeof(uint32_t));
+    if (!slots) {
+        return -1;
+    }
+    for (size_t i = 0; i < pool->slot_count; i++) {
+        uint32_t id = pool->slots[i];
+        if (id == 0) continue;
+        const char *str = pool->data + id;
+        size_t idx = string_hash(str, strlen(str)) & (slot_count - 1);
+        while (slots[idx] != 0) {
+            idx = (idx + 1) & (slot_count - 1);
+        }
+        slots[idx] = id;
+    }
+    free(pool->slots);
+    pool->slots = slots;
+    pool->slot_count = slot_count;
+    return 0;
+}
+
+// 驻留长度为len的字符串（不必以NUL结尾，不能含NUL），返回id；
+// 空串或内存不足时返回0
+uint32_t string_pool_intern(string_pool_t *pool, const char *str, size_t len) {
+    if (len == 0 || (!pool->data && string_pool_init(pool) != 0)) {
+        return 0;
+    }
+
+    uint32_t hash = string_hash(str, len);
+    size_t idx = hash & (pool->slot_count - 1);
+    while (pool->slots[idx] != 0) {
+        const char *existing = pool->data + pool->slots[idx];
+        if (memcmp(existing, str, len) == 0 && existing[len] == '\0') {
+            return pool->slots[idx];
+        }
+        idx = (idx + 1) & (pool->slot_count - 1);
+    }
+
+    if (pool->used + len + 1 > UINT32_MAX) {
+        return 0;
+    }
+    if (pool->used + len + 1 > pool->capacity) {
+        size_t capacity = pool->capacity * 2;
+        while (capacity < pool->used + len + 1) capacity *= 2;
+        char *data = realloc(pool->data, capacity);
+        if (!data) {
+            return 0;
+        }
+        pool->data = data;
+        pool->capacity = capacity;
+    }
+
+    // 负载因子保持在1/2以下；扩容失败时只要还有空槽就继续使用
+    if ((pool->count + 1) * 2 > pool->slot_count) {
+        if (string_pool_grow_slots(pool) != 0 && pool->count + 1 >= pool->slot_count) {
+            return 0;
+        }
+        idx = hash & (pool->slot_count - 1);
+        while (pool->slots[idx] != 0) {
+            idx = (idx + 1) & (pool->slot_count - 1);
+        }
+    }
+
+    uint32_t id = (uint32_t)pool->used;
+    memcpy(pool->data + id, str, len);
+    pool->data[id + len] = '\0';
+    pool->used += len + 1;
+    pool->slots[idx] = id;
+    pool->count++;
+    return id;
+}
+
+// 按id取字符串，id为0时返回空串
+const char *string_pool_get(const string_pool_t *pool, uint32_t id) {
+    return pool->data && id < pool->used ? pool->data + id : "";
+}
+
+void string_pool_free(string_pool_t *pool) {
+    free(pool->data);
+    free(pool->slots);
+    memset(pool, 0, sizeof(*pool));
+}
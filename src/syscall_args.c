@@ -0,0 +1,395 @@
+// src/syscall_args.c
+#include "sandbox.h"
+#include <sys/mman.h>
+#include <sys/un.h>
+#include <ctype.h>
+
+// 表驱动的系统调用参数描述：每个关心的系统调用一个描述符。
+// 只描述本机ABI的调用号；跟踪器据此决定读取哪些参数的内存，
+// 文本日志、malbox-decode和NDJSON据此格式化参数块
+
+#define ARG(n, t) { n, t, -1 }
+#define ARG_X(n, t, x) { n, t, x }
+#define PATH_CWD(n) { n, ARG_PATH, -1 }
+#define PATH_AT(n, dirfd) { n, ARG_PATH, dirfd }
+
+static const syscall_desc_t syscall_descs[SYSCALL_MAX] = {
+    // 文件
+    [__NR_open] = { 3, { PATH_CWD("pathname"), ARG("flags", ARG_OPEN_FLAGS), ARG("mode", ARG_MODE) } },
+    [__NR_openat] = { 4, { ARG("dirfd", ARG_DIRFD), PATH_AT("pathname", 0),
+                           ARG("flags", ARG_OPEN_FLAGS), ARG("mode", ARG_MODE) } },
+    [__NR_openat2] = { 4, { ARG("dirfd", ARG_DIRFD), PATH_AT("pathname", 0),
+                            ARG("how", ARG_HEX), ARG("size", ARG_INT) } },
+    [__NR_creat] = { 2, { PATH_CWD("pathname"), ARG("mode", ARG_MODE) } },
+    [__NR_stat] = { 2, { PATH_CWD("pathname"), ARG("statbuf", ARG_HEX) } },
+    [__NR_lstat] = { 2, { PATH_CWD("pathname"), ARG("statbuf", ARG_HEX) } },
+    [__NR_newfstatat] = { 4, { ARG("dirfd", ARG_DIRFD), PATH_AT("pathname", 0),
+                               ARG("statbuf", ARG_HEX), ARG("flags", ARG_AT_FLAGS) } },
+    [__NR_statx] = { 5, { ARG("dirfd", ARG_DIRFD), PATH_AT("pathname", 0), ARG("flags", ARG_AT_FLAGS),
+                          ARG("mask", ARG_HEX), ARG("statxbuf", ARG_HEX) } },
+    [__NR_access] = { 2, { PATH_CWD("pathname"), ARG("mode", ARG_INT) } },
+    [__NR_faccessat] = { 3, { ARG("dirfd", ARG_DIRFD), PATH_AT("pathname", 0), ARG("mode", ARG_INT) } },
+    [__NR_faccessat2] = { 4, { ARG("dirfd", ARG_DIRFD), PATH_AT("pathname", 0), ARG("mode", ARG_INT),
+                               ARG("flags", ARG_AT_FLAGS) } },
+    [__NR_readlink] = { 3, { PATH_CWD("pathname"), ARG("buf", ARG_HEX), ARG("bufsiz", ARG_INT) } },
+    [__NR_readlinkat] = { 4, { ARG("dirfd", ARG_DIRFD), PATH_AT("pathname", 0), ARG("buf", ARG_HEX),
+                               ARG("bufsiz", ARG_INT) } },
+    [__NR_unlink] = { 1, { PATH_CWD("pathname") } },
+    [__NR_unlinkat] = { 3, { ARG("dirfd", ARG_DIRFD), PATH_AT("pathname", 0), ARG("flags", ARG_AT_FLAGS) } },
+    [__NR_mkdir] = { 2, { PATH_CWD("pathname"), ARG("mode", ARG_MODE) } },
+    [__NR_mkdirat] = { 3, { ARG("dirfd", ARG_DIRFD), PATH_AT("pathname", 0), ARG("mode", ARG_MODE) } },
+    [__NR_rmdir] = { 1, { PATH_CWD("pathname") } },
+    [__NR_rename] = { 2, { PATH_CWD("oldpath"), PATH_CWD("newpath") } },
+    [__NR_renameat] = { 4, { ARG("olddirfd", ARG_DIRFD), PATH_AT("oldpath", 0),
+                             ARG("newdirfd", ARG_DIRFD), PATH_AT("newpath", 2) } },
+    [__NR_renameat2] = { 5, { ARG("olddirfd", ARG_DIRFD), PATH_AT("oldpath", 0),
+                              ARG("newdirfd", ARG_DIRFD), PATH_AT("newpath", 2), ARG("flags", ARG_HEX) } },
+    [__NR_link] = { 2, { PATH_CWD("oldpath"), PATH_CWD("newpath") } },
+    [__NR_linkat] = { 5, { ARG("olddirfd", ARG_DIRFD), PATH_AT("oldpath", 0),
+                           ARG("newdirfd", ARG_DIRFD), PATH_AT("newpath", 2), ARG("flags", ARG_AT_FLAGS) } },
+    [__NR_symlink] = { 2, { ARG("target", ARG_STRING), PATH_CWD("linkpath") } },
+    [__NR_symlinkat] = { 3, { ARG("target", ARG_STRING), ARG("newdirfd", ARG_DIRFD), PATH_AT("linkpath", 1) } },
+    [__NR_chmod] = { 2, { PATH_CWD("pathname"), ARG("mode", ARG_MODE) } },
+    [__NR_fchmodat] = { 3, { ARG("dirfd", ARG_DIRFD), PATH_AT("pathname", 0), ARG("mode", ARG_MODE) } },
+    [__NR_truncate] = { 2, { PATH_CWD("path"), ARG("length", ARG_INT) } },
+    [__NR_chdir] = { 1, { PATH_CWD("path") } },
+    [__NR_fchdir] = { 1, { ARG("fd", ARG_FD) } },
+    // 文件描述符（输出缓冲区在入口时还没有内容，只记录地址）
+    [__NR_read] = { 3, { ARG("fd", ARG_FD), ARG("buf", ARG_HEX), ARG("count", ARG_INT) } },
+    [__NR_pread64] = { 4, { ARG("fd", ARG_FD), ARG("buf", ARG_HEX), ARG("count", ARG_INT),
+                            ARG("offset", ARG_INT) } },
+    [__NR_write] = { 3, { ARG("fd", ARG_FD), ARG_X("buf", ARG_BUFFER, 2), ARG("count", ARG_INT) } },
+    [__NR_pwrite64] = { 4, { ARG("fd", ARG_FD), ARG_X("buf", ARG_BUFFER, 2), ARG("count", ARG_INT),
+                             ARG("offset", ARG_INT) } },
+    [__NR_readv] = { 3, { ARG("fd", ARG_FD), ARG("iov", ARG_HEX), ARG("iovcnt", ARG_INT) } },
+    [__NR_writev] = { 3, { ARG("fd", ARG_FD), ARG("iov", ARG_HEX), ARG("iovcnt", ARG_INT) } },
+    [__NR_close] = { 1, { ARG("fd", ARG_FD) } },
+    [__NR_fstat] = { 2, { ARG("fd", ARG_FD), ARG("statbuf", ARG_HEX) } },
+    [__NR_lseek] = { 3, { ARG("fd", ARG_FD), ARG("offset", ARG_INT), ARG("whence", ARG_INT) } },
+    [__NR_ioctl] = { 3, { ARG("fd", ARG_FD), ARG("request", ARG_HEX), ARG("arg", ARG_HEX) } },
+    [__NR_fcntl] = { 3, { ARG("fd", ARG_FD), ARG("cmd", ARG_INT), ARG("arg", ARG_HEX) } },
+    [__NR_dup] = { 1, { ARG("oldfd", ARG_FD) } },
+    [__NR_dup2] = { 2, { ARG("oldfd", ARG_FD), ARG("newfd", ARG_FD) } },
+    [__NR_dup3] = { 3, { ARG("oldfd", ARG_FD), ARG("newfd", ARG_FD), ARG("flags", ARG_OPEN_FLAGS) } },
+    [__NR_getdents64] = { 3, { ARG("fd", ARG_FD), ARG("dirp", ARG_HEX), ARG("count", ARG_INT) } },
+    [__NR_fsync] = { 1, { ARG("fd", ARG_FD) } },
+    [__NR_ftruncate] = { 2, { ARG("fd", ARG_FD), ARG("length", ARG_INT) } },
+    [__NR_fchmod] = { 2, { ARG("fd", ARG_FD), ARG("mode", ARG_MODE) } },
+    [__NR_flock] = { 2, { ARG("fd", ARG_FD), ARG("operation", ARG_INT) } },
+    [__NR_sendfile] = { 4, { ARG("out_fd", ARG_FD), ARG("in_fd", ARG_FD), ARG("offset", ARG_HEX),
+                             ARG("count", ARG_INT) } },
+    // 进程
+    [__NR_execve] = { 3, { PATH_CWD("filename"), ARG("argv", ARG_STRING_ARRAY),
+                           ARG("envp", ARG_STRING_ARRAY) } },
+    [__NR_execveat] = { 5, { ARG("dirfd", ARG_DIRFD), PATH_AT("pathname", 0), ARG("argv", ARG_STRING_ARRAY),
+                             ARG("envp", ARG_STRING_ARRAY), ARG("flags", ARG_AT_FLAGS) } },
+    [__NR_clone] = { 5, { ARG("flags", ARG_CLONE_FLAGS), ARG("stack", ARG_HEX), ARG("parent_tid", ARG_HEX),
+                          ARG("child_tid", ARG_HEX), ARG("tls", ARG_HEX) } },
+    // 内存
+    [__NR_mmap] = { 6, { ARG("addr", ARG_HEX), ARG("length", ARG_INT), ARG("prot", ARG_PROT),
+                         ARG("flags", ARG_MMAP_FLAGS), ARG("fd", ARG_FD), ARG("offset", ARG_HEX) } },
+    [__NR_mprotect] = { 3, { ARG("addr", ARG_HEX), ARG("len", ARG_INT), ARG("prot", ARG_PROT) } },
+    // 网络
+    [__NR_connect] = { 3, { ARG("sockfd", ARG_FD), ARG_X("addr", ARG_SOCKADDR, 2), ARG("addrlen", ARG_INT) } },
+    [__NR_bind] = { 3, { ARG("sockfd", ARG_FD), ARG_X("addr", ARG_SOCKADDR, 2), ARG("addrlen", ARG_INT) } },
+    [__NR_sendto] = { 6, { ARG("sockfd", ARG_FD), ARG_X("buf", ARG_BUFFER, 2), ARG("len", ARG_INT),
+                           ARG("flags", ARG_HEX), ARG_X("dest_addr", ARG_SOCKADDR, 5),
+                           ARG("addrlen", ARG_INT) } },
+    [__NR_recvfrom] = { 6, { ARG("sockfd", ARG_FD), ARG("buf", ARG_HEX), ARG("len", ARG_INT),
+                             ARG("flags", ARG_HEX), ARG("src_addr", ARG_HEX), ARG("addrlen", ARG_HEX) } },
+    [__NR_sendmsg] = { 3, { ARG("sockfd", ARG_FD), ARG("msg", ARG_HEX), ARG("flags", ARG_HEX) } },
+    [__NR_recvmsg] = { 3, { ARG("sockfd", ARG_FD), ARG("msg", ARG_HEX), ARG("flags", ARG_HEX) } },
+    [__NR_listen] = { 2, { ARG("sockfd", ARG_FD), ARG("backlog", ARG_INT) } },
+    [__NR_accept] = { 3, { ARG("sockfd", ARG_FD), ARG("addr", ARG_HEX), ARG("addrlen", ARG_HEX) } },
+    [__NR_accept4] = { 4, { ARG("sockfd", ARG_FD), ARG("addr", ARG_HEX), ARG("addrlen", ARG_HEX),
+                            ARG("flags", ARG_HEX) } },
+    [__NR_shutdown] = { 2, { ARG("sockfd", ARG_FD), ARG("how", ARG_INT) } },
+    [__NR_getsockname] = { 3, { ARG("sockfd", ARG_FD), ARG("addr", ARG_HEX), ARG("addrlen", ARG_HEX) } },
+    [__NR_getpeername] = { 3, { ARG("sockfd", ARG_FD), ARG("addr", ARG_HEX), ARG("addrlen", ARG_HEX) } },
+    [__NR_setsockopt] = { 5, { ARG("sockfd", ARG_FD), ARG("level", ARG_INT), ARG("optname", ARG_INT),
+                               ARG("optval", ARG_HEX), ARG("optlen", ARG_INT) } },
+    [__NR_getsockopt] = { 5, { ARG("sockfd", ARG_FD), ARG("level", ARG_INT), ARG("optname", ARG_INT),
+                               ARG("optval", ARG_HEX), ARG("optlen", ARG_HEX) } },
+};
+
+// 返回系统调用的参数描述符；兼容ABI和没有描述符的调用返回NULL
+const syscall_desc_t *get_syscall_desc(int abi, int syscall_nr) {
+    if (abi != SYSCALL_ABI_NATIVE || syscall_nr < 0 || syscall_nr >= SYSCALL_MAX ||
+        syscall_descs[syscall_nr].argc == 0) {
+        return NULL;
+    }
+    return &syscall_descs[syscall_nr];
+}
+
+// 在参数块中查找第index个参数的数据，找到返回0
+int arg_blob_find(const char *blob, size_t len, int index, const char **data, size_t *data_len) {
+    size_t pos = 0;
+    while (pos + sizeof(arg_blob_entry_t) <= len) {
+        arg_blob_entry_t entry;
+        memcpy(&entry, blob + pos, sizeof(entry));
+        pos += sizeof(entry);
+        if (entry.len > len - pos) {
+            break;
+        }
+        if (entry.index == index) {
+            *data = blob + pos;
+            *data_len = entry.len;
+            return 0;
+        }
+        pos += entry.len;
+    }
+    return -1;
+}
+
+// 参数块中的路径：有解析结果时取绝对路径，否则取原始路径（不存在时返回空串）
+const char *arg_blob_path(const char *blob, size_t len, int index, size_t *path_len) {
+    const char *data;
+    size_t data_len;
+    if (arg_blob_find(blob, len, index, &data, &data_len) != 0) {
+        *path_len = 0;
+        return "";
+    }
+    size_t raw_len = strnlen(data, data_len);
+    if (raw_len + 1 < data_len) {
+        *path_len = data_len - raw_len - 1;
+        return data + raw_len + 1;
+    }
+    *path_len = raw_len;
+    return data;
+}
+
+typedef struct {
+    uint64_t value;
+    const char *name;
+} flag_name_t;
+
+#define FLAG(f) { f, #f }
+
+static const flag_name_t open_flags[] = {
+    FLAG(O_TMPFILE), FLAG(O_SYNC), FLAG(O_CREAT), FLAG(O_EXCL), FLAG(O_NOCTTY), FLAG(O_TRUNC),
+    FLAG(O_APPEND), FLAG(O_NONBLOCK), FLAG(O_DSYNC), FLAG(O_ASYNC), FLAG(O_DIRECT), FLAG(O_DIRECTORY),
+    FLAG(O_NOFOLLOW), FLAG(O_NOATIME), FLAG(O_CLOEXEC), FLAG(O_PATH),
+};
+
+static const flag_name_t prot_flags[] = {
+    FLAG(PROT_READ), FLAG(PROT_WRITE), FLAG(PROT_EXEC), FLAG(PROT_GROWSDOWN), FLAG(PROT_GROWSUP),
+};
+
+static const flag_name_t mmap_flags[] = {
+    FLAG(MAP_SHARED_VALIDATE), FLAG(MAP_SHARED), FLAG(MAP_PRIVATE), FLAG(MAP_FIXED), FLAG(MAP_ANONYMOUS),
+    FLAG(MAP_32BIT), FLAG(MAP_GROWSDOWN), FLAG(MAP_DENYWRITE), FLAG(MAP_EXECUTABLE), FLAG(MAP_LOCKED),
+    FLAG(MAP_NORESERVE), FLAG(MAP_POPULATE), FLAG(MAP_NONBLOCK), FLAG(MAP_STACK), FLAG(MAP_HUGETLB),
+    FLAG(MAP_SYNC), FLAG(MAP_FIXED_NOREPLACE),
+};
+
+static const flag_name_t clone_flags[] = {
+    FLAG(CLONE_VM), FLAG(CLONE_FS), FLAG(CLONE_FILES), FLAG(CLONE_SIGHAND), FLAG(CLONE_PIDFD),
+    FLAG(CLONE_PTRACE), FLAG(CLONE_VFORK), FLAG(CLONE_PARENT), FLAG(CLONE_THREAD), FLAG(CLONE_NEWNS),
+    FLAG(CLONE_SYSVSEM), FLAG(CLONE_SETTLS), FLAG(CLONE_PARENT_SETTID), FLAG(CLONE_CHILD_CLEARTID),
+    FLAG(CLONE_DETACHED), FLAG(CLONE_UNTRACED), FLAG(CLONE_CHILD_SETTID), FLAG(CLONE_NEWCGROUP),
+    FLAG(CLONE_NEWUTS), FLAG(CLONE_NEWIPC), FLAG(CLONE_NEWUSER), FLAG(CLONE_NEWPID), FLAG(CLONE_NEWNET),
+    FLAG(CLONE_IO),
+};
+
+static const flag_name_t at_flags[] = {
+    FLAG(AT_SYMLINK_NOFOLLOW), FLAG(AT_REMOVEDIR), FLAG(AT_SYMLINK_FOLLOW), FLAG(AT_NO_AUTOMOUNT),
+    FLAG(AT_EMPTY_PATH), FLAG(AT_EACCESS),
+};
+
+static void append_name(char *out, size_t outlen, size_t *pos, const char *name) {
+    int n = snprintf(out + *pos, outlen - *pos, "%s%s", *pos > 0 ? "|" : "", name);
+    if (n > 0) {
+        *pos = *pos + (size_t)n < outlen ? *pos + (size_t)n : outlen - 1;
+    }
+}
+
+// 把标志位参数格式化为"A|B|0x..."，返回长度
+size_t format_flag_names(int type, uint64_t value, char *out, size_t outlen) {
+    const flag_name_t *table;
+    size_t count;
+    size_t pos = 0;
+    char extra[32];
+    out[0] = '\0';
+
+    switch (type) {
+    case ARG_OPEN_FLAGS:
+        // 访问模式不是独立的位
+        append_name(out, outlen, &pos, (value & O_ACCMODE) == O_WRONLY ? "O_WRONLY" :
+                                       (value & O_ACCMODE) == O_RDWR ? "O_RDWR" :
+                                       (value & O_ACCMODE) == O_RDONLY ? "O_RDONLY" : "O_ACCMODE");
+        value &= ~(uint64_t)O_ACCMODE;
+        table = open_flags;
+        count = sizeof(open_flags) / sizeof(open_flags[0]);
+        break;
+    case ARG_PROT:
+        if (value == PROT_NONE) {
+            append_name(out, outlen, &pos, "PROT_NONE");
+        }
+        table = prot_flags;
+        count = sizeof(prot_flags) / sizeof(prot_flags[0]);
+        break;
+    case ARG_MMAP_FLAGS:
+        table = mmap_flags;
+        count = sizeof(mmap_flags) / sizeof(mmap_flags[0]);
+        break;
+    case ARG_CLONE_FLAGS:
+        // 低8位是子进程退出时发给父进程的信号
+        if (value & 0xff) {
+            const char *sig = sigabbrev_np((int)(value & 0xff));
+            snprintf(extra, sizeof(extra), "SIG%s", sig ? sig : "?");
+            append_name(out, outlen, &pos, extra);
+            value &= ~(uint64_t)0xff;
+        }
+        table = clone_flags;
+        count = sizeof(clone_flags) / sizeof(clone_flags[0]);
+        break;
+    case ARG_AT_FLAGS:
+        table = at_flags;
+        count = sizeof(at_flags) / sizeof(at_flags[0]);
+        break;
+    default:
+        snprintf(out, outlen, "%#llx", (unsigned long long)value);
+        return strlen(out);
+    }
+
+    // 复合标志（O_TMPFILE、O_SYNC、MAP_SHARED_VALIDATE）排在表前面，先匹配先消耗
+    for (size_t i = 0; i < count && value; i++) {
+        if (table[i].value && (value & table[i].value) == table[i].value) {
+            append_name(out, outlen, &pos, table[i].name);
+            value &= ~table[i].value;
+        }
+    }
+    if (value || pos == 0) {
+        snprintf(extra, sizeof(extra), "%#llx", (unsigned long long)value);
+        append_name(out, outlen, &pos, extra);
+    }
+    return pos;
+}
+
+// 输出带引号的字符串，不可打印字符转义
+static void print_quoted(FILE *fp, const char *str, size_t len) {
+    fputc('"', fp);
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)str[i];
+        if (c == '"' || c == '\\') {
+            fprintf(fp, "\\%c", c);
+        } else if (c == '\n') {
+            fputs("\\n", fp);
+        } else if (isprint(c) || c >= 0x80) {
+            fputc(c, fp);
+        } else {
+            fprintf(fp, "\\x%02x", c);
+        }
+    }
+    fputc('"', fp);
+}
+
+static void print_arg_value(FILE *fp, const syscall_arg_desc_t *desc, const uint64_t *args, int index,
+                            const char *data, size_t data_len, int found) {
+    uint64_t value = args[index];
+    char buf[512];
+
+    switch (desc->type) {
+    case ARG_INT:
+        fprintf(fp, "%lld", (long long)value);
+        return;
+    case ARG_FD:
+    case ARG_DIRFD:
+        // 有fd跟踪的描述时按strace -y的样式附在fd后面
+        if (desc->type == ARG_DIRFD && (int)value == AT_FDCWD) {
+            fputs("AT_FDCWD", fp);
+        } else if (found) {
+            fprintf(fp, "%d<%.*s>", (int)value, (int)data_len, data);
+        } else {
+            fprintf(fp, "%d", (int)value);
+        }
+        return;
+    case ARG_HEX:
+        fprintf(fp, "%#llx", (unsigned long long)value);
+        return;
+    case ARG_MODE:
+        fprintf(fp, "%#llo", (unsigned long long)value);
+        return;
+    case ARG_OPEN_FLAGS:
+    case ARG_PROT:
+    case ARG_MMAP_FLAGS:
+    case ARG_CLONE_FLAGS:
+    case ARG_AT_FLAGS:
+        format_flag_names(desc->type, value, buf, sizeof(buf));
+        fputs(buf, fp);
+        return;
+    default:
+        break;
+    }
+
+    if (!found) {
+        if (value) {
+            fprintf(fp, "%#llx", (unsigned long long)value);
+        } else {
+            fputs("NULL", fp);
+        }
+        return;
+    }
+
+    switch (desc->type) {
+    case ARG_PATH: {
+        size_t raw_len = strnlen(data, data_len);
+        print_quoted(fp, data, raw_len);
+        if (raw_len + 1 < data_len) {
+            fputs(" => ", fp);
+            print_quoted(fp, data + raw_len + 1, strnlen(data + raw_len + 1, data_len - raw_len - 1));
+        }
+        break;
+    }
+    case ARG_STRING:
+        print_quoted(fp, data, strnlen(data, data_len));
+        break;
+    case ARG_STRING_ARRAY: {
+        fputc('[', fp);
+        for (size_t pos = 0; pos < data_len;) {
+            size_t n = strnlen(data + pos, data_len - pos);
+            if (pos > 0) fputs(", ", fp);
+            print_quoted(fp, data + pos, n);
+            pos += n + 1;
+        }
+        fputc(']', fp);
+        break;
+    }
+    case ARG_SOCKADDR: {
+        struct sockaddr_storage addr;
+        memset(&addr, 0, sizeof(addr));
+        size_t len = data_len < sizeof(addr) ? data_len : sizeof(addr);
+        memcpy(&addr, data, len);
+        format_sockaddr(&addr, len, buf, sizeof(buf));
+        fputs(buf, fp);
+        break;
+    }
+    case ARG_BUFFER:
+        print_quoted(fp, data, data_len);
+        if (desc->aux >= 0 && args[desc->aux] > data_len) {
+            fputs("...", fp);
+        }
+        break;
+    default:
+        fprintf(fp, "%#llx", (unsigned long long)value);
+        break;
+    }
+}
+
+// 按描述符输出一行解码后的参数，如 openat(dirfd=AT_FDCWD, pathname="a" => "/tmp/a", ...)
+void format_syscall_args(FILE *fp, int syscall_nr, const uint64_t *args, const char *blob, size_t len) {
+    const syscall_desc_t *desc = get_syscall_desc(SYSCALL_ABI_NATIVE, syscall_nr);
+    if (!desc) {
+        return;
+    }
+
+    fprintf(fp, "%s(", get_syscall_name(syscall_nr));
+    for (int i = 0; i < desc->argc; i++) {
+        const char *data = NULL;
+        size_t data_len = 0;
+        int found = arg_blob_find(blob, len, i, &data, &data_len) == 0;
+        fprintf(fp, "%s%s=", i > 0 ? ", " : "", desc->args[i].name);
+        print_arg_value(fp, &desc->args[i], args, i, data, data_len, found);
+    }
+    fputs(")", fp);
+}
@@ -0,0 +1,289 @@
+// src/syscall_capture.c
+#include "sandbox.h"
+
+// 按描述符读取系统调用参数引用的内存并序列化为参数块。
+// 一次停止中所有直接引用的内存（路径、地址、缓冲区、指针数组）合并为一次
+// process_vm_readv；argv/envp的字符串要等指针数组读回后才知道地址，再合并读取一次
+
+#define CAPTURE_MAX_READS (6 + 2 * ARG_ARRAY_ENTRIES)
+#define CAPTURE_PREVIEW_MAX 4096  // 缓冲区预览的硬上限
+#define CAPTURE_ARRAY_PEEK 256    // argv/envp每个字符串首次读取的字节数，更长的再单独补读
+
+typedef struct {
+    arg_capture_t *capture;
+    size_t scratch_used;
+    tracee_read_t reads[CAPTURE_MAX_READS];
+    int count;
+} capture_plan_t;
+
+static size_t page_remaining(unsigned long addr) {
+    static size_t page_size;
+    if (page_size == 0) {
+        long ret = sysconf(_SC_PAGESIZE);
+        page_size = ret > 0 ? (size_t)ret : 4096;
+    }
+    return page_size - (addr & (page_size - 1));
+}
+
+// 在暂存区中分配len字节并加入读取计划，返回读取项的下标（-1表示空间不足）
+static int plan_read(capture_plan_t *plan, unsigned long addr, size_t len) {
+    if (plan->count == CAPTURE_MAX_READS || len == 0 ||
+        plan->scratch_used + len > sizeof(plan->capture->scratch)) {
+        return -1;
+    }
+    tracee_read_t *read = &plan->reads[plan->count];
+    read->addr = addr;
+    read->buf = plan->capture->scratch + plan->scratch_used;
+    read->len = len;
+    plan->scratch_used += len;
+    return plan->count++;
+}
+
+// 字符串先只读到页尾（下一页可能不可读，会让整批读取提前中断）
+static int plan_string(capture_plan_t *plan, unsigned long addr, size_t maxlen) {
+    size_t len = page_remaining(addr);
+    return plan_read(plan, addr, len < maxlen ? len : maxlen);
+}
+
+// 批量读取后补全字符串：未在首段内结束的改用read_tracee_string读完整，
+// 返回字符串长度（-1表示不可读），字符串保证以NUL结尾
+static ssize_t finish_string(capture_plan_t *plan, pid_t tid, int slot, size_t maxlen) {
+    tracee_read_t *read = &plan->reads[slot];
+    char *buf = read->buf;
+    if (read->result <= 0) {
+        return -1;
+    }
+    char *nul = memchr(buf, '\0', (size_t)read->result);
+    if (nul) {
+        return nul - buf;
+    }
+    if ((size_t)read->result < read->len || read->len >= maxlen) {
+        // 后面不可读或已达上限：截断
+        buf[read->result - 1] = '\0';
+        return read->result - 1;
+    }
+    // 跨页的长字符串：在暂存区末尾重新读取完整内容
+    if (plan->scratch_used + maxlen > sizeof(plan->capture->scratch)) {
+        buf[read->result - 1] = '\0';
+        return read->result - 1;
+    }
+    char *full = plan->capture->scratch + plan->scratch_used;
+    ssize_t n = read_tracee_string(tid, read->addr, full, maxlen);
+    if (n < 0) {
+        buf[read->result - 1] = '\0';
+        return read->result - 1;
+    }
+    plan->scratch_used += (size_t)n + 1;
+    read->buf = full;
+    return n;
+}
+
+// 向参数块追加一项，空间不足时丢弃
+char *arg_blob_append(arg_capture_t *capture, int index, int type, size_t len) {
+    if (len > UINT16_MAX || capture->len + sizeof(arg_blob_entry_t) + len > sizeof(capture->blob)) {
+        return NULL;
+    }
+    arg_blob_entry_t entry = { .index = (uint8_t)index, .type = (uint8_t)type, .len = (uint16_t)len };
+    memcpy(capture->blob + capture->len, &entry, sizeof(entry));
+    char *data = capture->blob + capture->len + sizeof(entry);
+    capture->len += sizeof(entry) + len;
+    return data;
+}
+
+// 读取/proc下的符号链接
+static ssize_t read_proc_link(pid_t tid, const char *what, char *out, size_t outlen) {
+    char link[64];
+    snprintf(link, sizeof(link), "/proc/%d/%s", tid, what);
+    ssize_t n = readlink(link, out, outlen - 1);
+    if (n < 0) {
+        return -1;
+    }
+    out[n] = '\0';
+    return n;
+}
+
+// 把相对路径按dirfd（或当前目录）解析为沙箱内的绝对路径。
+// /proc给出的是跟踪器视角的路径，要去掉沙箱根目录的前缀。绝对路径不需要解析，返回-1
+ssize_t resolve_tracee_path(pid_t tid, long dirfd, const char *path, char *out, size_t outlen) {
+    if (path[0] == '/') {
+        return -1;
+    }
+
+    char base[PATH_MAX], root[PATH_MAX];
+    char what[32];
+    if ((int)dirfd == AT_FDCWD) {
+        snprintf(what, sizeof(what), "cwd");
+    } else {
+        snprintf(what, sizeof(what), "fd/%d", (int)dirfd);
+    }
+    ssize_t base_len = read_proc_link(tid, what, base, sizeof(base));
+    if (base_len < 0) {
+        return -1;
+    }
+
+    const char *inside = base;
+    ssize_t root_len = read_proc_link(tid, "root", root, sizeof(root));
+    if (root_len > 1 && strncmp(base, root, (size_t)root_len) == 0 &&
+        (base[root_len] == '/' || base[root_len] == '\0')) {
+        inside = base[root_len] == '\0' ? "/" : base + root_len;
+    }
+
+    int n;
+    if (path[0] == '\0') {
+        n = snprintf(out, outlen, "%s", inside);  // AT_EMPTY_PATH：dirfd本身
+    } else {
+        n = snprintf(out, outlen, "%s%s%s", inside, strcmp(inside, "/") == 0 ? "" : "/", path);
+    }
+    return n < 0 || (size_t)n >= outlen ? -1 : n;
+}
+
+// 读取并序列化一次系统调用入口的参数，成功时capture->len为参数块长度。
+// 没有描述符的系统调用直接返回，不读取任何内存
+int capture_syscall_args(pid_t tid, int syscall_nr, const unsigned long *args, int preview_bytes,
+                         arg_capture_t *capture) {
+    capture->len = 0;
+    const syscall_desc_t *desc = get_syscall_desc(SYSCALL_ABI_NATIVE, syscall_nr);
+    if (!desc) {
+        return 0;
+    }
+
+    capture_plan_t plan;
+    plan.capture = capture;
+    plan.scratch_used = 0;
+    plan.count = 0;
+
+    // 第一批：参数直接指向的内存
+    int slot[6];
+    for (int i = 0; i < desc->argc; i++) {
+        const syscall_arg_desc_t *arg = &desc->args[i];
+        unsigned long addr = args[i];
+        slot[i] = -1;
+        if (addr == 0) {
+            continue;
+        }
+        switch (arg->type) {
+        case ARG_PATH:
+        case ARG_STRING:
+            slot[i] = plan_string(&plan, addr, PATH_MAX);
+            break;
+        case ARG_SOCKADDR: {
+            size_t len = args[arg->aux];
+            slot[i] = plan_read(&plan, addr, len < sizeof(struct sockaddr_storage) ?
+                                             len : sizeof(struct sockaddr_storage));
+            break;
+        }
+        case ARG_BUFFER: {
+            size_t limit = preview_bytes < CAPTURE_PREVIEW_MAX ? (size_t)preview_bytes : CAPTURE_PREVIEW_MAX;
+            size_t len = args[arg->aux];
+            if (preview_bytes > 0) {
+                slot[i] = plan_read(&plan, addr, len < limit ? len : limit);
+            }
+            break;
+        }
+        case ARG_STRING_ARRAY:
+            slot[i] = plan_read(&plan, addr, ARG_ARRAY_ENTRIES * sizeof(unsigned long));
+            break;
+        default:
+            break;
+        }
+    }
+    if (plan.count == 0) {
+        return 0;
+    }
+    read_tracee_batch(tid, plan.reads, plan.count);
+
+    // 第二批：argv/envp指针数组中的各个字符串
+    int second = plan.count;
+    int first_string[6], string_count[6];
+    for (int i = 0; i < desc->argc; i++) {
+        first_string[i] = plan.count;
+        string_count[i] = 0;
+        if (desc->args[i].type != ARG_STRING_ARRAY || slot[i] < 0 || plan.reads[slot[i]].result <= 0) {
+            continue;
+        }
+        const unsigned long *ptrs = plan.reads[slot[i]].buf;
+        int entries = (int)(plan.reads[slot[i]].result / (ssize_t)sizeof(unsigned long));
+        for (int j = 0; j < entries && ptrs[j] != 0; j++) {
+            if (plan_string(&plan, ptrs[j], CAPTURE_ARRAY_PEEK) < 0) {
+                break;
+            }
+            string_count[i]++;
+        }
+    }
+    if (plan.count > second) {
+        read_tracee_batch(tid, plan.reads + second, plan.count - second);
+    }
+
+    // 序列化
+    for (int i = 0; i < desc->argc; i++) {
+        const syscall_arg_desc_t *arg = &desc->args[i];
+        if (slot[i] < 0) {
+            continue;
+        }
+        tracee_read_t *read = &plan.reads[slot[i]];
+
+        switch (arg->type) {
+        case ARG_PATH:
+        case ARG_STRING: {
+            ssize_t len = finish_string(&plan, tid, slot[i], PATH_MAX);
+            if (len < 0) {
+                break;
+            }
+            char resolved[PATH_MAX];
+            ssize_t resolved_len = -1;
+            if (arg->type == ARG_PATH) {
+                long dirfd = arg->aux >= 0 ? (long)args[arg->aux] : AT_FDCWD;
+                resolved_len = resolve_tracee_path(tid, dirfd, read->buf, resolved, sizeof(resolved));
+            }
+            size_t total = (size_t)len + (resolved_len >= 0 ? (size_t)resolved_len + 1 : 0);
+            char *data = arg_blob_append(capture, i, arg->type, total);
+            if (data) {
+                memcpy(data, read->buf, (size_t)len);
+                if (resolved_len >= 0) {
+                    data[len] = '\0';
+                    memcpy(data + len + 1, resolved, (size_t)resolved_len);
+                }
+            }
+            break;
+        }
+        case ARG_SOCKADDR:
+        case ARG_BUFFER:
+            if (read->result > 0) {
+                char *data = arg_blob_append(capture, i, arg->type, (size_t)read->result);
+                if (data) {
+                    memcpy(data, read->buf, (size_t)read->result);
+                }
+            }
+            break;
+        case ARG_STRING_ARRAY: {
+            // 先补全各个字符串并算出总长度（不超过ARG_ARRAY_MAX），再一次性追加
+            size_t total = 0;
+            int kept = 0;
+            ssize_t lens[ARG_ARRAY_ENTRIES];
+            for (int j = 0; j < string_count[i] && total < ARG_ARRAY_MAX; j++, kept++) {
+                lens[j] = finish_string(&plan, tid, first_string[i] + j, PATH_MAX);
+                if (lens[j] < 0) {
+                    lens[j] = 0;
+                }
+                if (total + (size_t)lens[j] + 1 > ARG_ARRAY_MAX) {
+                    lens[j] = (ssize_t)(ARG_ARRAY_MAX - total - 1);
+                }
+                total += (size_t)lens[j] + 1;
+            }
+            char *data = arg_blob_append(capture, i, arg->type, total);
+            if (!data) {
+                break;
+            }
+            for (int j = 0; j < kept; j++) {
+                memcpy(data, plan.reads[first_string[i] + j].buf, (size_t)lens[j]);
+                data[lens[j]] = '\0';
+                data += lens[j] + 1;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    return 0;
+}
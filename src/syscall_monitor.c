@@ -2,225 +2,2553 @@
 #include <sys/ptrace.h>
 #include <sys/user.h>
 #include <sys/wait.h>
-#include <sys/time.h>
+#include <time.h>
 #include <sys/syscall.h>
 #include <sys/uio.h>
 #include <sys/reg.h>
 #include <asm/unistd.h>
+#include <stddef.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <pthread.h>
+#include <linux/audit.h>
+#include <linux/seccomp.h>
 
-// 保存常见系统调用名称
-static const char *syscall_names[] = {
+#define CPU_TIMEOUT_POLL_MS 100  // CPU时间限制的检查间隔
+#define KILL_GRACE_MS 5000       // 终止沙箱后等待剩余任务退出的时间
+#define SHARD_INBOX_INITIAL 256  // 跟踪线程收件箱的初始容量，满时加倍
+
+// 跟踪线程的结束方式
+enum {
+    SHARDS_RUNNING = 0,
+    SHARDS_DONE,                    // 所有任务都已退出
+    SHARDS_ABANDON,                 // 放弃等待剩余任务，线程退出时由EXITKILL杀死它们
+};
+
+// 新任务的创建方式，决定它能否迁移到其他跟踪线程
+enum {
+    SPAWN_UNKNOWN = 0,              // 未看到父任务的系统调用入口（过滤模式未跟踪），不迁移
+    SPAWN_PROCESS,                  // 不共享地址空间的新进程
+    SPAWN_SHARED,                   // 线程、CLONE_VM或vfork的子进程，留在父任务的跟踪线程上
+};
+
+// 交给跟踪线程处理的一条消息：分派线程取到的状态变化，或迁移过来的新进程
+typedef struct {
+    pid_t tid;
+    int status;
+    uint64_t stop_ns;               // 分派线程取到本次状态变化的时间
+    struct task_migration *migration; // 非NULL表示接管迁移过来的新进程
+} shard_msg_t;
+
+// 一次ptrace停止：处理前取得的系统调用信息，处理后决定的恢复方式
+typedef struct {
+    int has_info;                   // info有效（系统调用入口、退出或seccomp停止）
+    struct __ptrace_syscall_info info;
+    int request;                    // 恢复执行的ptrace请求，-1表示任务保持停止（已交接或等待父任务）
+    int sig;                        // 恢复时注入的信号
+} ptrace_stop_t;
+
+// 迁移中的新进程：源跟踪线程脱离前保存的状态，目标跟踪线程接管后的第一次停止时恢复
+typedef struct task_migration {
+    task_state_t task;
+    struct user_regs_struct regs;   // 脱离前的寄存器（脱离期间进程停在pause中）
+    uint64_t sigmask;               // 脱离前的信号掩码（脱离期间屏蔽所有信号）
+    char *fds;                      // 导出的fd表
+    size_t fds_len;
+} task_migration_t;
+
+// 跟踪线程（分片）。ptrace把被跟踪任务绑定到attach它的线程，一个任务只属于一个分片，
+// 状态表、参数块、统计和日志缓冲都是分片私有的，处理停止时不需要任何共享锁。
+// 只有一个分片时（包括eBPF和通知后端）它就是主线程
+typedef struct monitor_shard {
+    struct syscall_monitor *monitor;
+    int index;                      // 0为主线程，跟踪根进程及其线程
+    pthread_t thread;
+    pid_t ktid;                     // 内核线程ID，与/proc中的TracerPid比较
+    int producer;                   // 在跟踪日志中的生产者编号
+    FILE *log;                      // 文本日志。多个分片时为内存流，每条消息处理完一次写出
+    char *log_buf;
+    size_t log_len;
+    task_table_t tasks;             // 本分片跟踪的线程
+    arg_capture_t capture;          // 当前系统调用入口的参数块
+    pid_t capture_tid;              // capture属于哪个任务的入口（退出时据此判断是否已被覆盖）
+    string_pool_t strings;          // fd表中路径和套接字描述的驻留字符串
+    ngram_profile_t ngram;          // 系统调用序列的n-gram画像（n为0表示不统计），结束时合并
+    latency_hist_t latency[SYSCALL_ABI_COUNT][SYSCALL_MAX]; // 每类系统调用的次数和延迟分布（按ABI区分）
+    uint64_t policy_hits;           // 命中策略规则的次数（不含放行）
+    mem_dump_cache_t dump_cache;    // 本分片进程的页哈希和读取缓冲区
+    int tracees;                    // 正在跟踪的任务数（原子读写），选择迁移目标用
+    int held;                       // 初始停止先于父任务fork事件到达、暂停等待的新任务数
+    uint64_t stops;                 // 处理的停止次数
+    pthread_mutex_t inbox_lock;     // 只保护收件箱
+    pthread_cond_t inbox_cond;
+    shard_msg_t *inbox;             // 环形队列
+    size_t inbox_cap;
+    size_t inbox_head;
+    size_t inbox_len;
+} monitor_shard_t;
+
+// 系统调用监控结构：配置和真正全局的状态。按任务的状态都在分片中
+typedef struct syscall_monitor {
+    pid_t pid;                      // 被监控的根进程ID
+    sandbox_result *result;         // 运行结果（根进程退出状态等）
+    FILE *log_file;                 // 日志文件
+    uint64_t ptrace_overhead_ns;    // 从每次延迟中扣除的ptrace往返开销（0表示不扣除）
+    trace_log_t *trace_log;         // 二进制跟踪日志（为NULL时输出文本日志）
+    int control_producer;           // 超时记录使用的生产者编号（多个分片时属于分派线程）
+    int idle_request;               // 不在系统调用中时的恢复方式
+    const sandbox_config *config;   // 沙箱配置（超时限制等）
+    int sigchld_fd;                 // 限时模式下接收SIGCHLD的signalfd，-1表示直接阻塞在waitpid上
+    int wall_fd;                    // 墙上时间限制（终止后复用为回收宽限期）的timerfd
+    int cpu_fd;                     // 周期性检查CPU时间的timerfd
+    int timeouts_enabled;           // 是否已屏蔽SIGCHLD并创建计时器
+    sigset_t saved_mask;            // 屏蔽SIGCHLD之前的信号掩码
+    int killing;                    // 已终止沙箱，正在回收剩余任务
+    int warp_enabled;               // 是否启用睡眠加速
+    time_warp_t warp;               // 沙箱的虚拟时间状态（所有分片共用）
+    pthread_mutex_t warp_lock;      // 只在改写睡眠和时间查询时持有
+    uint8_t decode_mode[SYSCALL_MAX]; // 每个本机系统调用的参数解码方式（DECODE_*）
+    int preview_bytes;              // 缓冲区预览的字节数（0表示不预览）
+    int fd_tracking;                // 是否跟踪每个进程的fd表
+    const policy_t *policy;         // 系统调用策略（NULL表示没有）
+    int net_enabled;                // 是否启用伪造网络
+    fake_net_t net;                 // 沙箱网络命名空间和已交给sinkhole的端口
+    int ebpf_enabled;               // 使用eBPF后端（否则为ptrace）
+    ebpf_backend_t ebpf;            // eBPF程序、映射和环形缓冲区
+    uint64_t ebpf_events;           // 从环形缓冲区取出的记录数
+    int notif_enabled;              // 使用seccomp用户通知后端
+    int notif_listener;             // seccomp监听fd
+    pthread_t notif_threads[NOTIF_THREADS_MAX]; // 监督线程
+    int notif_thread_count;
+    int notif_stop_fd;              // 写入后通知监督线程退出的eventfd
+    pthread_mutex_t notif_recv_lock; // 监督线程轮流等待和接收通知
+    uint64_t notif_events;          // 处理的通知数
+    long ptrace_options;            // PTRACE_SETOPTIONS和迁移时PTRACE_SEIZE的选项
+    monitor_shard_t **shards;       // 跟踪线程，第一个是主线程
+    int shard_count;
+    int shards_stopping;            // 跟踪线程的结束方式（SHARDS_*）
+    uint8_t *owner;                 // 按tid记录所属分片的编号+1（原子读写），0表示未知
+    size_t owner_size;
+    int live_tasks;                 // 各分片状态表中的任务总数（原子读写）
+    int migrating;                  // 已脱离源分片、尚未被目标分片接管的新进程数
+    uint64_t migrations;            // 交给其他跟踪线程的新进程数
+    int migration_ok;               // 新进程可以停在pause中迁移（pause不会被跟踪或拦截）
+    int wake_fd;                    // 任务全部结束时唤醒分派线程的eventfd（只有一个分片时为-1）
+    int dump_enabled;               // 是否转储变为可执行的内存
+    mem_dump_t dump;                // 转储目录、索引和计数器
+    int threaded;                   // 通知后端：多个监督线程共用分片0
+    pthread_mutex_t lock;           // 通知后端的监督线程之间保护分片0
+} syscall_monitor_t;
+
+// 参数解码方式
+enum {
+    DECODE_OFF = 0,                 // 不读取参数内存
+    DECODE_EVENTS,                  // 只为文件/执行/网络事件读取所需的参数
+    DECODE_FULL,                    // 按描述符解码全部参数
+};
+
+// 延迟计时用的时钟：CLOCK_MONOTONIC_RAW不受NTP调频影响，且走vDSO
+static inline uint64_t monitor_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// 通知后端的监督线程共用分片0的日志、统计和状态表，访问时加锁；其他后端不加锁
+static inline void monitor_lock(syscall_monitor_t *monitor) {
+    if (monitor->threaded) {
+        pthread_mutex_lock(&monitor->lock);
+    }
+}
+
+static inline void monitor_unlock(syscall_monitor_t *monitor) {
+    if (monitor->threaded) {
+        pthread_mutex_unlock(&monitor->lock);
+    }
+}
+
+#define CALIBRATION_ROUNDS 2000  // 校准时执行的空系统调用次数
+
+// 测量一次被跟踪系统调用比原生调用多出的耗时（恢复执行、停止、唤醒跟踪器），
+// 方法与主循环计时一致：入口停止后恢复执行到退出停止被waitpid取到为止。
+// 用一个只反复调用getppid的子进程测中位数，失败时返回0（不扣除）
+static uint64_t calibrate_ptrace_overhead(void) {
+    latency_hist_t *traced = calloc(2, sizeof(*traced));
+    if (!traced) {
+        perror("内存分配失败");
+        return 0;
+    }
+    latency_hist_t *native = traced + 1;
+
+    for (int i = 0; i < CALIBRATION_ROUNDS; i++) {
+        uint64_t start = monitor_now_ns();
+        syscall(SYS_getppid);
+        latency_hist_record(native, monitor_now_ns() - start);
+    }
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("创建校准进程失败");
+        free(traced);
+        return 0;
+    }
+    if (pid == 0) {
+        ptrace(PTRACE_TRACEME, 0, NULL, NULL);
+        raise(SIGSTOP);
+        for (int i = 0; i < CALIBRATION_ROUNDS; i++) {
+            syscall(SYS_getppid);
+        }
+        _exit(0);
+    }
+
+    int status;
+    waitpid(pid, &status, 0);
+    ptrace(PTRACE_SETOPTIONS, pid, 0, PTRACE_O_TRACESYSGOOD | PTRACE_O_EXITKILL);
+    ptrace(PTRACE_SYSCALL, pid, 0, 0);
+
+    // 与主循环一样每次停止取一次PTRACE_GET_SYSCALL_INFO，校准值包含这部分开销
+    int measure = 0;
+    uint64_t resume_ns = 0;
+    struct __ptrace_syscall_info info;
+    while (waitpid(pid, &status, 0) == pid && WIFSTOPPED(status)) {
+        uint64_t stop_ns = monitor_now_ns();
+        if (WSTOPSIG(status) == (SIGTRAP | 0x80) &&
+            ptrace(PTRACE_GET_SYSCALL_INFO, pid, sizeof(info), &info) > 0) {
+            if (info.op == PTRACE_SYSCALL_INFO_ENTRY) {
+                measure = info.entry.nr == SYS_getppid;
+            } else if (info.op == PTRACE_SYSCALL_INFO_EXIT && measure) {
+                latency_hist_record(traced, stop_ns - resume_ns);
+            }
+        }
+        resume_ns = monitor_now_ns();
+        ptrace(PTRACE_SYSCALL, pid, 0, 0);
+    }
+    if (!WIFEXITED(status) && !WIFSIGNALED(status)) {
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+    }
+
+    uint64_t traced_ns = latency_hist_percentile(traced, 50);
+    uint64_t native_ns = latency_hist_percentile(native, 50);
+    free(traced);
+    return traced_ns > native_ns ? traced_ns - native_ns : 0;
+}
+
+// 产生文件/执行/网络事件的系统调用，即使未要求解码参数也要读取
+static int is_event_syscall(int nr) {
+    return nr == __NR_open || nr == __NR_openat || nr == __NR_execve || nr == __NR_execveat ||
+           nr == __NR_connect;
+}
+
+// fd跟踪需要从参数块取得路径或地址的系统调用
+static int is_fd_capture_syscall(int nr) {
+    return nr == __NR_open || nr == __NR_openat || nr == __NR_openat2 || nr == __NR_creat ||
+           nr == __NR_connect || nr == __NR_bind;
+}
+
+// 根据--decode列表确定每个系统调用的解码方式
+static void setup_decoding(syscall_monitor_t *monitor, const sandbox_config *config) {
+    for (int nr = 0; nr < SYSCALL_MAX; nr++) {
+        if (!get_syscall_desc(SYSCALL_ABI_NATIVE, nr)) continue;
+        int selected = !config->decode_selected;
+        for (int i = 0; i < config->decode_count && !selected; i++) {
+            selected = config->decode_syscalls[i] == nr;
+        }
+        int events = is_event_syscall(nr) || (monitor->fd_tracking && is_fd_capture_syscall(nr)) ||
+                     (monitor->policy && policy_needs_capture(monitor->policy, nr)) ||
+                     (monitor->net_enabled && nr == __NR_sendto);
+        monitor->decode_mode[nr] = selected ? DECODE_FULL : events ? DECODE_EVENTS : DECODE_OFF;
+    }
+    monitor->preview_bytes = config->preview_bytes < 0 ? 0 :
+                             config->preview_bytes > 0 ? config->preview_bytes : DEFAULT_PREVIEW_BYTES;
+}
+
+// 以NUL分隔的字符串数组中的条目数
+static int count_strings(const char *data, size_t len) {
+    int count = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] == '\0') count++;
+    }
+    return count;
+}
+
+// 提交一条不带负载的进程生命周期记录。producer为调用线程在跟踪日志中的编号
+static void push_task_event(syscall_monitor_t *monitor, int producer, pid_t tid, uint16_t type,
+                            uint64_t arg0, uint64_t arg1, int64_t ret, uint32_t flags) {
+    trace_record_t rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.timestamp_ns = trace_timestamp_ns();
+    rec.tid = (uint32_t)tid;
+    rec.type = type;
+    rec.syscall_nr = -1;
+    rec.args[0] = arg0;
+    rec.args[1] = arg1;
+    rec.ret = ret;
+    rec.flags = flags;
+    trace_log_push(monitor->trace_log, producer, &rec, NULL, 0);
+}
+
+static void record_task_event(monitor_shard_t *shard, pid_t tid, uint16_t type,
+                              uint64_t arg0, uint64_t arg1, int64_t ret, uint32_t flags) {
+    push_task_event(shard->monitor, shard->producer, tid, type, arg0, arg1, ret, flags);
+}
+
+// 二进制模式的系统调用入口：只填充定长记录，解码的参数块原样作为负载，不做任何格式化
+static void record_syscall_entry(monitor_shard_t *shard, task_state_t *task, int decode) {
+    trace_log_t *log = shard->monitor->trace_log;
+    int producer = shard->producer;
+    const arg_capture_t *capture = &shard->capture;
+    trace_record_t rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.timestamp_ns = trace_timestamp_ns();
+    rec.tid = (uint32_t)task->tid;
+    rec.type = TRACE_REC_SYSCALL_ENTRY;
+    rec.syscall_nr = task->current_syscall;
+    rec.flags = task->current_abi == SYSCALL_ABI_COMPAT ? TRACE_REC_FLAG_COMPAT : 0;
+    for (int i = 0; i < 6; i++) {
+        rec.args[i] = task->args[i];
+    }
+    if (decode == DECODE_FULL) {
+        rec.flags |= TRACE_REC_FLAG_DECODED;
+        trace_log_push(log, producer, &rec, capture->blob, capture->len);
+    } else {
+        trace_log_push(log, producer, &rec, NULL, 0);
+    }
+    if (decode == DECODE_OFF) {
+        return;
+    }
+    rec.flags = 0;
+
+    int nr = task->current_syscall;
+    const char *data;
+    size_t len;
+    if (nr == __NR_open || nr == __NR_openat) {
+        const char *path = arg_blob_path(capture->blob, capture->len, nr == __NR_open ? 0 : 1, &len);
+        rec.type = TRACE_REC_FILE_OPEN;
+        trace_log_push(log, producer, &rec, path, len);
+    } else if (nr == __NR_execve || nr == __NR_execveat) {
+        int base = nr == __NR_execve ? 0 : 1;
+        const char *path = arg_blob_path(capture->blob, capture->len, base, &len);
+        rec.type = TRACE_REC_EXEC;
+        trace_log_push(log, producer, &rec, path, len);
+
+        static const uint16_t array_types[2] = { TRACE_REC_EXEC_ARGV, TRACE_REC_EXEC_ENVP };
+        for (int i = 0; i < 2; i++) {
+            if (arg_blob_find(capture->blob, capture->len, base + 1 + i, &data, &len) != 0) {
+                data = NULL;
+                len = 0;
+            }
+            rec.type = array_types[i];
+            rec.args[0] = (uint64_t)count_strings(data, len);
+            trace_log_push(log, producer, &rec, data, len);
+        }
+    } else if (nr == __NR_connect) {
+        if (arg_blob_find(capture->blob, capture->len, 1, &data, &len) != 0) {
+            data = NULL;
+            len = 0;
+        }
+        rec.type = TRACE_REC_NET_CONNECT;
+        trace_log_push(log, producer, &rec, data, len);
+    }
+}
+
+// 二进制模式的系统调用退出
+static void record_syscall_exit(monitor_shard_t *shard, task_state_t *task, long ret,
+                                uint64_t latency_ns) {
+    trace_record_t rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.timestamp_ns = trace_timestamp_ns();
+    rec.tid = (uint32_t)task->tid;
+    rec.type = TRACE_REC_SYSCALL_EXIT;
+    rec.syscall_nr = task->current_syscall;
+    rec.flags = TRACE_REC_FLAG_LATENCY;
+    if (task->current_abi == SYSCALL_ABI_COMPAT) {
+        rec.flags |= TRACE_REC_FLAG_COMPAT;
+    }
+    rec.args[0] = latency_ns;
+    rec.ret = ret;
+    trace_log_push(shard->monitor->trace_log, shard->producer, &rec, NULL, 0);
+}
+
+// 命中策略规则
+static void record_policy_hit(monitor_shard_t *shard, task_state_t *task, const policy_rule_t *rule,
+                              int enforce) {
+    trace_record_t rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.timestamp_ns = trace_timestamp_ns();
+    rec.tid = (uint32_t)task->tid;
+    rec.type = TRACE_REC_POLICY;
+    rec.syscall_nr = task->current_syscall;
+    rec.args[0] = (uint64_t)rule->action;
+    rec.args[1] = (uint64_t)rule->value;
+    rec.args[2] = (uint64_t)rule->line;
+    rec.args[3] = (uint64_t)enforce;
+    trace_log_push(shard->monitor->trace_log, shard->producer, &rec, NULL, 0);
+}
+
+// 结束时的单个系统调用延迟统计（各分片已合并到分片0）
+static void record_syscall_stats(monitor_shard_t *shard, int abi, int nr) {
+    syscall_monitor_t *monitor = shard->monitor;
+    const latency_hist_t *hist = &shard->latency[abi][nr];
+    trace_record_t rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.timestamp_ns = trace_timestamp_ns();
+    rec.tid = (uint32_t)monitor->pid;
+    rec.type = TRACE_REC_SYSCALL_STATS;
+    rec.syscall_nr = nr;
+    rec.flags = abi == SYSCALL_ABI_COMPAT ? TRACE_REC_FLAG_COMPAT : 0;
+    rec.args[0] = hist->count;
+    rec.args[1] = hist->total_ns;
+    rec.args[2] = latency_hist_percentile(hist, 50.0);
+    rec.args[3] = latency_hist_percentile(hist, 90.0);
+    rec.args[4] = latency_hist_percentile(hist, 99.0);
+    rec.args[5] = hist->max_ns;
+    trace_log_push(monitor->trace_log, shard->producer, &rec, NULL, 0);
+}
+
+// 结束时的top-K n-gram和MinHash签名
+static void record_ngram_profile(monitor_shard_t *shard) {
+    syscall_monitor_t *monitor = shard->monitor;
+    const ngram_profile_t *profile = &shard->ngram;
+    ngram_entry_t top[NGRAM_TOP_MAX];
+    int count = ngram_sorted_top(profile, top);
+
+    trace_record_t rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.timestamp_ns = trace_timestamp_ns();
+    rec.tid = (uint32_t)monitor->pid;
+    rec.type = TRACE_REC_NGRAM;
+    rec.syscall_nr = -1;
+    for (int i = 0; i < count; i++) {
+        rec.args[0] = top[i].key;
+        rec.args[1] = top[i].count;
+        rec.args[2] = (uint64_t)profile->n;
+        rec.args[3] = (uint64_t)(i + 1);
+        rec.args[4] = profile->total;
+        trace_log_push(monitor->trace_log, shard->producer, &rec, NULL, 0);
+    }
+
+    uint32_t signature[MINHASH_SIZE];
+    if (ngram_minhash_signature(profile, signature) == 0) {
+        memset(rec.args, 0, sizeof(rec.args));
+        rec.type = TRACE_REC_MINHASH;
+        rec.args[0] = (uint64_t)profile->n;
+        rec.args[1] = MINHASH_SIZE;
+        trace_log_push(monitor->trace_log, shard->producer, &rec, signature, sizeof(signature));
+    }
+}
+
+// 事件流的结束汇总
+static void record_summary(syscall_monitor_t *monitor, int unique_syscalls) {
+    trace_record_t rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.timestamp_ns = trace_timestamp_ns();
+    rec.tid = (uint32_t)monitor->pid;
+    rec.type = TRACE_REC_SUMMARY;
+    rec.syscall_nr = -1;
+    rec.args[0] = (uint64_t)unique_syscalls;
+    rec.args[1] = (uint64_t)monitor->result->timeout_reason;
+    rec.args[2] = monitor->warp.sleeps;
+    rec.ret = monitor->warp.offset_ns;
+    trace_log_push(monitor->trace_log, 0, &rec, NULL, 0);
+}
+
+#ifdef __x86_64__
+#define X86_COMPAT_CS 0x23  // 32位用户代码段选择子
+#define X86_USER64_CS 0x33  // 64位用户代码段选择子
+#define X86_SYSCALL_INSN 0x050f // syscall指令（0f 05）按小端读出的低16位
+#endif
+
+// 系统调用号在计数器范围内时返回1（恶意程序可能使用任意编号）
+static inline int syscall_nr_valid(int nr) {
+    return nr >= 0 && nr < SYSCALL_MAX;
+}
+
+// 按当前ABI的调用约定从寄存器取出系统调用参数
+static void load_syscall_args(task_state_t *task, const struct user_regs_struct *regs) {
     #ifdef __x86_64__
-    [0] = "read",
-    [1] = "write",
-    [2] = "open",
-    [3] = "close",
-    [4] = "stat",
-    [5] = "fstat",
-    [6] = "lstat",
-    [7] = "poll",
-    [8] = "lseek",
-    [9] = "mmap",
-    [10] = "mprotect",
-    [11] = "munmap",
-    [12] = "brk",
-    [13] = "rt_sigaction",
-    [14] = "rt_sigprocmask",
-    [15] = "rt_sigreturn",
-    [16] = "ioctl",
-    [17] = "pread64",
-    [18] = "pwrite64",
-    [19] = "readv",
-    [20] = "writev",
-    [21] = "access",
-    [22] = "pipe",
-    [23] = "select",
-    [24] = "sched_yield",
-    [25] = "mremap",
-    [26] = "msync",
-    [27] = "mincore",
-    [28] = "madvise",
-    [29] = "shmget",
-    [30] = "shmat",
-    // 只列出部分常见的系统调用，完整列表太长
-    [56] = "clone",
-    [57] = "fork",
-    [58] = "vfork",
-    [59] = "execve",
-    [60] = "exit",
-    [61] = "wait4",
-    [62] = "kill",
-    [63] = "uname",
-    // 网络相关
-    [41] = "socket",
-    [42] = "connect",
-    [43] = "accept",
-    [44] = "sendto",
-    [45] = "recvfrom",
-    [46] = "sendmsg",
-    [47] = "recvmsg",
-    [48] = "shutdown",
-    [49] = "bind",
-    [50] = "listen",
-    [51] = "getsockname",
-    // 文件操作相关
-    [257] = "openat",
-    [80] = "mkdir",
-    [82] = "rename",
-    [83] = "rmdir",
-    [84] = "creat",
-    [86] = "link",
-    [87] = "unlink",
-    [88] = "symlink",
-    [89] = "readlink",
-    [90] = "chmod",
-    [92] = "chown",
+    if (task->current_abi == SYSCALL_ABI_COMPAT) {
+        // i386约定：ebx, ecx, edx, esi, edi, ebp
+        task->args[0] = (uint32_t)regs->rbx;
+        task->args[1] = (uint32_t)regs->rcx;
+        task->args[2] = (uint32_t)regs->rdx;
+        task->args[3] = (uint32_t)regs->rsi;
+        task->args[4] = (uint32_t)regs->rdi;
+        task->args[5] = (uint32_t)regs->rbp;
+    } else {
+        task->args[0] = regs->rdi;
+        task->args[1] = regs->rsi;
+        task->args[2] = regs->rdx;
+        task->args[3] = regs->r10;
+        task->args[4] = regs->r8;
+        task->args[5] = regs->r9;
+    }
     #else
-    // 32位系统调用表，如果需要支持32位系统
+    // 32位系统的寄存器不同
     // ...
     #endif
-};
+}
 
-#ifdef __x86_64__
-#define SYSCALL_MAX 335  // x86_64系统上大约有335个系统调用
-#else
-#define SYSCALL_MAX 385  // 32位系统可能有更多
-#endif
+// 参数解码按本机系统调用号进行，兼容ABI的调用只记录原始参数
+static int decode_mode_of(const syscall_monitor_t *monitor, int abi, int nr) {
+    return abi == SYSCALL_ABI_NATIVE && syscall_nr_valid(nr) ? monitor->decode_mode[nr] : DECODE_OFF;
+}
+
+static int syscall_decode_mode(const syscall_monitor_t *monitor, const task_state_t *task) {
+    return decode_mode_of(monitor, task->current_abi, task->current_syscall);
+}
+
+// 系统调用入口（两种后端共用）：task中的调用号、ABI和参数已经填好，
+// shard->capture为本次入口读到的参数块
+static void monitor_syscall_entry(monitor_shard_t *shard, task_state_t *task, int decode) {
+    syscall_monitor_t *monitor = shard->monitor;
+    int compat = task->current_abi == SYSCALL_ABI_COMPAT;
+    int nr = task->current_syscall;
+    if (shard->ngram.n) {
+        ngram_push(&shard->ngram, task->ngram_history, &task->ngram_len, task->current_abi, nr);
+    }
+    if (decode == DECODE_FULL) {
+        fd_track_annotate(task->fds, &shard->strings, task->tid, nr, task->args, &shard->capture);
+    }
+
+    if (monitor->trace_log) {
+        record_syscall_entry(shard, task, decode);
+        return;
+    }
+
+    // 简单记录系统调用信息
+    fprintf(shard->log, "[%d] [ENTRY] syscall %d (%s%s), args: %lx, %lx, %lx, %lx, %lx, %lx\n",
+            task->tid, nr, compat ? "i386:" : "", get_syscall_name_abi(task->current_abi, nr),
+            task->args[0], task->args[1], task->args[2],
+            task->args[3], task->args[4], task->args[5]);
+    if (decode == DECODE_OFF) {
+        return;
+    }
+
+    const arg_capture_t *capture = &shard->capture;
+    if (decode == DECODE_FULL) {
+        uint64_t args[6];
+        for (int i = 0; i < 6; i++) {
+            args[i] = task->args[i];
+        }
+        fprintf(shard->log, "[%d] [ARGS] ", task->tid);
+        format_syscall_args(shard->log, nr, args, capture->blob, capture->len);
+        fputc('\n', shard->log);
+    }
+
+    // 特殊处理某些系统调用
+    const char *data;
+    size_t len;
+    if (nr == __NR_open || nr == __NR_openat) {
+        const char *path = arg_blob_path(capture->blob, capture->len, nr == __NR_open ? 0 : 1, &len);
+        fprintf(shard->log, "[%d] [FILE] Attempting to open: %.*s\n", task->tid, (int)len, path);
+    } else if (nr == __NR_execve || nr == __NR_execveat) {
+        int base = nr == __NR_execve ? 0 : 1;
+        const char *path = arg_blob_path(capture->blob, capture->len, base, &len);
+        fprintf(shard->log, "[%d] [EXEC] Executing: %.*s\n", task->tid, (int)len, path);
+
+        // eBPF后端在内核中只捕获路径，不输出argv/envp
+        static const char *const labels[2] = { "argv", "envp" };
+        for (int i = 0; i < 2 && !monitor->ebpf_enabled; i++) {
+            if (arg_blob_find(capture->blob, capture->len, base + 1 + i, &data, &len) != 0) {
+                fprintf(shard->log, "[%d] [EXEC] %s: <无法读取>\n", task->tid, labels[i]);
+                continue;
+            }
+            fprintf(shard->log, "[%d] [EXEC] %s (%d):", task->tid, labels[i], count_strings(data, len));
+            for (size_t pos = 0; pos < len; pos += strnlen(data + pos, len - pos) + 1) {
+                fprintf(shard->log, " \"%s\"", data + pos);
+            }
+            fprintf(shard->log, "\n");
+        }
+    } else if (nr == __NR_connect) {
+        char addr_str[128] = "<无法读取>";
+        if (arg_blob_find(capture->blob, capture->len, 1, &data, &len) == 0) {
+            struct sockaddr_storage addr;
+            memset(&addr, 0, sizeof(addr));
+            memcpy(&addr, data, len < sizeof(addr) ? len : sizeof(addr));
+            format_sockaddr(&addr, len < sizeof(addr) ? len : sizeof(addr), addr_str, sizeof(addr_str));
+        }
+        fprintf(shard->log, "[%d] [NET] Attempting to connect, socket fd: %ld, address: %s\n",
+                task->tid, task->args[0], addr_str);
+    }
+}
+
+// ptrace停止的ABI：arch由内核按本次进入的方式给出，64位程序用int 0x80进入i386兼容表
+// （常见的规避手段）时同样报告为AUDIT_ARCH_I386
+static inline int ptrace_stop_abi(const struct __ptrace_syscall_info *info) {
+    return info->arch == AUDIT_ARCH_I386 ? SYSCALL_ABI_COMPAT : SYSCALL_ABI_NATIVE;
+}
+
+// 处理停止前的准备：系统调用停止和seccomp停止时取PTRACE_GET_SYSCALL_INFO，入口处读取参数内存
+static void prefetch_stop(monitor_shard_t *shard, pid_t tid, int status, ptrace_stop_t *stop) {
+    int sig = WSTOPSIG(status);
+    int event = status >> 16;
+    stop->has_info = 0;
+    if (sig != (SIGTRAP | 0x80) && !(sig == SIGTRAP && event == PTRACE_EVENT_SECCOMP)) {
+        return;
+    }
+    if (ptrace(PTRACE_GET_SYSCALL_INFO, tid, sizeof(stop->info), &stop->info) <= 0) {
+        perror("获取系统调用信息失败");
+        return;
+    }
+    stop->has_info = 1;
+
+    // 入口停止和seccomp停止的nr、args布局相同
+    const struct __ptrace_syscall_info *info = &stop->info;
+    arg_capture_t *capture = &shard->capture;
+    capture->len = 0;
+    if ((info->op == PTRACE_SYSCALL_INFO_ENTRY || info->op == PTRACE_SYSCALL_INFO_SECCOMP) &&
+        decode_mode_of(shard->monitor, ptrace_stop_abi(info), (int)info->entry.nr) != DECODE_OFF) {
+        unsigned long args[6];
+        for (int i = 0; i < 6; i++) {
+            args[i] = info->entry.args[i];
+        }
+        capture_syscall_args(tid, (int)info->entry.nr, args, shard->monitor->preview_bytes, capture);
+    }
+}
+
+// ptrace后端的系统调用入口：调用号和参数取自PTRACE_GET_SYSCALL_INFO，参数块已在prefetch_stop中读好
+static void handle_syscall_entry(monitor_shard_t *shard, task_state_t *task, const ptrace_stop_t *stop) {
+    syscall_monitor_t *monitor = shard->monitor;
+    const struct __ptrace_syscall_info *info = &stop->info;
+    task->current_syscall = (int)info->entry.nr;
+    task->current_abi = ptrace_stop_abi(info);
+    for (int i = 0; i < 6; i++) {
+        // i386约定下参数是32位的
+        task->args[i] = task->current_abi == SYSCALL_ABI_COMPAT ? (uint32_t)info->entry.args[i]
+                                                                : info->entry.args[i];
+    }
+
+    shard->capture_tid = task->tid;
+    monitor_syscall_entry(shard, task, syscall_decode_mode(monitor, task));
+}
+
+// 系统调用退出（两种后端共用）：ret为按ABI取好的返回值，latency_ns为执行时间
+static void monitor_syscall_exit(monitor_shard_t *shard, task_state_t *task, long ret,
+                                 uint64_t latency_ns) {
+    syscall_monitor_t *monitor = shard->monitor;
+    if (syscall_nr_valid(task->current_syscall)) {
+        latency_hist_record(&shard->latency[task->current_abi][task->current_syscall], latency_ns);
+    }
+
+    // 参数块已被其他任务的入口覆盖时，fd跟踪改从/proc读取
+    if (task->fds && task->current_abi == SYSCALL_ABI_NATIVE) {
+        fd_track_syscall_exit(&task->fds, &shard->strings, task->tid, task->current_syscall, task->args,
+                              ret, shard->capture_tid == task->tid ? &shard->capture : NULL);
+    }
+
+    if (monitor->trace_log) {
+        record_syscall_exit(shard, task, ret, latency_ns);
+        return;
+    }
+
+    // 记录返回值和执行时间
+    int compat = task->current_abi == SYSCALL_ABI_COMPAT;
+    fprintf(shard->log, "[%d] [EXIT] syscall %d (%s%s), result: %ld, time: %.2f us\n",
+            task->tid, task->current_syscall, compat ? "i386:" : "",
+            get_syscall_name_abi(task->current_abi, task->current_syscall), ret,
+            (double)latency_ns / 1e3);
+    if (compat) {
+        return;
+    }
+
+    // 特殊处理某些系统调用的返回值
+    if ((task->current_syscall == __NR_open || task->current_syscall == __NR_openat) && ret >= 0) {
+        fprintf(shard->log, "[%d] [FILE] Successfully opened file, fd: %ld\n", task->tid, ret);
+    } else if (task->current_syscall == __NR_connect && ret == 0) {
+        fprintf(shard->log, "[%d] [NET] Successfully connected\n", task->tid);
+    }
+}
+
+// ptrace后端的系统调用退出：ret为样本将看到的返回值
+static void handle_syscall_exit(monitor_shard_t *shard, task_state_t *task, long ret,
+                                uint64_t stop_ns) {
+    syscall_monitor_t *monitor = shard->monitor;
+    // 计算执行时间：从入口停止后恢复执行到退出停止，不含跟踪器自身的解码和日志开销
+    uint64_t latency_ns = stop_ns > task->entry_ns ? stop_ns - task->entry_ns : 0;
+    latency_ns = latency_ns > monitor->ptrace_overhead_ns ? latency_ns - monitor->ptrace_overhead_ns : 0;
+    monitor_syscall_exit(shard, task, ret, latency_ns);
+}
+
+// 从/proc读取线程组和父进程（通知后端登记新任务、转储可执行内存时使用）
+static void read_task_ids(pid_t tid, pid_t *tgid, pid_t *ppid) {
+    *tgid = *ppid = tid;
+    char path[64], line[128];
+    snprintf(path, sizeof(path), "/proc/%d/status", tid);
+    FILE *fp = fopen(path, "re");
+    if (!fp) {
+        return;
+    }
+    int found = 0;
+    while (found < 2 && fgets(line, sizeof(line), fp)) {
+        if (sscanf(line, "Tgid: %d", tgid) == 1 || sscanf(line, "PPid: %d", ppid) == 1) {
+            found++;
+        }
+    }
+    fclose(fp);
+}
+
+// 记录tid属于哪个分片，分派线程据此投递状态变化。只有多个分片时才有这张表
+static inline void owner_set(syscall_monitor_t *monitor, pid_t tid, int index) {
+    if (monitor->owner && tid > 0 && (size_t)tid < monitor->owner_size) {
+        __atomic_store_n(&monitor->owner[tid], (uint8_t)(index + 1), __ATOMIC_RELEASE);
+    }
+}
+
+static inline int owner_get(syscall_monitor_t *monitor, pid_t tid) {
+    if (tid > 0 && (size_t)tid < monitor->owner_size) {
+        return __atomic_load_n(&monitor->owner[tid], __ATOMIC_ACQUIRE) - 1;
+    }
+    return -1;
+}
+
+// 插入和删除分片的任务，同时维护分片的负载和全局的任务总数。
+// 最后一个任务结束时唤醒分派线程
+static task_state_t *shard_insert_task(monitor_shard_t *shard, pid_t tid) {
+    int before = shard->tasks.count;
+    task_state_t *task = task_table_insert(&shard->tasks, tid);
+    if (task && shard->tasks.count != before) {
+        __atomic_fetch_add(&shard->tracees, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&shard->monitor->live_tasks, 1, __ATOMIC_SEQ_CST);
+    }
+    return task;
+}
+
+// 一个计入分片负载的任务不再存在（已从状态表删除或未能插入）
+static void shard_task_gone(monitor_shard_t *shard) {
+    syscall_monitor_t *monitor = shard->monitor;
+    __atomic_fetch_sub(&shard->tracees, 1, __ATOMIC_RELAXED);
+    uint64_t one = 1;
+    if (__atomic_sub_fetch(&monitor->live_tasks, 1, __ATOMIC_SEQ_CST) == 0 && monitor->wake_fd != -1 &&
+        write(monitor->wake_fd, &one, sizeof(one)) == -1) {
+        perror("唤醒分派线程失败");
+    }
+}
+
+static void shard_remove_task(monitor_shard_t *shard, pid_t tid) {
+    int before = shard->tasks.count;
+    task_table_remove(&shard->tasks, tid);
+    if (shard->tasks.count != before) {
+        shard_task_gone(shard);
+    }
+}
+
+// 父任务停在fork/vfork/clone事件时取本次调用的clone标志：入口被跟踪过时取自任务状态，
+// 否则（过滤模式未跟踪这些调用）从寄存器读取。返回-1表示无法得知（如兼容ABI）
+static int read_clone_flags(task_state_t *parent, uint64_t *flags) {
+    int nr;
+    unsigned long arg0;
+    if (parent->in_syscall) {
+        if (parent->current_abi != SYSCALL_ABI_NATIVE) {
+            return -1;
+        }
+        nr = parent->current_syscall;
+        arg0 = parent->args[0];
+    } else {
+        struct user_regs_struct regs;
+        if (ptrace(PTRACE_GETREGS, parent->tid, 0, &regs) == -1 || regs.cs != X86_USER64_CS) {
+            return -1;
+        }
+        nr = (int)regs.orig_rax;
+        arg0 = regs.rdi;
+    }
+
+    switch (nr) {
+    case __NR_fork:
+        *flags = SIGCHLD;
+        return 0;
+    case __NR_vfork:
+        *flags = CLONE_VM | CLONE_VFORK | SIGCHLD;
+        return 0;
+    case __NR_clone:
+        *flags = arg0;
+        return 0;
+    case __NR_clone3:  // struct clone_args的第一个字段
+        return read_tracee_memory(parent->tid, arg0, flags, sizeof(*flags)) == (ssize_t)sizeof(*flags) ? 0 : -1;
+    default:
+        return -1;
+    }
+}
+
+static void start_new_task(monitor_shard_t *shard, task_state_t *task);
+static void shard_post(monitor_shard_t *shard, const shard_msg_t *msg);
+
+// 处理fork/vfork/clone事件：新任务会以SIGSTOP（或PTRACE_EVENT_STOP）开始，先登记到状态表。
+// 新任务与父任务是否共用文件表、能否迁移都按clone标志判断；不可知时按事件类型猜测文件表，且不迁移
+static void handle_new_task(monitor_shard_t *shard, task_state_t *parent, int event) {
+    syscall_monitor_t *monitor = shard->monitor;
+    unsigned long new_tid = 0;
+    if (ptrace(PTRACE_GETEVENTMSG, parent->tid, 0, &new_tid) == -1) {
+        perror("获取新任务ID失败");
+        return;
+    }
+
+    uint64_t flags = 0;
+    int known = read_clone_flags(parent, &flags) == 0;
+    task_state_t *child = shard_insert_task(shard, (pid_t)new_tid);
+    if (!child) {
+        fprintf(shard->log, "[%d] [PROC] 任务表已满，无法跟踪新任务 %lu\n", parent->tid, new_tid);
+    } else {
+        owner_set(monitor, child->tid, shard->index);
+        child->spawn = !known ? SPAWN_UNKNOWN :
+                       flags & (CLONE_VM | CLONE_THREAD | CLONE_VFORK | CLONE_FILES) ? SPAWN_SHARED : SPAWN_PROCESS;
+        if (!child->fds && parent->fds) {
+            int shared = known ? (flags & CLONE_FILES) != 0 : event == PTRACE_EVENT_CLONE;
+            child->fds = shared ? fd_table_share(parent->fds) : fd_table_copy(parent->fds);
+        }
+    }
+
+    if (monitor->trace_log) {
+        record_task_event(shard, parent->tid, TRACE_REC_PROC_NEW, new_tid, (uint64_t)event, 0, 0);
+    } else {
+        const char *kind = event == PTRACE_EVENT_CLONE ? "clone" :
+                           event == PTRACE_EVENT_VFORK ? "vfork" : "fork";
+        fprintf(shard->log, "[%d] [PROC] 新任务: %lu (%s)\n", parent->tid, new_tid, kind);
+    }
+
+    // 初始停止已经先到达，新任务一直停在那里等这个事件
+    if (child && child->new_task == NEW_TASK_HELD) {
+        shard->held--;
+        start_new_task(shard, child);
+    }
+}
+
+// execve成功（两种后端共用）：去掉close-on-exec的fd并记录
+static void monitor_exec_done(monitor_shard_t *shard, task_state_t *task, unsigned long former_tid) {
+    syscall_monitor_t *monitor = shard->monitor;
+    task->fds = fd_table_exec(task->fds);
+    if (monitor->trace_log) {
+        record_task_event(shard, task->tid, TRACE_REC_PROC_EXEC, former_tid, 0, 0, 0);
+    } else {
+        fprintf(shard->log, "[%d] [PROC] execve完成 (原tid: %lu)\n", task->tid, former_tid);
+    }
+}
+
+// 处理exec事件：非主线程执行execve时，内核会把它的tid换成线程组leader的tid
+static task_state_t *handle_exec_event(monitor_shard_t *shard, task_state_t *task) {
+    syscall_monitor_t *monitor = shard->monitor;
+    unsigned long former_tid = (unsigned long)task->tid;
+    ptrace(PTRACE_GETEVENTMSG, task->tid, 0, &former_tid);
+
+    if ((pid_t)former_tid != task->tid) {
+        task_state_t *former = task_table_lookup(&shard->tasks, (pid_t)former_tid);
+        if (former) {
+            // 线程组leader的状态被执行exec的线程取代，它持有的fd表引用随之释放
+            pid_t tid = task->tid;
+            fd_table_release(task->fds);
+            *task = *former;
+            task->tid = tid;
+            shard_remove_task(shard, (pid_t)former_tid);
+            // 删除时元素可能前移，重新定位
+            task = task_table_lookup(&shard->tasks, tid);
+        }
+        // 原tid已经消失，不会再报告退出
+        owner_set(monitor, (pid_t)former_tid, -1);
+    }
+    monitor_exec_done(shard, task, former_tid);
+    return task;
+}
+
+// 处理任务退出，从状态表中删除。status为-1表示退出状态未知（eBPF后端中
+// 未经exit系统调用结束的任务）
+static void handle_task_exit(monitor_shard_t *shard, pid_t tid, int status) {
+    syscall_monitor_t *monitor = shard->monitor;
+    task_state_t *task = task_table_lookup(&shard->tasks, tid);
+    if (task) {
+        fd_table_release(task->fds);
+        free(task->migration);
+    }
+    shard_remove_task(shard, tid);
+
+    if (tid == monitor->pid) {
+        monitor->result->exit_status = status;
+        monitor->result->exited = 1;
+    }
+
+    if (status == -1) {
+        if (monitor->trace_log) {
+            record_task_event(shard, tid, TRACE_REC_PROC_EXIT, 0, 0, 0, TRACE_REC_FLAG_SIGNALED);
+        }
+        fprintf(shard->log, "\n[%d] [INFO] 任务结束 (未调用exit，可能被信号终止)\n", tid);
+        return;
+    }
+
+    if (monitor->trace_log) {
+        record_task_event(shard, tid, TRACE_REC_PROC_EXIT, 0, 0,
+                          WIFEXITED(status) ? WEXITSTATUS(status) : WTERMSIG(status),
+                          WIFSIGNALED(status) ? TRACE_REC_FLAG_SIGNALED : 0);
+    }
+
+    const char *who = tid == monitor->pid ? "进程" : "任务";
+    if (WIFEXITED(status)) {
+        fprintf(shard->log, "\n[%d] [INFO] %s正常退出，状态码: %d\n", tid, who, WEXITSTATUS(status));
+    } else {
+        fprintf(shard->log, "\n[%d] [INFO] %s被信号终止: %d\n", tid, who, WTERMSIG(status));
+    }
+}
+
+// 按任务当前状态选择恢复执行的方式
+static int resume_request(const syscall_monitor_t *monitor, const task_state_t *task) {
+    return (task && task->in_syscall) ? PTRACE_SYSCALL : monitor->idle_request;
+}
+
+// 恢复执行，sig为需要交还给任务的信号
+static void resume_task(pid_t tid, int request, int sig) {
+    if (ptrace(request, tid, 0, sig) == -1 && errno != ESRCH) {
+        perror("ptrace失败");
+    }
+}
+
+// 设置一次性（interval_ms为0）或周期性的timerfd
+static int arm_timer(int fd, long ms, long interval_ms) {
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec = ms / 1000;
+    its.it_value.tv_nsec = (ms % 1000) * 1000000;
+    its.it_interval.tv_sec = interval_ms / 1000;
+    its.it_interval.tv_nsec = (interval_ms % 1000) * 1000000;
+    return timerfd_settime(fd, 0, &its, NULL);
+}
+
+// 有超时限制时改为在poll上等待SIGCHLD(signalfd)和计时器(timerfd)，
+// 没有限制时保持直接阻塞在waitpid上，不增加任何开销。
+// eBPF后端总是在poll上同时等待环形缓冲区和SIGCHLD，通知后端的主线程和多个跟踪线程时的
+// 分派线程总是在poll上等待SIGCHLD
+static int setup_timeouts(syscall_monitor_t *monitor) {
+    const sandbox_config *config = monitor->config;
+    monitor->sigchld_fd = monitor->wall_fd = monitor->cpu_fd = -1;
+    if (config->timeout_ms <= 0 && config->cpu_timeout_ms <= 0 && !monitor->ebpf_enabled &&
+        !monitor->notif_enabled && monitor->shard_count <= 1) {
+        return 0;
+    }
+
+    // 必须在第一次WNOHANG轮询之前屏蔽，之后到达的SIGCHLD都会在signalfd上排队
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, &monitor->saved_mask);
+    monitor->timeouts_enabled = 1;
+
+    monitor->sigchld_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    monitor->wall_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (monitor->sigchld_fd == -1 || monitor->wall_fd == -1) {
+        perror("创建超时计时器失败");
+        return -1;
+    }
+    if (config->timeout_ms > 0) {
+        arm_timer(monitor->wall_fd, config->timeout_ms, 0);
+    }
+
+    if (config->cpu_timeout_ms > 0) {
+        monitor->cpu_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (monitor->cpu_fd == -1) {
+            perror("创建超时计时器失败");
+            return -1;
+        }
+        arm_timer(monitor->cpu_fd, CPU_TIMEOUT_POLL_MS, CPU_TIMEOUT_POLL_MS);
+        if (monitor->result->cgroup_path[0] == '\0') {
+            fprintf(monitor->log_file, "注意: 沙箱没有cgroup，CPU时间限制只统计根进程\n");
+        }
+    }
+    return 0;
+}
+
+static void teardown_timeouts(syscall_monitor_t *monitor) {
+    if (!monitor->timeouts_enabled) {
+        return;
+    }
+    if (monitor->sigchld_fd != -1) close(monitor->sigchld_fd);
+    if (monitor->wall_fd != -1) close(monitor->wall_fd);
+    if (monitor->cpu_fd != -1) close(monitor->cpu_fd);
+    monitor->sigchld_fd = monitor->wall_fd = monitor->cpu_fd = -1;
+    sigprocmask(SIG_SETMASK, &monitor->saved_mask, NULL);
+    monitor->timeouts_enabled = 0;
+}
+
+// 沙箱已使用的CPU时间：优先取cgroup（覆盖所有子进程），否则只统计根进程
+static uint64_t sandbox_cpu_usage_us(syscall_monitor_t *monitor) {
+    uint64_t usage_us;
+    if (cgroup_read_cpu_usage(monitor->result->cgroup_path, &usage_us) == 0) {
+        return usage_us;
+    }
+
+    clockid_t clock;
+    struct timespec ts;
+    if (clock_getcpuclockid(monitor->pid, &clock) != 0 || clock_gettime(clock, &ts) != 0) {
+        return 0;
+    }
+    return (uint64_t)ts.tv_sec * 1000000ull + (uint64_t)ts.tv_nsec / 1000;
+}
+
+// 超时：记录原因并终止整个PID命名空间，之后只等待宽限期内回收剩余任务
+static void terminate_sandbox(syscall_monitor_t *monitor, int reason) {
+    const sandbox_config *config = monitor->config;
+    if (reason == TIMEOUT_WALL) {
+        fprintf(monitor->log_file, "\n[%d] [TIMEOUT] 超过墙上时间限制 %.1f 秒，终止沙箱\n",
+                monitor->pid, (double)config->timeout_ms / 1000.0);
+    } else {
+        fprintf(monitor->log_file, "\n[%d] [TIMEOUT] 超过CPU时间限制 %.1f 秒，终止沙箱\n",
+                monitor->pid, (double)config->cpu_timeout_ms / 1000.0);
+    }
+
+    if (monitor->trace_log) {
+        // 多个跟踪线程时由分派线程调用，它的生产者只在提交这一条记录时处于忙碌状态
+        long limit_ms = reason == TIMEOUT_WALL ? config->timeout_ms : config->cpu_timeout_ms;
+        int sharded = monitor->shard_count > 1;
+        if (sharded) trace_log_busy(monitor->trace_log, monitor->control_producer);
+        push_task_event(monitor, monitor->control_producer, monitor->pid, TRACE_REC_TIMEOUT,
+                        (uint64_t)reason, (uint64_t)limit_ms, 0, 0);
+        if (sharded) trace_log_idle(monitor->trace_log, monitor->control_producer);
+    }
+
+    monitor->result->timeout_reason = reason;
+    monitor->killing = 1;
+    kill_sandbox(config, monitor->pid);
+
+    arm_timer(monitor->wall_fd, KILL_GRACE_MS, 0);
+    if (monitor->cpu_fd != -1) {
+        arm_timer(monitor->cpu_fd, 0, 0);
+    }
+}
+
+// 没有待处理的状态变化时等待下一个SIGCHLD、计时器、eBPF记录或跟踪线程的唤醒，返回-1表示
+// 放弃等待剩余任务。未使用的fd为-1，poll会忽略；没有signalfd时（只可能是eBPF后端）定期检查根进程
+static int wait_for_events(syscall_monitor_t *monitor) {
+    struct pollfd pfds[5] = {
+        { .fd = monitor->sigchld_fd, .events = POLLIN },
+        { .fd = monitor->wall_fd, .events = POLLIN },
+        { .fd = monitor->cpu_fd, .events = POLLIN },
+        { .fd = monitor->ebpf_enabled ? monitor->ebpf.ring_fd : -1, .events = POLLIN },
+        { .fd = monitor->wake_fd, .events = POLLIN },
+    };
+    if (poll(pfds, 5, monitor->sigchld_fd == -1 ? CPU_TIMEOUT_POLL_MS : -1) == -1) {
+        return errno == EINTR ? 0 : -1;
+    }
+
+    // 清空已到达的信号、唤醒和计时器到期计数
+    struct signalfd_siginfo info;
+    uint64_t expirations;
+    while (read(monitor->sigchld_fd, &info, sizeof(info)) == (ssize_t)sizeof(info)) {}
+    if (pfds[4].revents & POLLIN) {
+        while (read(monitor->wake_fd, &expirations, sizeof(expirations)) > 0) {}
+    }
+
+    int ret = 0;
+    monitor_lock(monitor);
+    if ((pfds[1].revents & POLLIN) && read(monitor->wall_fd, &expirations, sizeof(expirations)) > 0) {
+        if (monitor->killing) {
+            fprintf(monitor->log_file, "[%d] [TIMEOUT] 终止后仍有 %d 个任务未退出，停止等待\n",
+                    monitor->pid, __atomic_load_n(&monitor->live_tasks, __ATOMIC_SEQ_CST));
+            ret = -1;
+        } else {
+            terminate_sandbox(monitor, TIMEOUT_WALL);
+        }
+    }
+
+    if (ret == 0 && monitor->cpu_fd != -1 && (pfds[2].revents & POLLIN) &&
+        read(monitor->cpu_fd, &expirations, sizeof(expirations)) > 0 && !monitor->killing &&
+        sandbox_cpu_usage_us(monitor) >= (uint64_t)monitor->config->cpu_timeout_ms * 1000) {
+        terminate_sandbox(monitor, TIMEOUT_CPU);
+    }
+    monitor_unlock(monitor);
+    return ret;
+}
+
+// 睡眠加速：入口处改写睡眠类系统调用。只有这里和exec事件需要完整的寄存器
+static void warp_syscall_entry(monitor_shard_t *shard, task_state_t *task) {
+    syscall_monitor_t *monitor = shard->monitor;
+    struct user_regs_struct regs;
+    if (ptrace(PTRACE_GETREGS, task->tid, 0, &regs) == -1) {
+        perror("获取寄存器失败");
+        return;
+    }
+    // 虚拟时间由所有分片共用，只在改写时持有锁
+    pthread_mutex_lock(&monitor->warp_lock);
+    int64_t before = monitor->warp.offset_ns;
+    int changed = time_warp_entry(&monitor->warp, task, &regs);
+    int64_t after = monitor->warp.offset_ns;
+    pthread_mutex_unlock(&monitor->warp_lock);
+    if (!changed) {
+        return;
+    }
+    if (ptrace(PTRACE_SETREGS, task->tid, 0, &regs) == -1) {
+        perror("写回寄存器失败");
+        return;
+    }
+    if (!monitor->trace_log) {
+        fprintf(shard->log, "[%d] [TIME] %s睡眠 %.3f s，虚拟时间偏移 %.3f s\n", task->tid,
+                task->warp_action == WARP_SKIPPED ? "跳过" : "缩短",
+                (double)(after - before) / 1e9, (double)after / 1e9);
+    }
+}
+
+// 睡眠加速：退出处恢复被改写的调用并给时间查询加上虚拟偏移，*ret随之更新
+static void warp_syscall_exit(monitor_shard_t *shard, task_state_t *task, long *ret) {
+    syscall_monitor_t *monitor = shard->monitor;
+    struct user_regs_struct regs;
+    if (ptrace(PTRACE_GETREGS, task->tid, 0, &regs) == -1) {
+        perror("获取寄存器失败");
+        return;
+    }
+    pthread_mutex_lock(&monitor->warp_lock);
+    int changed = time_warp_exit(&monitor->warp, task, &regs);
+    pthread_mutex_unlock(&monitor->warp_lock);
+    if (!changed) {
+        return;
+    }
+    if (ptrace(PTRACE_SETREGS, task->tid, 0, &regs) == -1) {
+        perror("写回寄存器失败");
+    } else if (task->current_abi == SYSCALL_ABI_NATIVE) {
+        *ret = (long)regs.rax;
+    }
+}
+
+// 系统调用策略：入口处查找命中的规则并记录。能在内核中执行的规则只记录
+// （完整跟踪模式下跟踪器先于seccomp看到入口，过滤模式下命中这些规则的调用不会停下来），
+// 其余由跟踪器把系统调用号改为-1跳过，退出时填入返回值，或直接终止进程。
+// eBPF和通知后端的样本不在ptrace停止中（stopped为0），这里只记录：eBPF后端的命令行已拒绝
+// 需要跟踪器执行的规则，通知后端由监督线程在回复中执行。
+// 返回1表示已跳过系统调用
+static int policy_syscall_entry(monitor_shard_t *shard, task_state_t *task, int stopped) {
+    syscall_monitor_t *monitor = shard->monitor;
+    if (task->current_abi != SYSCALL_ABI_NATIVE) {
+        return 0;
+    }
+    const policy_rule_t *rule = policy_match(monitor->policy, task->current_syscall, task->args,
+                                             &shard->capture);
+    if (!rule || rule->action == POLICY_ALLOW) {
+        return 0;
+    }
+
+    shard->policy_hits++;
+    int enforce = rule->tracer_enforced && rule->action != POLICY_LOG;
+    if (monitor->trace_log) {
+        record_policy_hit(shard, task, rule, enforce);
+    } else {
+        char action[64];
+        format_policy_action(rule->action, rule->value, action, sizeof(action));
+        fprintf(shard->log, "[%d] [POLICY] %s %s (第%d行，%s)\n", task->tid, action,
+                get_syscall_name(task->current_syscall), rule->line,
+                rule->action == POLICY_LOG ? "仅记录" : enforce ? "跟踪器执行" : "内核执行");
+    }
+    if (!enforce || !stopped) {
+        return 0;
+    }
+
+    // 致命信号挂起时内核不会再执行这次系统调用，这里同样跳过以防万一
+    if (rule->action == POLICY_KILL) {
+        kill(task->tid, SIGKILL);
+        task->policy_ret = -EPERM;
+    } else {
+        task->policy_ret = rule->action == POLICY_ERRNO ? -rule->value : rule->value;
+    }
+    task->policy_skip = 1;
+    // 只改两个寄存器，不必读写整个寄存器组；调用号为-1时内核不会覆盖rax
+    if (ptrace(PTRACE_POKEUSER, task->tid, offsetof(struct user_regs_struct, orig_rax), -1L) == -1 ||
+        ptrace(PTRACE_POKEUSER, task->tid, offsetof(struct user_regs_struct, rax), task->policy_ret) == -1) {
+        perror("写回寄存器失败");
+    }
+    return 1;
+}
+
+// 被策略跳过的系统调用退出时填入伪造的返回值
+static void policy_syscall_exit(task_state_t *task) {
+    task->policy_skip = 0;
+    if (ptrace(PTRACE_POKEUSER, task->tid, offsetof(struct user_regs_struct, rax), task->policy_ret) == -1) {
+        perror("写回寄存器失败");
+    }
+}
+
+// 伪造网络：样本连接或发送到某个端口之前，在沙箱中创建监听该端口的套接字交给sinkhole。
+// 样本此时停在系统调用入口，恢复执行时监听已经就绪
+static void net_syscall_entry(monitor_shard_t *shard, task_state_t *task) {
+    syscall_monitor_t *monitor = shard->monitor;
+    int nr = task->current_syscall;
+    if (task->current_abi != SYSCALL_ABI_NATIVE || (nr != __NR_connect && nr != __NR_sendto)) {
+        return;
+    }
+    const char *data;
+    size_t len;
+    const arg_capture_t *capture = &shard->capture;
+    if (arg_blob_find(capture->blob, capture->len, nr == __NR_connect ? 1 : 4, &data, &len) != 0) {
+        return;
+    }
+
+    struct sockaddr_storage addr;
+    memset(&addr, 0, sizeof(addr));
+    memcpy(&addr, data, len < sizeof(addr) ? len : sizeof(addr));
+    uint16_t port;
+    if (addr.ss_family == AF_INET && len >= sizeof(struct sockaddr_in)) {
+        port = ntohs(((struct sockaddr_in *)&addr)->sin_port);
+    } else if (addr.ss_family == AF_INET6 && len >= sizeof(struct sockaddr_in6)) {
+        port = ntohs(((struct sockaddr_in6 *)&addr)->sin6_port);
+    } else {
+        return;
+    }
+
+    // 套接字类型取自fd跟踪的描述；不可知时connect按TCP、sendto按UDP处理
+    int type = nr == __NR_connect ? SOCK_STREAM : SOCK_DGRAM;
+    if (task->fds) {
+        const char *desc = string_pool_get(&shard->strings,
+                                           fd_table_describe(task->fds, &shard->strings, task->tid,
+                                                             (int)task->args[0]));
+        if (strstr(desc, "/dgram]")) {
+            type = SOCK_DGRAM;
+        } else if (strstr(desc, "/stream]")) {
+            type = SOCK_STREAM;
+        }
+    }
+    if (fake_net_listen(&monitor->net, type, port) == 1 && !monitor->trace_log) {
+        fprintf(shard->log, "[%d] [NET] sinkhole开始监听 %s/%u\n", task->tid,
+                type == SOCK_DGRAM ? "udp" : "tcp", port);
+    }
+}
+
+// 对任务所在进程做一次可执行内存快照，逐个区域记录结果
+static void dump_exec_memory(monitor_shard_t *shard, pid_t tid, int trigger, unsigned long start,
+                             unsigned long end) {
+    syscall_monitor_t *monitor = shard->monitor;
+    pid_t tgid, ppid;
+    read_task_ids(tid, &tgid, &ppid);
+    mem_dump_region_t regions[MEM_DUMP_BATCH];
+    int count = mem_dump_snapshot(&monitor->dump, &shard->dump_cache, tgid, tid, trigger, start, end, regions,
+                                  MEM_DUMP_BATCH);
+    for (int i = 0; i < count; i++) {
+        const mem_dump_region_t *region = &regions[i];
+        if (monitor->trace_log) {
+            trace_record_t rec;
+            memset(&rec, 0, sizeof(rec));
+            rec.timestamp_ns = trace_timestamp_ns();
+            rec.tid = (uint32_t)tid;
+            rec.type = TRACE_REC_MEM_DUMP;
+            rec.syscall_nr = -1;
+            rec.args[0] = region->start;
+            rec.args[1] = region->end;
+            rec.args[3] = (uint64_t)trigger;
+            rec.args[4] = (uint64_t)region->pages;
+            rec.args[5] = (uint64_t)region->changed_pages;
+            rec.ret = region->status;
+            int has_digest = region->status == MEM_DUMP_STORED || region->status == MEM_DUMP_DUPLICATE;
+            trace_log_push(monitor->trace_log, shard->producer, &rec, region->digest,
+                           has_digest ? SHA256_DIGEST_LEN : 0);
+        } else {
+            char line[256];
+            format_mem_dump(trigger, region, line, sizeof(line));
+            fprintf(shard->log, "[%d] [DUMP] %s\n", tid, line);
+        }
+    }
+}
+
+// 系统调用成功返回后检查是否有内存变为可执行。mremap不带保护标志，由maps判断新位置是否可执行
+static void dump_syscall_exit(monitor_shard_t *shard, task_state_t *task, long ret) {
+    const unsigned long *args = task->args;
+    switch (task->current_syscall) {
+    case __NR_mmap:
+        if (args[2] & PROT_EXEC) {
+            dump_exec_memory(shard, task->tid, MEM_DUMP_MMAP, (unsigned long)ret, (unsigned long)ret + args[1]);
+        }
+        break;
+    case __NR_mprotect:
+    case __NR_pkey_mprotect:
+        if (args[2] & PROT_EXEC) {
+            dump_exec_memory(shard, task->tid, MEM_DUMP_MPROTECT, args[0], args[0] + args[1]);
+        }
+        break;
+    case __NR_mremap:
+        dump_exec_memory(shard, task->tid, MEM_DUMP_MREMAP, (unsigned long)ret, (unsigned long)ret + args[2]);
+        break;
+    default:
+        break;
+    }
+}
+
+// ptrace后端的系统调用入口或seccomp停止：记录后按策略、伪造网络和睡眠加速处理
+static void ptrace_syscall_entry(monitor_shard_t *shard, task_state_t *task, const ptrace_stop_t *stop) {
+    syscall_monitor_t *monitor = shard->monitor;
+    handle_syscall_entry(shard, task, stop);
+    if (monitor->dump_enabled && task->current_abi == SYSCALL_ABI_NATIVE &&
+        (task->current_syscall == __NR_exit_group || task->current_syscall == __NR_execve ||
+         task->current_syscall == __NR_execveat)) {
+        // 可写可执行的区域在映射之后才被写入解密后的代码，进程结束或换映像之前再看一次
+        dump_exec_memory(shard, task->tid, MEM_DUMP_RESCAN, 0, 0);
+    }
+    int skipped = monitor->policy && policy_syscall_entry(shard, task, 1);
+    if (monitor->net_enabled && !skipped) {
+        net_syscall_entry(shard, task);
+    }
+    if (monitor->warp_enabled && !skipped) {
+        warp_syscall_entry(shard, task);
+    }
+    task->in_syscall = 1;
+}
+
+// ptrace后端的系统调用退出。没有对应入口的退出（例如跟踪开始前已在系统调用中）无法配对，忽略
+static void ptrace_syscall_exit(monitor_shard_t *shard, task_state_t *task,
+                                const struct __ptrace_syscall_info *info, uint64_t stop_ns) {
+    syscall_monitor_t *monitor = shard->monitor;
+    if (!task->in_syscall) {
+        return;
+    }
+    // 兼容ABI的返回值是32位有符号数
+    long ret = task->current_abi == SYSCALL_ABI_COMPAT ? (long)(int32_t)info->exit.rval : (long)info->exit.rval;
+    int skipped = task->policy_skip;
+    if (skipped) {
+        policy_syscall_exit(task);
+        ret = task->policy_ret;
+    } else if (monitor->warp_enabled) {
+        warp_syscall_exit(shard, task, &ret);
+    }
+    handle_syscall_exit(shard, task, ret, stop_ns);
+    if (monitor->dump_enabled && !skipped && ret >= 0 && task->current_abi == SYSCALL_ABI_NATIVE) {
+        dump_syscall_exit(shard, task, ret);
+    }
+    task->in_syscall = 0;
+}
+
+// 信号投递停止：把信号交还给任务，返回恢复时要注入的信号。样本常靠SIGSEGV、SIGTRAP等
+// 处理器做反调试或解密，吞掉信号会改变它的行为。PTRACE_GETSIGINFO失败说明是组停止，
+// 此时不注入信号直接恢复（未使用PTRACE_SEIZE，无法让任务保持停止）
+static int handle_signal_stop(monitor_shard_t *shard, pid_t tid, int sig) {
+    siginfo_t si;
+    if (ptrace(PTRACE_GETSIGINFO, tid, 0, &si) == -1) {
+        return 0;
+    }
+    if (shard->monitor->trace_log) {
+        record_task_event(shard, tid, TRACE_REC_SIGNAL, (uint64_t)sig, (uint64_t)(int64_t)si.si_code, 0, 0);
+    } else {
+        const char *name = sigabbrev_np(sig);
+        fprintf(shard->log, "[%d] [SIGNAL] 转发信号 SIG%s (%d), si_code: %d\n", tid,
+                name ? name : "UNKNOWN", sig, si.si_code);
+    }
+    return sig;
+}
+
+// 新进程交给哪个跟踪线程：主线程只保留根进程及其线程，其余新进程分给任务最少的线程，
+// 当前线程并不比它多出两个以上时留在原处；目标线程的状态表过半时不再迁入。返回NULL表示不迁移
+static monitor_shard_t *pick_shard(syscall_monitor_t *monitor, monitor_shard_t *current) {
+    monitor_shard_t *best = NULL;
+    int best_load = 0;
+    for (int i = 1; i < monitor->shard_count; i++) {
+        monitor_shard_t *shard = monitor->shards[i];
+        int load = __atomic_load_n(&shard->tracees, __ATOMIC_RELAXED);
+        if (!best || load < best_load) {
+            best = shard;
+            best_load = load;
+        }
+    }
+    int current_load = __atomic_load_n(&current->tracees, __ATOMIC_RELAXED);
+    if (!best || best == current || best_load >= TASK_TABLE_SIZE / 2 ||
+        (current->index != 0 && best_load + 1 >= current_load)) {
+        return NULL;
+    }
+    return best;
+}
+
+// 迁移期间进程停在pause中，不能有seccomp过滤器把它变成跟踪停止或改变它的结果。
+// 沙箱自己的过滤器已在migration_ok中确认不涉及pause，这里确认样本没有再安装过滤器
+static int seccomp_allows_pause(syscall_monitor_t *monitor, pid_t tid) {
+    char path[64], line[128];
+    snprintf(path, sizeof(path), "/proc/%d/status", tid);
+    FILE *fp = fopen(path, "re");
+    if (!fp) {
+        return 0;
+    }
+    int mode = -1, filters = -1;
+    while (fgets(line, sizeof(line), fp)) {
+        if (sscanf(line, "Seccomp: %d", &mode) == 1) {
+            continue;
+        }
+        if (sscanf(line, "Seccomp_filters: %d", &filters) == 1) {
+            break;
+        }
+    }
+    fclose(fp);
+    int expected = monitor->config->seccomp_filter || monitor->policy ? 1 : 0;
+    return mode == 0 || (filters >= 0 && filters <= expected);
+}
+
+// 把停在初始停止处的新进程交给target，样本和它的父进程都看不到这次交接：先屏蔽所有信号，
+// 再把寄存器改成回到刚执行过的syscall指令调用pause，然后不带信号地脱离。脱离后进程只会
+// 睡在pause中，不执行任何用户代码，也不进入停止状态（父进程收不到CLD_STOPPED）。
+// 新进程刚从fork返回，rip指向syscall指令之后。返回0表示已交出，task随之从状态表中删除
+static int migrate_task(monitor_shard_t *shard, task_state_t *task, monitor_shard_t *target) {
+    syscall_monitor_t *monitor = shard->monitor;
+    pid_t tid = task->tid;
+    task_migration_t *migration = calloc(1, sizeof(*migration));
+    if (!migration) {
+        return -1;
+    }
+    if (ptrace(PTRACE_GETREGS, tid, 0, &migration->regs) == -1 || migration->regs.cs != X86_USER64_CS) {
+        goto fail;
+    }
+    errno = 0;
+    long insn = ptrace(PTRACE_PEEKTEXT, tid, migration->regs.rip - 2, 0);
+    if (errno != 0 || (insn & 0xffff) != X86_SYSCALL_INSN ||
+        ptrace(PTRACE_GETSIGMASK, tid, sizeof(migration->sigmask), &migration->sigmask) == -1) {
+        goto fail;
+    }
+    if (task->fds) {
+        migration->fds = fd_table_export(task->fds, &shard->strings, &migration->fds_len);
+        if (!migration->fds) {
+            goto fail;
+        }
+    }
+
+    uint64_t blocked = ~0ull;
+    struct user_regs_struct regs = migration->regs;
+    regs.rip -= 2;
+    regs.rax = __NR_pause;
+    regs.orig_rax = -1;
+    if (ptrace(PTRACE_SETSIGMASK, tid, sizeof(blocked), &blocked) == -1) {
+        goto fail;
+    }
+    if (ptrace(PTRACE_SETREGS, tid, 0, &regs) == -1) {
+        goto restore;
+    }
+
+    // 脱离之前计入迁移中：分派线程在接管之前看不到这个进程，不能据此判断任务已全部结束
+    __atomic_fetch_add(&monitor->migrations, 1, __ATOMIC_SEQ_CST);
+    __atomic_fetch_add(&monitor->migrating, 1, __ATOMIC_SEQ_CST);
+    if (ptrace(PTRACE_DETACH, tid, 0, 0) == -1) {
+        __atomic_fetch_sub(&monitor->migrating, 1, __ATOMIC_SEQ_CST);
+        goto restore;
+    }
+
+    // 负载在此时就转到目标线程，接连派生的进程不会都选中同一个线程；任务总数不变
+    migration->task = *task;
+    migration->task.fds = NULL;
+    fd_table_release(task->fds);
+    task_table_remove(&shard->tasks, tid);
+    __atomic_fetch_sub(&shard->tracees, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&target->tracees, 1, __ATOMIC_RELAXED);
+    shard_post(target, &(shard_msg_t){ .tid = tid, .migration = migration });
+    return 0;
+
+restore:
+    ptrace(PTRACE_SETREGS, tid, 0, &migration->regs);
+    ptrace(PTRACE_SETSIGMASK, tid, sizeof(migration->sigmask), &migration->sigmask);
+fail:
+    free(migration->fds);
+    free(migration);
+    return -1;
+}
+
+// 新任务的初始停止和父任务的fork事件都已处理：新进程在这里决定是否迁移，否则恢复执行。
+// 返回后task可能已不在状态表中
+static void start_new_task(monitor_shard_t *shard, task_state_t *task) {
+    syscall_monitor_t *monitor = shard->monitor;
+    task->new_task = 0;
+    if (task->spawn == SPAWN_PROCESS && monitor->migration_ok) {
+        monitor_shard_t *target = pick_shard(monitor, shard);
+        if (target && seccomp_allows_pause(monitor, task->tid) && migrate_task(shard, task, target) == 0) {
+            return;
+        }
+    }
+    resume_task(task->tid, resume_request(monitor, task), 0);
+}
+
+// 迁移过来的新进程的第一次停止：恢复脱离前的寄存器和信号掩码。orig_rax为-1，
+// pause被打断后不会重新执行，rax保持fork的返回值
+static void restore_migrated_task(task_state_t *task) {
+    task_migration_t *migration = task->migration;
+    migration->regs.orig_rax = -1;
+    if (ptrace(PTRACE_SETREGS, task->tid, 0, &migration->regs) == -1 ||
+        ptrace(PTRACE_SETSIGMASK, task->tid, sizeof(migration->sigmask), &migration->sigmask) == -1) {
+        if (errno != ESRCH) {
+            perror("恢复迁移进程的状态失败");
+        }
+    }
+    free(migration);
+    task->migration = NULL;
+    task->new_task = 0;
+}
+
+// 父任务在fork事件之前被杀死时，等待它的新任务不会再等到该事件：分片中有任务退出时
+// 让所有等待中的新任务开始执行（不迁移）
+static void release_held_tasks(monitor_shard_t *shard) {
+    for (size_t i = 0; i < TASK_TABLE_SIZE && shard->held > 0; i++) {
+        task_state_t *task = &shard->tasks.slots[i];
+        if (task->tid != 0 && task->new_task == NEW_TASK_HELD) {
+            shard->held--;
+            task->new_task = 0;
+            resume_task(task->tid, resume_request(shard->monitor, task), 0);
+        }
+    }
+}
+
+// 处理一次ptrace停止，按PTRACE_GET_SYSCALL_INFO报告的类型分派，不依赖入口/退出交替的假设。
+// 恢复方式写入stop，由调用者执行。stop_ns为waitpid取到本次停止的时间
+static void handle_stop(monitor_shard_t *shard, pid_t tid, int status, uint64_t stop_ns,
+                        ptrace_stop_t *stop) {
+    syscall_monitor_t *monitor = shard->monitor;
+    task_state_t *task = task_table_lookup(&shard->tasks, tid);
+    int early = 0;
+    if (!task) {
+        // 新任务的初始停止可能先于父进程的fork事件到达
+        task = shard_insert_task(shard, tid);
+        if (task) {
+            owner_set(monitor, tid, shard->index);
+            early = 1;
+        }
+    }
+
+    int sig = WSTOPSIG(status);
+    int event = status >> 16;
+    int entered = 0;
+    int inject = 0;
+    stop->sig = 0;
+
+    if (task && task->new_task == NEW_TASK_MIGRATED) {
+        restore_migrated_task(task);
+        if (event == PTRACE_EVENT_STOP) {
+            // 接管时PTRACE_INTERRUPT造成的停止
+            stop->request = resume_request(monitor, task);
+            return;
+        }
+    }
+
+    if (stop->has_info) {
+        // 系统调用停止或seccomp过滤器命中
+        const struct __ptrace_syscall_info *info = &stop->info;
+        if (!task) {
+            // 状态表已满：不再解码该任务，只让它继续运行
+        } else if (info->op == PTRACE_SYSCALL_INFO_ENTRY || info->op == PTRACE_SYSCALL_INFO_SECCOMP) {
+            ptrace_syscall_entry(shard, task, stop);
+            entered = 1;
+        } else if (info->op == PTRACE_SYSCALL_INFO_EXIT) {
+            ptrace_syscall_exit(shard, task, info, stop_ns);
+        }
+    } else if (sig == (SIGTRAP | 0x80) || (sig == SIGTRAP && event == PTRACE_EVENT_SECCOMP)) {
+        // 取系统调用信息失败，已在prefetch_stop中报告
+    } else if (sig == SIGTRAP && (event == PTRACE_EVENT_FORK || event == PTRACE_EVENT_VFORK ||
+                                  event == PTRACE_EVENT_CLONE)) {
+        if (task) {
+            handle_new_task(shard, task, event);
+        }
+    } else if (sig == SIGTRAP && event == PTRACE_EVENT_EXEC) {
+        if (task) {
+            task = handle_exec_event(shard, task);
+        }
+        if (monitor->dump_enabled) {
+            dump_exec_memory(shard, tid, MEM_DUMP_EXEC, 0, 0);
+        }
+        // 新程序还未开始执行，此时从auxv中隐藏vDSO
+        struct user_regs_struct regs;
+        if (monitor->warp_enabled && ptrace(PTRACE_GETREGS, tid, 0, &regs) == 0) {
+            int hidden = time_warp_hide_vdso(tid, &regs) == 0;
+            if (!monitor->trace_log) fprintf(shard->log, "[%d] [TIME] %s\n", tid,
+                    hidden ? "已隐藏vDSO，时间查询将经过跟踪器" : "未找到vDSO，时间查询不经过vDSO");
+        }
+    } else if (task && task->new_task == NEW_TASK_ATTACHED &&
+               ((sig == SIGSTOP && event == 0) || event == PTRACE_EVENT_STOP)) {
+        // 新任务的初始停止（PTRACE_SEIZE接管的进程派生的任务为PTRACE_EVENT_STOP），吞掉即可。
+        // 先于fork事件到达时还不知道新任务能否迁移，多个跟踪线程时让它停在这里等待该事件
+        stop->request = -1;
+        if (early && monitor->shard_count > 1) {
+            task->new_task = NEW_TASK_HELD;
+            shard->held++;
+            return;
+        }
+        start_new_task(shard, task);
+        return;
+    } else if (event == 0) {
+        inject = handle_signal_stop(shard, tid, sig);
+    }
+
+    stop->sig = inject;
+    if (task) {
+        task->new_task = 0;
+        if (entered) {
+            // 系统调用计时从恢复执行开始
+            task->entry_ns = monitor_now_ns();
+        }
+    }
+    stop->request = resume_request(monitor, task);
+}
+
+// 处理一次状态变化。系统调用信息和参数内存在prefetch_stop中读取，之后处理并恢复任务
+static void dispatch_wait_status(monitor_shard_t *shard, pid_t tid, int status, uint64_t stop_ns) {
+    shard->stops++;
+    if (WIFEXITED(status) || WIFSIGNALED(status)) {
+        handle_task_exit(shard, tid, status);
+        if (shard->held > 0) {
+            release_held_tasks(shard);
+        }
+        return;
+    }
+    if (!WIFSTOPPED(status)) {
+        return;
+    }
+
+    ptrace_stop_t stop;
+    prefetch_stop(shard, tid, status, &stop);
+    handle_stop(shard, tid, status, stop_ns, &stop);
+    if (stop.request != -1) {
+        resume_task(tid, stop.request, stop.sig);
+    }
+}
+
+// 多个分片时把处理一条消息产生的文本日志一次写入日志文件，各分片的行不会交错
+static void shard_flush_log(monitor_shard_t *shard) {
+    if (shard->log == shard->monitor->log_file) {
+        return;
+    }
+    fflush(shard->log);
+    if (shard->log_len > 0) {
+        fwrite(shard->log_buf, 1, shard->log_len, shard->monitor->log_file);
+        rewind(shard->log);
+    }
+}
+
+// 向分片投递一条消息。收件箱满时加倍，分派线程从不因跟踪线程处理慢而阻塞
+static void shard_post(monitor_shard_t *shard, const shard_msg_t *msg) {
+    pthread_mutex_lock(&shard->inbox_lock);
+    while (shard->inbox_len == shard->inbox_cap) {
+        shard_msg_t *inbox = malloc(2 * shard->inbox_cap * sizeof(*inbox));
+        if (!inbox) {
+            // 等跟踪线程取走消息腾出位置
+            pthread_mutex_unlock(&shard->inbox_lock);
+            sched_yield();
+            pthread_mutex_lock(&shard->inbox_lock);
+            continue;
+        }
+        for (size_t i = 0; i < shard->inbox_len; i++) {
+            inbox[i] = shard->inbox[(shard->inbox_head + i) % shard->inbox_cap];
+        }
+        free(shard->inbox);
+        shard->inbox = inbox;
+        shard->inbox_head = 0;
+        shard->inbox_cap *= 2;
+    }
+    shard->inbox[(shard->inbox_head + shard->inbox_len) % shard->inbox_cap] = *msg;
+    shard->inbox_len++;
+    pthread_cond_signal(&shard->inbox_cond);
+    pthread_mutex_unlock(&shard->inbox_lock);
+}
+
+// 取下一条消息，没有时在条件变量上等待。等待期间在跟踪日志中标记为空闲，
+// 写入线程不必等它就能输出其他分片的记录。返回-1表示跟踪线程应当结束：
+// SHARDS_DONE时先处理完收件箱，SHARDS_ABANDON时立即结束
+static int shard_receive(monitor_shard_t *shard, shard_msg_t *msg) {
+    syscall_monitor_t *monitor = shard->monitor;
+    pthread_mutex_lock(&shard->inbox_lock);
+    for (;;) {
+        int stopping = __atomic_load_n(&monitor->shards_stopping, __ATOMIC_ACQUIRE);
+        if (stopping == SHARDS_ABANDON || (stopping == SHARDS_DONE && shard->inbox_len == 0)) {
+            pthread_mutex_unlock(&shard->inbox_lock);
+            return -1;
+        }
+        if (shard->inbox_len > 0) {
+            break;
+        }
+        if (monitor->trace_log) trace_log_idle(monitor->trace_log, shard->producer);
+        pthread_cond_wait(&shard->inbox_cond, &shard->inbox_lock);
+        if (monitor->trace_log) trace_log_busy(monitor->trace_log, shard->producer);
+    }
+    *msg = shard->inbox[shard->inbox_head];
+    shard->inbox_head = (shard->inbox_head + 1) % shard->inbox_cap;
+    shard->inbox_len--;
+    pthread_mutex_unlock(&shard->inbox_lock);
+    return 0;
+}
+
+// 分片不知道的tid（例如tid被复用、分派线程的记录已过时）按/proc中的TracerPid找到跟踪它的线程
+static monitor_shard_t *tracer_shard(syscall_monitor_t *monitor, pid_t tid) {
+    char path[64], line[128];
+    snprintf(path, sizeof(path), "/proc/%d/status", tid);
+    FILE *fp = fopen(path, "re");
+    if (!fp) {
+        return NULL;
+    }
+    pid_t tracer = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        if (sscanf(line, "TracerPid: %d", &tracer) == 1) {
+            break;
+        }
+    }
+    fclose(fp);
+    for (int i = 0; tracer > 0 && i < monitor->shard_count; i++) {
+        if (__atomic_load_n(&monitor->shards[i]->ktid, __ATOMIC_ACQUIRE) == tracer) {
+            return monitor->shards[i];
+        }
+    }
+    return NULL;
+}
+
+// 接管迁移过来的新进程。进程睡在pause中且屏蔽了所有信号，PTRACE_SEIZE不会让它停止，
+// 之后用PTRACE_INTERRUPT让它停下；第一次停止时由restore_migrated_task恢复原来的状态
+static void shard_adopt(monitor_shard_t *shard, task_migration_t *migration) {
+    syscall_monitor_t *monitor = shard->monitor;
+    pid_t tid = migration->task.tid;
+    owner_set(monitor, tid, shard->index);
+    task_state_t *task = task_table_insert(&shard->tasks, tid);
+    if (task) {
+        *task = migration->task;
+        task->new_task = NEW_TASK_MIGRATED;
+        task->migration = migration;
+        if (migration->fds) {
+            task->fds = fd_table_import(migration->fds, migration->fds_len, &shard->strings);
+        }
+    }
+    free(migration->fds);
+    migration->fds = NULL;
+
+    int seized = task && ptrace(PTRACE_SEIZE, tid, 0, monitor->ptrace_options) == 0;
+    if (!seized && (!task || errno != ESRCH)) {
+        // 进程脱离了跟踪，不能让它继续运行
+        perror("接管迁移的进程失败");
+        kill(tid, SIGKILL);
+    }
+    if (seized && ptrace(PTRACE_INTERRUPT, tid, 0, 0) == -1 && errno != ESRCH) {
+        perror("停止迁移的进程失败");
+        kill(tid, SIGKILL);
+    }
+    __atomic_fetch_sub(&monitor->migrating, 1, __ATOMIC_SEQ_CST);
+    if (!seized) {
+        // 交接期间进程已被杀死（例如超时终止沙箱），不会再有跟踪线程收到它的退出
+        if (task) {
+            handle_task_exit(shard, tid, -1);
+        } else {
+            free(migration);
+            shard_task_gone(shard);
+        }
+    }
+    // 让分派线程重新检查是否还有被跟踪的任务
+    uint64_t one = 1;
+    if (monitor->wake_fd != -1 && write(monitor->wake_fd, &one, sizeof(one)) == -1) {
+        perror("唤醒分派线程失败");
+    }
+}
+
+// 处理一条消息。状态表中没有的tid若由其他线程跟踪，转交给那个线程
+static void shard_handle(monitor_shard_t *shard, shard_msg_t *msg) {
+    if (msg->migration) {
+        shard_adopt(shard, msg->migration);
+        return;
+    }
+    if (WIFSTOPPED(msg->status) && !task_table_lookup(&shard->tasks, msg->tid)) {
+        monitor_shard_t *owner = tracer_shard(shard->monitor, msg->tid);
+        if (owner && owner != shard) {
+            owner_set(shard->monitor, msg->tid, owner->index);
+            shard_post(owner, msg);
+            return;
+        }
+    }
+    dispatch_wait_status(shard, msg->tid, msg->status, msg->stop_ns);
+}
+
+// 跟踪线程的主循环：处理收件箱中的消息，直到分派线程要求结束
+static void shard_loop(monitor_shard_t *shard) {
+    syscall_monitor_t *monitor = shard->monitor;
+    if (monitor->trace_log) trace_log_busy(monitor->trace_log, shard->producer);
+    shard_msg_t msg;
+    while (shard_receive(shard, &msg) == 0) {
+        shard_handle(shard, &msg);
+        shard_flush_log(shard);
+    }
+    if (monitor->trace_log) trace_log_idle(monitor->trace_log, shard->producer);
+}
+
+static void *shard_thread(void *arg) {
+    monitor_shard_t *shard = arg;
+    __atomic_store_n(&shard->ktid, gettid(), __ATOMIC_RELEASE);
+    shard_loop(shard);
+    return NULL;
+}
+
+// 所有跟踪线程结束主循环：SHARDS_DONE在所有任务退出后，SHARDS_ABANDON放弃等待剩余任务
+static void shards_stop(syscall_monitor_t *monitor, int how) {
+    int running = SHARDS_RUNNING;
+    __atomic_compare_exchange_n(&monitor->shards_stopping, &running, how, 0, __ATOMIC_ACQ_REL,
+                                __ATOMIC_ACQUIRE);
+    for (int i = 0; i < monitor->shard_count; i++) {
+        monitor_shard_t *shard = monitor->shards[i];
+        pthread_mutex_lock(&shard->inbox_lock);
+        pthread_cond_broadcast(&shard->inbox_cond);
+        pthread_mutex_unlock(&shard->inbox_lock);
+    }
+}
+
+// 把一次状态变化投递给跟踪该任务的分片。不在记录中的tid（例如接管前已派生的任务）
+// 按TracerPid查找，找不到时交给主线程；退出后tid可能被复用，清除记录
+static void route_wait_status(syscall_monitor_t *monitor, pid_t tid, int status, uint64_t stop_ns) {
+    int index = owner_get(monitor, tid);
+    monitor_shard_t *shard = index >= 0 && index < monitor->shard_count ? monitor->shards[index] : NULL;
+    if (!shard) {
+        shard = tracer_shard(monitor, tid);
+        if (!shard) {
+            shard = monitor->shards[0];
+        }
+    }
+    int exited = WIFEXITED(status) || WIFSIGNALED(status);
+    if (exited) {
+        owner_set(monitor, tid, -1);
+    }
+    shard_post(shard, &(shard_msg_t){ .tid = tid, .status = status, .stop_ns = stop_ns });
+}
+
+// 分派线程：不带__WNOTHREAD的waitpid能取到本进程任何线程跟踪的任务的状态变化，
+// 按tid投递给所属分片，自己从不执行ptrace操作。没有状态变化时在poll上等待SIGCHLD、
+// 计时器和任务全部结束的通知，并处理超时，不轮询也不向跟踪线程发送信号
+static void *dispatcher_thread(void *arg) {
+    syscall_monitor_t *monitor = arg;
+    int how = SHARDS_DONE;
+    int status;
+    while (__atomic_load_n(&monitor->live_tasks, __ATOMIC_SEQ_CST) > 0) {
+        uint64_t migrations = __atomic_load_n(&monitor->migrations, __ATOMIC_SEQ_CST);
+        int migrating = __atomic_load_n(&monitor->migrating, __ATOMIC_SEQ_CST);
+        pid_t tid = waitpid(-1, &status, __WALL | WNOHANG);
+        if (tid > 0) {
+            route_wait_status(monitor, tid, status, monitor_now_ns());
+            continue;
+        }
+        if (tid == -1 && errno == EINTR) {
+            continue;
+        }
+        if (tid == -1 && errno != ECHILD) {
+            perror("waitpid失败");
+            how = SHARDS_ABANDON;
+            break;
+        }
+        // 没有被跟踪的任务，且期间没有进程处在脱离和接管之间：剩下的退出都已投递
+        if (tid == -1 && migrating == 0 && __atomic_load_n(&monitor->migrating, __ATOMIC_SEQ_CST) == 0 &&
+            __atomic_load_n(&monitor->migrations, __ATOMIC_SEQ_CST) == migrations) {
+            break;
+        }
+        if (wait_for_events(monitor) != 0) {
+            how = SHARDS_ABANDON;
+            break;
+        }
+    }
+    shards_stop(monitor, how);
+    return NULL;
+}
 
-// 系统调用监控结构
-typedef struct {
-    pid_t pid;                      // 被监控进程ID
-    FILE *log_file;                 // 日志文件
-    int syscall_count[SYSCALL_MAX]; // 系统调用计数器
-    struct timeval last_entry;      // 上次系统调用进入时间
-    long exec_time_us[SYSCALL_MAX]; // 每类系统调用执行时间(微秒)
-    int in_syscall;                 // 是否在系统调用中
-    int current_syscall;            // 当前系统调用号
-    unsigned long args[6];          // 当前系统调用参数
-} syscall_monitor_t;
+// 创建跟踪分片。只有一个分片时（包括eBPF和通知后端）直接写日志文件；多个时各分片
+// 先写入自己的内存流，按tid记录所属分片的表按pid_max分配
+static int init_shards(syscall_monitor_t *monitor, int count) {
+    monitor->shards = calloc(TRACER_THREADS_MAX, sizeof(*monitor->shards));
+    if (!monitor->shards) {
+        perror("内存分配失败");
+        return -1;
+    }
+    monitor->wake_fd = -1;
+    for (int i = 0; i < count; i++) {
+        monitor_shard_t *shard = calloc(1, sizeof(*shard));
+        if (!shard) {
+            perror("内存分配失败");
+            return -1;
+        }
+        monitor->shards[i] = shard;
+        monitor->shard_count = i + 1;
+        shard->monitor = monitor;
+        shard->index = i;
+        shard->producer = i;
+        shard->log = monitor->log_file;
+        pthread_mutex_init(&shard->inbox_lock, NULL);
+        pthread_cond_init(&shard->inbox_cond, NULL);
+        if (monitor->config->ngram_n >= 0) {
+            ngram_init(&shard->ngram, monitor->config->ngram_n ? monitor->config->ngram_n : NGRAM_DEFAULT_N,
+                       monitor->config->ngram_top ? monitor->config->ngram_top : NGRAM_DEFAULT_TOP);
+        }
+        if (count > 1) {
+            shard->inbox_cap = SHARD_INBOX_INITIAL;
+            shard->inbox = malloc(shard->inbox_cap * sizeof(*shard->inbox));
+            shard->log = open_memstream(&shard->log_buf, &shard->log_len);
+            if (!shard->inbox || !shard->log) {
+                perror("内存分配失败");
+                return -1;
+            }
+        }
+    }
+    monitor->control_producer = count > 1 ? count : 0;
+    if (count == 1) {
+        return 0;
+    }
 
-// 返回当前微秒时间戳
-static long get_current_time_us() __attribute__((used));
-static long get_current_time_us() {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return tv.tv_sec * 1000000 + tv.tv_usec;
+    monitor->owner_size = 4194304;  // pid_max的上限
+    FILE *fp = fopen("/proc/sys/kernel/pid_max", "re");
+    long pid_max;
+    if (fp) {
+        if (fscanf(fp, "%ld", &pid_max) == 1 && pid_max > 0 && pid_max <= 4194304) {
+            monitor->owner_size = (size_t)pid_max + 1;
+        }
+        fclose(fp);
+    }
+    monitor->owner = calloc(monitor->owner_size, sizeof(*monitor->owner));
+    if (!monitor->owner) {
+        perror("内存分配失败");
+        return -1;
+    }
+    return 0;
 }
 
-// 计算两个时间戳之间的差值（微秒）
-static long time_diff_us(struct timeval *start, struct timeval *end) {
-    return (end->tv_sec - start->tv_sec) * 1000000 + (end->tv_usec - start->tv_usec);
+// 结束后把各分片的统计合并到分片0，按分片0输出
+static void merge_shards(syscall_monitor_t *monitor) {
+    monitor_shard_t *total = monitor->shards[0];
+    for (int i = 1; i < monitor->shard_count; i++) {
+        monitor_shard_t *shard = monitor->shards[i];
+        for (int abi = 0; abi < SYSCALL_ABI_COUNT; abi++) {
+            for (int nr = 0; nr < SYSCALL_MAX; nr++) {
+                latency_hist_merge(&total->latency[abi][nr], &shard->latency[abi][nr]);
+            }
+        }
+        if (monitor->config->ngram_n >= 0) {
+            ngram_merge(&total->ngram, &shard->ngram);
+        }
+        total->policy_hits += shard->policy_hits;
+    }
 }
 
-// 获取系统调用名称
-static const char *get_syscall_name(int syscall_nr) {
-    if (syscall_nr >= 0 && syscall_nr < SYSCALL_MAX && syscall_names[syscall_nr] != NULL) {
-        return syscall_names[syscall_nr];
+static void free_shards(syscall_monitor_t *monitor) {
+    if (!monitor->shards) {
+        return;
+    }
+    // 创建线程失败时shard_count会减小，按分配的数量释放
+    for (int i = 0; i < TRACER_THREADS_MAX && monitor->shards[i]; i++) {
+        monitor_shard_t *shard = monitor->shards[i];
+        for (size_t j = 0; j < TASK_TABLE_SIZE; j++) {
+            if (shard->tasks.slots[j].tid != 0) {
+                fd_table_release(shard->tasks.slots[j].fds);
+                free(shard->tasks.slots[j].migration);
+            }
+        }
+        for (size_t j = 0; j < shard->inbox_len; j++) {
+            task_migration_t *migration = shard->inbox[(shard->inbox_head + j) % shard->inbox_cap].migration;
+            if (migration) {
+                free(migration->fds);
+                free(migration);
+            }
+        }
+        if (shard->log != monitor->log_file) {
+            fclose(shard->log);
+            free(shard->log_buf);
+        }
+        string_pool_free(&shard->strings);
+        mem_dump_cache_free(&shard->dump_cache);
+        free(shard->inbox);
+        pthread_mutex_destroy(&shard->inbox_lock);
+        pthread_cond_destroy(&shard->inbox_cond);
+        free(shard);
     }
-    return "unknown";
+    free(monitor->shards);
+    monitor->shards = NULL;
+    free(monitor->owner);
+    monitor->owner = NULL;
 }
 
-// 从进程内存中读取字符串
-static void read_string_from_process(pid_t pid, unsigned long addr, char *str, size_t maxlen) {
-    size_t i = 0;
-    unsigned long tmp;
+// ptrace后端：等待沙箱到达初始停止，配置网络并设置ptrace选项
+static int start_ptrace_monitor(syscall_monitor_t *monitor) {
+    const sandbox_config *config = monitor->config;
+    pid_t child_pid = monitor->pid;
 
-    while (i < maxlen - 1) {
-        tmp = ptrace(PTRACE_PEEKDATA, pid, addr + i, NULL);
-        if (errno != 0) {
-            str[i] = '\0';
-            return;
+    // 等待子进程停止（由于PTRACE_TRACEME）
+    waitpid(child_pid, NULL, 0);
+    monitor->result->ready_ns = trace_timestamp_ns();
+
+    // 样本还未执行，此时配置沙箱的网络
+    if (monitor->net_enabled) {
+        if (fake_net_attach(&monitor->net, config->sinkhole_fd, child_pid) == 0) {
+            fprintf(monitor->log_file, "伪造网络: 所有地址路由到回环接口，连接由sinkhole接受 (沙箱 %d)\n\n",
+                    child_pid);
+        } else {
+            monitor->net_enabled = 0;
+            printf("警告: 伪造网络不可用\n");
+        }
+    }
+
+    if (config->latency_calibrate) {
+        monitor->ptrace_overhead_ns = calibrate_ptrace_overhead();
+        fprintf(monitor->log_file, "延迟校准: 每次系统调用扣除ptrace往返开销 %llu ns\n\n",
+                (unsigned long long)monitor->ptrace_overhead_ns);
+        printf("ptrace往返开销校准: %llu ns\n", (unsigned long long)monitor->ptrace_overhead_ns);
+    }
+
+    // 设置ptrace选项。EXITKILL：跟踪器意外退出时内核杀死所有被跟踪的任务，
+    // 不会留下脱离观察继续运行的样本
+    long options = PTRACE_O_TRACECLONE | PTRACE_O_TRACEFORK | PTRACE_O_TRACEVFORK |
+                   PTRACE_O_TRACEEXEC | PTRACE_O_TRACESYSGOOD | PTRACE_O_EXITKILL;
+    if (config->seccomp_filter) {
+        options |= PTRACE_O_TRACESECCOMP;
+    }
+    if (ptrace(PTRACE_SETOPTIONS, child_pid, 0, options) == -1) {
+        perror("设置ptrace选项失败");
+        return -1;
+    }
+
+    // 停止分派依赖PTRACE_GET_SYSCALL_INFO（5.3及以上内核），在样本执行前确认可用
+    struct __ptrace_syscall_info info;
+    if (ptrace(PTRACE_GET_SYSCALL_INFO, child_pid, sizeof(info), &info) == -1) {
+        perror("PTRACE_GET_SYSCALL_INFO不可用（需要5.3及以上内核）");
+        return -1;
+    }
+
+    // 过滤模式下只在seccomp事件处停止，其余系统调用以原生速度运行；
+    // 命中过滤器后改用PTRACE_SYSCALL恢复一次，以捕获对应的系统调用退出
+    monitor->idle_request = config->seccomp_filter ? PTRACE_CONT : PTRACE_SYSCALL;
+    monitor->ptrace_options = options;
+
+    // 迁移中的进程停在pause中不被跟踪，pause不能被沙箱的seccomp过滤器停下或拦截
+    int pause_filtered = monitor->policy && monitor->policy->first[__NR_pause] >= 0;
+    for (int i = 0; config->seccomp_filter && i < config->traced_count; i++) {
+        if (config->traced_syscalls[i] == __NR_pause) {
+            pause_filtered = 1;
         }
+    }
+    monitor->migration_ok = monitor->shard_count > 1 && !pause_filtered;
+    return 0;
+}
+
+// ptrace后端：登记根进程并让它开始执行
+static void start_root_task(syscall_monitor_t *monitor) {
+    monitor_shard_t *shard = monitor->shards[0];
+    task_state_t *root = shard_insert_task(shard, monitor->pid);
+    root->new_task = 0;
+    owner_set(monitor, monitor->pid, 0);
+    if (monitor->fd_tracking) {
+        // 沙箱进程已经打开的fd在第一次用到时从/proc读取
+        root->fds = fd_table_new();
+    }
+    resume_task(monitor->pid, resume_request(monitor, root), 0);
+}
 
-        // 一次读取8个字节（一个long）
-        for (size_t j = 0; j < sizeof(long) && i < maxlen - 1; j++, i++) {
-            char c = (char)(tmp & 0xFF);
-            str[i] = c;
-            if (c == '\0') {
-                return;
+// 只有一个跟踪线程的ptrace后端主循环：等待所有被跟踪的进程和线程，直到全部退出。
+// 有超时限制时先非阻塞地取完所有状态变化，没有时再在poll上等待
+static void run_ptrace_monitor(syscall_monitor_t *monitor) {
+    monitor_shard_t *shard = monitor->shards[0];
+    int wait_flags = monitor->sigchld_fd == -1 ? __WALL : __WALL | WNOHANG;
+    int status;
+    while (shard->tasks.count > 0) {
+        pid_t tid = waitpid(-1, &status, wait_flags);
+        if (tid == 0) {
+            if (wait_for_events(monitor) != 0) break;
+            continue;
+        }
+        if (tid == -1) {
+            if (errno == EINTR) continue;
+            if (errno != ECHILD) {
+                perror("waitpid失败");
             }
-            tmp >>= 8;
+            break;
+        }
+        dispatch_wait_status(shard, tid, status, monitor_now_ns());
+        shard_flush_log(shard);
+    }
+}
+
+// 多个跟踪线程的ptrace后端：主线程是分片0，跟踪根进程及其线程，新进程迁移到其他分片。
+// 分派线程回收所有状态变化并投递到所属分片的收件箱；各分片只访问自己的状态，
+// 跟踪记录写入各自的环形缓冲区，由写入线程按时间戳归并
+static void run_sharded_ptrace_monitor(syscall_monitor_t *monitor) {
+    monitor->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (monitor->wake_fd == -1) {
+        perror("创建eventfd失败");
+    }
+
+    // 新线程不接收任何信号，SIGCHLD由分派线程从signalfd读取
+    sigset_t all, saved;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &saved);
+    monitor->shards[0]->thread = pthread_self();
+    monitor->shards[0]->ktid = gettid();
+    int count = 1;
+    for (; count < monitor->shard_count; count++) {
+        monitor_shard_t *shard = monitor->shards[count];
+        if (pthread_create(&shard->thread, NULL, shard_thread, shard) != 0) {
+            fprintf(stderr, "警告: 只创建了 %d 个跟踪线程\n", count);
+            break;
         }
     }
-    str[maxlen - 1] = '\0';
+    monitor->shard_count = count;
+    if (count == 1) {
+        monitor->migration_ok = 0;
+    }
+
+    // 根进程必须在分派线程启动之前登记，否则它会以为任务已全部结束
+    start_root_task(monitor);
+    pthread_t dispatcher;
+    int has_dispatcher = pthread_create(&dispatcher, NULL, dispatcher_thread, monitor) == 0;
+    pthread_sigmask(SIG_SETMASK, &saved, NULL);
+    if (has_dispatcher) {
+        shard_loop(monitor->shards[0]);
+    } else {
+        perror("创建分派线程失败");
+    }
+
+    // 主线程提前结束时，其余线程也不再等待
+    shards_stop(monitor, SHARDS_ABANDON);
+    if (has_dispatcher) {
+        pthread_join(dispatcher, NULL);
+    }
+    for (int i = 1; i < count; i++) {
+        pthread_join(monitor->shards[i]->thread, NULL);
+    }
+    for (int i = 0; i < count; i++) {
+        shard_flush_log(monitor->shards[i]);
+    }
+
+    fprintf(monitor->log_file, "\n跟踪线程: %d 个，%llu 个新进程迁移到其他线程\n",
+            count, (unsigned long long)monitor->migrations);
+    for (int i = 0; i < count; i++) {
+        fprintf(monitor->log_file, "  线程 %d: 处理 %llu 次停止\n", i,
+                (unsigned long long)monitor->shards[i]->stops);
+    }
+}
+
+// eBPF后端：父进程号，线程取所属进程，进程从/proc读取
+static pid_t ebpf_task_parent(const ebpf_event_t *event) {
+    if (event->tid != event->tgid) {
+        return (pid_t)event->tgid;
+    }
+    char path[64], buf[512];
+    snprintf(path, sizeof(path), "/proc/%u/stat", event->tid);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return (pid_t)event->tid;
+    }
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    // "pid (comm) state ppid"，comm中可能有括号和空格，从最后一个右括号往后解析
+    buf[n > 0 ? n : 0] = '\0';
+    char *p = strrchr(buf, ')');
+    int ppid;
+    if (!p || sscanf(p + 1, " %*c %d", &ppid) != 1) {
+        return (pid_t)event->tid;
+    }
+    return (pid_t)ppid;
+}
+
+// eBPF后端：任务第一次出现。同一线程组共用fd表（线程几乎总是带CLONE_FILES），
+// 新进程的表在第一次用到时从/proc读取
+static task_state_t *ebpf_new_task(syscall_monitor_t *monitor, const ebpf_event_t *event) {
+    monitor_shard_t *shard = monitor->shards[0];
+    pid_t tid = (pid_t)event->tid;
+    pid_t parent = ebpf_task_parent(event);
+    task_state_t *task = shard_insert_task(shard, tid);
+    if (!task) {
+        fprintf(shard->log, "[%d] [PROC] 任务表已满，无法跟踪新任务 %d\n", parent, tid);
+        return NULL;
+    }
+    task->new_task = 0;
+    if (monitor->fd_tracking) {
+        task_state_t *leader = event->tid != event->tgid ? task_table_lookup(&shard->tasks, (pid_t)event->tgid) : NULL;
+        task->fds = leader && leader->fds ? fd_table_share(leader->fds) : fd_table_new();
+    }
+
+    int kind = event->tid != event->tgid ? PTRACE_EVENT_CLONE : PTRACE_EVENT_FORK;
+    if (monitor->trace_log) {
+        record_task_event(shard, parent, TRACE_REC_PROC_NEW, (uint64_t)tid, (uint64_t)kind, 0, 0);
+    } else {
+        fprintf(shard->log, "[%d] [PROC] 新任务: %d (%s)\n", parent, tid,
+                kind == PTRACE_EVENT_CLONE ? "clone" : "fork");
+    }
+    return task;
 }
 
-// 处理系统调用入口
-static void handle_syscall_entry(syscall_monitor_t *monitor, struct user_regs_struct *regs) {
+// eBPF后端的系统调用入口：寄存器副本与user_regs_struct的前若干字段布局相同。
+// 样本不停止，int 0x80无法从指令判断，只按代码段区分兼容ABI
+static void ebpf_syscall_entry(syscall_monitor_t *monitor, task_state_t *task, const ebpf_event_t *event) {
+    monitor_shard_t *shard = monitor->shards[0];
+    struct user_regs_struct regs;
+    memset(&regs, 0, sizeof(regs));
+    memcpy(&regs, event->regs, sizeof(event->regs));
+    task->current_syscall = event->syscall_nr;
     #ifdef __x86_64__
-    monitor->current_syscall = regs->orig_rax;
-    monitor->args[0] = regs->rdi;
-    monitor->args[1] = regs->rsi;
-    monitor->args[2] = regs->rdx;
-    monitor->args[3] = regs->r10;
-    monitor->args[4] = regs->r8;
-    monitor->args[5] = regs->r9;
-    #else
-    // 32位系统的寄存器不同
-    // ...
+    task->current_abi = regs.cs == X86_COMPAT_CS ? SYSCALL_ABI_COMPAT : SYSCALL_ABI_NATIVE;
     #endif
+    load_syscall_args(task, &regs);
 
-    gettimeofday(&monitor->last_entry, NULL);
+    int decode = syscall_decode_mode(monitor, task);
+    shard->capture_tid = task->tid;
+    ebpf_event_capture(&monitor->ebpf, event, &shard->capture);
+    monitor_syscall_entry(shard, task, decode);
+    if (monitor->policy) {
+        policy_syscall_entry(shard, task, 0);
+    }
+    task->in_syscall = 1;
+    task->entry_ns = event->timestamp_ns;
+}
 
-    // 简单记录系统调用信息
-    fprintf(monitor->log_file, "[ENTRY] syscall %d (%s), args: %lx, %lx, %lx, %lx, %lx, %lx\n",
-            monitor->current_syscall, get_syscall_name(monitor->current_syscall),
-            monitor->args[0], monitor->args[1], monitor->args[2],
-            monitor->args[3], monitor->args[4], monitor->args[5]);
+// eBPF后端的系统调用退出：延迟为内核中两次跟踪点之间的时间，不含任何跟踪开销
+static void ebpf_syscall_exit(syscall_monitor_t *monitor, task_state_t *task, const ebpf_event_t *event) {
+    monitor_shard_t *shard = monitor->shards[0];
+    long ret = task->current_abi == SYSCALL_ABI_COMPAT ? (long)(int32_t)event->ret : (long)event->ret;
+    uint64_t latency_ns = event->timestamp_ns > task->entry_ns ? event->timestamp_ns - task->entry_ns : 0;
+    monitor_syscall_exit(shard, task, ret, latency_ns);
+    task->in_syscall = 0;
 
-    // 特殊处理某些系统调用
-    if (monitor->current_syscall == __NR_open || monitor->current_syscall == __NR_openat) {
-        char path[PATH_MAX] = {0};
-        if (monitor->current_syscall == __NR_open) {
-            read_string_from_process(monitor->pid, monitor->args[0], path, PATH_MAX);
-        } else { // openat
-            read_string_from_process(monitor->pid, monitor->args[1], path, PATH_MAX);
+    int nr = task->current_syscall;
+    if (task->current_abi == SYSCALL_ABI_NATIVE && (nr == __NR_execve || nr == __NR_execveat) && ret == 0) {
+        monitor_exec_done(shard, task, (unsigned long)task->tid);
+    }
+}
+
+// 环形缓冲区中的一条记录
+static void handle_ebpf_event(void *ctx, const ebpf_event_t *event) {
+    syscall_monitor_t *monitor = ctx;
+    monitor_shard_t *shard = monitor->shards[0];
+    monitor->ebpf_events++;
+    pid_t tid = (pid_t)event->tid;
+    task_state_t *task = task_table_lookup(&shard->tasks, tid);
+
+    if (event->type == EBPF_EVENT_TASK_EXIT) {
+        // 根进程的退出状态由waitpid取得；其余任务只有自己调用exit时才知道退出码
+        if (task && tid != monitor->pid) {
+            int nr = task->current_syscall;
+            int status = task->in_syscall && task->current_abi == SYSCALL_ABI_NATIVE &&
+                         (nr == __NR_exit || nr == __NR_exit_group) ? W_EXITCODE((int)(task->args[0] & 0xff), 0) : -1;
+            handle_task_exit(shard, tid, status);
+        }
+        return;
+    }
+
+    if (!task && !(task = ebpf_new_task(monitor, event))) {
+        return;
+    }
+    if (event->type == EBPF_EVENT_ENTRY) {
+        ebpf_syscall_entry(monitor, task, event);
+    } else if (task->in_syscall) {
+        // 挂载之前已经进入的系统调用没有入口记录，忽略其退出
+        ebpf_syscall_exit(monitor, task, event);
+    }
+}
+
+// eBPF后端：按沙箱cgroup挂载内核程序。参数捕获计划与ptrace后端的解码方式一致
+static int start_ebpf_monitor(syscall_monitor_t *monitor) {
+    const sandbox_config *config = monitor->config;
+    // 等沙箱完成准备工作后再挂载，否则沙箱自身的初始化也会被记录。
+    // 启动套接字由monitor_sandbox关闭，失败时沙箱读到EOF后退出
+    char ready;
+    if (read(config->start_sock[1], &ready, 1) != 1) {
+        fprintf(stderr, "沙箱进程未能就绪\n");
+        return -1;
+    }
+
+    uint8_t capture[SYSCALL_MAX];
+    for (int nr = 0; nr < SYSCALL_MAX; nr++) {
+        capture[nr] = monitor->decode_mode[nr] != DECODE_OFF;
+    }
+    if (ebpf_backend_open(&monitor->ebpf, monitor->result->cgroup_path, capture) != 0) {
+        return -1;
+    }
+    monitor->result->ready_ns = trace_timestamp_ns();
+    fprintf(monitor->log_file, "eBPF后端: raw_syscalls跟踪点，环形缓冲区 %d MB，样本不处于ptrace之下\n\n",
+            EBPF_RINGBUF_SIZE >> 20);
+    return 0;
+}
+
+// eBPF后端的主循环：样本不停止，只需不断取出记录，直到根进程退出。
+// 根进程是PID命名空间的init，它被回收之前命名空间中的其他任务都已结束
+static void run_ebpf_monitor(syscall_monitor_t *monitor) {
+    const sandbox_config *config = monitor->config;
+    monitor_shard_t *shard = monitor->shards[0];
+    task_state_t *root = shard_insert_task(shard, monitor->pid);
+    root->new_task = 0;
+    if (monitor->fd_tracking) {
+        root->fds = fd_table_new();
+    }
+
+    // 内核程序已经挂载，放行沙箱exec样本
+    if (write(config->start_sock[1], "x", 1) != 1) {
+        perror("通知沙箱进程失败");
+    }
+
+    for (;;) {
+        ebpf_backend_consume(&monitor->ebpf, handle_ebpf_event, monitor);
+        int status;
+        pid_t pid = waitpid(monitor->pid, &status, WNOHANG);
+        if (pid == monitor->pid) {
+            ebpf_backend_consume(&monitor->ebpf, handle_ebpf_event, monitor);
+            handle_task_exit(shard, monitor->pid, status);
+            break;
+        }
+        if (pid == -1 && errno != EINTR) {
+            perror("waitpid失败");
+            break;
+        }
+        if (wait_for_events(monitor) != 0) break;
+    }
+
+    uint64_t drops = ebpf_backend_drops(&monitor->ebpf);
+    fprintf(monitor->log_file, "\neBPF后端: 处理 %llu 条记录，环形缓冲区满时丢弃 %llu 条\n",
+            (unsigned long long)monitor->ebpf_events, (unsigned long long)drops);
+    if (drops > 0) {
+        printf("警告: eBPF环形缓冲区丢弃了 %llu 条记录\n", (unsigned long long)drops);
+    }
+    ebpf_backend_close(&monitor->ebpf);
+}
+
+// 通知后端看不到大多数任务的结束（只有自己调用exit的），状态表满时清理已不存在的任务
+static void notif_sweep_tasks(syscall_monitor_t *monitor) {
+    monitor_shard_t *shard = monitor->shards[0];
+    for (int i = 0; i < TASK_TABLE_SIZE; i++) {
+        pid_t tid = shard->tasks.slots[i].tid;
+        if (tid != 0 && tid != monitor->pid && kill(tid, 0) == -1 && errno == ESRCH) {
+            handle_task_exit(shard, tid, -1);
+            // 删除时后面的元素可能前移到这个槽位
+            i--;
         }
-        fprintf(monitor->log_file, "[FILE] Attempting to open: %s\n", path);
-    } else if (monitor->current_syscall == __NR_execve) {
-        char path[PATH_MAX] = {0};
-        read_string_from_process(monitor->pid, monitor->args[0], path, PATH_MAX);
-        fprintf(monitor->log_file, "[EXEC] Executing: %s\n", path);
-    } else if (monitor->current_syscall == __NR_connect) {
-        fprintf(monitor->log_file, "[NET] Attempting to connect, socket fd: %ld\n", monitor->args[0]);
     }
 }
 
-// 处理系统调用退出
-static void handle_syscall_exit(syscall_monitor_t *monitor, struct user_regs_struct *regs) {
-    struct timeval exit_time;
-    gettimeofday(&exit_time, NULL);
+// 通知后端：任务第一次出现
+static task_state_t *notif_new_task(syscall_monitor_t *monitor, pid_t tid) {
+    monitor_shard_t *shard = monitor->shards[0];
+    pid_t tgid, ppid;
+    read_task_ids(tid, &tgid, &ppid);
+    pid_t parent = tid != tgid ? tgid : ppid;
+    task_state_t *task = shard_insert_task(shard, tid);
+    if (!task) {
+        notif_sweep_tasks(monitor);
+        task = shard_insert_task(shard, tid);
+    }
+    if (!task) {
+        fprintf(shard->log, "[%d] [PROC] 任务表已满，无法跟踪新任务 %d\n", parent, tid);
+        return NULL;
+    }
+    task->new_task = 0;
+
+    int kind = tid != tgid ? PTRACE_EVENT_CLONE : PTRACE_EVENT_FORK;
+    if (monitor->trace_log) {
+        record_task_event(shard, parent, TRACE_REC_PROC_NEW, (uint64_t)tid, (uint64_t)kind, 0, 0);
+    } else {
+        fprintf(shard->log, "[%d] [PROC] 新任务: %d (%s)\n", parent, tid,
+                kind == PTRACE_EVENT_CLONE ? "clone" : "fork");
+    }
+    return task;
+}
 
-    long ret = 0;
+// 通知后端的一次系统调用入口。读取参数内存和匹配策略在各监督线程中并发进行，
+// 记录日志和统计时加锁；样本线程一直等到回复，同一线程的事件按顺序记录。
+// 延迟统计为监督线程从收到通知到回复的处理时间。内核不给通知打时间戳，
+// 所有监督线程都在忙时通知在队列中等待的时间不包括在内。
+// 回复CONTINUE后内核会重新读取参数内存，按内存参数做的判定可能被样本的其他线程绕过，
+// 这类规则在check_backend_options中被拒绝
+static void notif_syscall(syscall_monitor_t *monitor, const struct seccomp_notif *req, arg_capture_t *capture) {
+    monitor_shard_t *shard = monitor->shards[0];
+    uint64_t recv_ns = monitor_now_ns();
+    int listener = monitor->notif_listener;
+    task_state_t call;
+    memset(&call, 0, sizeof(call));
+    call.tid = (pid_t)req->pid;
+    call.current_syscall = req->data.nr;
     #ifdef __x86_64__
-    ret = regs->rax;
-    #else
-    // 32位系统的寄存器不同
-    // ...
+    call.current_abi = req->data.arch == AUDIT_ARCH_X86_64 ? SYSCALL_ABI_NATIVE : SYSCALL_ABI_COMPAT;
     #endif
+    for (int i = 0; i < 6; i++) {
+        call.args[i] = (unsigned long)req->data.args[i];
+    }
 
-    // 计算执行时间
-    long exec_time = time_diff_us(&monitor->last_entry, &exit_time);
-    monitor->exec_time_us[monitor->current_syscall] += exec_time;
+    int decode = syscall_decode_mode(monitor, &call);
+    capture->len = 0;
+    if (decode != DECODE_OFF) {
+        capture_syscall_args(call.tid, call.current_syscall, call.args, monitor->preview_bytes, capture);
+    }
+    const policy_rule_t *rule = NULL;
+    if (monitor->policy && call.current_abi == SYSCALL_ABI_NATIVE) {
+        rule = policy_match(monitor->policy, call.current_syscall, call.args, capture);
+    }
+    // 参数内存是在样本线程停止期间读取的，通知仍然有效才说明读到的是这次调用的参数
+    if (!notif_id_valid(listener, req->id)) {
+        return;
+    }
 
-    // 增加系统调用计数
-    monitor->syscall_count[monitor->current_syscall]++;
+    monitor_lock(monitor);
+    monitor->notif_events++;
+    task_state_t *task = task_table_lookup(&shard->tasks, call.tid);
+    if (task || (task = notif_new_task(monitor, call.tid))) {
+        task->current_syscall = call.current_syscall;
+        task->current_abi = call.current_abi;
+        memcpy(task->args, call.args, sizeof(task->args));
+        memcpy(shard->capture.blob, capture->blob, capture->len);
+        shard->capture.len = capture->len;
+        shard->capture_tid = task->tid;
 
-    // 记录返回值和执行时间
-    fprintf(monitor->log_file, "[EXIT] syscall %d (%s), result: %ld, time: %ld us\n",
-            monitor->current_syscall, get_syscall_name(monitor->current_syscall),
-            ret, exec_time);
+        monitor_syscall_entry(shard, task, decode);
+        if (monitor->policy) {
+            policy_syscall_entry(shard, task, 0);
+        }
+        if (monitor->net_enabled) {
+            net_syscall_entry(shard, task);
+        }
+        int nr = call.current_syscall;
+        if (syscall_nr_valid(nr)) {
+            latency_hist_record(&shard->latency[call.current_abi][nr], monitor_now_ns() - recv_ns);
+        }
+        // 根进程的退出状态由waitpid取得
+        if (call.current_abi == SYSCALL_ABI_NATIVE && (nr == __NR_exit || nr == __NR_exit_group) &&
+            call.tid != monitor->pid) {
+            handle_task_exit(shard, call.tid, W_EXITCODE((int)(call.args[0] & 0xff), 0));
+        }
+    }
+    monitor_unlock(monitor);
 
-    // 特殊处理某些系统调用的返回值
-    if ((monitor->current_syscall == __NR_open || monitor->current_syscall == __NR_openat) && ret >= 0) {
-        fprintf(monitor->log_file, "[FILE] Successfully opened file, fd: %ld\n", ret);
-    } else if (monitor->current_syscall == __NR_connect && ret == 0) {
-        fprintf(monitor->log_file, "[NET] Successfully connected\n");
+    if (!rule || rule->action == POLICY_ALLOW || rule->action == POLICY_LOG || !rule->tracer_enforced) {
+        notif_continue(listener, req->id);
+    } else if (rule->action == POLICY_KILL) {
+        // 致命信号挂起时内核不会再执行这次系统调用
+        kill(call.tid, SIGKILL);
+        notif_return(listener, req->id, -EPERM);
+    } else {
+        notif_return(listener, req->id, rule->action == POLICY_ERRNO ? -rule->value : rule->value);
+    }
+}
+
+// 监督线程：轮流等待通知，接收后放开等待权再处理，处理仍是并行的。同一时刻只有一个线程
+// 在poll和接收，poll报告有通知后接收不会阻塞在ioctl中。主线程经eventfd要求退出；
+// 过滤器不再被任何任务使用时监听fd报告POLLHUP，线程也会自行退出
+static void *notif_worker(void *arg) {
+    syscall_monitor_t *monitor = arg;
+    struct seccomp_notif *req = malloc(sizeof(*req));
+    arg_capture_t *capture = malloc(sizeof(*capture));
+    if (!req || !capture) {
+        perror("内存分配失败");
+        free(req);
+        free(capture);
+        return NULL;
+    }
+
+    struct pollfd fds[2] = {
+        { .fd = monitor->notif_listener, .events = POLLIN },
+        { .fd = monitor->notif_stop_fd, .events = POLLIN },
+    };
+    for (;;) {
+        pthread_mutex_lock(&monitor->notif_recv_lock);
+        int stop = 0, received = 0;
+        int ret = poll(fds, 2, -1);
+        if (ret == -1 && errno != EINTR) {
+            perror("等待seccomp通知失败");
+            stop = 1;
+        } else if (ret > 0) {
+            stop = fds[1].revents != 0 || (fds[0].revents & (POLLHUP | POLLERR | POLLNVAL)) != 0;
+            if (!stop && (fds[0].revents & POLLIN)) {
+                received = notif_receive(monitor->notif_listener, req) == 0;
+                // ENOENT：样本线程在通知被接收前已被终止
+                if (!received && errno != ENOENT) {
+                    perror("接收seccomp通知失败");
+                    stop = 1;
+                }
+            }
+        }
+        pthread_mutex_unlock(&monitor->notif_recv_lock);
+        if (stop) break;
+        if (received) notif_syscall(monitor, req, capture);
+    }
+
+    free(req);
+    free(capture);
+    return NULL;
+}
+
+// 结束监督线程。eventfd写入后一直可读，每个线程轮到等待时都会看到并退出
+static void notif_stop_workers(syscall_monitor_t *monitor) {
+    uint64_t one = 1;
+    if (monitor->notif_thread_count > 0 && write(monitor->notif_stop_fd, &one, sizeof(one)) == -1) {
+        perror("通知监督线程退出失败");
+    }
+    for (int i = 0; i < monitor->notif_thread_count; i++) {
+        pthread_join(monitor->notif_threads[i], NULL);
+    }
+    monitor->notif_thread_count = 0;
+}
+
+// 通知后端：取得沙箱的监听fd，配置网络。被选中的系统调用在监督线程启动之前一直阻塞
+static int start_notif_monitor(syscall_monitor_t *monitor) {
+    const sandbox_config *config = monitor->config;
+    if (config->sandbox_pidfd == -1) {
+        fprintf(stderr, "通知后端需要pidfd（5.6及以上内核）\n");
+        return -1;
+    }
+    monitor->notif_listener = notif_fetch_listener(monitor->pid, config->sandbox_pidfd);
+    if (monitor->notif_listener == -1) {
+        return -1;
+    }
+    monitor->result->ready_ns = trace_timestamp_ns();
+
+    if (monitor->net_enabled) {
+        if (fake_net_attach(&monitor->net, config->sinkhole_fd, monitor->pid) == 0) {
+            fprintf(monitor->log_file, "伪造网络: 所有地址路由到回环接口，连接由sinkhole接受 (沙箱 %d)\n\n",
+                    monitor->pid);
+        } else {
+            monitor->net_enabled = 0;
+            printf("警告: 伪造网络不可用\n");
+        }
+    }
+    return 0;
+}
+
+// 通知后端的主线程：启动监督线程后只等待根进程退出和超时
+static void run_notif_monitor(syscall_monitor_t *monitor) {
+    const sandbox_config *config = monitor->config;
+    monitor_shard_t *shard = monitor->shards[0];
+    task_state_t *root = shard_insert_task(shard, monitor->pid);
+    root->new_task = 0;
+
+    int count = config->notif_threads;
+    if (count <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        count = cpus < 2 ? 2 : cpus > NOTIF_THREADS_MAX ? NOTIF_THREADS_MAX : (int)cpus;
+    }
+
+    // 监督线程屏蔽所有信号，SIGCHLD留给主线程的signalfd
+    monitor->notif_stop_fd = eventfd(0, EFD_CLOEXEC);
+    if (monitor->notif_stop_fd == -1) {
+        perror("创建eventfd失败");
+        count = 0;
+    }
+    pthread_mutex_init(&monitor->notif_recv_lock, NULL);
+    sigset_t mask, saved_mask;
+    sigfillset(&mask);
+    pthread_sigmask(SIG_SETMASK, &mask, &saved_mask);
+    for (int i = 0; i < count; i++) {
+        int err = pthread_create(&monitor->notif_threads[i], NULL, notif_worker, monitor);
+        if (err != 0) {
+            fprintf(stderr, "创建监督线程失败: %s\n", strerror(err));
+            break;
+        }
+        monitor->notif_thread_count++;
+    }
+    pthread_sigmask(SIG_SETMASK, &saved_mask, NULL);
+    if (monitor->notif_thread_count == 0) {
+        // 没有人回复通知，样本会一直阻塞
+        kill_sandbox(config, monitor->pid);
+    }
+    fprintf(monitor->log_file, "通知后端: %d 个监督线程\n\n", monitor->notif_thread_count);
+
+    for (;;) {
+        int status;
+        pid_t pid = waitpid(monitor->pid, &status, WNOHANG);
+        if (pid == monitor->pid) {
+            monitor_lock(monitor);
+            handle_task_exit(shard, monitor->pid, status);
+            monitor_unlock(monitor);
+            break;
+        }
+        if (pid == -1 && errno != EINTR) {
+            perror("waitpid失败");
+            break;
+        }
+        if (wait_for_events(monitor) != 0) break;
+    }
+
+    notif_stop_workers(monitor);
+    pthread_mutex_destroy(&monitor->notif_recv_lock);
+    if (monitor->notif_stop_fd != -1) {
+        close(monitor->notif_stop_fd);
     }
+    close(monitor->notif_listener);
+    fprintf(monitor->log_file, "\n通知后端: 处理 %llu 条通知\n", (unsigned long long)monitor->notif_events);
 }
 
 // 子进程监控函数 - 在子进程内部调用
-int setup_monitoring(pid_t child_pid) {
+int setup_monitoring(pid_t child_pid, const sandbox_config *config, sandbox_result *result) {
     // 创建日志文件
     char log_path[PATH_MAX];
     snprintf(log_path, sizeof(log_path), "/tmp/malbox_syscall_%d.log", child_pid);
@@ -231,107 +2559,278 @@ int setup_monitoring(pid_t child_pid) {
     }
 
     fprintf(log_file, "===== MalBox系统调用监控 =====\n");
-    fprintf(log_file, "目标进程: %d\n\n", child_pid);
-
-    // 初始化监控结构
-    syscall_monitor_t monitor;
-    memset(&monitor, 0, sizeof(monitor));
-    monitor.pid = child_pid;
-    monitor.log_file = log_file;
-    monitor.in_syscall = 0;
-
-    // 等待子进程停止（由于PTRACE_TRACEME）
-    waitpid(child_pid, NULL, 0);
+    fprintf(log_file, "目标进程: %d\n", child_pid);
+    if (config->backend == MONITOR_BACKEND_EBPF) {
+        fprintf(log_file, "跟踪模式: eBPF (全部系统调用，不使用ptrace)\n\n");
+    } else if (config->backend == MONITOR_BACKEND_NOTIF) {
+        fprintf(log_file, "跟踪模式: seccomp用户通知 (%d 个系统调用，不使用ptrace)\n", config->traced_count);
+        fprintf(log_file, "只记录系统调用入口，延迟统计为监督线程的处理时间（不含排队）\n\n");
+    } else if (config->seccomp_filter) {
+        fprintf(log_file, "跟踪模式: seccomp-bpf过滤 (仅跟踪 %d 个系统调用)\n\n", config->traced_count);
+    } else {
+        fprintf(log_file, "跟踪模式: 全部系统调用\n\n");
+    }
+    if (config->backend == MONITOR_BACKEND_PTRACE && config->tracer_threads > 1) {
+        fprintf(log_file, "跟踪线程: %d 个，新进程在初始停止后迁移到任务最少的线程，日志按时间戳归并\n\n",
+                config->tracer_threads);
+    }
+    if (config->policy) {
+        int in_kernel = 0;
+        for (int i = 0; i < config->policy->count; i++) {
+            in_kernel += !config->policy->rules[i].tracer_enforced;
+        }
+        fprintf(log_file, "系统调用策略: %s (%d 条规则，%d 条编译进seccomp在内核中执行)\n\n",
+                config->policy->path, config->policy->count, in_kernel);
+    }
 
-    // 设置ptrace选项
-    if (ptrace(PTRACE_SETOPTIONS, child_pid, 0,
-               PTRACE_O_TRACECLONE | PTRACE_O_TRACEFORK | PTRACE_O_TRACEVFORK |
-               PTRACE_O_TRACEEXEC | PTRACE_O_TRACESYSGOOD) == -1) {
-        perror("设置ptrace选项失败");
+    // 初始化监控结构（状态表较大，放在堆上）
+    syscall_monitor_t *monitor = calloc(1, sizeof(*monitor));
+    if (!monitor) {
+        perror("内存分配失败");
+        fclose(log_file);
+        return -1;
+    }
+    monitor->pid = child_pid;
+    monitor->log_file = log_file;
+    monitor->result = result;
+    monitor->config = config;
+    monitor->warp_enabled = config->time_warp;
+    monitor->warp.factor = config->time_warp_factor;
+    monitor->fd_tracking = !config->fd_track_disabled;
+    monitor->policy = config->policy;
+    monitor->net_enabled = config->sinkhole;
+    monitor->ebpf_enabled = config->backend == MONITOR_BACKEND_EBPF;
+    monitor->notif_enabled = config->backend == MONITOR_BACKEND_NOTIF;
+    monitor->threaded = monitor->notif_enabled;
+    if (monitor->threaded) {
+        pthread_mutex_init(&monitor->lock, NULL);
+    }
+    pthread_mutex_init(&monitor->warp_lock, NULL);
+    setup_decoding(monitor, config);
+    int shard_count = config->backend == MONITOR_BACKEND_PTRACE && config->tracer_threads > 1 ?
+                      config->tracer_threads : 1;
+    if (init_shards(monitor, shard_count) != 0) {
+        free_shards(monitor);
+        free(monitor);
         fclose(log_file);
         return -1;
     }
 
-    printf("系统调用监控已启动，日志文件: %s\n", log_path);
-
-    // 主监控循环
-    int status;
-    while (1) {
-        // 继续执行直到下一个系统调用
-        if (ptrace(PTRACE_SYSCALL, child_pid, 0, 0) == -1) {
-            perror("ptrace失败");
-            break;
+    // 可执行内存转储：每次运行一个目录，指定了上级目录时按沙箱pid分开
+    if (config->mem_dump) {
+        char dump_dir[PATH_MAX];
+        if (config->mem_dump_dir) {
+            mkdir(config->mem_dump_dir, 0700);
+            snprintf(dump_dir, sizeof(dump_dir), "%s/%d", config->mem_dump_dir, child_pid);
+        } else {
+            snprintf(dump_dir, sizeof(dump_dir), "/tmp/malbox_dump_%d", child_pid);
         }
-
-        if (waitpid(child_pid, &status, 0) == -1) {
-            perror("waitpid失败");
-            break;
+        if (mem_dump_open(&monitor->dump, dump_dir) == 0) {
+            monitor->dump_enabled = 1;
+            fprintf(log_file, "可执行内存转储: %s (按内容哈希命名，index.txt为每次快照的索引)\n\n", dump_dir);
+        } else {
+            printf("警告: 可执行内存转储不可用\n");
         }
+    }
 
-        // 检查进程是否退出
-        if (WIFEXITED(status)) {
-            fprintf(log_file, "\n[INFO] 进程正常退出，状态码: %d\n", WEXITSTATUS(status));
-            break;
+    // 二进制/NDJSON模式：逐事件记录交给写线程，文本日志只保留头部和统计
+    char bin_path[PATH_MAX];
+    if (config->binary_log || config->json_output) {
+        int format = config->json_output ? TRACE_FORMAT_NDJSON : TRACE_FORMAT_BINARY;
+        if (config->json_output) {
+            snprintf(bin_path, sizeof(bin_path), "%s", config->json_output);
+        } else {
+            snprintf(bin_path, sizeof(bin_path), "/tmp/malbox_syscall_%d.bin", child_pid);
+        }
+        // 每个跟踪线程一个环形缓冲区，另有一个给分派线程记录超时
+        monitor->trace_log = trace_log_open(bin_path, child_pid, format, shard_count > 1 ? shard_count + 1 : 1);
+        if (!monitor->trace_log) {
+            free_shards(monitor);
+            free(monitor);
+            fclose(log_file);
+            return -1;
+        }
+        if (config->json_output) {
+            fprintf(log_file, "事件记录: %s (NDJSON)\n\n", bin_path);
+        } else {
+            fprintf(log_file, "事件记录: %s (使用malbox-decode查看)\n\n", bin_path);
         }
+    }
 
-        if (WIFSIGNALED(status)) {
-            fprintf(log_file, "\n[INFO] 进程被信号终止: %d\n", WTERMSIG(status));
-            break;
+    int started = monitor->ebpf_enabled ? start_ebpf_monitor(monitor) :
+                  monitor->notif_enabled ? start_notif_monitor(monitor) : start_ptrace_monitor(monitor);
+    if (started != 0) {
+        trace_log_close(monitor->trace_log);
+        if (monitor->dump_enabled) {
+            mem_dump_close(&monitor->dump);
         }
+        free_shards(monitor);
+        free(monitor);
+        fclose(log_file);
+        return -1;
+    }
 
-        // 处理系统调用
-        if (WIFSTOPPED(status) && WSTOPSIG(status) & 0x80) {
-            struct user_regs_struct regs;
-            if (ptrace(PTRACE_GETREGS, child_pid, 0, &regs) == -1) {
-                perror("获取寄存器失败");
-                continue;
-            }
+    printf("系统调用监控已启动，日志文件: %s\n", log_path);
+    if (monitor->trace_log) {
+        printf("%s事件记录: %s\n", config->json_output ? "NDJSON" : "二进制", bin_path);
+    }
 
-            if (monitor.in_syscall) {
-                handle_syscall_exit(&monitor, &regs);
-            } else {
-                handle_syscall_entry(&monitor, &regs);
-            }
+    if (setup_timeouts(monitor) != 0) {
+        teardown_timeouts(monitor);
+        printf("警告: 超时限制不可用\n");
+    }
 
-            monitor.in_syscall = !monitor.in_syscall;
-        }
+    if (monitor->ebpf_enabled) {
+        run_ebpf_monitor(monitor);
+    } else if (monitor->notif_enabled) {
+        run_notif_monitor(monitor);
+    } else if (monitor->shard_count > 1) {
+        run_sharded_ptrace_monitor(monitor);
+    } else {
+        start_root_task(monitor);
+        run_ptrace_monitor(monitor);
+    }
+
+    teardown_timeouts(monitor);
+    merge_shards(monitor);
+    monitor_shard_t *shard = monitor->shards[0];
+    if (monitor->trace_log) {
+        // 跟踪线程都已结束，统计和汇总由主线程以分片0的身份提交
+        trace_log_busy(monitor->trace_log, shard->producer);
     }
 
     // 输出系统调用统计信息
     fprintf(log_file, "\n===== 系统调用统计 =====\n");
-    for (int i = 0; i < SYSCALL_MAX; i++) {
-        if (monitor.syscall_count[i] > 0) {
-            fprintf(log_file, "%-20s (#%d): %d 次调用, 总执行时间: %ld us, 平均: %.2f us\n",
-                    get_syscall_name(i), i, monitor.syscall_count[i],
-                    monitor.exec_time_us[i],
-                    (float)monitor.exec_time_us[i] / monitor.syscall_count[i]);
+    int unique_syscalls = 0;
+    for (int abi = 0; abi < SYSCALL_ABI_COUNT; abi++) {
+        for (int i = 0; i < SYSCALL_MAX; i++) {
+            if (shard->latency[abi][i].count == 0) continue;
+
+            // 兼容ABI的调用单独列出，编号按i386表解释
+            char label[64];
+            snprintf(label, sizeof(label), "%s%s", abi == SYSCALL_ABI_COMPAT ? "i386:" : "",
+                     get_syscall_name_abi(abi, i));
+            print_latency_stats(log_file, label, i, &shard->latency[abi][i]);
+            if (monitor->trace_log) {
+                record_syscall_stats(shard, abi, i);
+            }
+
+            // 计算不同系统调用的数量
+            unique_syscalls++;
         }
     }
 
-    // 计算不同系统调用的数量
-    int unique_syscalls = 0;
-    for (int i = 0; i < SYSCALL_MAX; i++) {
-        if (monitor.syscall_count[i] > 0) {
-            unique_syscalls++;
+    result->unique_syscalls = unique_syscalls;
+
+    if (shard->ngram.n) {
+        print_ngram_profile(log_file, &shard->ngram);
+        if (monitor->trace_log) {
+            record_ngram_profile(shard);
+        }
+    }
+
+    if (monitor->policy) {
+        fprintf(log_file, "\n系统调用策略: 跟踪器看到 %llu 次规则命中\n", (unsigned long long)shard->policy_hits);
+    }
+
+    if (monitor->warp_enabled) {
+        fprintf(log_file, "\n睡眠加速: 改写 %llu 次睡眠，虚拟时间领先真实时间 %.3f s\n",
+                (unsigned long long)monitor->warp.sleeps, (double)monitor->warp.offset_ns / 1e9);
+        printf("睡眠加速: 改写 %llu 次睡眠，虚拟时间领先 %.3f s\n",
+               (unsigned long long)monitor->warp.sleeps, (double)monitor->warp.offset_ns / 1e9);
+    }
+
+    if (monitor->dump_enabled) {
+        const mem_dump_t *dump = &monitor->dump;
+        fprintf(log_file, "\n可执行内存转储: %llu 次区域快照，保存 %llu 个 (%llu 字节)，%llu 个内容重复，%llu 个未变化\n",
+                (unsigned long long)dump->snapshots, (unsigned long long)dump->stored,
+                (unsigned long long)dump->stored_bytes, (unsigned long long)dump->duplicates,
+                (unsigned long long)dump->unchanged);
+        printf("可执行内存转储: %s，保存 %llu 个区域 (%llu 字节)\n", dump->dir,
+               (unsigned long long)dump->stored, (unsigned long long)dump->stored_bytes);
+        mem_dump_close(&monitor->dump);
+    }
+
+    // 汇总放在事件流最后，消费者据此判断本次运行已结束；之后等待写线程落盘剩余记录
+    if (monitor->trace_log) {
+        record_summary(monitor, unique_syscalls);
+        trace_log_close(monitor->trace_log);
+    }
+
+    if (monitor->net_enabled) {
+        fake_net_detach(&monitor->net);
+    }
+
+    if (monitor->fd_tracking) {
+        // 各分片的字符串池各自驻留，相同的字符串在不同分片中各计一次
+        size_t strings = 0, bytes = 0;
+        for (int i = 0; i < monitor->shard_count; i++) {
+            strings += monitor->shards[i]->strings.count;
+            bytes += monitor->shards[i]->strings.used;
         }
+        fprintf(log_file, "\nfd跟踪: 驻留 %zu 个不同的路径/套接字描述，共 %zu 字节\n", strings, bytes);
+    }
+    // 提前结束时状态表中可能还有任务，由free_shards释放
+    free_shards(monitor);
+    if (monitor->wake_fd != -1) {
+        close(monitor->wake_fd);
     }
+    if (monitor->threaded) {
+        pthread_mutex_destroy(&monitor->lock);
+    }
+    pthread_mutex_destroy(&monitor->warp_lock);
 
     fprintf(log_file, "\n系统调用监控完成，共记录 %d 种不同的系统调用\n", unique_syscalls);
     printf("系统调用监控完成，共记录 %d 种不同的系统调用\n", unique_syscalls);
 
+    free(monitor);
     fclose(log_file);
     return 0;
 }
 
 // 准备被追踪的子进程
-int prepare_traced_child() {
-    // 通知父进程我们准备好被追踪
-    if (ptrace(PTRACE_TRACEME, 0, NULL, NULL) == -1) {
-        perror("ptrace(TRACEME) 失败");
+int prepare_traced_child(const sandbox_config *config) {
+    if (config->backend == MONITOR_BACKEND_EBPF) {
+        // eBPF后端不使用ptrace。沙箱根进程是PID命名空间的init，不能用SIGSTOP暂停自己，
+        // 改为通知父进程已就绪，并阻塞到内核程序挂载完成
+        char start_byte;
+        close(config->start_sock[1]);
+        if (write(config->start_sock[0], "r", 1) != 1 ||
+            read(config->start_sock[0], &start_byte, 1) != 1) {
+            printf("等待eBPF监控启动失败\n");
+            return -1;
+        }
+        close(config->start_sock[0]);
+    } else if (config->backend == MONITOR_BACKEND_NOTIF) {
+        // 通知后端只在安装过滤器时被跟踪：父进程在seccomp调用的退出处取走监听fd后脱离，
+        // 之后的系统调用（包括这里的close）按过滤器交给监督线程，不需要另外的启动同步
+        if (ptrace(PTRACE_TRACEME, 0, NULL, NULL) == -1) {
+            perror("ptrace(TRACEME) 失败");
+            return -1;
+        }
+        kill(getpid(), SIGSTOP);
+        int listener = install_seccomp_filter(config);
+        if (listener == -1) {
+            return -1;
+        }
+        close(listener);
+        return 0;
+    } else {
+        // 通知父进程我们准备好被追踪
+        if (ptrace(PTRACE_TRACEME, 0, NULL, NULL) == -1) {
+            perror("ptrace(TRACEME) 失败");
+            return -1;
+        }
+
+        // 向自己发送SIGSTOP信号，暂停直到父进程准备好监控
+        kill(getpid(), SIGSTOP);
+    }
+
+    // 父进程已设置PTRACE_O_TRACESECCOMP，此时再安装过滤器，execl本身也会被跟踪；
+    // 完整跟踪模式和eBPF后端下有策略时也安装，用于在内核中执行只看寄存器的规则
+    if ((config->seccomp_filter || config->policy) && install_seccomp_filter(config) == -1) {
         return -1;
     }
 
-    // 向自己发送SIGSTOP信号，暂停直到父进程准备好监控
-    kill(getpid(), SIGSTOP);
     return 0;
 }
\ No newline at end of file
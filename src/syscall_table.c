@@ -0,0 +1,46 @@
+// src/syscall_table.c
+#include "sandbox.h"
+
+// 完整的系统调用名称表，构建时由Makefile从内核的asm/unistd_*.h生成
+static const char *const syscall_names_64[SYSCALL_MAX] = {
+#include "syscall_names_64.inc"
+};
+
+// i386兼容ABI（32位程序，或64位程序中的int 0x80）
+static const char *const syscall_names_32[SYSCALL_MAX] = {
+#include "syscall_names_32.inc"
+};
+
+#define X32_SYSCALL_BIT 0x40000000
+
+// 按ABI获取系统调用名称
+const char *get_syscall_name_abi(int abi, int syscall_nr) {
+    const char *const *table = abi == SYSCALL_ABI_COMPAT ? syscall_names_32 : syscall_names_64;
+    if (abi == SYSCALL_ABI_NATIVE && syscall_nr > 0 && (syscall_nr & X32_SYSCALL_BIT)) {
+        // x32 ABI复用x86_64的编号空间
+        syscall_nr &= ~X32_SYSCALL_BIT;
+    }
+    if (syscall_nr >= 0 && syscall_nr < SYSCALL_MAX && table[syscall_nr] != NULL) {
+        return table[syscall_nr];
+    }
+    return "unknown";
+}
+
+// 获取系统调用名称（本机ABI）
+const char *get_syscall_name(int syscall_nr) {
+    return get_syscall_name_abi(SYSCALL_ABI_NATIVE, syscall_nr);
+}
+
+const char *get_syscall_abi_name(int abi) {
+    return abi == SYSCALL_ABI_COMPAT ? "i386" : "x86_64";
+}
+
+// 根据名称查找系统调用号（本机ABI），未找到返回-1
+int get_syscall_number(const char *name) {
+    for (int i = 0; i < SYSCALL_MAX; i++) {
+        if (syscall_names_64[i] && strcmp(syscall_names_64[i], name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,77 @@
+// src/task_table.c
+#include "sandbox.h"
+
+// 开放寻址哈希表：线性探测，删除时向后移位而不是留墓碑，
+// 因此大量线程创建/退出后查找仍然是O(1)，且全程不分配内存
+
+#define TASK_TABLE_MASK (TASK_TABLE_SIZE - 1)
+
+static inline size_t task_hash(pid_t tid) {
+    // 乘法哈希，打散连续分配的tid
+    return ((uint32_t)tid * 2654435761u) & TASK_TABLE_MASK;
+}
+
+// 查找线程状态，不存在时返回NULL
+task_state_t *task_table_lookup(task_table_t *table, pid_t tid) {
+    size_t idx = task_hash(tid);
+    for (size_t probe = 0; probe < TASK_TABLE_SIZE; probe++) {
+        task_state_t *slot = &table->slots[idx];
+        if (slot->tid == tid) {
+            return slot;
+        }
+        if (slot->tid == 0) {
+            return NULL;
+        }
+        idx = (idx + 1) & TASK_TABLE_MASK;
+    }
+    return NULL;
+}
+
+// 查找或插入线程状态；新插入的槽位清零并标记为new_task，表满时返回NULL
+task_state_t *task_table_insert(task_table_t *table, pid_t tid) {
+    // 负载因子保持在3/4以下，保证探测长度有界
+    size_t idx = task_hash(tid);
+    for (size_t probe = 0; probe < TASK_TABLE_SIZE; probe++) {
+        task_state_t *slot = &table->slots[idx];
+        if (slot->tid == tid) {
+            return slot;
+        }
+        if (slot->tid == 0) {
+            if (table->count >= TASK_TABLE_SIZE / 4 * 3) {
+                return NULL;
+            }
+            memset(slot, 0, sizeof(*slot));
+            slot->tid = tid;
+            slot->new_task = NEW_TASK_ATTACHED;
+            table->count++;
+            return slot;
+        }
+        idx = (idx + 1) & TASK_TABLE_MASK;
+    }
+    return NULL;
+}
+
+// 删除线程状态，并把后续探测链上的元素前移填补空位
+void task_table_remove(task_table_t *table, pid_t tid) {
+    task_state_t *slot = task_table_lookup(table, tid);
+    if (!slot) {
+        return;
+    }
+
+    size_t hole = (size_t)(slot - table->slots);
+    size_t idx = (hole + 1) & TASK_TABLE_MASK;
+    while (table->slots[idx].tid != 0) {
+        size_t home = task_hash(table->slots[idx].tid);
+        // 元素的理想位置不在(hole, idx]区间内时，才能移动到hole
+        int movable = (idx > hole) ? (home <= hole || home > idx)
+                                   : (home <= hole && home > idx);
+        if (movable) {
+            table->slots[hole] = table->slots[idx];
+            hole = idx;
+        }
+        idx = (idx + 1) & TASK_TABLE_MASK;
+    }
+
+    memset(&table->slots[hole], 0, sizeof(table->slots[hole]));
+    table->count--;
+}
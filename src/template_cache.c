@@ -0,0 +1,238 @@
+// src/template_cache.c
+#include "sandbox.h"
+#include <dirent.h>
+
+// 按解析出的依赖集合内容寻址的根文件系统模板缓存。
+// 模板目录只构建一次，之后每个沙箱用overlayfs（失败时退回只读bind挂载）
+// 叠加一个可写的tmpfs层，只需再复制样本本身
+
+#define FNV_OFFSET 14695981039346656037ull
+#define FNV_PRIME 1099511628211ull
+
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t len) {
+    const unsigned char *p = data;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= p[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+static int compare_paths(const void *a, const void *b) {
+    return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+// 计算依赖集合的键：路径+文件身份（设备、inode、大小、修改时间），
+// 主机上的库更新后自然得到新模板
+static int compute_template_key(lib_list_t *libs, char *key, size_t keylen) {
+    qsort(libs->paths, (size_t)libs->count, sizeof(char *), compare_paths);
+
+    uint64_t hash = FNV_OFFSET;
+    for (int i = 0; i < libs->count; i++) {
+        struct stat st;
+        if (stat(libs->paths[i], &st) != 0) {
+            printf("无法获取依赖库状态 %s: %s\n", libs->paths[i], strerror(errno));
+            return -1;
+        }
+        uint64_t identity[4] = {
+            (uint64_t)st.st_dev, (uint64_t)st.st_ino,
+            (uint64_t)st.st_size, (uint64_t)st.st_mtime
+        };
+        hash = fnv1a(hash, libs->paths[i], strlen(libs->paths[i]) + 1);
+        hash = fnv1a(hash, identity, sizeof(identity));
+    }
+
+    snprintf(key, keylen, "%016llx", (unsigned long long)hash);
+    return 0;
+}
+
+// 递归删除目录（用于清理未能发布的模板）
+static void remove_tree(const char *path) {
+    DIR *dir = opendir(path);
+    if (dir) {
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+
+            char child[PATH_MAX];
+            snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+            struct stat st;
+            if (lstat(child, &st) == 0 && S_ISDIR(st.st_mode)) {
+                remove_tree(child);
+            } else {
+                unlink(child);
+            }
+        }
+        closedir(dir);
+    }
+    rmdir(path);
+}
+
+// 构建模板：先在临时目录中填充，再原子rename发布，
+// 并发的工作进程同时构建同一个模板时只有一个会成功发布
+static int build_template(const lib_list_t *libs, const char *cache_dir, const char *template_path,
+                          int link_mode) {
+    char build_dir[PATH_MAX];
+    snprintf(build_dir, sizeof(build_dir), "%s/.build-XXXXXX", cache_dir);
+    if (!mkdtemp(build_dir)) {
+        perror("创建模板构建目录失败");
+        return -1;
+    }
+    chmod(build_dir, 0755);
+
+    if (create_sandbox_directories(build_dir) != 0) {
+        remove_tree(build_dir);
+        return -1;
+    }
+
+    int staged = stage_dynamic_libs(libs, build_dir, link_mode);
+    if (staged != libs->count) {
+        printf("模板构建不完整: %d/%d 个依赖库\n", staged, libs->count);
+        remove_tree(build_dir);
+        return -1;
+    }
+
+    if (rename(build_dir, template_path) != 0) {
+        if (errno == EEXIST || errno == ENOTEMPTY) {
+            // 其他进程已发布相同的模板
+            remove_tree(build_dir);
+            return 0;
+        }
+        perror("发布模板失败");
+        remove_tree(build_dir);
+        return -1;
+    }
+
+    printf("已构建根文件系统模板: %s (%d 个依赖库)\n", template_path, staged);
+    return 0;
+}
+
+// overlayfs: 模板为只读下层，tmpfs中的upper/work为可写上层
+static int mount_overlay_root(const char *template_path, const char *sandbox_dir,
+                              char *root_out, size_t root_len) {
+    char upper[PATH_MAX], work[PATH_MAX], merged[PATH_MAX];
+    snprintf(upper, sizeof(upper), "%s/upper", sandbox_dir);
+    snprintf(work, sizeof(work), "%s/work", sandbox_dir);
+    snprintf(merged, sizeof(merged), "%s/root", sandbox_dir);
+
+    if (mkdir(upper, 0755) == -1 || mkdir(work, 0755) == -1 || mkdir(merged, 0755) == -1) {
+        printf("创建overlay目录失败: %s\n", strerror(errno));
+        return -1;
+    }
+
+    char options[PATH_MAX * 3 + 64];
+    snprintf(options, sizeof(options), "lowerdir=%s,upperdir=%s,workdir=%s",
+             template_path, upper, work);
+    if (mount("overlay", merged, "overlay", 0, options) == -1) {
+        printf("挂载overlayfs失败: %s\n", strerror(errno));
+        rmdir(upper);
+        rmdir(work);
+        rmdir(merged);
+        return -1;
+    }
+
+    snprintf(root_out, root_len, "%s", merged);
+    return 0;
+}
+
+// 退路：沙箱根仍为tmpfs，模板中的库目录以只读bind挂载的方式引入
+static int bind_template_dirs(const char *template_path, const char *sandbox_dir,
+                              char *root_out, size_t root_len) {
+    if (create_sandbox_directories(sandbox_dir) != 0) {
+        return -1;
+    }
+
+    DIR *dir = opendir(template_path);
+    if (!dir) {
+        perror("打开模板目录失败");
+        return -1;
+    }
+
+    int ret = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        const char *name = entry->d_name;
+        // bin/tmp/dev必须可写，保留在tmpfs上
+        if (name[0] == '.' || strcmp(name, "bin") == 0 || strcmp(name, "tmp") == 0 ||
+            strcmp(name, "dev") == 0) {
+            continue;
+        }
+
+        char src[PATH_MAX], dest[PATH_MAX];
+        snprintf(src, sizeof(src), "%s/%s", template_path, name);
+        snprintf(dest, sizeof(dest), "%s/%s", sandbox_dir, name);
+
+        struct stat st;
+        if (lstat(src, &st) != 0 || !S_ISDIR(st.st_mode)) {
+            continue;
+        }
+        if (mkdir(dest, 0755) == -1 && errno != EEXIST) {
+            printf("创建挂载点 %s 失败: %s\n", dest, strerror(errno));
+            ret = -1;
+            break;
+        }
+        if (mount(src, dest, NULL, MS_BIND | MS_REC, NULL) == -1 ||
+            mount(NULL, dest, NULL, MS_BIND | MS_REMOUNT | MS_RDONLY, NULL) == -1) {
+            printf("只读绑定 %s 失败: %s\n", src, strerror(errno));
+            ret = -1;
+            break;
+        }
+    }
+    closedir(dir);
+
+    if (ret == 0) {
+        snprintf(root_out, root_len, "%s", sandbox_dir);
+    }
+    return ret;
+}
+
+// 从模板缓存准备沙箱根目录。sandbox_dir是已挂载的tmpfs，
+// 成功时root_out为最终要chroot的目录（依赖库已就绪，只缺样本本身）
+int setup_template_root(const sandbox_config *config, const char *sandbox_dir,
+                        char *root_out, size_t root_len) {
+    const char *cache_dir = config->template_dir ? config->template_dir : DEFAULT_TEMPLATE_DIR;
+
+    lib_list_t libs;
+    if (resolve_dynamic_libs(config->binary_path, &libs) != 0) {
+        return -1;
+    }
+
+    char key[32];
+    if (compute_template_key(&libs, key, sizeof(key)) != 0) {
+        free_lib_list(&libs);
+        return -1;
+    }
+
+    char template_path[PATH_MAX];
+    snprintf(template_path, sizeof(template_path), "%s/%s", cache_dir, key);
+
+    struct stat st;
+    if (stat(template_path, &st) == 0 && S_ISDIR(st.st_mode)) {
+        printf("命中根文件系统模板: %s\n", template_path);
+    } else {
+        if (mkdir_p(cache_dir, 0755) != 0) {
+            printf("创建模板缓存目录 %s 失败: %s\n", cache_dir, strerror(errno));
+            free_lib_list(&libs);
+            return -1;
+        }
+        // bind挂载只在当前挂载命名空间有效，不能进入持久化的模板，改用硬链接
+        int link_mode = config->stage_mode == STAGE_BIND ? STAGE_HARDLINK : config->stage_mode;
+        if (build_template(&libs, cache_dir, template_path, link_mode) != 0) {
+            free_lib_list(&libs);
+            return -1;
+        }
+    }
+    free_lib_list(&libs);
+
+    if (mount_overlay_root(template_path, sandbox_dir, root_out, root_len) == 0) {
+        printf("沙箱根目录: overlayfs (模板 %s)\n", key);
+        return 0;
+    }
+
+    if (bind_template_dirs(template_path, sandbox_dir, root_out, root_len) == 0) {
+        printf("沙箱根目录: 只读bind挂载 (模板 %s)\n", key);
+        return 0;
+    }
+
+    return -1;
+}
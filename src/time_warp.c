@@ -0,0 +1,274 @@
+// src/time_warp.c
+#include "sandbox.h"
+#include <sys/user.h>
+#include <time.h>
+#include <elf.h>
+
+// 睡眠加速：在系统调用入口跳过或缩短睡眠，省下的时间累计为虚拟时间偏移，
+// 在时间查询的系统调用退出时加到结果上，样本看到的时间仍然是连续的。
+// 时间查询通常走vDSO而不进入内核，因此exec时从auxv中隐藏vDSO，迫使libc使用系统调用
+
+#define WARP_MIN_SLEEP_NS 1000000ull  // 短于此的睡眠照常执行
+#define WARP_STACK_SCRATCH 256        // 缩短后的时间结构写在红区之下的栈空间
+#define NSEC_PER_SEC 1000000000ll
+
+// 超时参数的格式
+enum {
+    WARP_ARG_TIMESPEC,
+    WARP_ARG_TIMEVAL,
+    WARP_ARG_MSEC,          // poll的毫秒数，直接在寄存器中
+};
+
+static unsigned long *arg_register(struct user_regs_struct *regs, int index) {
+    switch (index) {
+    case 0: return (unsigned long *)&regs->rdi;
+    case 1: return (unsigned long *)&regs->rsi;
+    case 2: return (unsigned long *)&regs->rdx;
+    case 3: return (unsigned long *)&regs->r10;
+    case 4: return (unsigned long *)&regs->r8;
+    default: return (unsigned long *)&regs->r9;
+    }
+}
+
+// 只处理系统范围的时钟，进程/线程CPU时钟与睡眠加速无关
+static int is_wall_clock(long clock_id) {
+    switch (clock_id) {
+    case CLOCK_REALTIME:
+    case CLOCK_MONOTONIC:
+    case CLOCK_MONOTONIC_RAW:
+    case CLOCK_REALTIME_COARSE:
+    case CLOCK_MONOTONIC_COARSE:
+    case CLOCK_BOOTTIME:
+    case CLOCK_REALTIME_ALARM:
+    case CLOCK_BOOTTIME_ALARM:
+    case CLOCK_TAI:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static int64_t clock_now_ns(clockid_t clock_id) {
+    struct timespec ts;
+    if (clock_gettime(clock_id, &ts) != 0) {
+        return 0;
+    }
+    return (int64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+// 读取超时参数，返回纳秒数；不可读或非法时返回-1
+static int64_t read_timeout(pid_t pid, int format, unsigned long value) {
+    if (format == WARP_ARG_MSEC) {
+        return (int)value > 0 ? (int64_t)(int)value * 1000000 : -1;
+    }
+    if (format == WARP_ARG_TIMEVAL) {
+        struct timeval tv;
+        if (read_tracee_memory(pid, value, &tv, sizeof(tv)) != (ssize_t)sizeof(tv) ||
+            tv.tv_sec < 0 || tv.tv_usec < 0) {
+            return -1;
+        }
+        return (int64_t)tv.tv_sec * NSEC_PER_SEC + (int64_t)tv.tv_usec * 1000;
+    }
+    struct timespec ts;
+    if (read_tracee_memory(pid, value, &ts, sizeof(ts)) != (ssize_t)sizeof(ts) ||
+        ts.tv_sec < 0 || ts.tv_nsec < 0) {
+        return -1;
+    }
+    return (int64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+// 把缩短后的超时写到栈上的临时区域，返回其地址（poll直接返回毫秒数）
+static unsigned long write_scratch_timeout(pid_t pid, const struct user_regs_struct *regs,
+                                           int format, int64_t ns) {
+    if (format == WARP_ARG_MSEC) {
+        return (unsigned long)(ns / 1000000);
+    }
+
+    // x86_64的红区为128字节，临时区域在其下方并按16字节对齐
+    unsigned long scratch = (regs->rsp - 128 - WARP_STACK_SCRATCH) & ~15ul;
+    int ok;
+    if (format == WARP_ARG_TIMEVAL) {
+        struct timeval tv = { .tv_sec = ns / NSEC_PER_SEC, .tv_usec = (ns % NSEC_PER_SEC) / 1000 };
+        ok = write_tracee_memory(pid, scratch, &tv, sizeof(tv)) == 0;
+    } else {
+        struct timespec ts = { .tv_sec = ns / NSEC_PER_SEC, .tv_nsec = ns % NSEC_PER_SEC };
+        ok = write_tracee_memory(pid, scratch, &ts, sizeof(ts)) == 0;
+    }
+    return ok ? scratch : 0;
+}
+
+// 睡眠类系统调用入口。返回1表示regs已修改，调用者需要写回
+int time_warp_entry(time_warp_t *warp, task_state_t *task, struct user_regs_struct *regs) {
+    task->warp_action = WARP_NONE;
+    if (task->current_abi != SYSCALL_ABI_NATIVE) {
+        return 0;
+    }
+
+    const unsigned long *args = task->args;
+    int format = WARP_ARG_TIMESPEC;
+    int index;
+    long clock_id = CLOCK_MONOTONIC;
+    int absolute = 0;
+
+    // select/poll只有在不等待任何fd时才是单纯的睡眠
+    switch (task->current_syscall) {
+    case __NR_nanosleep:
+        index = 0;
+        break;
+    case __NR_clock_nanosleep:
+        clock_id = (long)args[0];
+        if (!is_wall_clock(clock_id)) return 0;
+        absolute = (args[1] & TIMER_ABSTIME) != 0;
+        index = 2;
+        break;
+    case __NR_select:
+        if (args[1] || args[2] || args[3]) return 0;
+        format = WARP_ARG_TIMEVAL;
+        index = 4;
+        break;
+    case __NR_pselect6:
+        if (args[1] || args[2] || args[3]) return 0;
+        index = 4;
+        break;
+    case __NR_poll:
+        if (args[1] != 0) return 0;
+        format = WARP_ARG_MSEC;
+        index = 2;
+        break;
+    case __NR_ppoll:
+        if (args[1] != 0) return 0;
+        index = 2;
+        break;
+    default:
+        return 0;
+    }
+
+    if (format != WARP_ARG_MSEC && args[index] == 0) {
+        return 0;
+    }
+    int64_t requested = read_timeout(task->tid, format, args[index]);
+    if (requested < 0) {
+        return 0;
+    }
+
+    // 绝对时间睡眠：样本的目标时间基于虚拟时间，必须改写，否则会多睡offset那么久
+    int64_t real_now = 0;
+    if (absolute) {
+        real_now = clock_now_ns((clockid_t)clock_id);
+        requested -= real_now + warp->offset_ns;
+        if (requested < 0) {
+            requested = 0;
+        }
+    } else if ((uint64_t)requested < WARP_MIN_SLEEP_NS) {
+        return 0;
+    }
+
+    int64_t actual = warp->factor > 1 ? requested / warp->factor : 0;
+    if (actual == 0) {
+        // 跳过：系统调用号改为-1，退出时把返回值改为0（成功/超时）
+        regs->orig_rax = (unsigned long)-1;
+        task->warp_action = WARP_SKIPPED;
+    } else {
+        unsigned long value = write_scratch_timeout(task->tid, regs, format,
+                                                    absolute ? real_now + actual : actual);
+        if (value == 0 && format != WARP_ARG_MSEC) {
+            return 0;
+        }
+        unsigned long *reg = arg_register(regs, index);
+        task->warp_saved_arg = *reg;
+        task->warp_arg_index = index;
+        *reg = value;
+        task->warp_action = WARP_SCALED;
+    }
+
+    warp->offset_ns += requested - actual;
+    warp->sleeps++;
+    return 1;
+}
+
+// 给查询到的时间加上虚拟偏移
+static void shift_time_result(pid_t pid, int format, unsigned long addr, int64_t offset_ns) {
+    int64_t ns = read_timeout(pid, format, addr);
+    if (ns < 0) {
+        return;
+    }
+    ns += offset_ns;
+    if (format == WARP_ARG_TIMEVAL) {
+        struct timeval tv = { .tv_sec = ns / NSEC_PER_SEC, .tv_usec = (ns % NSEC_PER_SEC) / 1000 };
+        write_tracee_memory(pid, addr, &tv, sizeof(tv));
+    } else {
+        struct timespec ts = { .tv_sec = ns / NSEC_PER_SEC, .tv_nsec = ns % NSEC_PER_SEC };
+        write_tracee_memory(pid, addr, &ts, sizeof(ts));
+    }
+}
+
+// 系统调用退出：补全被跳过的睡眠、恢复参数寄存器、调整时间查询结果。
+// 返回1表示regs已修改，调用者需要写回
+int time_warp_exit(time_warp_t *warp, task_state_t *task, struct user_regs_struct *regs) {
+    int modified = 0;
+    if (task->warp_action == WARP_SKIPPED) {
+        regs->rax = 0;
+        modified = 1;
+    } else if (task->warp_action == WARP_SCALED) {
+        *arg_register(regs, task->warp_arg_index) = task->warp_saved_arg;
+        modified = 1;
+    }
+    task->warp_action = WARP_NONE;
+
+    if (warp->offset_ns == 0 || task->current_abi != SYSCALL_ABI_NATIVE || (long)regs->rax < 0) {
+        return modified;
+    }
+
+    const unsigned long *args = task->args;
+    switch (task->current_syscall) {
+    case __NR_clock_gettime:
+        if (is_wall_clock((long)args[0]) && args[1]) {
+            shift_time_result(task->tid, WARP_ARG_TIMESPEC, args[1], warp->offset_ns);
+        }
+        break;
+    case __NR_gettimeofday:
+        if (args[0]) {
+            shift_time_result(task->tid, WARP_ARG_TIMEVAL, args[0], warp->offset_ns);
+        }
+        break;
+    case __NR_time: {
+        long seconds = (long)regs->rax + (long)(warp->offset_ns / NSEC_PER_SEC);
+        regs->rax = (unsigned long)seconds;
+        if (args[0]) {
+            write_tracee_memory(task->tid, args[0], &seconds, sizeof(seconds));
+        }
+        modified = 1;
+        break;
+    }
+    default:
+        break;
+    }
+    return modified;
+}
+
+#define AUXV_SCAN_BYTES 32768  // exec后栈顶到auxv末尾的最大扫描范围
+
+// exec事件停止时栈顶依次为argc、argv[]、NULL、envp[]、NULL、auxv对。
+// 把AT_SYSINFO_EHDR改为AT_IGNORE，新程序就看不到vDSO，时间查询都会进入内核
+int time_warp_hide_vdso(pid_t pid, const struct user_regs_struct *regs) {
+    unsigned long *stack = malloc(AUXV_SCAN_BYTES);
+    if (!stack) {
+        return -1;
+    }
+    ssize_t n = read_tracee_memory(pid, regs->rsp, stack, AUXV_SCAN_BYTES);
+    size_t words = n > 0 ? (size_t)n / sizeof(unsigned long) : 0;
+
+    int ret = -1;
+    size_t i = 1 + (words > 0 ? stack[0] : 0) + 1;  // 跳过argc和argv
+    while (i < words && stack[i] != 0) i++;          // 跳过envp
+    for (i++; i + 1 < words && stack[i] != AT_NULL; i += 2) {
+        if (stack[i] == AT_SYSINFO_EHDR) {
+            unsigned long ignore = AT_IGNORE;
+            ret = write_tracee_memory(pid, regs->rsp + i * sizeof(unsigned long),
+                                      &ignore, sizeof(ignore));
+            break;
+        }
+    }
+    free(stack);
+    return ret;
+}
@@ -0,0 +1,108 @@
+// src/trace_format.c
+#include "sandbox.h"
+#include <stddef.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+// 将套接字地址格式化为可读字符串
+void format_sockaddr(const struct sockaddr_storage *addr, size_t len, char *out, size_t outlen) {
+    char host[INET6_ADDRSTRLEN];
+
+    if (len >= sizeof(struct sockaddr_in) && addr->ss_family == AF_INET) {
+        const struct sockaddr_in *in = (const struct sockaddr_in *)addr;
+        inet_ntop(AF_INET, &in->sin_addr, host, sizeof(host));
+        snprintf(out, outlen, "%s:%u", host, ntohs(in->sin_port));
+    } else if (len >= sizeof(struct sockaddr_in6) && addr->ss_family == AF_INET6) {
+        const struct sockaddr_in6 *in6 = (const struct sockaddr_in6 *)addr;
+        inet_ntop(AF_INET6, &in6->sin6_addr, host, sizeof(host));
+        snprintf(out, outlen, "[%s]:%u", host, ntohs(in6->sin6_port));
+    } else if (len > offsetof(struct sockaddr_un, sun_path) && addr->ss_family == AF_UNIX) {
+        const struct sockaddr_un *un = (const struct sockaddr_un *)addr;
+        size_t path_len = len - offsetof(struct sockaddr_un, sun_path);
+        if (un->sun_path[0] == '\0') {
+            // 抽象命名空间套接字
+            snprintf(out, outlen, "unix:@%.*s", (int)(path_len - 1), un->sun_path + 1);
+        } else {
+            snprintf(out, outlen, "unix:%.*s", (int)strnlen(un->sun_path, path_len), un->sun_path);
+        }
+    } else {
+        snprintf(out, outlen, "family=%d", addr->ss_family);
+    }
+}
+
+// 将策略动作格式化为策略文件中的写法，如errno(EACCES)、fake(42)
+void format_policy_action(int action, long value, char *out, size_t outlen) {
+    const char *name;
+    switch (action) {
+    case POLICY_ALLOW: snprintf(out, outlen, "allow"); return;
+    case POLICY_LOG: snprintf(out, outlen, "log"); return;
+    case POLICY_KILL: snprintf(out, outlen, "kill"); return;
+    case POLICY_FAKE: snprintf(out, outlen, "fake(%ld)", value); return;
+    case POLICY_ERRNO:
+        name = strerrorname_np((int)value);
+        if (name) {
+            snprintf(out, outlen, "errno(%s)", name);
+        } else {
+            snprintf(out, outlen, "errno(%ld)", value);
+        }
+        return;
+    default:
+        snprintf(out, outlen, "action(%d)", action);
+        return;
+    }
+}
+
+// 可执行内存快照的触发事件（JSON输出和索引文件中的写法）
+const char *mem_dump_trigger_name(int trigger) {
+    static const char *const names[] = {
+        [MEM_DUMP_MMAP] = "mmap",
+        [MEM_DUMP_MPROTECT] = "mprotect",
+        [MEM_DUMP_MREMAP] = "mremap",
+        [MEM_DUMP_EXEC] = "exec",
+        [MEM_DUMP_RESCAN] = "rescan",
+    };
+    if (trigger < 0 || trigger >= (int)(sizeof(names) / sizeof(names[0]))) {
+        return "unknown";
+    }
+    return names[trigger];
+}
+
+const char *mem_dump_status_name(int status) {
+    static const char *const names[] = {
+        [MEM_DUMP_STORED] = "stored",
+        [MEM_DUMP_DUPLICATE] = "duplicate",
+        [MEM_DUMP_UNCHANGED] = "unchanged",
+        [MEM_DUMP_EMPTY] = "empty",
+        [MEM_DUMP_UNREADABLE] = "unreadable",
+    };
+    if (status < 0 || status >= (int)(sizeof(names) / sizeof(names[0]))) {
+        return "unknown";
+    }
+    return names[status];
+}
+
+// 文本日志和malbox-decode中的一行快照结果，如
+// mprotect 0x7f0000000000-0x7f0000003000 (3页，变化3页) -> <SHA-256>.bin 已保存
+void format_mem_dump(int trigger, const mem_dump_region_t *region, char *out, size_t outlen) {
+    static const char *const results[] = {
+        [MEM_DUMP_STORED] = "已保存",
+        [MEM_DUMP_DUPLICATE] = "内容已存在",
+        [MEM_DUMP_UNCHANGED] = "未变化",
+        [MEM_DUMP_EMPTY] = "全为零页，未保存",
+        [MEM_DUMP_UNREADABLE] = "不可读",
+    };
+    const char *result = region->status >= 0 && region->status <= MEM_DUMP_UNREADABLE ?
+                         results[region->status] : "未知";
+    char hex[SHA256_HEX_LEN];
+    if (region->status == MEM_DUMP_STORED || region->status == MEM_DUMP_DUPLICATE) {
+        sha256_hex(region->digest, hex);
+        snprintf(out, outlen, "%s 0x%lx-0x%lx (%d页，变化%d页) -> %s.bin %s",
+                 mem_dump_trigger_name(trigger), region->start, region->end, region->pages,
+                 region->changed_pages, hex, result);
+    } else {
+        snprintf(out, outlen, "%s 0x%lx-0x%lx (%d页，变化%d页) %s", mem_dump_trigger_name(trigger),
+                 region->start, region->end, region->pages, region->changed_pages, result);
+    }
+}
@@ -0,0 +1,503 @@
+// src/trace_json.c
+#include "sandbox.h"
+#include <stdarg.h>
+#include <stddef.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/ptrace.h>
+
+// 把跟踪记录格式化为NDJSON：每个事件一行，字段带类型（数字、数组、布尔），
+// 消费者不需要再解析文本日志。输出先攒在缓冲区里，满了或一批记录处理完才写出。
+// 每个事件开始前按最坏情况预留整行的空间，缓冲区中只有完整的行，一行总是由同一次write写出，
+// 批量模式下多个沙箱追加写入同一个文件时行不会交错
+
+#define JSON_EVENT_FIXED 16384  // 负载之外的部分（名称、数字、标志数组）的长度上限
+// 负载的每个字节最多输出为6个字节（\u00XX）
+#define JSON_EVENT_MAX(payload_len) (6 * (size_t)(payload_len) + JSON_EVENT_FIXED)
+
+_Static_assert(JSON_EVENT_MAX(UINT16_MAX) <= JSON_OUT_BUFFER_SIZE, "JSON输出缓冲区容不下最大的事件");
+
+void json_out_init(json_out_t *out, int fd, int is_socket) {
+    out->fd = fd;
+    out->is_socket = is_socket;
+    out->failed = 0;
+    out->len = 0;
+}
+
+// 写出缓冲区内容。消费者断开或磁盘写满后不再重试，丢弃之后的输出
+int json_out_flush(json_out_t *out) {
+    size_t done = 0;
+    while (!out->failed && done < out->len) {
+        ssize_t n = out->is_socket ? send(out->fd, out->buf + done, out->len - done, MSG_NOSIGNAL)
+                                   : write(out->fd, out->buf + done, out->len - done);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            perror("写入JSON事件流失败，停止输出");
+            out->failed = 1;
+            break;
+        }
+        done += (size_t)n;
+    }
+    out->len = 0;
+    return out->failed ? -1 : 0;
+}
+
+// 事件开始时已经预留了整行，这里的写出只是防止越界，正常情况下不会发生
+static inline void json_reserve(json_out_t *out, size_t n) {
+    if (out->len + n > sizeof(out->buf)) {
+        json_out_flush(out);
+    }
+}
+
+static void json_raw(json_out_t *out, const char *text) {
+    size_t n = strlen(text);
+    json_reserve(out, n);
+    memcpy(out->buf + out->len, text, n);
+    out->len += n;
+}
+
+static void json_printf(json_out_t *out, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void json_printf(json_out_t *out, const char *fmt, ...) {
+    va_list ap;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        size_t avail = sizeof(out->buf) - out->len;
+        va_start(ap, fmt);
+        int n = vsnprintf(out->buf + out->len, avail, fmt, ap);
+        va_end(ap);
+        if (n < 0) {
+            return;
+        }
+        if ((size_t)n < avail) {
+            out->len += (size_t)n;
+            return;
+        }
+        // 剩余空间不够：写出已有内容后重新格式化（单个片段远小于缓冲区）
+        json_out_flush(out);
+    }
+}
+
+// 合法UTF-8序列的长度，不合法时返回0
+static size_t utf8_sequence_len(const unsigned char *p, size_t avail) {
+    size_t len;
+    unsigned int min;
+    if (p[0] >= 0xc2 && p[0] <= 0xdf) {
+        len = 2; min = 0x80;
+    } else if ((p[0] & 0xf0) == 0xe0) {
+        len = 3; min = 0x800;
+    } else if (p[0] >= 0xf0 && p[0] <= 0xf4) {
+        len = 4; min = 0x10000;
+    } else {
+        return 0;
+    }
+    if (len > avail) {
+        return 0;
+    }
+    unsigned int cp = p[0] & (0x7f >> len);
+    for (size_t i = 1; i < len; i++) {
+        if ((p[i] & 0xc0) != 0x80) {
+            return 0;
+        }
+        cp = (cp << 6) | (p[i] & 0x3f);
+    }
+    if (cp < min || cp > 0x10ffff || (cp >= 0xd800 && cp <= 0xdfff)) {
+        return 0;
+    }
+    return len;
+}
+
+// 输出带引号的JSON字符串。样本给出的路径和参数可能不是合法UTF-8，
+// 非法字节按\u00XX输出（即按Latin-1解释），保证每一行都能被严格的解析器接受
+static void json_string(json_out_t *out, const char *str, size_t len) {
+    static const char hex[] = "0123456789abcdef";
+    const unsigned char *p = (const unsigned char *)str;
+
+    json_reserve(out, 1);
+    out->buf[out->len++] = '"';
+    size_t i = 0;
+    while (i < len) {
+        json_reserve(out, 6);
+        char *dst = out->buf + out->len;
+        unsigned char c = p[i];
+        if (c >= 0x80) {
+            size_t seq = utf8_sequence_len(p + i, len - i);
+            if (seq > 0) {
+                memcpy(dst, p + i, seq);
+                out->len += seq;
+                i += seq;
+                continue;
+            }
+        }
+        if (c == '"' || c == '\\') {
+            dst[0] = '\\';
+            dst[1] = (char)c;
+            out->len += 2;
+        } else if (c == '\n') {
+            memcpy(dst, "\\n", 2);
+            out->len += 2;
+        } else if (c == '\t') {
+            memcpy(dst, "\\t", 2);
+            out->len += 2;
+        } else if (c < 0x20 || c >= 0x7f) {
+            memcpy(dst, "\\u00", 4);
+            dst[4] = hex[c >> 4];
+            dst[5] = hex[c & 0xf];
+            out->len += 6;
+        } else {
+            dst[0] = (char)c;
+            out->len += 1;
+        }
+        i++;
+    }
+    json_reserve(out, 1);
+    out->buf[out->len++] = '"';
+}
+
+static void json_key_string(json_out_t *out, const char *key, const char *str, size_t len) {
+    json_printf(out, ",\"%s\":", key);
+    json_string(out, str, len);
+}
+
+// 以NUL分隔的字符串数组负载输出为JSON数组
+static void json_string_array(json_out_t *out, const char *key, const char *payload, size_t len) {
+    json_printf(out, ",\"%s\":[", key);
+    size_t pos = 0;
+    while (pos < len) {
+        size_t n = strnlen(payload + pos, len - pos);
+        if (pos > 0) json_raw(out, ",");
+        json_string(out, payload + pos, n);
+        pos += n + 1;
+    }
+    json_raw(out, "]");
+}
+
+static void json_sockaddr(json_out_t *out, const char *payload, size_t payload_len) {
+    if (payload_len < sizeof(sa_family_t)) {
+        json_raw(out, ",\"family\":null");
+        return;
+    }
+
+    struct sockaddr_storage addr;
+    memset(&addr, 0, sizeof(addr));
+    size_t len = payload_len < sizeof(addr) ? payload_len : sizeof(addr);
+    memcpy(&addr, payload, len);
+    char host[INET6_ADDRSTRLEN];
+
+    if (len >= sizeof(struct sockaddr_in) && addr.ss_family == AF_INET) {
+        const struct sockaddr_in *in = (const struct sockaddr_in *)&addr;
+        inet_ntop(AF_INET, &in->sin_addr, host, sizeof(host));
+        json_printf(out, ",\"family\":\"inet\",\"address\":\"%s\",\"port\":%u", host, ntohs(in->sin_port));
+    } else if (len >= sizeof(struct sockaddr_in6) && addr.ss_family == AF_INET6) {
+        const struct sockaddr_in6 *in6 = (const struct sockaddr_in6 *)&addr;
+        inet_ntop(AF_INET6, &in6->sin6_addr, host, sizeof(host));
+        json_printf(out, ",\"family\":\"inet6\",\"address\":\"%s\",\"port\":%u", host, ntohs(in6->sin6_port));
+    } else if (len > offsetof(struct sockaddr_un, sun_path) && addr.ss_family == AF_UNIX) {
+        const struct sockaddr_un *un = (const struct sockaddr_un *)&addr;
+        size_t path_len = len - offsetof(struct sockaddr_un, sun_path);
+        int abstract = un->sun_path[0] == '\0';
+        json_raw(out, ",\"family\":\"unix\"");
+        if (abstract) {
+            json_key_string(out, "path", un->sun_path + 1, path_len - 1);
+        } else {
+            json_key_string(out, "path", un->sun_path, strnlen(un->sun_path, path_len));
+        }
+        json_printf(out, ",\"abstract\":%s", abstract ? "true" : "false");
+    } else {
+        json_printf(out, ",\"family\":%d", addr.ss_family);
+    }
+}
+
+// 标志位输出为名称数组
+static void json_flags(json_out_t *out, int type, uint64_t value) {
+    char names[512];
+    format_flag_names(type, value, names, sizeof(names));
+    json_raw(out, "[");
+    char *saveptr = NULL;
+    int first = 1;
+    for (char *name = strtok_r(names, "|", &saveptr); name; name = strtok_r(NULL, "|", &saveptr)) {
+        json_printf(out, "%s\"%s\"", first ? "" : ",", name);
+        first = 0;
+    }
+    json_raw(out, "]");
+}
+
+// 按描述符输出解码后的参数对象，键为参数名。
+// 路径的解析结果放在"<参数名>_resolved"中，读不到的指针参数为null
+static void json_decoded_args(json_out_t *out, const trace_record_t *rec, const char *blob, size_t len) {
+    const syscall_desc_t *desc = get_syscall_desc(SYSCALL_ABI_NATIVE, rec->syscall_nr);
+    if (!desc) {
+        return;
+    }
+
+    json_raw(out, ",\"decoded\":{");
+    for (int i = 0; i < desc->argc; i++) {
+        const syscall_arg_desc_t *arg = &desc->args[i];
+        uint64_t value = rec->args[i];
+        const char *data;
+        size_t data_len;
+        int found = arg_blob_find(blob, len, i, &data, &data_len) == 0;
+        json_printf(out, "%s\"%s\":", i > 0 ? "," : "", arg->name);
+
+        switch (arg->type) {
+        case ARG_OPEN_FLAGS:
+        case ARG_PROT:
+        case ARG_MMAP_FLAGS:
+        case ARG_CLONE_FLAGS:
+        case ARG_AT_FLAGS:
+            json_flags(out, arg->type, value);
+            continue;
+        case ARG_PATH:
+        case ARG_STRING:
+        case ARG_STRING_ARRAY:
+        case ARG_SOCKADDR:
+        case ARG_BUFFER:
+            break;
+        case ARG_FD:
+        case ARG_DIRFD:
+            json_printf(out, "%d", (int)value);
+            if (found) {
+                json_printf(out, ",\"%s_path\":", arg->name);
+                json_string(out, data, data_len);
+            }
+            continue;
+        default:
+            json_printf(out, "%lld", (long long)value);
+            continue;
+        }
+
+        if (!found) {
+            json_raw(out, "null");
+            continue;
+        }
+        switch (arg->type) {
+        case ARG_PATH: {
+            size_t raw_len = strnlen(data, data_len);
+            json_string(out, data, raw_len);
+            if (raw_len + 1 < data_len) {
+                json_printf(out, ",\"%s_resolved\":", arg->name);
+                json_string(out, data + raw_len + 1, data_len - raw_len - 1);
+            }
+            break;
+        }
+        case ARG_STRING:
+            json_string(out, data, strnlen(data, data_len));
+            break;
+        case ARG_STRING_ARRAY:
+            json_raw(out, "[");
+            for (size_t pos = 0; pos < data_len;) {
+                size_t n = strnlen(data + pos, data_len - pos);
+                if (pos > 0) json_raw(out, ",");
+                json_string(out, data + pos, n);
+                pos += n + 1;
+            }
+            json_raw(out, "]");
+            break;
+        case ARG_SOCKADDR:
+            json_printf(out, "{\"len\":%zu", data_len);
+            json_sockaddr(out, data, data_len);
+            json_raw(out, "}");
+            break;
+        case ARG_BUFFER: {
+            uint64_t total = arg->aux >= 0 ? rec->args[arg->aux] : data_len;
+            json_printf(out, "{\"len\":%llu,\"truncated\":%s,\"preview\":", (unsigned long long)total,
+                        total > data_len ? "true" : "false");
+            json_string(out, data, data_len);
+            json_raw(out, "}");
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    json_raw(out, "}");
+}
+
+static const char *timeout_name(uint64_t reason) {
+    return reason == TIMEOUT_WALL ? "\"wall\"" : reason == TIMEOUT_CPU ? "\"cpu\"" : "null";
+}
+
+// 事件流的第一行，给出沙箱根进程和墙上时间基准（事件时间戳为CLOCK_MONOTONIC）
+void json_write_start(json_out_t *out, uint32_t pid, uint64_t start_realtime_ns) {
+    json_printf(out, "{\"event\":\"start\",\"pid\":%u,\"realtime_ns\":%llu}\n",
+                pid, (unsigned long long)start_realtime_ns);
+}
+
+// 把一条跟踪记录（及其负载）格式化为一行JSON。pid为沙箱根进程，
+// 多个沙箱写入同一个消费者时用来区分事件来源
+void json_write_record(json_out_t *out, uint32_t pid, const trace_record_t *rec, const char *payload) {
+    static const char *const event_names[] = {
+        [TRACE_REC_SYSCALL_ENTRY] = "syscall_entry",
+        [TRACE_REC_SYSCALL_EXIT] = "syscall_exit",
+        [TRACE_REC_FILE_OPEN] = "file_open",
+        [TRACE_REC_EXEC] = "exec",
+        [TRACE_REC_EXEC_ARGV] = "exec_argv",
+        [TRACE_REC_EXEC_ENVP] = "exec_envp",
+        [TRACE_REC_NET_CONNECT] = "net_connect",
+        [TRACE_REC_PROC_EXIT] = "process_exit",
+        [TRACE_REC_PROC_NEW] = "process_new",
+        [TRACE_REC_PROC_EXEC] = "process_exec",
+        [TRACE_REC_TIMEOUT] = "timeout",
+        [TRACE_REC_SYSCALL_STATS] = "syscall_stats",
+        [TRACE_REC_SUMMARY] = "summary",
+        [TRACE_REC_NGRAM] = "ngram",
+        [TRACE_REC_MINHASH] = "minhash",
+        [TRACE_REC_POLICY] = "policy",
+        [TRACE_REC_SIGNAL] = "signal",
+        [TRACE_REC_MEM_DUMP] = "mem_dump",
+    };
+    size_t type_count = sizeof(event_names) / sizeof(event_names[0]);
+    if (rec->type >= type_count || !event_names[rec->type]) {
+        return;
+    }
+
+    if (out->len + JSON_EVENT_MAX(rec->payload_len) > sizeof(out->buf)) {
+        json_out_flush(out);
+    }
+
+    int nr = rec->syscall_nr;
+    int abi = (rec->flags & TRACE_REC_FLAG_COMPAT) ? SYSCALL_ABI_COMPAT : SYSCALL_ABI_NATIVE;
+    json_printf(out, "{\"event\":\"%s\",\"ts_ns\":%llu,\"pid\":%u,\"tid\":%u",
+                event_names[rec->type], (unsigned long long)rec->timestamp_ns, pid, rec->tid);
+
+    switch (rec->type) {
+    case TRACE_REC_SYSCALL_ENTRY:
+    case TRACE_REC_SYSCALL_EXIT:
+    case TRACE_REC_SYSCALL_STATS:
+    case TRACE_REC_POLICY:
+        json_printf(out, ",\"abi\":\"%s\",\"nr\":%d,\"name\":\"%s\"", get_syscall_abi_name(abi), nr,
+                    get_syscall_name_abi(abi, nr));
+        break;
+    default:
+        break;
+    }
+
+    size_t len = rec->payload_len;
+    switch (rec->type) {
+    case TRACE_REC_SYSCALL_ENTRY:
+        // 参数按有符号数输出：AT_FDCWD、-1等常见值保持原样，用户态指针都小于2^63
+        json_printf(out, ",\"args\":[%lld,%lld,%lld,%lld,%lld,%lld]",
+                    (long long)rec->args[0], (long long)rec->args[1], (long long)rec->args[2],
+                    (long long)rec->args[3], (long long)rec->args[4], (long long)rec->args[5]);
+        if (rec->flags & TRACE_REC_FLAG_DECODED) {
+            json_decoded_args(out, rec, payload, len);
+        }
+        break;
+    case TRACE_REC_SYSCALL_EXIT:
+        json_printf(out, ",\"ret\":%lld", (long long)rec->ret);
+        if (rec->flags & TRACE_REC_FLAG_LATENCY) {
+            json_printf(out, ",\"latency_ns\":%llu", (unsigned long long)rec->args[0]);
+        }
+        break;
+    case TRACE_REC_FILE_OPEN:
+    case TRACE_REC_EXEC:
+        if (len > 0) {
+            json_key_string(out, "path", payload, strnlen(payload, len));
+        } else {
+            json_raw(out, ",\"path\":null");
+        }
+        break;
+    case TRACE_REC_EXEC_ARGV:
+        json_string_array(out, "argv", payload, len);
+        break;
+    case TRACE_REC_EXEC_ENVP:
+        json_string_array(out, "envp", payload, len);
+        break;
+    case TRACE_REC_NET_CONNECT:
+        json_printf(out, ",\"fd\":%lld", (long long)rec->args[0]);
+        json_sockaddr(out, payload, len);
+        break;
+    case TRACE_REC_PROC_NEW: {
+        const char *kind = rec->args[1] == PTRACE_EVENT_CLONE ? "clone" :
+                           rec->args[1] == PTRACE_EVENT_VFORK ? "vfork" : "fork";
+        json_printf(out, ",\"child_tid\":%llu,\"kind\":\"%s\"", (unsigned long long)rec->args[0], kind);
+        break;
+    }
+    case TRACE_REC_PROC_EXEC:
+        json_printf(out, ",\"former_tid\":%llu", (unsigned long long)rec->args[0]);
+        break;
+    case TRACE_REC_PROC_EXIT:
+        if ((rec->flags & TRACE_REC_FLAG_SIGNALED) && rec->ret == 0) {
+            // 信号未知（eBPF后端中未调用exit就结束的任务）
+            json_printf(out, ",\"root\":%s,\"signaled\":true,\"signal\":null",
+                        rec->tid == pid ? "true" : "false");
+        } else if (rec->flags & TRACE_REC_FLAG_SIGNALED) {
+            const char *sig = sigabbrev_np((int)rec->ret);
+            json_printf(out, ",\"root\":%s,\"signaled\":true,\"signal\":%lld,\"signal_name\":\"SIG%s\"",
+                        rec->tid == pid ? "true" : "false", (long long)rec->ret, sig ? sig : "UNKNOWN");
+        } else {
+            json_printf(out, ",\"root\":%s,\"signaled\":false,\"exit_code\":%lld",
+                        rec->tid == pid ? "true" : "false", (long long)rec->ret);
+        }
+        break;
+    case TRACE_REC_TIMEOUT:
+        json_printf(out, ",\"reason\":%s,\"limit_ms\":%llu", timeout_name(rec->args[0]),
+                    (unsigned long long)rec->args[1]);
+        break;
+    case TRACE_REC_SYSCALL_STATS:
+        json_printf(out, ",\"count\":%llu,\"total_ns\":%llu,\"p50_ns\":%llu,\"p90_ns\":%llu,"
+                    "\"p99_ns\":%llu,\"max_ns\":%llu",
+                    (unsigned long long)rec->args[0], (unsigned long long)rec->args[1],
+                    (unsigned long long)rec->args[2], (unsigned long long)rec->args[3],
+                    (unsigned long long)rec->args[4], (unsigned long long)rec->args[5]);
+        break;
+    case TRACE_REC_SUMMARY:
+        json_printf(out, ",\"unique_syscalls\":%llu,\"timeout\":%s,\"warp_sleeps\":%llu,"
+                    "\"warp_offset_ns\":%lld",
+                    (unsigned long long)rec->args[0], timeout_name(rec->args[1]),
+                    (unsigned long long)rec->args[2], (long long)rec->ret);
+        break;
+    case TRACE_REC_NGRAM: {
+        int n = rec->args[2] >= NGRAM_MIN && rec->args[2] <= NGRAM_MAX ? (int)rec->args[2] : NGRAM_MIN;
+        json_printf(out, ",\"n\":%d,\"rank\":%llu,\"syscalls\":[", n, (unsigned long long)rec->args[3]);
+        for (int i = 0; i < n; i++) {
+            int compat;
+            const char *name = ngram_token_name(rec->args[0], n, i, &compat);
+            json_printf(out, "%s\"%s%s\"", i > 0 ? "," : "", compat ? "i386:" : "", name);
+        }
+        json_printf(out, "],\"count\":%llu,\"total\":%llu", (unsigned long long)rec->args[1],
+                    (unsigned long long)rec->args[4]);
+        break;
+    }
+    case TRACE_REC_MINHASH: {
+        uint32_t value;
+        json_printf(out, ",\"n\":%llu,\"k\":%zu,\"signature\":\"", (unsigned long long)rec->args[0],
+                    len / sizeof(value));
+        for (size_t pos = 0; pos + sizeof(value) <= len; pos += sizeof(value)) {
+            memcpy(&value, payload + pos, sizeof(value));
+            json_printf(out, "%08x", value);
+        }
+        json_raw(out, "\"");
+        break;
+    }
+    case TRACE_REC_POLICY: {
+        char action[64];
+        format_policy_action((int)rec->args[0], (long)rec->args[1], action, sizeof(action));
+        json_printf(out, ",\"action\":\"%s\",\"line\":%llu,\"enforced_by\":\"%s\"", action,
+                    (unsigned long long)rec->args[2],
+                    rec->args[0] == POLICY_LOG ? "none" : rec->args[3] ? "tracer" : "kernel");
+        break;
+    }
+    case TRACE_REC_SIGNAL: {
+        const char *sig = sigabbrev_np((int)rec->args[0]);
+        json_printf(out, ",\"signal\":%llu,\"signal_name\":\"SIG%s\",\"si_code\":%lld",
+                    (unsigned long long)rec->args[0], sig ? sig : "UNKNOWN", (long long)rec->args[1]);
+        break;
+    }
+    case TRACE_REC_MEM_DUMP:
+        json_printf(out, ",\"trigger\":\"%s\",\"start\":%llu,\"end\":%llu,\"pages\":%llu,"
+                    "\"changed_pages\":%llu,\"status\":\"%s\"",
+                    mem_dump_trigger_name((int)rec->args[3]), (unsigned long long)rec->args[0],
+                    (unsigned long long)rec->args[1], (unsigned long long)rec->args[4],
+                    (unsigned long long)rec->args[5], mem_dump_status_name((int)rec->ret));
+        if (len == SHA256_DIGEST_LEN) {
+            char hex[SHA256_HEX_LEN];
+            sha256_hex((const unsigned char *)payload, hex);
+            json_printf(out, ",\"sha256\":\"%s\"", hex);
+        }
+        break;
+    default:
+        break;
+    }
+    json_raw(out, "}\n");
+}
@@ -0,0 +1,469 @@
+// src/trace_log.c
+#include "sandbox.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <time.h>
+
+#define TRACE_RING_SLOTS (1u << 16)            // 环形缓冲区槽位数（必须是2的幂）
+#define TRACE_RING_MIN_SLOTS (1u << 14)        // 多个生产者时每个环的最少槽位数，容得下最大的负载
+#define TRACE_MERGE_SLOTS 4096                 // 归并输出时暂存区的槽位数
+#define TRACE_WRITER_IDLE_NS 200000            // 缓冲区为空时写线程的休眠时间
+#define TRACE_UNIX_PREFIX "unix:"              // NDJSON输出目标为Unix域套接字时的前缀
+
+// 生产者状态：空闲的生产者在变为忙碌之前不会提交记录，忙碌后提交的记录时间戳不早于变为忙碌的时刻
+enum {
+    TRACE_PRODUCER_IDLE = 0,
+    TRACE_PRODUCER_BUSY,
+};
+
+// 单生产者/单消费者（写线程）无锁环形缓冲区
+typedef struct {
+    trace_record_t *slots;
+    size_t mask;                       // 槽位数 - 1
+    _Alignas(64) atomic_size_t head;   // 生产者写入位置
+    size_t cached_tail;                // 生产者缓存的消费位置，减少跨核读取
+    atomic_int state;                  // TRACE_PRODUCER_*
+    atomic_uint_least64_t busy_ts;     // 最近一次变为忙碌的时刻，之后提交的记录都不早于它
+    _Alignas(64) atomic_size_t tail;   // 消费者读取位置
+    uint64_t last_ts;                  // 写线程最后取出的记录的时间戳
+} trace_ring_t;
+
+// 每个生产者（跟踪线程）一个环形缓冲区。只有一个生产者时写线程直接成批写出槽位；
+// 多个时按时间戳归并，输出仍按时间有序
+struct trace_log {
+    trace_ring_t *rings;
+    int ring_count;
+    int fd;
+    int format;                        // TRACE_FORMAT_*
+    pid_t pid;                         // 沙箱根进程，写入每个JSON事件
+    json_out_t *json;                  // NDJSON模式的输出缓冲区
+    char *payload;                     // NDJSON模式下拼接跨越环尾的负载
+    trace_record_t *merged;            // 归并输出时的暂存区（二进制格式）
+    pthread_t writer;
+    atomic_int stopping;
+};
+
+// 返回单调时钟纳秒时间戳（走vDSO，无系统调用）
+uint64_t trace_timestamp_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// 完整写入一组iovec，处理部分写入
+static int write_all(int fd, struct iovec *iov, int iovcnt) {
+    while (iovcnt > 0) {
+        ssize_t n = writev(fd, iov, iovcnt);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        while (iovcnt > 0 && (size_t)n >= iov->iov_len) {
+            n -= (ssize_t)iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= (size_t)n;
+        }
+    }
+    return 0;
+}
+
+// 二进制格式：已提交的槽位原样写出。可读区间可能跨越环尾，最多分两段
+static void write_binary_batch(trace_log_t *log, trace_ring_t *ring, size_t tail, size_t head) {
+    size_t slot_count = ring->mask + 1;
+    size_t start = tail & ring->mask;
+    size_t count = head - tail;
+    struct iovec iov[2];
+    int iovcnt = 1;
+    size_t first = slot_count - start;
+    if (first >= count) {
+        iov[0].iov_base = &ring->slots[start];
+        iov[0].iov_len = count * sizeof(trace_record_t);
+    } else {
+        iov[0].iov_base = &ring->slots[start];
+        iov[0].iov_len = first * sizeof(trace_record_t);
+        iov[1].iov_base = &ring->slots[0];
+        iov[1].iov_len = (count - first) * sizeof(trace_record_t);
+        iovcnt = 2;
+    }
+
+    if (write_all(log->fd, iov, iovcnt) == -1) {
+        perror("写入二进制跟踪日志失败");
+    }
+}
+
+// NDJSON格式：格式化一条记录，负载拼接到连续的缓冲区中
+static size_t write_json_record(trace_log_t *log, trace_ring_t *ring, size_t tail) {
+    const trace_record_t *rec = &ring->slots[tail & ring->mask];
+    size_t payload_slots = TRACE_PAYLOAD_SLOTS(rec->payload_len);
+    for (size_t i = 0; i < payload_slots; i++) {
+        memcpy(log->payload + i * sizeof(trace_record_t),
+               &ring->slots[(tail + 1 + i) & ring->mask], sizeof(trace_record_t));
+    }
+    json_write_record(log->json, (uint32_t)log->pid, rec, log->payload);
+    return 1 + payload_slots;
+}
+
+// NDJSON格式：逐条格式化到输出缓冲区，整批处理完再写出一次，
+// 消费者能及时看到事件，又不会每个事件一次系统调用
+static void write_json_batch(trace_log_t *log, trace_ring_t *ring, size_t tail, size_t head) {
+    while (tail != head) {
+        tail += write_json_record(log, ring, tail);
+    }
+    json_out_flush(log->json);
+}
+
+// 只有一个生产者：取出所有已提交的槽位，返回取出的槽位数
+static size_t write_single(trace_log_t *log) {
+    trace_ring_t *ring = &log->rings[0];
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (head == tail) {
+        return 0;
+    }
+    if (log->format == TRACE_FORMAT_NDJSON) {
+        write_json_batch(log, ring, tail, head);
+    } else {
+        write_binary_batch(log, ring, tail, head);
+    }
+    atomic_store_explicit(&ring->tail, head, memory_order_release);
+    return head - tail;
+}
+
+static void flush_merged(trace_log_t *log, size_t *staged) {
+    if (*staged == 0) {
+        return;
+    }
+    struct iovec iov = { .iov_base = log->merged, .iov_len = *staged * sizeof(trace_record_t) };
+    if (write_all(log->fd, &iov, 1) == -1) {
+        perror("写入二进制跟踪日志失败");
+    }
+    *staged = 0;
+}
+
+// 多个生产者：按时间戳归并。每个环内的时间戳是递增的，一条记录只有在不晚于所有环今后
+// 可能提交的最早时间戳时才能输出：非空的环取其第一条记录，空的忙碌环取变为忙碌的时刻与
+// 它最后输出的时间戳中较晚的一个，空的空闲环取读状态之前的时钟（之后变为忙碌的生产者
+// 只会提交更晚的记录）。
+// draining为1时所有生产者都已结束，全部输出。返回取出的槽位数
+static size_t write_merged(trace_log_t *log, int draining) {
+    int count = log->ring_count;
+    size_t pos[TRACE_PRODUCERS_MAX], head[TRACE_PRODUCERS_MAX];
+    int idle[TRACE_PRODUCERS_MAX];
+    uint64_t busy_ts[TRACE_PRODUCERS_MAX];
+    uint64_t now = draining ? UINT64_MAX : trace_timestamp_ns();
+    for (int r = 0; r < count; r++) {
+        trace_ring_t *ring = &log->rings[r];
+        // 依次读忙碌时刻、状态和写入位置：看到新的忙碌时刻时，上一段忙碌期间提交的记录都已可见；
+        // 看到空闲时，变为空闲之前提交的记录都已可见
+        busy_ts[r] = atomic_load(&ring->busy_ts);
+        idle[r] = atomic_load(&ring->state) == TRACE_PRODUCER_IDLE;
+        head[r] = atomic_load_explicit(&ring->head, memory_order_acquire);
+        pos[r] = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    }
+
+    size_t taken = 0, staged = 0;
+    for (;;) {
+        int best = -1;
+        uint64_t best_ts = 0, bound = UINT64_MAX;
+        for (int r = 0; r < count; r++) {
+            trace_ring_t *ring = &log->rings[r];
+            if (pos[r] != head[r]) {
+                uint64_t ts = ring->slots[pos[r] & ring->mask].timestamp_ns;
+                if (best == -1 || ts < best_ts) {
+                    best = r;
+                    best_ts = ts;
+                }
+            } else {
+                uint64_t limit = now;
+                if (!idle[r] && !draining) {
+                    limit = busy_ts[r] > ring->last_ts ? busy_ts[r] : ring->last_ts;
+                }
+                if (limit < bound) bound = limit;
+            }
+        }
+        if (best == -1 || best_ts > bound) {
+            break;
+        }
+
+        trace_ring_t *ring = &log->rings[best];
+        size_t slots = 1 + TRACE_PAYLOAD_SLOTS(ring->slots[pos[best] & ring->mask].payload_len);
+        if (log->format == TRACE_FORMAT_NDJSON) {
+            write_json_record(log, ring, pos[best]);
+        } else {
+            if (staged + slots > TRACE_MERGE_SLOTS) {
+                flush_merged(log, &staged);
+            }
+            for (size_t i = 0; i < slots; i++) {
+                log->merged[staged++] = ring->slots[(pos[best] + i) & ring->mask];
+            }
+        }
+        ring->last_ts = best_ts;
+        pos[best] += slots;
+        taken += slots;
+    }
+
+    if (log->format == TRACE_FORMAT_NDJSON) {
+        if (taken > 0) json_out_flush(log->json);
+    } else {
+        flush_merged(log, &staged);
+    }
+    for (int r = 0; r < count; r++) {
+        atomic_store_explicit(&log->rings[r].tail, pos[r], memory_order_release);
+    }
+    return taken;
+}
+
+// 写线程：批量取出已提交的槽位，交给对应格式写出
+static void *trace_writer_thread(void *arg) {
+    trace_log_t *log = arg;
+
+    while (1) {
+        int stopping = atomic_load_explicit(&log->stopping, memory_order_acquire);
+        size_t taken = log->ring_count == 1 ? write_single(log) : write_merged(log, stopping);
+        if (taken > 0) {
+            continue;
+        }
+        // 停止标志之后再确认一次，避免丢掉最后一批记录
+        if (stopping) {
+            break;
+        }
+        struct timespec idle = { 0, TRACE_WRITER_IDLE_NS };
+        nanosleep(&idle, NULL);
+    }
+
+    return NULL;
+}
+
+// 连接消费者监听的Unix域套接字（流式）
+static int connect_unix_socket(const char *path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "套接字路径过长: %s\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        perror("创建套接字失败");
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+        fprintf(stderr, "无法连接事件消费者 %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void trace_log_free(trace_log_t *log) {
+    if (log->fd != -1) {
+        close(log->fd);
+    }
+    for (int r = 0; log->rings && r < log->ring_count; r++) {
+        free(log->rings[r].slots);
+    }
+    free(log->rings);
+    free(log->merged);
+    free(log->json);
+    free(log->payload);
+    free(log);
+}
+
+// 二进制格式写文件头；NDJSON格式输出start事件
+static int write_log_header(trace_log_t *log) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    uint64_t realtime_ns = (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+
+    if (log->format == TRACE_FORMAT_NDJSON) {
+        json_write_start(log->json, (uint32_t)log->pid, realtime_ns);
+        return json_out_flush(log->json);
+    }
+
+    trace_log_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_LOG_MAGIC, sizeof(header.magic));
+    header.version = TRACE_LOG_VERSION;
+    header.record_size = sizeof(trace_record_t);
+    header.pid = (uint32_t)log->pid;
+    header.start_realtime_ns = realtime_ns;
+
+    if (write(log->fd, &header, sizeof(header)) != (ssize_t)sizeof(header)) {
+        perror("写入二进制跟踪日志头失败");
+        return -1;
+    }
+    return 0;
+}
+
+// 创建跟踪日志并启动写线程。二进制格式的target为文件路径；
+// NDJSON格式的target为文件路径（追加写入，批量模式下多个沙箱共用）
+// 或"unix:路径"（连接由消费者监听的流式套接字）。producers为提交记录的线程数，
+// 每个线程用自己的编号调用trace_log_push
+trace_log_t *trace_log_open(const char *target, pid_t pid, int format, int producers) {
+    trace_log_t *log = calloc(1, sizeof(*log));
+    if (!log) {
+        perror("内存分配失败");
+        return NULL;
+    }
+    log->fd = -1;
+    log->format = format;
+    log->pid = pid;
+
+    if (producers < 1) producers = 1;
+    if (producers > TRACE_PRODUCERS_MAX) producers = TRACE_PRODUCERS_MAX;
+    size_t slot_count = TRACE_RING_SLOTS;
+    // 生产者多时缩小每个环，总内存控制在单环的4倍以内
+    while (slot_count > TRACE_RING_MIN_SLOTS && slot_count * (size_t)producers > TRACE_RING_SLOTS * 4) {
+        slot_count /= 2;
+    }
+    log->rings = calloc((size_t)producers, sizeof(*log->rings));
+    log->ring_count = producers;
+    if (!log->rings) {
+        perror("分配跟踪环形缓冲区失败");
+        trace_log_free(log);
+        return NULL;
+    }
+    for (int r = 0; r < producers; r++) {
+        trace_ring_t *ring = &log->rings[r];
+        ring->slots = malloc(slot_count * sizeof(trace_record_t));
+        ring->mask = slot_count - 1;
+        atomic_init(&ring->head, 0);
+        atomic_init(&ring->tail, 0);
+        atomic_init(&ring->state, TRACE_PRODUCER_IDLE);
+        atomic_init(&ring->busy_ts, 0);
+        if (!ring->slots) {
+            perror("分配跟踪环形缓冲区失败");
+            trace_log_free(log);
+            return NULL;
+        }
+    }
+    if (producers > 1 && format != TRACE_FORMAT_NDJSON) {
+        log->merged = malloc(TRACE_MERGE_SLOTS * sizeof(trace_record_t));
+        if (!log->merged) {
+            perror("内存分配失败");
+            trace_log_free(log);
+            return NULL;
+        }
+    }
+
+    int is_socket = 0;
+    if (format == TRACE_FORMAT_NDJSON) {
+        log->json = malloc(sizeof(*log->json));
+        log->payload = malloc(TRACE_PAYLOAD_SLOTS(UINT16_MAX) * sizeof(trace_record_t));
+        if (!log->json || !log->payload) {
+            perror("内存分配失败");
+            trace_log_free(log);
+            return NULL;
+        }
+        if (strncmp(target, TRACE_UNIX_PREFIX, strlen(TRACE_UNIX_PREFIX)) == 0) {
+            log->fd = connect_unix_socket(target + strlen(TRACE_UNIX_PREFIX));
+            is_socket = 1;
+        } else {
+            log->fd = open(target, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+            if (log->fd == -1) {
+                perror("无法创建JSON事件文件");
+            }
+        }
+        json_out_init(log->json, log->fd, is_socket);
+    } else {
+        log->fd = open(target, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (log->fd == -1) {
+            perror("无法创建二进制跟踪日志");
+        }
+    }
+
+    if (log->fd == -1 || write_log_header(log) != 0) {
+        trace_log_free(log);
+        return NULL;
+    }
+
+    atomic_init(&log->stopping, 0);
+
+    // 写线程屏蔽所有信号：监控线程用signalfd接收SIGCHLD，
+    // 若写线程未屏蔽，内核会把进程级的SIGCHLD投递给它而被忽略
+    sigset_t all, saved;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &saved);
+    int err = pthread_create(&log->writer, NULL, trace_writer_thread, log);
+    pthread_sigmask(SIG_SETMASK, &saved, NULL);
+    if (err != 0) {
+        fprintf(stderr, "创建跟踪日志写线程失败\n");
+        trace_log_free(log);
+        return NULL;
+    }
+
+    return log;
+}
+
+// 提交一条记录（及可选负载）。热路径：不格式化、不分配内存，
+// 缓冲区满时让出CPU等待写线程，而不是丢弃记录。多个生产者时调用者须处于忙碌状态
+void trace_log_push(trace_log_t *log, int producer, const trace_record_t *rec, const void *payload,
+                    size_t payload_len) {
+    trace_ring_t *ring = &log->rings[producer];
+    if (payload_len > UINT16_MAX) {
+        payload_len = UINT16_MAX;
+    }
+    size_t slot_count = ring->mask + 1;
+    size_t payload_slots = TRACE_PAYLOAD_SLOTS(payload_len);
+    size_t needed = 1 + payload_slots;
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    while (head + needed - ring->cached_tail > slot_count) {
+        ring->cached_tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        if (head + needed - ring->cached_tail > slot_count) {
+            sched_yield();
+        }
+    }
+
+    trace_record_t *slot = &ring->slots[head & ring->mask];
+    *slot = *rec;
+    slot->payload_len = (uint16_t)payload_len;
+
+    // 负载按槽位逐个拷贝，以处理环尾回绕
+    const char *src = payload;
+    for (size_t i = 0; i < payload_slots; i++) {
+        trace_record_t *dst = &ring->slots[(head + 1 + i) & ring->mask];
+        size_t chunk = payload_len - i * sizeof(trace_record_t);
+        if (chunk > sizeof(trace_record_t)) {
+            chunk = sizeof(trace_record_t);
+        } else {
+            memset((char *)dst + chunk, 0, sizeof(trace_record_t) - chunk);
+        }
+        memcpy(dst, src + i * sizeof(trace_record_t), chunk);
+    }
+
+    atomic_store_explicit(&ring->head, head + needed, memory_order_release);
+}
+
+// 生产者即将阻塞等待（没有要处理的事件），写线程不再等它的记录
+void trace_log_idle(trace_log_t *log, int producer) {
+    atomic_store(&log->rings[producer].state, TRACE_PRODUCER_IDLE);
+}
+
+// 生产者恢复处理事件。先记下时刻再变为忙碌：写线程在这个环为空时以它为界，
+// 不必等到生产者提交下一条记录。顺序一致的存储保证之后读取的时钟不早于写线程看到空闲时读的时钟
+void trace_log_busy(trace_log_t *log, int producer) {
+    atomic_store(&log->rings[producer].busy_ts, trace_timestamp_ns());
+    atomic_store(&log->rings[producer].state, TRACE_PRODUCER_BUSY);
+}
+
+// 停止写线程，落盘剩余记录并释放资源
+void trace_log_close(trace_log_t *log) {
+    if (!log) {
+        return;
+    }
+
+    atomic_store_explicit(&log->stopping, 1, memory_order_release);
+    pthread_join(log->writer, NULL);
+
+    trace_log_free(log);
+}
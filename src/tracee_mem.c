@@ -0,0 +1,262 @@
+// src/tracee_mem.c
+#include "sandbox.h"
+#include <sys/ptrace.h>
+#include <sys/uio.h>
+
+// 页大小在进程生命周期内不变，只查询一次
+static size_t tracee_page_size(void) {
+    static size_t page_size = 0;
+    if (page_size == 0) {
+        long ret = sysconf(_SC_PAGESIZE);
+        page_size = ret > 0 ? (size_t)ret : 4096;
+    }
+    return page_size;
+}
+
+// 距离下一个页边界的字节数
+static size_t bytes_to_page_end(unsigned long addr) {
+    size_t page_size = tracee_page_size();
+    return page_size - (addr & (page_size - 1));
+}
+
+// 逐字读取（PTRACE_PEEKDATA），仅在/proc/<tid>/mem打不开时使用
+static ssize_t peek_tracee_memory(pid_t pid, unsigned long addr, void *buf, size_t len) {
+    char *dst = buf;
+    size_t done = 0;
+
+    while (done < len) {
+        // 按字对齐读取，再截取需要的字节
+        unsigned long word_addr = (addr + done) & ~(sizeof(long) - 1);
+        size_t offset = (addr + done) - word_addr;
+
+        errno = 0;
+        long word = ptrace(PTRACE_PEEKDATA, pid, word_addr, NULL);
+        if (errno != 0) {
+            break;
+        }
+
+        size_t chunk = sizeof(long) - offset;
+        if (chunk > len - done) {
+            chunk = len - done;
+        }
+        memcpy(dst + done, (char *)&word + offset, chunk);
+        done += chunk;
+    }
+
+    if (done == 0 && len > 0) {
+        return -1;
+    }
+    return (ssize_t)done;
+}
+
+static int open_tracee_mem(pid_t pid) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/mem", pid);
+    return open(path, O_RDONLY | O_CLOEXEC);
+}
+
+// 经/proc/<tid>/mem读取，在第一个未映射的页处停止
+static ssize_t pread_tracee_memory(int mem_fd, unsigned long addr, void *buf, size_t len) {
+    ssize_t n = pread(mem_fd, buf, len, (off_t)addr);
+    return n > 0 ? n : -1;
+}
+
+// 强制读取不跨页的一段内存。process_vm_readv遵守页的读权限，而/proc/<tid>/mem的读取
+// 与PEEKDATA一样带FOLL_FORCE，一次pread就能读完整页
+static ssize_t force_read_tracee(pid_t pid, unsigned long addr, void *buf, size_t len) {
+    int fd = open_tracee_mem(pid);
+    if (fd == -1) {
+        return peek_tracee_memory(pid, addr, buf, len);
+    }
+    ssize_t n = pread_tracee_memory(fd, addr, buf, len);
+    close(fd);
+    return n;
+}
+
+// 读取被跟踪进程的一段内存，返回实际读到的字节数（从起始地址连续可读的部分）。
+// 批量读取在不可读页处中断时只强制读取这一页，然后从下一页继续批量读取
+ssize_t read_tracee_memory(pid_t pid, unsigned long addr, void *buf, size_t len) {
+    if (len == 0) {
+        return 0;
+    }
+
+    size_t done = 0;
+    while (done < len) {
+        struct iovec local = { .iov_base = (char *)buf + done, .iov_len = len - done };
+        struct iovec remote = { .iov_base = (void *)(addr + done), .iov_len = len - done };
+        ssize_t n = process_vm_readv(pid, &local, 1, &remote, 1, 0);
+        if (n > 0) {
+            // 部分读取时下一轮从中断的页开始，在那里失败后再强制读取
+            done += (size_t)n;
+            continue;
+        }
+
+        size_t chunk = bytes_to_page_end(addr + done);
+        if (chunk > len - done) {
+            chunk = len - done;
+        }
+        n = force_read_tracee(pid, addr + done, (char *)buf + done, chunk);
+        if (n <= 0) {
+            break;
+        }
+        done += (size_t)n;
+        if ((size_t)n < chunk) {
+            break;
+        }
+    }
+    return done > 0 ? (ssize_t)done : -1;
+}
+
+// 读取被跟踪进程中的以NUL结尾的字符串。
+// 按页边界分块批量读取，用memchr查找结束符；返回字符串长度，失败返回-1
+ssize_t read_tracee_string(pid_t pid, unsigned long addr, char *str, size_t maxlen) {
+    if (maxlen == 0) {
+        return -1;
+    }
+
+    size_t done = 0;
+    while (done < maxlen - 1) {
+        // 单次读取不跨页，避免后一页不可读导致整块失败
+        size_t chunk = bytes_to_page_end(addr + done);
+        if (chunk > maxlen - 1 - done) {
+            chunk = maxlen - 1 - done;
+        }
+
+        struct iovec local = { .iov_base = str + done, .iov_len = chunk };
+        struct iovec remote = { .iov_base = (void *)(addr + done), .iov_len = chunk };
+        ssize_t n = process_vm_readv(pid, &local, 1, &remote, 1, 0);
+        if (n <= 0) {
+            // 页没有读权限时process_vm_readv失败，强制读取这一页
+            n = force_read_tracee(pid, addr + done, str + done, chunk);
+            if (n <= 0) {
+                str[done] = '\0';
+                return done > 0 ? (ssize_t)done : -1;
+            }
+        }
+
+        char *nul = memchr(str + done, '\0', (size_t)n);
+        if (nul) {
+            return nul - str;
+        }
+        done += (size_t)n;
+    }
+
+    str[maxlen - 1] = '\0';
+    return (ssize_t)(maxlen - 1);
+}
+
+// 读取以NULL结尾的指针数组（如execve的argv/envp），返回读到的指针数量
+int read_tracee_pointer_array(pid_t pid, unsigned long addr, unsigned long *ptrs, int max_count) {
+    if (addr == 0 || max_count <= 0) {
+        return 0;
+    }
+
+    ssize_t n = read_tracee_memory(pid, addr, ptrs, (size_t)max_count * sizeof(unsigned long));
+    if (n <= 0) {
+        return -1;
+    }
+
+    int count = (int)(n / (ssize_t)sizeof(unsigned long));
+    for (int i = 0; i < count; i++) {
+        if (ptrs[i] == 0) {
+            return i;
+        }
+    }
+    return count;
+}
+
+// 写入被跟踪进程的内存，返回0表示全部写入。
+// 先用process_vm_writev，目标页不可写时退回PTRACE_POKEDATA（逐字读-改-写）
+int write_tracee_memory(pid_t pid, unsigned long addr, const void *buf, size_t len) {
+    if (len == 0) {
+        return 0;
+    }
+
+    struct iovec local = { .iov_base = (void *)buf, .iov_len = len };
+    struct iovec remote = { .iov_base = (void *)addr, .iov_len = len };
+    if (process_vm_writev(pid, &local, 1, &remote, 1, 0) == (ssize_t)len) {
+        return 0;
+    }
+
+    const char *src = buf;
+    size_t done = 0;
+    while (done < len) {
+        unsigned long word_addr = (addr + done) & ~(sizeof(long) - 1);
+        size_t offset = (addr + done) - word_addr;
+        size_t chunk = sizeof(long) - offset;
+        if (chunk > len - done) {
+            chunk = len - done;
+        }
+
+        long word = 0;
+        if (offset != 0 || chunk != sizeof(long)) {
+            errno = 0;
+            word = ptrace(PTRACE_PEEKDATA, pid, word_addr, NULL);
+            if (errno != 0) {
+                return -1;
+            }
+        }
+        memcpy((char *)&word + offset, src + done, chunk);
+        if (ptrace(PTRACE_POKEDATA, pid, word_addr, word) == -1) {
+            return -1;
+        }
+        done += chunk;
+    }
+    return 0;
+}
+
+// 在一次process_vm_readv中读取多段内存（一次停止内的所有参数）。
+// 内核在第一段读取失败处停止，之后的各段打开一次/proc/<tid>/mem逐段pread补读：
+// 每段一次系统调用，与段的大小和其中不可读的页数无关（转储的可执行区域可能是--x）。
+// 打不开时逐段退回read_tracee_memory。返回实际调用process_vm_readv之外的补读次数
+int read_tracee_batch(pid_t pid, tracee_read_t *reads, int count) {
+    struct iovec local[count > 0 ? count : 1];
+    struct iovec remote[count > 0 ? count : 1];
+    int iovcnt = 0;
+    for (int i = 0; i < count; i++) {
+        reads[i].result = -1;
+        if (reads[i].len == 0) {
+            reads[i].result = 0;
+            continue;
+        }
+        local[iovcnt].iov_base = reads[i].buf;
+        local[iovcnt].iov_len = reads[i].len;
+        remote[iovcnt].iov_base = (void *)reads[i].addr;
+        remote[iovcnt].iov_len = reads[i].len;
+        iovcnt++;
+    }
+    if (iovcnt == 0) {
+        return 0;
+    }
+
+    ssize_t n = process_vm_readv(pid, local, (unsigned long)iovcnt, remote, (unsigned long)iovcnt, 0);
+    size_t done = n > 0 ? (size_t)n : 0;
+
+    int retries = 0, mem_fd = -1, mem_opened = 0;
+    for (int i = 0; i < count; i++) {
+        if (reads[i].len == 0) {
+            continue;
+        }
+        if (done >= reads[i].len) {
+            reads[i].result = (ssize_t)reads[i].len;
+            done -= reads[i].len;
+            continue;
+        }
+        // 读取在这一段中断：这一段及之后的各段单独补读
+        done = 0;
+        if (!mem_opened) {
+            mem_fd = open_tracee_mem(pid);
+            mem_opened = 1;
+        }
+        if (mem_fd != -1) {
+            reads[i].result = pread_tracee_memory(mem_fd, reads[i].addr, reads[i].buf, reads[i].len);
+        } else {
+            reads[i].result = read_tracee_memory(pid, reads[i].addr, reads[i].buf, reads[i].len);
+        }
+        retries++;
+    }
+    if (mem_fd != -1) {
+        close(mem_fd);
+    }
+    return retries;
+}
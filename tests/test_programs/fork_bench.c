@@ -0,0 +1,115 @@
+// tests/test_programs/fork_bench.c
+// 多进程测试程序：同时派生多个工作进程，各自执行大量系统调用。
+// 分别用 --tracer-threads=1 和 --tracer-threads=N 运行，比较耗时即为多个跟踪线程的加速；
+// 程序同时检查迁移对样本不可见：父进程收不到子进程的停止通知，
+// 子进程继承的信号掩码不变，fork后立即收到的信号不会丢失
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+static volatile sig_atomic_t got_usr1;
+
+static void on_usr1(int sig) {
+    (void)sig;
+    got_usr1 = 1;
+}
+
+// 工作进程：检查继承的状态，然后反复执行getppid/open/close，退出码表示检查结果
+static int worker(int index, long iterations, pid_t parent) {
+    sigset_t mask;
+    sigprocmask(SIG_SETMASK, NULL, &mask);
+    if (!sigismember(&mask, SIGUSR2) || sigismember(&mask, SIGUSR1)) {
+        fprintf(stderr, "工作进程 %d: 信号掩码被改变\n", index);
+        return 2;
+    }
+
+    long done = 0;
+    for (long i = 0; i < iterations; i++) {
+        if (getppid() != parent) {
+            fprintf(stderr, "工作进程 %d: 父进程号不符\n", index);
+            return 3;
+        }
+        int fd = open("/", O_RDONLY | O_DIRECTORY);
+        if (fd == -1) {
+            perror("open失败");
+            return 4;
+        }
+        close(fd);
+        done++;
+    }
+
+    // 父进程在fork之后立即发送了SIGUSR1，信号丢失时由alarm结束等待
+    sigdelset(&mask, SIGUSR1);
+    alarm(10);
+    while (!got_usr1) {
+        sigsuspend(&mask);
+    }
+    return done == iterations ? 0 : 5;
+}
+
+int main(int argc, char *argv[]) {
+    int workers = argc > 1 ? atoi(argv[1]) : 8;
+    long iterations = argc > 2 ? atol(argv[2]) : 20000;
+    if (workers <= 0 || iterations <= 0) {
+        printf("用法: %s [工作进程数] [每个进程的循环次数]\n", argv[0]);
+        return 1;
+    }
+    printf("多进程测试程序启动: %d 个工作进程，每个 %ld 次循环\n", workers, iterations);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_usr1;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGUSR1, &sa, NULL);
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGUSR2);
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pid_t *pids = calloc((size_t)workers, sizeof(*pids));
+    if (!pids) {
+        perror("内存分配失败");
+        return 1;
+    }
+    pid_t parent = getpid();
+    for (int i = 0; i < workers; i++) {
+        pids[i] = fork();
+        if (pids[i] == -1) {
+            perror("fork失败");
+            return 1;
+        }
+        if (pids[i] == 0) {
+            _exit(worker(i, iterations, parent));
+        }
+        kill(pids[i], SIGUSR1);
+    }
+
+    // WUNTRACED：子进程进入停止状态时这里会看到
+    int failed = 0, stopped = 0;
+    for (int i = 0; i < workers; i++) {
+        int status;
+        while (waitpid(pids[i], &status, WUNTRACED) == pids[i] && WIFSTOPPED(status)) {
+            stopped++;
+            kill(pids[i], SIGCONT);
+        }
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            failed++;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    free(pids);
+
+    double elapsed = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("耗时: %.3f 秒，%.0f 次系统调用/秒\n", elapsed, (double)workers * (double)iterations * 3 / elapsed);
+    printf("失败的工作进程: %d，观察到的停止: %d\n", failed, stopped);
+    printf("测试%s\n", failed == 0 && stopped == 0 ? "完成" : "失败");
+    return failed == 0 && stopped == 0 ? 0 : 1;
+}
@@ -0,0 +1,295 @@
+// tools/malbox_decode.c
+// 将二进制跟踪日志(/tmp/malbox_syscall_<pid>.bin)离线转换为文本日志格式，
+// 或用--json转换为与--json实时输出相同的NDJSON事件流
+#include "sandbox.h"
+#include <sys/ptrace.h>
+
+#define DECODE_MAX_TIDS 1024  // 同时跟踪入口时间的线程数上限
+
+// 每个线程上一次系统调用入口的时间戳，用于计算执行时间
+typedef struct {
+    uint32_t tid;
+    uint64_t entry_ns;
+} decode_thread_t;
+
+typedef struct {
+    uint32_t root_pid;
+    decode_thread_t threads[DECODE_MAX_TIDS];
+    int thread_count;
+    latency_hist_t latency[SYSCALL_ABI_COUNT][SYSCALL_MAX];
+} decode_state_t;
+
+static decode_thread_t *lookup_thread(decode_state_t *state, uint32_t tid) {
+    for (int i = 0; i < state->thread_count; i++) {
+        if (state->threads[i].tid == tid) {
+            return &state->threads[i];
+        }
+    }
+    if (state->thread_count == DECODE_MAX_TIDS) {
+        return NULL;
+    }
+    decode_thread_t *thread = &state->threads[state->thread_count++];
+    thread->tid = tid;
+    thread->entry_ns = 0;
+    return thread;
+}
+
+// 输出以NUL分隔的字符串数组负载
+static void print_string_array(const char *label, const trace_record_t *rec, const char *payload) {
+    printf("[%u] [EXEC] %s (%d):", rec->tid, label, (int)rec->args[0]);
+    size_t pos = 0;
+    while (pos < rec->payload_len) {
+        size_t len = strnlen(payload + pos, rec->payload_len - pos);
+        printf(" \"%.*s\"", (int)len, payload + pos);
+        pos += len + 1;
+    }
+    printf("\n");
+}
+
+static void decode_record(decode_state_t *state, const trace_record_t *rec, const char *payload) {
+    int nr = rec->syscall_nr;
+    int abi = (rec->flags & TRACE_REC_FLAG_COMPAT) ? SYSCALL_ABI_COMPAT : SYSCALL_ABI_NATIVE;
+    const char *abi_prefix = abi == SYSCALL_ABI_COMPAT ? "i386:" : "";
+    uint32_t tid = rec->tid;
+    decode_thread_t *thread = lookup_thread(state, tid);
+
+    switch (rec->type) {
+    case TRACE_REC_SYSCALL_ENTRY:
+        if (thread) {
+            thread->entry_ns = rec->timestamp_ns;
+        }
+        printf("[%u] [ENTRY] syscall %d (%s%s), args: %lx, %lx, %lx, %lx, %lx, %lx\n",
+               tid, nr, abi_prefix, get_syscall_name_abi(abi, nr),
+               (unsigned long)rec->args[0], (unsigned long)rec->args[1], (unsigned long)rec->args[2],
+               (unsigned long)rec->args[3], (unsigned long)rec->args[4], (unsigned long)rec->args[5]);
+        if (rec->flags & TRACE_REC_FLAG_DECODED) {
+            printf("[%u] [ARGS] ", tid);
+            format_syscall_args(stdout, nr, rec->args, payload, rec->payload_len);
+            printf("\n");
+        }
+        break;
+    case TRACE_REC_SYSCALL_EXIT: {
+        // 优先使用跟踪器记录的延迟，旧日志退回到记录时间戳之差
+        uint64_t latency_ns = 0;
+        if (rec->flags & TRACE_REC_FLAG_LATENCY) {
+            latency_ns = rec->args[0];
+        } else if (thread && thread->entry_ns != 0) {
+            latency_ns = rec->timestamp_ns - thread->entry_ns;
+        }
+        if (nr >= 0 && nr < SYSCALL_MAX) {
+            latency_hist_record(&state->latency[abi][nr], latency_ns);
+        }
+        printf("[%u] [EXIT] syscall %d (%s%s), result: %ld, time: %.2f us\n",
+               tid, nr, abi_prefix, get_syscall_name_abi(abi, nr), (long)rec->ret,
+               (double)latency_ns / 1e3);
+        if (abi != SYSCALL_ABI_NATIVE) {
+            break;
+        }
+        if ((nr == __NR_open || nr == __NR_openat) && rec->ret >= 0) {
+            printf("[%u] [FILE] Successfully opened file, fd: %ld\n", tid, (long)rec->ret);
+        } else if (nr == __NR_connect && rec->ret == 0) {
+            printf("[%u] [NET] Successfully connected\n", tid);
+        }
+        break;
+    }
+    case TRACE_REC_FILE_OPEN:
+        printf("[%u] [FILE] Attempting to open: %.*s\n", tid, (int)rec->payload_len, payload);
+        break;
+    case TRACE_REC_EXEC:
+        printf("[%u] [EXEC] Executing: %.*s\n", tid, (int)rec->payload_len, payload);
+        break;
+    case TRACE_REC_EXEC_ARGV:
+        print_string_array("argv", rec, payload);
+        break;
+    case TRACE_REC_EXEC_ENVP:
+        print_string_array("envp", rec, payload);
+        break;
+    case TRACE_REC_NET_CONNECT: {
+        char addr_str[128] = "<无法读取>";
+        if (rec->payload_len > 0) {
+            struct sockaddr_storage addr;
+            memset(&addr, 0, sizeof(addr));
+            size_t len = rec->payload_len < sizeof(addr) ? rec->payload_len : sizeof(addr);
+            memcpy(&addr, payload, len);
+            format_sockaddr(&addr, len, addr_str, sizeof(addr_str));
+        }
+        printf("[%u] [NET] Attempting to connect, socket fd: %ld, address: %s\n",
+               tid, (long)rec->args[0], addr_str);
+        break;
+    }
+    case TRACE_REC_PROC_NEW: {
+        const char *kind = rec->args[1] == PTRACE_EVENT_CLONE ? "clone" :
+                           rec->args[1] == PTRACE_EVENT_VFORK ? "vfork" : "fork";
+        printf("[%u] [PROC] 新任务: %lu (%s)\n", tid, (unsigned long)rec->args[0], kind);
+        break;
+    }
+    case TRACE_REC_PROC_EXEC:
+        printf("[%u] [PROC] execve完成 (原tid: %lu)\n", tid, (unsigned long)rec->args[0]);
+        break;
+    case TRACE_REC_PROC_EXIT: {
+        const char *who = tid == state->root_pid ? "进程" : "任务";
+        if ((rec->flags & TRACE_REC_FLAG_SIGNALED) && rec->ret == 0) {
+            // eBPF后端看不到未调用exit的任务的终止信号
+            printf("\n[%u] [INFO] %s结束 (未调用exit，可能被信号终止)\n", tid, who);
+        } else if (rec->flags & TRACE_REC_FLAG_SIGNALED) {
+            printf("\n[%u] [INFO] %s被信号终止: %ld\n", tid, who, (long)rec->ret);
+        } else {
+            printf("\n[%u] [INFO] %s正常退出，状态码: %ld\n", tid, who, (long)rec->ret);
+        }
+        break;
+    }
+    case TRACE_REC_TIMEOUT:
+        printf("\n[%u] [TIMEOUT] 超过%s时间限制 %.1f 秒，终止沙箱\n", tid,
+               rec->args[0] == TIMEOUT_CPU ? "CPU" : "墙上", (double)rec->args[1] / 1000.0);
+        break;
+    case TRACE_REC_SYSCALL_STATS:
+    case TRACE_REC_SUMMARY:
+        // 跟踪器的统计；文本输出由下面的print_statistics根据事件重新计算
+        break;
+    case TRACE_REC_NGRAM: {
+        int n = rec->args[2] >= NGRAM_MIN && rec->args[2] <= NGRAM_MAX ? (int)rec->args[2] : NGRAM_MIN;
+        if (rec->args[3] == 1) {
+            printf("\n===== 系统调用序列 (%d-gram, 共 %llu 个，计数为估计值) =====\n", n,
+                   (unsigned long long)rec->args[4]);
+        }
+        print_ngram_entry(stdout, (int)rec->args[3], rec->args[0], n, rec->args[1], rec->args[4]);
+        break;
+    }
+    case TRACE_REC_MINHASH: {
+        uint32_t signature[MINHASH_SIZE];
+        size_t count = rec->payload_len / sizeof(uint32_t);
+        count = count < MINHASH_SIZE ? count : MINHASH_SIZE;
+        memcpy(signature, payload, count * sizeof(uint32_t));
+        print_minhash_signature(stdout, signature, (int)count);
+        break;
+    }
+    case TRACE_REC_POLICY: {
+        char action[64];
+        format_policy_action((int)rec->args[0], (long)rec->args[1], action, sizeof(action));
+        printf("[%u] [POLICY] %s %s (第%llu行，%s)\n", tid, action, get_syscall_name(nr),
+               (unsigned long long)rec->args[2],
+               rec->args[0] == POLICY_LOG ? "仅记录" : rec->args[3] ? "跟踪器执行" : "内核执行");
+        break;
+    }
+    case TRACE_REC_SIGNAL: {
+        const char *sig = sigabbrev_np((int)rec->args[0]);
+        printf("[%u] [SIGNAL] 转发信号 SIG%s (%llu), si_code: %lld\n", tid, sig ? sig : "UNKNOWN",
+               (unsigned long long)rec->args[0], (long long)rec->args[1]);
+        break;
+    }
+    case TRACE_REC_MEM_DUMP: {
+        mem_dump_region_t region = {
+            .start = rec->args[0], .end = rec->args[1],
+            .pages = (int)rec->args[4], .changed_pages = (int)rec->args[5], .status = (int)rec->ret,
+        };
+        if (rec->payload_len == SHA256_DIGEST_LEN) {
+            memcpy(region.digest, payload, SHA256_DIGEST_LEN);
+        }
+        char line[256];
+        format_mem_dump((int)rec->args[3], &region, line, sizeof(line));
+        printf("[%u] [DUMP] %s\n", tid, line);
+        break;
+    }
+    default:
+        printf("[UNKNOWN] 记录类型 %u\n", rec->type);
+        break;
+    }
+}
+
+static void print_statistics(const decode_state_t *state) {
+    int unique_syscalls = 0;
+
+    printf("\n===== 系统调用统计 =====\n");
+    for (int abi = 0; abi < SYSCALL_ABI_COUNT; abi++) {
+        for (int i = 0; i < SYSCALL_MAX; i++) {
+            if (state->latency[abi][i].count == 0) continue;
+
+            char label[64];
+            snprintf(label, sizeof(label), "%s%s", abi == SYSCALL_ABI_COMPAT ? "i386:" : "",
+                     get_syscall_name_abi(abi, i));
+            print_latency_stats(stdout, label, i, &state->latency[abi][i]);
+            unique_syscalls++;
+        }
+    }
+    printf("\n系统调用监控完成，共记录 %d 种不同的系统调用\n", unique_syscalls);
+}
+
+int main(int argc, char *argv[]) {
+    int json = argc == 3 && strcmp(argv[1], "--json") == 0;
+    if (argc != 2 && !json) {
+        printf("用法: %s [--json] <malbox_syscall_PID.bin>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    const char *path = argv[argc - 1];
+
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        perror("打开二进制跟踪日志失败");
+        return EXIT_FAILURE;
+    }
+
+    trace_log_header_t header;
+    if (fread(&header, sizeof(header), 1, fp) != 1 ||
+        memcmp(header.magic, TRACE_LOG_MAGIC, sizeof(header.magic)) != 0) {
+        fprintf(stderr, "错误: '%s' 不是MalBox二进制跟踪日志\n", path);
+        fclose(fp);
+        return EXIT_FAILURE;
+    }
+    if (header.version != TRACE_LOG_VERSION || header.record_size != sizeof(trace_record_t)) {
+        fprintf(stderr, "错误: 不支持的日志版本 %u (记录大小 %u)\n", header.version, header.record_size);
+        fclose(fp);
+        return EXIT_FAILURE;
+    }
+
+    decode_state_t *state = calloc(1, sizeof(*state));
+    if (!state) {
+        perror("内存分配失败");
+        fclose(fp);
+        return EXIT_FAILURE;
+    }
+
+    state->root_pid = header.pid;
+
+    json_out_t *out = NULL;
+    if (json) {
+        out = malloc(sizeof(*out));
+        if (!out) {
+            perror("内存分配失败");
+            free(state);
+            fclose(fp);
+            return EXIT_FAILURE;
+        }
+        json_out_init(out, STDOUT_FILENO, 0);
+        json_write_start(out, header.pid, header.start_realtime_ns);
+    } else {
+        printf("===== MalBox系统调用监控 =====\n");
+        printf("目标进程: %u\n\n", header.pid);
+    }
+
+    // 负载最长UINT16_MAX字节，按整槽位读取
+    static char payload[TRACE_PAYLOAD_SLOTS(UINT16_MAX) * sizeof(trace_record_t)];
+    trace_record_t rec;
+    while (fread(&rec, sizeof(rec), 1, fp) == 1) {
+        size_t payload_size = TRACE_PAYLOAD_SLOTS(rec.payload_len) * sizeof(trace_record_t);
+        if (payload_size > 0 && fread(payload, payload_size, 1, fp) != 1) {
+            fprintf(stderr, "警告: 日志在记录负载中途截断\n");
+            break;
+        }
+        if (out) {
+            json_write_record(out, header.pid, &rec, payload);
+        } else {
+            decode_record(state, &rec, payload);
+        }
+    }
+
+    if (out) {
+        json_out_flush(out);
+        free(out);
+    } else {
+        print_statistics(state);
+    }
+
+    free(state);
+    fclose(fp);
+    return 0;
+}